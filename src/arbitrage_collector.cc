@@ -1,5 +1,6 @@
 #include "websocket/binance_book_ticker_stream.hpp"
 #include "websocket/kraken_websocket_client.hpp"
+#include "db/capture_file_writer.hpp"
 #include "db/mongo_ticker_consumer.hpp"
 #include "db/mongo_client.hpp"
 #include "utils/config.hpp"
@@ -13,6 +14,7 @@
 #include <boost/log/utility/setup/common_attributes.hpp>
 
 #include <iostream>
+#include <memory>
 #include <thread>
 
 namespace logging = boost::log;
@@ -29,18 +31,33 @@ int main(int argc, char* argv[]) {
 
     std::string config_path(argv[1]);
     auto config_json = cryptobot::GetConfigJson(config_path);
-    // TODO: take credentials from parameter store
-    std::string pass("DRt99xd4o7PMfygqotE8");
-    MongoClient* mongo_client =
-            MongoClient::GetInstance()->CreatePool("mongodb://" + config_json["user"].get<std::string>() + ":" + pass
-            + "@" + config_json["host"].get<std::string>() + ":" + config_json["port"].get<std::string>()
-            + "/?authSource=" + config_json["authSource"].get<std::string>());
-    std::cout << "Created Mongo client pool" << std::endl;
-    pass.clear();
+    // Either capture to a local file for offline replay, or store in Mongo
+    std::unique_ptr<CaptureFileWriter> capture_writer;
+    std::unique_ptr<MongoTickerConsumer> mongo_consumer;
+    ExchangeListener* consumer = nullptr;
+    if (config_json.contains("capture_file")) {
+        capture_writer = std::make_unique<CaptureFileWriter>(config_json["capture_file"].get<std::string>(),
+                config_json.value("capture_flush_rows", CaptureFileWriter::DEFAULT_FLUSH_ROWS));
+        consumer = capture_writer.get();
+        std::cout << "Capturing to " << config_json["capture_file"].get<std::string>() << std::endl;
+    } else {
+        // TODO: take credentials from parameter store
+        std::string pass("DRt99xd4o7PMfygqotE8");
+        MongoClient* mongo_client =
+                MongoClient::GetInstance()->CreatePool("mongodb://" + config_json["user"].get<std::string>() + ":" + pass
+                + "@" + config_json["host"].get<std::string>() + ":" + config_json["port"].get<std::string>()
+                + "/?authSource=" + config_json["authSource"].get<std::string>());
+        std::cout << "Created Mongo client pool" << std::endl;
+        pass.clear();
 
-    MongoTickerConsumer mongo_consumer(mongo_client, config_json["db"].get<std::string>(), config_json["collection"].get<std::string>());
-    BinanceBookTickerStream binance_websocket_client(&mongo_consumer);
-    KrakenWebsocketClient kraken_websocket_client(&mongo_consumer);
+        MongoWriterOptions writer_options;
+        writer_options.flush_interval = std::chrono::milliseconds(config_json.value("flush_interval_ms", 1000));
+        writer_options.max_batch_size = config_json.value("flush_batch_size", 4096);
+        mongo_consumer = std::make_unique<MongoTickerConsumer>(mongo_client, config_json["db"].get<std::string>(), config_json["collection"].get<std::string>(), writer_options);
+        consumer = mongo_consumer.get();
+    }
+    BinanceBookTickerStream binance_websocket_client(consumer);
+    KrakenWebsocketClient kraken_websocket_client(consumer);
 
     std::promise<void> binance_promise;
     std::future<void> binance_future = binance_promise.get_future();
@@ -98,6 +115,14 @@ int main(int argc, char* argv[]) {
     // std::this_thread::sleep_for(wait_time);
     // kraken_websocket_client.SubscribeOrderBook("XLM/XBT");
 
-    // Just wait for now
-    std::this_thread::sleep_until(std::chrono::time_point<std::chrono::system_clock>::max());
+    // Report writer health, or flush the capture file periodically
+    for (;;) {
+        std::this_thread::sleep_for(std::chrono::minutes(1));
+        if (capture_writer) {
+            // Bounds what is lost if the collector dies
+            capture_writer->Flush();
+        } else {
+            BOOST_LOG_TRIVIAL(info) << "Mongo writer stats: " << mongo_consumer->GetStats();
+        }
+    }
 }
@@ -1,5 +1,8 @@
 #include "backtest/backtest_exchange_client.hpp"
 #include "backtest/backtest_results_processor.h"
+#include "backtest/parallel_replay_runner.hpp"
+#include "backtest/parameter_sweep.hpp"
+#include "backtest/sharded_backtest.hpp"
 #include "exchange/exchange_client.h"
 #include "http/binance_client.hpp"
 #include "db/mongo_client.hpp"
@@ -14,16 +17,162 @@
 #include <boost/log/trivial.hpp>
 #include <boost/log/expressions.hpp>
 
+#include <algorithm>
 #include <cerrno>
 #include <fstream>
+#include <initializer_list>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
 
 namespace logging = boost::log;
 namespace keywords = boost::log::keywords;
 
+namespace {
+
+// Parameters that can be swept, see ArbitrageBacktest
+const char* const SWEEP_PARAMETERS[] = {
+  "arbitrage_match_profit_margin",
+  "min_trade_interval_us",
+  "max_ticker_age_us",
+  "max_ticker_delay_us",
+  "order_qty_multiplier",
+  "binance_fee",
+  "binance_network_latency_us",
+  "binance_execution_delay_us",
+  "kraken_fee",
+  "kraken_network_latency_us",
+  "kraken_execution_delay_us",
+};
+
+const std::initializer_list<SymbolId> RESULT_ASSETS = {SymbolId::USDT, SymbolId::BTC, SymbolId::ETH, SymbolId::ADA};
+
+// Initial balances on each exchange
+const std::unordered_map<SymbolId, double> INITIAL_BALANCES = {
+  {SymbolId::ADA, 10000.0},
+  {SymbolId::BTC, 1.0},
+  {SymbolId::ETH, 10.0},
+  {SymbolId::USDT, 24000}
+};
+
+// Equity valued in USDT, starting from the initial balances of both exchanges
+std::unique_ptr<BacktestResultsProcessor> CreateResultsProcessor(const std::string& results_file) {
+  ResultsOptions options;
+  options.valuation_asset = SymbolId::USDT;
+  auto results_processor = std::make_unique<BacktestResultsProcessor>(results_file, RESULT_ASSETS, options);
+  for (const char* exchange : {"binance", "kraken"}) {
+    results_processor->SetInitialBalance(AccountBalance(INITIAL_BALANCES, exchange));
+  }
+  return results_processor;
+}
+
+/**
+ * Backtest clients and strategy of one run, parameters missing from the set take the default values.
+ */
+struct ArbitrageBacktest {
+  /**
+   * @param balance_listener receives balance updates of both clients
+   * @param latency_config latency model config per exchange, see LatencyModel::FromJson()
+   */
+  ArbitrageBacktest(AccountBalanceListener& balance_listener, const std::unordered_map<SymbolId, double>& initial_balances,
+      const ParameterGrid::ParameterSet& params, const cryptobot::json& latency_config)
+      : binance_backtest_client(CreateBacktestSettings("binance", 0.00075, 500000, initial_balances, params, latency_config),
+            balance_listener, &scheduler),
+        kraken_backtest_client(CreateBacktestSettings("kraken", 0.0020, 200000, initial_balances, params, latency_config),
+            balance_listener, &scheduler),
+        arbitrage_strategy(CreateStrategyOptions(params)) {
+    arbitrage_strategy.RegisterExchangeClient("binance", &binance_backtest_client);
+    arbitrage_strategy.RegisterExchangeClient("kraken", &kraken_backtest_client);
+  }
+
+  // First latencies recorded from the data, then clients, so that execution price is same as seen price
+  std::vector<ExchangeListener*> GetListeners() {
+    std::vector<ExchangeListener*> listeners;
+    for (const auto& latency_model : latency_models) {
+      if (auto* recorded = dynamic_cast<RecordedLatencyModel*>(latency_model.get())) {
+        listeners.push_back(recorded);
+      }
+    }
+    listeners.insert(listeners.end(), {&binance_backtest_client, &kraken_backtest_client, &arbitrage_strategy});
+    return listeners;
+  }
+
+  BacktestSettings CreateBacktestSettings(const std::string& exchange, double fee, uint64_t network_latency_us,
+      const std::unordered_map<SymbolId, double>& initial_balances, const ParameterGrid::ParameterSet& params, const cryptobot::json& latency_config) {
+    BacktestSettings settings;
+    // TODO: FIXME: slippage value per pair
+    settings.exchange = exchange;
+    settings.slippage = 0;
+    settings.fee = ParameterGrid::GetValue(params, exchange + "_fee", fee);
+    settings.network_latency_us = ParameterGrid::GetValue(params, exchange + "_network_latency_us", network_latency_us);
+    settings.execution_delay_us = ParameterGrid::GetValue(params, exchange + "_execution_delay_us", 20000);
+    settings.initial_balances = initial_balances;
+    if (latency_config.contains(exchange)) {
+      settings.latency_model = LatencyModel::FromJson(latency_config[exchange]);
+      latency_models.push_back(settings.latency_model);
+    }
+    return settings;
+  }
+
+  static ArbitrageStrategyOptions CreateStrategyOptions(const ParameterGrid::ParameterSet& params) {
+    const uint64_t max_ticker_age_us = ParameterGrid::GetValue(params, "max_ticker_age_us", 1000000); // 1s
+    const uint64_t max_ticker_delay_us = ParameterGrid::GetValue(params, "max_ticker_delay_us", 1000000); // 1s
+    ArbitrageStrategyOptions strategy_opts;
+    ExchangeParams binance_params;
+    binance_params.slippage = 0.0;
+    binance_params.fee = ParameterGrid::GetValue(params, "binance_fee", 0.00075);
+    binance_params.daily_volume = 10.0;
+    binance_params.max_ticker_age_us = max_ticker_age_us;
+    binance_params.max_ticker_delay_us = max_ticker_delay_us;
+    ExchangeParams kraken_params;
+    kraken_params.slippage = 0.0;
+    kraken_params.fee = ParameterGrid::GetValue(params, "kraken_fee", 0.0020);
+    kraken_params.daily_volume = 2.0;
+    kraken_params.max_ticker_age_us = max_ticker_age_us;
+    kraken_params.max_ticker_delay_us = max_ticker_delay_us;
+    strategy_opts.exchange_params = {
+      { "binance", binance_params },
+      { "kraken", kraken_params }
+    };
+    strategy_opts.default_amount = {
+      {SymbolId::ADA, 50},
+      {SymbolId::BTC, 0.001},
+      {SymbolId::DOT, 1.5},
+      {SymbolId::ETH, 0.03},
+      {SymbolId::EOS, 12},
+      {SymbolId::XLM, 100},
+    };
+    const double order_qty_multiplier = ParameterGrid::GetValue(params, "order_qty_multiplier", 1.0);
+    for (auto& p : strategy_opts.default_amount) {
+      p.second *= order_qty_multiplier;
+    }
+    strategy_opts.min_amount = {
+      {SymbolId::ADA, 25},
+      {SymbolId::BTC, 0.0002},
+      {SymbolId::DOT, 0.5},
+      {SymbolId::ETH, 0.005},
+      {SymbolId::EOS, 2.5},
+      {SymbolId::XLM, 20},
+    };
+    strategy_opts.min_trade_interval_us = ParameterGrid::GetValue(params, "min_trade_interval_us", 0);
+    strategy_opts.arbitrage_match_profit_margin = ParameterGrid::GetValue(params, "arbitrage_match_profit_margin", 0);
+    strategy_opts.time_provider_fcn = [](const Ticker& ticker) { return ticker.arrived_ts; };
+    return strategy_opts;
+  }
+
+  // Simulated clock shared by the clients
+  EventScheduler scheduler;
+  std::vector<std::shared_ptr<LatencyModel>> latency_models;
+  BacktestExchangeClient binance_backtest_client;
+  BacktestExchangeClient kraken_backtest_client;
+  ArbitrageStrategy arbitrage_strategy;
+};
+
+}
+
 int main(int argc, char* argv[]) {
   if (argc < 2) {
     std::cerr << "Please provide configuration file" << std::endl;
@@ -44,87 +193,111 @@ int main(int argc, char* argv[]) {
   std::cout << "Created Mongo client pool" << std::endl;
   pass.clear();
 
-  BacktestResultsProcessor backtest_results_processor("backtest_results.csv", {SymbolId::USDT, SymbolId::BTC, SymbolId::ETH, SymbolId::ADA});
-  BacktestSettings binance_backtest_settings;
-  // TODO: FIXME: slippage value per pair
-  binance_backtest_settings.exchange = "binance";
-  binance_backtest_settings.slippage = 0;
-  binance_backtest_settings.fee = 0.00075;
-  binance_backtest_settings.network_latency_us = 500000;
-  binance_backtest_settings.execution_delay_us = 20000;
-  binance_backtest_settings.initial_balances = {
-    {SymbolId::ADA, 10000.0},
-    {SymbolId::BTC, 1.0},
-    {SymbolId::ETH, 10.0},
-    {SymbolId::USDT, 24000}
-  };
-  BacktestExchangeClient binance_backtest_client(binance_backtest_settings, backtest_results_processor);
-  BacktestSettings kraken_backtest_settings;
-  kraken_backtest_settings.exchange = "kraken";
-  kraken_backtest_settings.slippage = 0;
-  kraken_backtest_settings.fee = 0.0020;
-  kraken_backtest_settings.network_latency_us = 200000;
-  kraken_backtest_settings.execution_delay_us = 20000;
-  kraken_backtest_settings.initial_balances = {
-    {SymbolId::ADA, 10000.0},
-    {SymbolId::BTC, 1.0},
-    {SymbolId::ETH, 10.0},
-    {SymbolId::USDT, 24000}
-  };
-  BacktestExchangeClient kraken_backtest_client(kraken_backtest_settings, backtest_results_processor);
-
-  ArbitrageStrategyOptions strategy_opts;
-  ExchangeParams binance_params;
-  binance_params.slippage = 0.0;
-  binance_params.fee = 0.00075;
-  binance_params.daily_volume = 10.0;
-  binance_params.max_ticker_age_us = 1000000; // 1s
-  binance_params.max_ticker_delay_us = 1000000; // 1s
-  ExchangeParams kraken_params;
-  kraken_params.slippage = 0.0;
-  kraken_params.fee = 0.0020;
-  kraken_params.daily_volume = 2.0;
-  kraken_params.max_ticker_age_us = 1000000; // 1s
-  kraken_params.max_ticker_delay_us = 1000000; // 1s
-  strategy_opts.exchange_params = {
-    { "binance", binance_params },
-    { "kraken", kraken_params }
-  };
-  strategy_opts.default_amount = {
-    {SymbolId::ADA, 50},
-    {SymbolId::BTC, 0.001},
-    {SymbolId::DOT, 1.5},
-    {SymbolId::ETH, 0.03},
-    {SymbolId::EOS, 12},
-    {SymbolId::XLM, 100},
-  };
-  strategy_opts.min_amount = {
-    {SymbolId::ADA, 25},
-    {SymbolId::BTC, 0.0002},
-    {SymbolId::DOT, 0.5},
-    {SymbolId::ETH, 0.005},
-    {SymbolId::EOS, 2.5},
-    {SymbolId::XLM, 20},
-  };
-  strategy_opts.min_trade_interval_us = 0;
-  strategy_opts.arbitrage_match_profit_margin = 0;
-  strategy_opts.time_provider_fcn = [](const Ticker& ticker) { return ticker.arrived_ts; };
-  ArbitrageStrategy arbitrage_strategy(strategy_opts);
-  arbitrage_strategy.RegisterExchangeClient("binance", &binance_backtest_client);
-  arbitrage_strategy.RegisterExchangeClient("kraken", &kraken_backtest_client);
-
+  // Eg. {"binance": {"type": "pareto", "min_us": 100000, "alpha": 2.5, "max_us": 2000000}}
+  const cryptobot::json latency_config = config_json.contains("latency") ? config_json["latency"] : cryptobot::json::object();
   MongoTickerProducer mongo_producer(mongo_client, config_json["db"].get<std::string>(), config_json["collection"].get<std::string>());
-  // First register clients, so that execution price is same as seen price
-  mongo_producer.Register(&binance_backtest_client);
-  mongo_producer.Register(&kraken_backtest_client);
-  mongo_producer.Register(&arbitrage_strategy);
+  if (config_json.contains("sweep") && config_json.contains("shards")) {
+    std::cerr << "sweep and shards can not be combined" << std::endl;
+    return -1;
+  }
+  if (config_json.contains("shards")) {
+    // Sharded mode, symbols are split between backtests replayed in parallel, each with its share of the balances
+    std::vector<SymbolPairId> symbols;
+    for (int i = 0; i < SymbolPairId::UNKNOWN; ++i) {
+      symbols.push_back(static_cast<SymbolPairId>(i));
+    }
+    const auto shards = SymbolSharding::Partition(symbols, config_json["shards"].get<size_t>());
+    const auto allocations = SymbolSharding::AllocateBalances(INITIAL_BALANCES, shards);
+    ParallelReplayOptions shard_options;
+    shard_options.threads = shards.size();
+    ParallelReplayRunner shard_runner(shard_options);
+    std::vector<std::unique_ptr<ShardBalanceRecorder>> recorders;
+    std::vector<std::unique_ptr<ArbitrageBacktest>> backtests;
+    for (size_t i = 0; i < shards.size(); ++i) {
+      recorders.push_back(std::make_unique<ShardBalanceRecorder>(i));
+      backtests.push_back(std::make_unique<ArbitrageBacktest>(*recorders.back(), allocations[i], ParameterGrid::ParameterSet(), latency_config));
+      recorders.back()->SetClock(&backtests.back()->scheduler);
+      shard_runner.AddInstance(backtests.back()->GetListeners(), shards[i]);
+    }
+    std::cout << "Replaying " << symbols.size() << " symbols in " << shards.size() << " shards" << std::endl;
+
+    mongo_producer.Register(&shard_runner);
+    int64_t count = mongo_producer.Produce();
+    shard_runner.Finish();
+    std::cout << "Produced " + std::to_string(count) + " tickers" << std::endl;
+
+    // Merged in simulated time order, so the results do not depend on thread scheduling. Without equity,
+    // prices at the time of the updates are gone by the merge
+    BacktestResultsProcessor results_processor("backtest_results.csv", RESULT_ASSETS);
+    for (size_t i = 0; i < shards.size(); ++i) {
+      for (const char* exchange : {"binance", "kraken"}) {
+        results_processor.SetInitialBalance(AccountBalance(allocations[i], ShardBalanceRecorder::GetShardExchange(exchange, i)));
+      }
+    }
+    std::vector<const ShardBalanceRecorder*> recorder_ptrs;
+    for (const auto& recorder : recorders) {
+      recorder_ptrs.push_back(recorder.get());
+    }
+    ShardBalanceRecorder::Merge(recorder_ptrs, results_processor);
+
+    const auto& balances = results_processor.GetCumulativeBalances();
+    BOOST_LOG_TRIVIAL(info) << "Balances size: " << balances.size();
+    BOOST_LOG_TRIVIAL(info) << balances;
+    return 0;
+  }
+  if (!config_json.contains("sweep")) {
+    auto results_processor = CreateResultsProcessor("backtest_results.csv");
+    ArbitrageBacktest backtest(*results_processor, INITIAL_BALANCES, ParameterGrid::ParameterSet(), latency_config);
+    mongo_producer.Register(results_processor.get());
+    // First register clients, so that execution price is same as seen price
+    for (auto* listener : backtest.GetListeners()) {
+      mongo_producer.Register(listener);
+    }
+    int64_t count = mongo_producer.Produce();
+    std::cout << "Produced " + std::to_string(count) + " tickers" << std::endl;
+
+    const auto& balances = results_processor->GetCumulativeBalances();
+    BOOST_LOG_TRIVIAL(info) << "Balances size: " << balances.size();
+    BOOST_LOG_TRIVIAL(info) << balances;
+    BOOST_LOG_TRIVIAL(info) << results_processor->GetMetrics();
+    return 0;
+  }
+
+  // Sweep mode, the data is read once and replayed into one backtest per parameter set
+  ParameterGrid grid = ParameterGrid::FromJson(config_json["sweep"]);
+  for (const auto& name : grid.GetNames()) {
+    if (std::find(std::begin(SWEEP_PARAMETERS), std::end(SWEEP_PARAMETERS), name) == std::end(SWEEP_PARAMETERS)) {
+      std::cerr << "Unknown sweep parameter " << name << std::endl;
+      return -1;
+    }
+  }
+  ParallelReplayOptions sweep_options;
+  if (config_json.contains("sweep_threads")) {
+    sweep_options.threads = config_json["sweep_threads"].get<size_t>();
+  }
+  ParallelReplayRunner sweep_runner(sweep_options);
+  const auto parameter_sets = grid.Expand();
+  std::vector<std::unique_ptr<BacktestResultsProcessor>> results_processors;
+  std::vector<std::unique_ptr<ArbitrageBacktest>> backtests;
+  for (size_t i = 0; i < parameter_sets.size(); ++i) {
+    results_processors.push_back(CreateResultsProcessor("backtest_results_" + std::to_string(i) + ".csv"));
+    backtests.push_back(std::make_unique<ArbitrageBacktest>(*results_processors.back(), INITIAL_BALANCES, parameter_sets[i], latency_config));
+    auto listeners = backtests.back()->GetListeners();
+    listeners.push_back(results_processors.back().get());
+    sweep_runner.AddInstance(listeners);
+  }
+  std::cout << "Sweeping " << parameter_sets.size() << " parameter sets on " << sweep_options.threads << " threads" << std::endl;
 
+  mongo_producer.Register(&sweep_runner);
   int64_t count = mongo_producer.Produce();
+  sweep_runner.Finish();
   std::cout << "Produced " + std::to_string(count) + " tickers" << std::endl;
 
-  const auto& balances = backtest_results_processor.GetCumulativeBalances();
-  BOOST_LOG_TRIVIAL(info) << "Balances size: " << balances.size();
-  BOOST_LOG_TRIVIAL(info) << balances;
+  for (size_t i = 0; i < backtests.size(); ++i) {
+    BOOST_LOG_TRIVIAL(info) << "Run " << i << " (" << ParameterGrid::ToString(parameter_sets[i]) << "), balances:";
+    BOOST_LOG_TRIVIAL(info) << results_processors[i]->GetCumulativeBalances();
+    BOOST_LOG_TRIVIAL(info) << results_processors[i]->GetMetrics();
+  }
 
   return 0;
 }
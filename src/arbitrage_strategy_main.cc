@@ -1,5 +1,9 @@
+#include "backtest/backtest_exchange_client.hpp"
+#include "db/capture_file_reader.hpp"
 #include "exchange/account_manager_impl.h"
 #include "exchange/exchange_listener.h"
+#include "exchange/failover_exchange_listener.hpp"
+#include "exchange/feed_arbiter.hpp"
 #include "http/binance_client.hpp"
 #include "http/kraken_client.hpp"
 #include "model/symbol.h"
@@ -7,7 +11,11 @@
 #include "websocket/binance_book_ticker_stream.hpp"
 #include "websocket/binance_user_data_stream.hpp"
 #include "websocket/kraken_user_data_stream.hpp"
+#include "websocket/feed_replayer.hpp"
 #include "websocket/kraken_websocket_client.hpp"
+#include "websocket/replay_messages.hpp"
+#include "utils/config.hpp"
+#include "utils/event_loop.hpp"
 
 #include <boost/log/core.hpp>
 #include <boost/log/trivial.hpp>
@@ -18,7 +26,9 @@
 
 #include <future>
 #include <iostream>
+#include <memory>
 #include <thread>
+#include <vector>
 
 namespace logging = boost::log;
 namespace keywords = boost::log::keywords;
@@ -32,13 +42,50 @@ void InitLogging() {
   logging::add_common_attributes();
 }
 
-int main(int argc, char* argv[]) {
-  (void)argc;
-  (void)argv;
+class NoopAccountBalanceListener : public AccountBalanceListener {
+public:
+  virtual void OnAccountBalanceUpdate(const AccountBalance&) override {}
+};
+
+// Client of replay mode, orders are accepted but never filled since it gets no market data: it is not
+// thread safe, and would be fed by the capture reader while the strategy sends orders from the stream threads
+std::unique_ptr<ExchangeClient> CreatePaperClient(const std::string& exchange, AccountBalanceListener& balance_listener) {
+  BacktestSettings settings{};
+  settings.exchange = exchange;
+  return std::make_unique<BacktestExchangeClient>(settings, balance_listener);
+}
 
+// Runs the stream on the event loop it is assigned to, if any
+void AssignEventLoop(WebsocketClient& stream, const std::string& name, const cryptobot::EventLoopGroup& event_loops) {
+  if (cryptobot::EventLoop* event_loop = event_loops.GetStreamLoop(name)) {
+    stream.set_event_loop(*event_loop);
+  }
+}
+
+/**
+ * Usage: arbitrage_main [config.json]
+ *
+ * With a capture file in the config, eg. {"capture_file": "arbitrage.cap", "speed": 10}, recorded market data
+ * is injected into the market data streams instead of connecting to exchanges (see FeedReplayer), orders go
+ * to paper clients that never fill them and stream latencies are logged at the end of the replay.
+ *
+ * Streams run on threads of their own, unless assigned to a shared event loop (see cryptobot::EventLoopGroup)
+ * in "event_loops", eg. {"event_loops": {"feeds": {"cpu": 2, "busy_poll": true, "streams": ["binance_book_ticker",
+ * "kraken"]}}}. Streams are named binance_user_data, kraken_user_data, binance_book_ticker and kraken.
+ *
+ * With eg. {"feed_connections": 2}, market data streams have redundant connections, arbitrated message by message
+ * (see FeedArbiter), or standing by with {"feed_arbitration": false} (see FailoverExchangeListener). The additional
+ * connections are named binance_book_ticker_1, kraken_1 and so on.
+ */
+int main(int argc, char* argv[]) {
   InitLogging();
   BOOST_LOG_TRIVIAL(info) << "Boost logging configured";
 
+  const cryptobot::json config = argc > 1 ? cryptobot::GetConfigJson(argv[1]) : cryptobot::json::object();
+  const bool replay = config.contains("capture_file");
+  cryptobot::EventLoopGroup event_loops(config.value("event_loops", cryptobot::json::object()));
+  event_loops.Start();
+
   ArbitrageStrategyOptions strategy_opts;
   ExchangeParams binance_params;
   binance_params.exchange_name = "binance";
@@ -80,81 +127,107 @@ int main(int argc, char* argv[]) {
   // The margin is applied to both sides
   strategy_opts.arbitrage_match_profit_margin = 0.00015;
 
-  BinanceClient binance_client;
-  AccountManagerImpl binance_account_manager(&binance_client);
-  KrakenClient kraken_client;
-  AccountManagerImpl kraken_account_manager(&kraken_client);
-
-  BinanceUserDataStream binance_stream = BinanceUserDataStream::Create(binance_account_manager);
-  std::promise<void> binance_stream_promise;
-  std::future<void> binance_user_future = binance_stream_promise.get_future();
-  binance_stream.start(std::move(binance_stream_promise));
-  binance_user_future.wait();
-
-  KrakenUserDataStream kraken_stream(kraken_account_manager);
-  std::promise<void> kraken_stream_promise;
-  std::future<void> kraken_user_future = kraken_stream_promise.get_future();
-  kraken_stream.start(std::move(kraken_stream_promise));
-  kraken_user_future.wait();
+  NoopAccountBalanceListener paper_balance_listener;
+  std::unique_ptr<ExchangeClient> binance_client = replay ? CreatePaperClient("binance", paper_balance_listener) : std::make_unique<BinanceClient>();
+  AccountManagerImpl binance_account_manager(binance_client.get());
+  std::unique_ptr<ExchangeClient> kraken_client = replay ? CreatePaperClient("kraken", paper_balance_listener) : std::make_unique<KrakenClient>();
+  AccountManagerImpl kraken_account_manager(kraken_client.get());
+
+  // User data streams, there are no accounts to follow in replay mode
+  std::unique_ptr<BinanceUserDataStream> binance_stream;
+  std::unique_ptr<KrakenUserDataStream> kraken_stream;
+  if (!replay) {
+    // Initialized in place, a started stream can't be moved
+    binance_stream.reset(new BinanceUserDataStream(BinanceUserDataStream::Create(binance_account_manager)));
+    AssignEventLoop(*binance_stream, "binance_user_data", event_loops);
+    std::promise<void> binance_stream_promise;
+    std::future<void> binance_user_future = binance_stream_promise.get_future();
+    binance_stream->start(std::move(binance_stream_promise));
+    binance_user_future.wait();
+
+    kraken_stream = std::make_unique<KrakenUserDataStream>(kraken_account_manager);
+    AssignEventLoop(*kraken_stream, "kraken_user_data", event_loops);
+    std::promise<void> kraken_stream_promise;
+    std::future<void> kraken_user_future = kraken_stream_promise.get_future();
+    kraken_stream->start(std::move(kraken_stream_promise));
+    kraken_user_future.wait();
+  }
 
   ArbitrageStrategy arbitrage_strategy(strategy_opts);
   arbitrage_strategy.RegisterExchangeClient("binance", &binance_account_manager);
   arbitrage_strategy.RegisterExchangeClient("kraken", &kraken_account_manager);
 
-  BinanceBookTickerStream binance_websocket_client(&arbitrage_strategy);
-  KrakenWebsocketClient kraken_websocket_client(&arbitrage_strategy, false);
-
-  std::promise<void> binance_promise;
-  std::future<void> binance_future = binance_promise.get_future();
-  binance_websocket_client.start(std::move(binance_promise));
-  std::promise<void> kraken_promise;
-  std::future<void> kraken_future = kraken_promise.get_future();
-  kraken_websocket_client.start(std::move(kraken_promise));
-  binance_future.wait();
-  kraken_future.wait();
-
-  auto wait_time = 500ms;
-  // TODO: subscribe with a single request, pass all symbols as initializer_list with single method, before starting
-  // See https://github.com/binance/binance-spot-api-docs/blob/master/web-socket-streams.md#subscribe-to-a-stream
-  binance_websocket_client.SubscribeTicker("btcusdt");
-  std::this_thread::sleep_for(wait_time);
-  binance_websocket_client.SubscribeTicker("adausdt");
-  std::this_thread::sleep_for(wait_time);
-  binance_websocket_client.SubscribeTicker("dotusdt");
-  std::this_thread::sleep_for(wait_time);
-  binance_websocket_client.SubscribeTicker("eosusdt");
-  std::this_thread::sleep_for(wait_time);
-  binance_websocket_client.SubscribeTicker("ethusdt");
-  std::this_thread::sleep_for(wait_time);
-  binance_websocket_client.SubscribeTicker("adabtc");
-  std::this_thread::sleep_for(wait_time);
-  binance_websocket_client.SubscribeTicker("dotbtc");
-  std::this_thread::sleep_for(wait_time);
-  binance_websocket_client.SubscribeTicker("eosbtc");
-  std::this_thread::sleep_for(wait_time);
-  binance_websocket_client.SubscribeTicker("eoseth");
-  std::this_thread::sleep_for(wait_time);
-  binance_websocket_client.SubscribeTicker("ethbtc");
-
-  kraken_websocket_client.SubscribeBookTicker("XBT/USDT");
-  std::this_thread::sleep_for(wait_time);
-  kraken_websocket_client.SubscribeBookTicker("ADA/USDT");
-  std::this_thread::sleep_for(wait_time);
-  kraken_websocket_client.SubscribeBookTicker("DOT/USDT");
-  std::this_thread::sleep_for(wait_time);
-  kraken_websocket_client.SubscribeBookTicker("EOS/USDT");
-  std::this_thread::sleep_for(wait_time);
-  kraken_websocket_client.SubscribeBookTicker("ETH/USDT");
-  std::this_thread::sleep_for(wait_time);
-  kraken_websocket_client.SubscribeBookTicker("ADA/XBT");
-  std::this_thread::sleep_for(wait_time);
-  kraken_websocket_client.SubscribeBookTicker("DOT/XBT");
-  std::this_thread::sleep_for(wait_time);
-  kraken_websocket_client.SubscribeBookTicker("EOS/XBT");
-  std::this_thread::sleep_for(wait_time);
-  kraken_websocket_client.SubscribeBookTicker("EOS/ETH");
-  std::this_thread::sleep_for(wait_time);
-  kraken_websocket_client.SubscribeBookTicker("ETH/XBT");
-
-  std::this_thread::sleep_until(std::chrono::time_point<std::chrono::system_clock>::max());
+  // Redundant connections of each market data stream, either all arbitrated, the first copy of each
+  // message reaching the strategy, or hot standbys taking over when the active connection disconnects
+  const size_t connections = replay ? 1 : config.value<size_t>("feed_connections", 1);
+  const bool arbitrate = config.value("feed_arbitration", true);
+  FeedArbiter binance_arbiter(arbitrage_strategy, connections, "binance");
+  FeedArbiter kraken_arbiter(arbitrage_strategy, connections, "kraken");
+  FailoverExchangeListener binance_failover(arbitrage_strategy, connections);
+  FailoverExchangeListener kraken_failover(arbitrage_strategy, connections);
+  auto connection_listener = [&](FeedArbiter& arbiter, FailoverExchangeListener& failover, size_t i) -> ExchangeListener* {
+    if (connections == 1) {
+      return &arbitrage_strategy;
+    }
+    return arbitrate ? arbiter.GetConnectionListener(i) : failover.GetConnectionListener(i);
+  };
+  // Started streams can't be moved
+  std::vector<std::unique_ptr<BinanceBookTickerStream>> binance_streams;
+  std::vector<std::unique_ptr<KrakenWebsocketClient>> kraken_streams;
+  std::vector<std::future<void>> stream_futures;
+  for (size_t i = 0; i < connections; ++i) {
+    const std::string suffix = i == 0 ? "" : "_" + std::to_string(i);
+    binance_streams.push_back(std::make_unique<BinanceBookTickerStream>(connection_listener(binance_arbiter, binance_failover, i)));
+    kraken_streams.push_back(std::make_unique<KrakenWebsocketClient>(connection_listener(kraken_arbiter, kraken_failover, i), false));
+    AssignEventLoop(*binance_streams.back(), "binance_book_ticker" + suffix, event_loops);
+    AssignEventLoop(*kraken_streams.back(), "kraken" + suffix, event_loops);
+    // Sent in a single message once connected
+    binance_streams.back()->SubscribeTickers({"btcusdt", "adausdt", "dotusdt", "eosusdt", "ethusdt", "adabtc", "dotbtc", "eosbtc", "eoseth", "ethbtc"});
+    kraken_streams.back()->SubscribeBookTickers({"XBT/USDT", "ADA/USDT", "DOT/USDT", "EOS/USDT", "ETH/USDT", "ADA/XBT", "DOT/XBT", "EOS/XBT", "EOS/ETH", "ETH/XBT"});
+
+    std::promise<void> binance_promise;
+    stream_futures.push_back(binance_promise.get_future());
+    std::promise<void> kraken_promise;
+    stream_futures.push_back(kraken_promise.get_future());
+    if (replay) {
+      binance_streams.back()->start_replay(std::move(binance_promise));
+      kraken_streams.back()->start_replay(std::move(kraken_promise));
+    } else {
+      binance_streams.back()->start(std::move(binance_promise));
+      kraken_streams.back()->start(std::move(kraken_promise));
+    }
+  }
+  for (auto& future : stream_futures) {
+    future.wait();
+  }
+  BinanceBookTickerStream& binance_websocket_client = *binance_streams.front();
+  KrakenWebsocketClient& kraken_websocket_client = *kraken_streams.front();
+
+  if (replay) {
+    FeedReplayOptions replay_options;
+    replay_options.speed = config.value("speed", 1.0);
+    FeedReplayer replayer(replay_options);
+    replayer.AddBookTickerStream("binance", "binance", binance_websocket_client, replay_messages::BinanceBookTicker);
+    // Recorded Kraken tickers or books, both go to the book stream
+    replayer.AddBookTickerStream("kraken", "kraken", kraken_websocket_client, replay_messages::KrakenTicker);
+    replayer.AddOrderBookStream("kraken", "kraken", kraken_websocket_client, replay_messages::KrakenBook);
+    CaptureFileReader capture_reader(config["capture_file"].get<std::string>());
+    capture_reader.Register(&replayer);
+    capture_reader.Produce();
+    replayer.Finish();
+    replayer.LogReport();
+    binance_websocket_client.stop_replay();
+    kraken_websocket_client.stop_replay();
+    // Before the streams of the loops are gone
+    event_loops.Stop();
+    return 0;
+  }
+
+  for (;;) {
+    std::this_thread::sleep_for(std::chrono::minutes(1));
+    if (connections > 1 && arbitrate) {
+      binance_arbiter.LogReport();
+      kraken_arbiter.LogReport();
+    }
+  }
 }
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "event_scheduler.hpp"
+
+#include "exchange/exchange_listener.h"
+#include "utils/checkpoint.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Saves a checkpoint of the components of a backtest every `interval_us` of simulated time,
+ * to `<path_prefix>_<timestamp>.ckpt`. Registered with the producer after all other listeners,
+ * so a checkpoint holds the state right after an event, and a run resumed from it continues
+ * with the next one.
+ *
+ * Scheduled order events can't be saved. A checkpoint due while orders are in flight is taken
+ * at the first event after the scheduler ran empty.
+ */
+class BacktestCheckpointer : public ExchangeListener {
+public:
+  /**
+   * @param scheduler simulated clock of the backtest clients
+   * @throws std::invalid_argument if interval_us is 0
+   */
+  BacktestCheckpointer(const std::string& path_prefix, uint64_t interval_us, const EventScheduler& scheduler)
+      : m_path_prefix(path_prefix), m_interval_us(interval_us), m_scheduler(scheduler), m_next_ts(0) {
+    if (interval_us == 0) {
+      throw std::invalid_argument("BacktestCheckpointer: interval must be positive");
+    }
+  }
+
+  /**
+   * @param name section of the component's state, restored with Checkpoint::Restore()
+   */
+  void Add(const std::string& name, const cryptobot::Checkpointable* component) {
+    m_components.emplace_back(name, component);
+  }
+
+  const std::vector<std::string>& GetPaths() const {
+    return m_paths;
+  }
+
+  static std::string GetPath(const std::string& path_prefix, uint64_t ts) {
+    return path_prefix + "_" + std::to_string(ts) + ".ckpt";
+  }
+
+  virtual void OnConnectionOpen(const std::string&) override {}
+
+  virtual void OnConnectionClose(const std::string&) override {}
+
+  virtual void OnBookTicker(const Ticker& ticker) override {
+    OnEvent(ticker.arrived_ts);
+  }
+
+  virtual void OnTradeTicker(const TradeTicker& ticker) override {
+    OnEvent(ticker.arrived_ts);
+  }
+
+  virtual void OnOrderBookUpdate(const OrderBook& order_book) override {
+    OnEvent(order_book.GetLastUpdate().arrived_ts);
+  }
+
+private:
+  void OnEvent(uint64_t ts) {
+    // Checkpoints at multiples of the interval, the first one after the first interval of replayed data
+    if (m_next_ts == 0) {
+      m_next_ts = (ts / m_interval_us + 1) * m_interval_us;
+      return;
+    }
+    if (ts < m_next_ts || !m_scheduler.empty()) {
+      return;
+    }
+    cryptobot::Checkpoint checkpoint(ts);
+    for (const auto& p : m_components) {
+      checkpoint.Add(p.first, *p.second);
+    }
+    const std::string path = GetPath(m_path_prefix, ts);
+    checkpoint.Save(path);
+    m_paths.push_back(path);
+    BOOST_LOG_TRIVIAL(info) << "Saved checkpoint " << path;
+    m_next_ts = (ts / m_interval_us + 1) * m_interval_us;
+  }
+
+  std::string m_path_prefix;
+  uint64_t m_interval_us;
+  const EventScheduler& m_scheduler;
+  uint64_t m_next_ts;
+  std::vector<std::pair<std::string, const cryptobot::Checkpointable*>> m_components;
+  std::vector<std::string> m_paths;
+};
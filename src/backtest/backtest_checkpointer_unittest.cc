@@ -0,0 +1,158 @@
+#include "backtest_checkpointer.hpp"
+#include "backtest_exchange_client.hpp"
+
+#include "db/capture_file_reader.hpp"
+#include "db/capture_file_writer.hpp"
+#include "model/ticker_test_utils.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <unistd.h>
+
+using namespace testing;
+
+namespace {
+
+class NoopBalanceListener : public AccountBalanceListener {
+public:
+  virtual void OnAccountBalanceUpdate(const AccountBalance&) override {}
+};
+
+class TickerRecorder : public ExchangeListener {
+public:
+  virtual void OnConnectionOpen(const std::string&) override {}
+
+  virtual void OnConnectionClose(const std::string&) override {}
+
+  virtual void OnBookTicker(const Ticker& ticker) override {
+    m_timestamps.push_back(ticker.arrived_ts);
+  }
+
+  std::vector<uint64_t> m_timestamps;
+};
+
+BacktestSettings CreateSettings() {
+  BacktestSettings settings;
+  settings.exchange = "test";
+  settings.fee = 0.001;
+  settings.slippage = 0.0;
+  settings.network_latency_us = 100000;
+  settings.execution_delay_us = 20000;
+  settings.initial_balances = {
+    {SymbolId::ADA, 100000.0},
+    {SymbolId::USDT, 100000}
+  };
+  return settings;
+}
+
+class BacktestCheckpointerTest : public Test {
+protected:
+  void SetUp() override {
+    const auto dir = std::filesystem::temp_directory_path();
+    m_capture_path = (dir / ("backtest_checkpointer_unittest_" + std::to_string(::getpid()) + ".cap")).string();
+    m_prefix = (dir / ("backtest_checkpointer_unittest_" + std::to_string(::getpid()))).string();
+    std::remove(m_capture_path.c_str());
+  }
+
+  void TearDown() override {
+    std::remove(m_capture_path.c_str());
+    for (const auto& path : m_checkpoint_paths) {
+      std::remove(path.c_str());
+    }
+  }
+
+  std::string m_capture_path;
+  std::string m_prefix;
+  std::vector<std::string> m_checkpoint_paths;
+};
+
+}
+
+TEST_F(BacktestCheckpointerTest, TestResumeReplay) {
+  {
+    // Several chunks, so checkpoints fall inside and at the end of them
+    CaptureFileWriter writer(m_capture_path, 3);
+    for (uint64_t ts = 1000; ts <= 20000; ts += 1000) {
+      writer.OnBookTicker(CreateTicker("binance", SymbolPairId::ADA_USDT, 1.10, 1.11, ts));
+    }
+  }
+
+  TickerRecorder full;
+  EventScheduler scheduler;
+  BacktestCheckpointer checkpointer(m_prefix, 5000, scheduler);
+  CaptureFileReader reader(m_capture_path);
+  checkpointer.Add("replay", &reader);
+  reader.Register(&full);
+  reader.Register(&checkpointer);
+  EXPECT_EQ(20, reader.Produce());
+  m_checkpoint_paths = checkpointer.GetPaths();
+  ASSERT_EQ(4u, m_checkpoint_paths.size());
+  EXPECT_EQ(BacktestCheckpointer::GetPath(m_prefix, 5000), m_checkpoint_paths.front());
+
+  for (const auto& path : m_checkpoint_paths) {
+    cryptobot::Checkpoint checkpoint = cryptobot::Checkpoint::Load(path);
+    CaptureFileReader resumed_reader(m_capture_path);
+    checkpoint.Restore("replay", resumed_reader);
+    TickerRecorder resumed;
+    resumed_reader.Register(&resumed);
+    resumed_reader.Produce();
+
+    std::vector<uint64_t> expected;
+    for (uint64_t ts : full.m_timestamps) {
+      if (ts > checkpoint.GetTimestamp()) {
+        expected.push_back(ts);
+      }
+    }
+    EXPECT_EQ(expected, resumed.m_timestamps) << path;
+  }
+}
+
+TEST_F(BacktestCheckpointerTest, TestInvalidInterval) {
+  EventScheduler scheduler;
+  EXPECT_THROW(BacktestCheckpointer(m_prefix, 0, scheduler), std::invalid_argument);
+}
+
+TEST(BacktestExchangeClientCheckpointTest, TestRestingOrderRoundTrip) {
+  NoopBalanceListener balance_listener;
+  BacktestExchangeClient client(CreateSettings(), balance_listener);
+  client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 1));
+  client.LimitOrder(SymbolPairId::ADA_USDT, Side::BUY, 1000, 1.09);
+
+  // Order still on its way to the exchange
+  cryptobot::CheckpointWriter in_flight_writer;
+  EXPECT_THROW(client.SaveState(in_flight_writer), std::runtime_error);
+
+  client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.11, 1.12, 230000));
+  cryptobot::Checkpoint checkpoint(230000);
+  checkpoint.Add("client", client);
+
+  BacktestExchangeClient restored(CreateSettings(), balance_listener);
+  checkpoint.Restore("client", restored);
+
+  auto orders = client.GetOpenOrders().Get();
+  auto restored_orders = restored.GetOpenOrders().Get();
+  ASSERT_EQ(1u, orders.size());
+  ASSERT_EQ(1u, restored_orders.size());
+  EXPECT_EQ(orders[0].GetId(), restored_orders[0].GetId());
+  EXPECT_DOUBLE_EQ(orders[0].GetPrice(), restored_orders[0].GetPrice());
+  for (SymbolId asset : {SymbolId::ADA, SymbolId::USDT}) {
+    EXPECT_DOUBLE_EQ(client.GetFreeBalance(asset), restored.GetFreeBalance(asset));
+  }
+
+  // Both fill the order the same way
+  const Ticker crossing = CreateTicker("test", SymbolPairId::ADA_USDT, 1.085, 1.095, 300000);
+  client.OnBookTicker(crossing);
+  restored.OnBookTicker(crossing);
+  EXPECT_EQ(client.HasOpenOrders(), restored.HasOpenOrders());
+  for (SymbolId asset : {SymbolId::ADA, SymbolId::USDT}) {
+    EXPECT_DOUBLE_EQ(client.GetTotalBalance(asset), restored.GetTotalBalance(asset));
+  }
+
+  // New orders continue the ids of the checkpointed client
+  auto order = client.LimitOrder(SymbolPairId::ADA_USDT, Side::BUY, 10, 1.0).Get();
+  auto restored_order = restored.LimitOrder(SymbolPairId::ADA_USDT, Side::BUY, 10, 1.0).Get();
+  EXPECT_EQ(order.GetId(), restored_order.GetId());
+}
@@ -1,17 +1,29 @@
 #pragma once
 
+#include "event_scheduler.hpp"
+#include "latency_model.hpp"
+#include "queue_position_model.hpp"
+
 #include "exchange/account_balance_listener.h"
 #include "exchange/account_manager.h"
 #include "exchange/exchange_listener.h"
 #include "exchange/user_data_listener.hpp"
+#include "model/model_checkpoint.hpp"
+#include "utils/checkpoint.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <fstream>
 #include <map>
+#include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <tuple>
+#include <typeinfo>
 #include <unordered_map>
+#include <vector>
 
 using namespace std::chrono;
 
@@ -24,25 +36,61 @@ struct BacktestSettings {
   // Time it takes for order to be executed after reaching exchange server
   double execution_delay_us;
   std::unordered_map<SymbolId, double> initial_balances;
+  // One way latency of market data, order requests and responses, fixed network_latency_us if not set
+  std::shared_ptr<LatencyModel> latency_model;
+  // Send NEW order updates when orders reach the exchange
+  bool notify_order_acks = false;
 };
 
-struct OrderRequest {
-  Order order;
-  double creation_timestamp_us;
+// Resting orders of a symbol sorted by price
+struct TickerLimitOrders {
+  std::multimap<double, Order> buys;
+  std::multimap<double, Order> sells;
+
+  bool empty() const {
+    return buys.empty() && sells.empty();
+  }
 };
 
-// TODO: support order book updates and trade tickers
-class BacktestExchangeClient : public AccountManager, public ExchangeListener {
+struct LimitOrderLocation {
+  std::multimap<double, Order>* orders;
+  std::multimap<double, Order>::iterator it;
+};
+
+/**
+ * Simulated exchange for backtesting.
+ *
+ * Order events run on the simulated clock of an EventScheduler, which follows arrival timestamps
+ * of the replayed data. Clients of one backtest share a scheduler, the clock is advanced by
+ * whichever client sees a market data event first, so a client must be registered with the
+ * producer before the strategies using it. An order sent at local time t is matched at
+ * t + market data latency + request latency + execution delay, ie. against the book as it was
+ * when the order reached the exchange, as we observe it. Order updates reach us one response
+ * latency after the exchange produced them. Latencies are sampled from settings.latency_model.
+ */
+class BacktestExchangeClient : public AccountManager, public ExchangeListener, public cryptobot::Checkpointable {
 public:
-  BacktestExchangeClient(const BacktestSettings& settings, AccountBalanceListener& balance_listener) : m_settings(settings),
-  m_account_balance(settings.initial_balances, settings.exchange), m_update_timestamp_us(0), m_balance_listener(balance_listener),
-  m_user_data_listener(nullptr), m_last_order_id(0) {
+  /**
+   * @param scheduler shared with the other clients of the backtest, own scheduler if null
+   */
+  BacktestExchangeClient(const BacktestSettings& settings, AccountBalanceListener& balance_listener, EventScheduler* scheduler = nullptr)
+      : m_settings(settings),
+      m_account_balance(settings.initial_balances, settings.exchange), m_balance_listener(balance_listener),
+      m_user_data_listener(nullptr), m_last_order_id(0), m_orders_in_flight(0) {
+    if (!m_settings.latency_model) {
+      m_settings.latency_model = std::make_shared<FixedLatencyModel>(m_settings.network_latency_us);
+    }
+    if (!scheduler) {
+      m_own_scheduler = std::make_unique<EventScheduler>();
+      scheduler = m_own_scheduler.get();
+    }
+    m_scheduler = scheduler;
   }
 
   virtual ~BacktestExchangeClient() {
     size_t sell_orders_count = 0, buy_orders_count = 0;
     double left_orders_balance = 0;
-    for (const auto& order : m_limit_orders) {
+    ForEachLimitOrder([&](const Order& order) {
       if (order.GetSide() == Side::SELL) {
         sell_orders_count++;
         left_orders_balance -= order.GetQuantity();
@@ -50,7 +98,7 @@ public:
         buy_orders_count++;
         left_orders_balance += order.GetQuantity();
       }
-    }
+    });
     BOOST_LOG_TRIVIAL(info) << "Left sell orders: " << sell_orders_count;
     BOOST_LOG_TRIVIAL(info) << "Left buy orders: " << buy_orders_count;
     BOOST_LOG_TRIVIAL(info) << "Left orders balance: " << left_orders_balance;
@@ -78,17 +126,13 @@ public:
         .OrderType_(OrderType::MARKET)
         .Quantity(qty)
         .Build();
-    OrderRequest order_req;
-    order_req.order = std::move(order);
     // Here we do not take into account strategy execution delay for simplicity.
-    // Use network_latency_us and execution_delay_us to adjust delay.
+    // Use latency model and execution_delay_us to adjust delay.
     //
-    // This works with assumption that orders are placed right after receiving a ticker.
-    // OnBookTicker with the most recent ticker has to be called before placing an order.
-    // There m_update_timestamp is updated with ticker arrival timestamp.
-    order_req.creation_timestamp_us = m_update_timestamp_us;
-    m_pending_market_orders.push_back(order_req);
-    return Result<Order>("", order_req.order);
+    // This works with assumption that orders are placed right after receiving market data,
+    // the order is sent at the arrival time of the most recent event.
+    SendToExchange(order);
+    return Result<Order>("", order);
   }
 
   virtual Result<Order> LimitOrder(SymbolPairId symbol, Side side, double qty, double price) override {
@@ -125,18 +169,25 @@ public:
   }
 
   virtual Result<std::vector<Order>> GetOpenOrders() override {
-    return Result<std::vector<Order>>("", m_limit_orders);
+    std::vector<Order> orders;
+    ForEachLimitOrder([&](const Order& order) {
+      orders.push_back(order);
+    });
+    return Result<std::vector<Order>>("", orders);
   }
 
   virtual Result<bool> CancelOrder(const Order& order) override {
-    for (size_t i = 0; m_limit_orders.size(); ++i) {
-      if (order == m_limit_orders.at(i)) {
-        m_limit_orders.erase(m_limit_orders.begin() + i);
-        --i;
-        return Result<bool>("Success canceling order", true);
-      }
+    auto index_it = m_limit_order_index.find(order.GetId());
+    if (index_it != m_limit_order_index.end()) {
+      index_it->second.orders->erase(index_it->second.it);
+      m_limit_order_index.erase(index_it);
+      return Result<bool>("Success canceling order", true);
     }
-    return Result<bool>("Failed canceling order", "No such order");
+    auto model_it = m_queue_models.find(order.GetSymbolId());
+    if (model_it != m_queue_models.end() && model_it->second.Remove(order)) {
+      return Result<bool>("Success canceling order", true);
+    }
+    return Result<bool>("Failed canceling order", std::string("No such order"));
   }
 
   virtual void CancelAllOrders() override {
@@ -146,16 +197,21 @@ public:
   // AccountManager
 
   virtual bool HasOpenOrders() override {
-    return !m_limit_orders.empty();
+    if (!m_limit_order_index.empty()) {
+      return true;
+    }
+    return std::any_of(m_queue_models.begin(), m_queue_models.end(), [](const auto& p) {
+      return !p.second.empty();
+    });
   };
 
   virtual bool HasOpenOrders(SymbolPairId pair) override {
-    for (const auto& order : m_limit_orders) {
-      if (pair == order.GetSymbolId()) {
-        return true;
-      }
+    auto orders_it = m_limit_orders.find(pair);
+    if (orders_it != m_limit_orders.end() && !orders_it->second.empty()) {
+      return true;
     }
-    return false;
+    auto model_it = m_queue_models.find(pair);
+    return model_it != m_queue_models.end() && !model_it->second.empty();
   };
 
   virtual double GetFreeBalance(SymbolId symbol_id) override {
@@ -167,8 +223,7 @@ public:
   };
 
   virtual bool IsAccountSynced() const override {
-    // TODO: return false if there is a pending market order
-    return true;
+    return m_orders_in_flight == 0;
   };
 
   // ExchangeListener
@@ -181,14 +236,12 @@ public:
     // no-op
   }
 
-  // TODO: using trade tickers as well (and perhaps with partial fill) would make the backtester better
   virtual void OnBookTicker(const Ticker& ticker) override {
     //BOOST_LOG_TRIVIAL(trace) << "BacktestExchangeClient::OnBookTicker, ticker: " << ticker;
-    m_update_timestamp_us = ticker.arrived_ts;
+    // Orders due before the ticker see the previous market state
+    m_scheduler->AdvanceTo(ticker.arrived_ts);
     if (m_settings.exchange == ticker.exchange) {
-      HandlePendingMarketOrders(ticker); // handle on book ticker
-      HandlePendingLimitOrders(ticker); // handle on book ticker
-      HandleLimitOrders(ticker); // handle on trade ticker
+      HandleLimitOrders(ticker); // orders of symbols without order book, others are filled from trades
       // auto it = m_tickers.find(ticker.symbol);
       // if (it != m_tickers.end()) {
       //   m_previous_tickers.insert_or_assign(it->first, it->second);
@@ -200,14 +253,183 @@ public:
 
   virtual void OnTradeTicker(const TradeTicker& ticker) override {
     BOOST_LOG_TRIVIAL(debug) << "BacktestExchangeClient::OnTradeTicker, ticker=" << ticker;
+    m_scheduler->AdvanceTo(ticker.arrived_ts);
+    if (m_settings.exchange != ticker.exchange) {
+      return;
+    }
+    SymbolPairId symbol = SymbolPairId(ticker.symbol);
+    auto model_it = m_queue_models.find(symbol);
+    const OrderBook* ob = GetOrderBook(symbol);
+    if (model_it == m_queue_models.end() || !ob) {
+      return;
+    }
+    // Buyer being the maker means the seller was the aggressor and hit the bids
+    Side resting_side = ticker.is_market_maker ? Side::BUY : Side::SELL;
+    model_it->second.OnTrade(ob->ToPrice(ticker.price), ticker.qty, resting_side, [this](Order& order, quantity_t qty, bool completed) {
+      FillLimitOrder(order, qty, completed);
+    });
   }
 
+  // Keeps own copy of the book for depth-aware fills, by applying the same diffs as the producer.
+  // Applying a diff only moves levels close to the touched prices, copying the whole book would not scale.
   virtual void OnOrderBookUpdate(const OrderBook& order_book) override {
-    BOOST_LOG_TRIVIAL(debug) << "BacktestExchangeClient::OnOrderBookUpdate, order_book=" << order_book;
+    const OrderBookUpdate& ob_update = order_book.GetLastUpdate();
+    m_scheduler->AdvanceTo(ob_update.arrived_ts);
+    if (m_settings.exchange != order_book.GetExchangeName()) {
+      return;
+    }
+    auto it = m_order_books.find(order_book.GetSymbolPairId());
+    if (it == m_order_books.end()) {
+      it = m_order_books.emplace(std::piecewise_construct,
+          std::forward_as_tuple(order_book.GetSymbolPairId()),
+          std::forward_as_tuple(order_book.GetExchangeName(), order_book.GetSymbolPairId(), order_book.GetDepth(), order_book.GetPrecisionSettings())).first;
+    }
+    if (ob_update.is_snapshot) {
+      it->second.clear();
+    }
+    OrderBook& ob = it->second;
+    ob.Update(ob_update);
+
+    auto model_it = m_queue_models.find(ob.GetSymbolPairId());
+    if (model_it == m_queue_models.end()) {
+      return;
+    }
+    QueuePositionModel& model = model_it->second;
+    const size_t price_precision = ob.GetPrecisionSettings().m_price_precision;
+    for (const auto& level : ob_update.bids) {
+      price_t price = price_t(level.price.ToFixedPoint(price_precision));
+      model.OnLevelVolume(Side::BUY, price, ob.GetLevelVolume(Side::BUY, price));
+    }
+    for (const auto& level : ob_update.asks) {
+      price_t price = price_t(level.price.ToFixedPoint(price_precision));
+      model.OnLevelVolume(Side::SELL, price, ob.GetLevelVolume(Side::SELL, price));
+    }
+    model.OnBestPrices(ob, [this](Order& order, quantity_t qty, bool completed) {
+      FillLimitOrder(order, qty, completed);
+    });
+  }
+
+  // Checkpointable
+
+  /**
+   * Saves balances, resting orders, tickers, order books and latency model state.
+   *
+   * @throws std::runtime_error if order events are scheduled, they can't be saved
+   */
+  virtual void SaveState(cryptobot::CheckpointWriter& writer) const override {
+    if (!m_scheduler->empty()) {
+      throw std::runtime_error("BacktestExchangeClient: can't checkpoint with scheduled order events");
+    }
+    SaveAccountBalance(writer, m_account_balance);
+    writer.Write(m_last_order_id);
+    // Sorted by symbol, so equal states give equal checkpoints
+    writer.Write<uint64_t>(m_tickers.size());
+    for (SymbolPairId symbol : SortedSymbols(m_tickers)) {
+      SaveTicker(writer, m_tickers.at(symbol));
+    }
+    writer.Write<uint64_t>(m_order_books.size());
+    for (SymbolPairId symbol : SortedSymbols(m_order_books)) {
+      SaveOrderBook(writer, m_order_books.at(symbol));
+    }
+    writer.Write<uint64_t>(m_limit_orders.size());
+    for (SymbolPairId symbol : SortedSymbols(m_limit_orders)) {
+      writer.Write(symbol);
+      const TickerLimitOrders& limit_orders = m_limit_orders.at(symbol);
+      for (const auto* orders : {&limit_orders.buys, &limit_orders.sells}) {
+        writer.Write<uint64_t>(orders->size());
+        for (const auto& price_order : *orders) {
+          writer.Write(price_order.first);
+          SaveOrder(writer, price_order.second);
+        }
+      }
+    }
+    writer.Write<uint64_t>(m_queue_models.size());
+    for (SymbolPairId symbol : SortedSymbols(m_queue_models)) {
+      const QueuePositionModel& model = m_queue_models.at(symbol);
+      writer.Write(symbol);
+      writer.Write<uint64_t>(model.size());
+      model.ForEach([&](const QueuePositionModel::QueuedOrder& queued) {
+        SaveOrder(writer, queued.order);
+        writer.Write(queued.price);
+        writer.Write(queued.left_qty);
+        writer.Write(queued.queue_ahead);
+        writer.Write(queued.level_volume);
+      });
+    }
+    cryptobot::CheckpointWriter latency_writer;
+    m_settings.latency_model->SaveState(latency_writer);
+    writer.WriteString(typeid(*m_settings.latency_model).name());
+    writer.WriteString(latency_writer.GetData());
+  }
+
+  /**
+   * Latency model state is only restored into a model of the same type, a run forked from
+   * the checkpoint may use another one.
+   */
+  virtual void LoadState(cryptobot::CheckpointReader& reader) override {
+    AccountBalance account_balance = LoadAccountBalance(reader);
+    if (account_balance.GetExchange() != m_settings.exchange) {
+      throw std::runtime_error("BacktestExchangeClient: checkpoint of " + account_balance.GetExchange() + ", not " + m_settings.exchange);
+    }
+    m_account_balance = std::move(account_balance);
+    m_last_order_id = reader.Read<uint64_t>();
+    m_tickers.clear();
+    for (uint64_t i = reader.Read<uint64_t>(); i > 0; --i) {
+      Ticker ticker = LoadTicker(reader);
+      m_tickers.insert_or_assign(ticker.symbol, ticker);
+    }
+    m_order_books.clear();
+    for (uint64_t i = reader.Read<uint64_t>(); i > 0; --i) {
+      OrderBook ob = LoadOrderBook(reader);
+      const SymbolPairId symbol = ob.GetSymbolPairId();
+      m_order_books.emplace(symbol, std::move(ob));
+    }
+    m_limit_orders.clear();
+    m_limit_order_index.clear();
+    for (uint64_t i = reader.Read<uint64_t>(); i > 0; --i) {
+      TickerLimitOrders& limit_orders = m_limit_orders[reader.Read<SymbolPairId>()];
+      for (auto* orders : {&limit_orders.buys, &limit_orders.sells}) {
+        for (uint64_t j = reader.Read<uint64_t>(); j > 0; --j) {
+          const double price = reader.Read<double>();
+          auto it = orders->emplace(price, LoadOrder(reader));
+          m_limit_order_index.insert_or_assign(it->second.GetId(), LimitOrderLocation{orders, it});
+        }
+      }
+    }
+    m_queue_models.clear();
+    for (uint64_t i = reader.Read<uint64_t>(); i > 0; --i) {
+      QueuePositionModel& model = m_queue_models[reader.Read<SymbolPairId>()];
+      for (uint64_t j = reader.Read<uint64_t>(); j > 0; --j) {
+        Order order = LoadOrder(reader);
+        const price_t price = reader.Read<price_t>();
+        const quantity_t left_qty = reader.Read<quantity_t>();
+        const quantity_t queue_ahead = reader.Read<quantity_t>();
+        model.Restore(QueuePositionModel::QueuedOrder{std::move(order), price, left_qty, queue_ahead, reader.Read<quantity_t>()});
+      }
+    }
+    const std::string latency_type = reader.ReadString();
+    const std::string latency_state = reader.ReadString();
+    if (latency_type == typeid(*m_settings.latency_model).name()) {
+      cryptobot::CheckpointReader latency_reader(latency_state);
+      m_settings.latency_model->LoadState(latency_reader);
+    } else {
+      BOOST_LOG_TRIVIAL(warning) << "BacktestExchangeClient: latency model changed since the checkpoint, its state is not restored";
+    }
+    m_orders_in_flight = 0;
   }
 
 private:
 
+  template <typename Map>
+  static std::vector<SymbolPairId> SortedSymbols(const Map& map) {
+    std::vector<SymbolPairId> symbols;
+    for (const auto& p : map) {
+      symbols.push_back(p.first);
+    }
+    std::sort(symbols.begin(), symbols.end());
+    return symbols;
+  }
+
   bool CanExecuteOrder(const Order& order) const {
     SymbolPair symbol_pair(order.GetSymbolId());
     if (order.GetSide() == Side::SELL) {
@@ -231,173 +453,251 @@ private:
       return Result<Order>("", "Insufficient funds");
     }
 
-    OrderRequest order_req;
     order.SetStatus(OrderStatus::NEW);
-    order_req.order = std::move(order);
-    order_req.creation_timestamp_us = m_update_timestamp_us;
-    m_pending_limit_orders.push_back(order_req);
+    SendToExchange(order);
     BOOST_LOG_TRIVIAL(trace) << "AddLimitOrder end";
     return Result<Order>("", order);
   }
 
-  void HandlePendingMarketOrders(const Ticker& ticker) {
-    for (size_t i = 0; i < m_pending_market_orders.size(); ++i) {
-      auto& order_request = m_pending_market_orders[i];
-      if (order_request.order.GetSymbolId() != ticker.symbol) {
-        continue;
-      }
-      // Take network latency twice: once for incoming data delay and once for sending order delay
-      if (order_request.creation_timestamp_us + 2 * m_settings.network_latency_us + m_settings.execution_delay_us < ticker.arrived_ts) {
-        // Get ticker before that
-        auto it = m_tickers.find(ticker.symbol);
-        if (it != m_tickers.end()) {
-          ExecuteMarketOrder(order_request.order, it->second);
-          m_pending_market_orders.erase(m_pending_market_orders.begin() + i);
-          --i;
-        } else {
-          BOOST_LOG_TRIVIAL(error) << "No previous ticker";
-          // TODO: is it even possible to end up here?
-          //ExecuteMarketOrder(order_request.order, ticker);
+  void SendToExchange(const Order& order) {
+    const uint64_t now = m_scheduler->Now();
+    // Market data we reacted to is already one latency old, so the exchange state the order meets
+    // is observed one more latency after the order reached the exchange
+    const uint64_t market_data_latency = m_settings.latency_model->Sample();
+    const uint64_t request_latency = m_settings.latency_model->Sample();
+    const uint64_t match_ts = now + market_data_latency + request_latency + static_cast<uint64_t>(m_settings.execution_delay_us);
+    ++m_orders_in_flight;
+    if (m_settings.notify_order_acks) {
+      const uint64_t ack_ts = now + request_latency + m_settings.latency_model->Sample();
+      Order ack = order;
+      ack.SetStatus(OrderStatus::NEW);
+      m_scheduler->Schedule(ack_ts, [this, ack]() {
+        if (m_user_data_listener) {
+          m_user_data_listener->OnOrderUpdate(ack);
         }
+      });
+    }
+    m_scheduler->Schedule(match_ts, [this, order = order]() mutable {
+      --m_orders_in_flight;
+      if (order.GetType() == OrderType::MARKET) {
+        MatchMarketOrder(order);
+      } else {
+        MatchLimitOrder(order);
       }
+    });
+  }
+
+  void MatchMarketOrder(Order& order) {
+    auto it = m_tickers.find(order.GetSymbolId());
+    if (it == m_tickers.end()) {
+      BOOST_LOG_TRIVIAL(error) << "No ticker for market order " << order;
+      order.SetStatus(OrderStatus::REJECTED);
+      NotifyOrderUpdate(order, false);
+      return;
     }
+    ExecuteMarketOrder(order, it->second);
   }
 
   void ExecuteMarketOrder(Order& order, const Ticker& ticker) {
-    const SymbolPair& sp = ticker.symbol;
-    SymbolId base_asset_id = sp.GetBaseAsset();
-    SymbolId quote_asset_id = sp.GetQuoteAsset();
     Side side = order.GetSide();
     double total_qty = order.GetQuantity();
-    double price, cost;
-    if (side == Side::SELL) {
-      // m_order_book.GetMarketFillPrice(Side::SELL, total_qty);
-      price = ticker.bid;
-      BOOST_LOG_TRIVIAL(info) << "Current ticker " << ticker << ", market selling " << total_qty;
-      // TODO: FIXME: implement partial fill here
-      if (ticker.bid_vol && ticker.bid_vol.value() < total_qty) {
-        BOOST_LOG_TRIVIAL(info) << "Order quantity above best ticker volume";
+    BOOST_LOG_TRIVIAL(info) << "Current ticker " << ticker << ", market " << (side == Side::SELL ? "selling " : "buying ") << total_qty;
+    const OrderBook* ob = GetOrderBook(order.GetSymbolId());
+    if (ob) {
+      MarketFill fill = ob->GetMarketFill(side, total_qty);
+      if (fill.quantity > 0) {
+        BOOST_LOG_TRIVIAL(info) << "Market order walked " << fill.levels << " levels, average price " << fill.GetAveragePrice();
+        if (fill.quantity < total_qty) {
+          // Book depth exhausted, the rest expires like an IOC order would
+          BOOST_LOG_TRIVIAL(warning) << "Order quantity above book volume, filled " << fill.quantity << " of " << total_qty;
+        }
+        order.SetPrice(fill.GetAveragePrice());
+        ApplyFill(order, fill.quantity, fill.notional, m_settings.slippage);
+        order.SetStatus(fill.quantity < total_qty ? OrderStatus::EXPIRED : OrderStatus::FILLED);
+        NotifyFill(order);
+        return;
       }
-      cost = total_qty*(price - m_settings.slippage)*(1.0 - m_settings.fee);
+      BOOST_LOG_TRIVIAL(warning) << "Empty order book side, filling at ticker price";
+    }
+    // No order book data, whole quantity at top of book price
+    double price = side == Side::SELL ? ticker.bid : ticker.ask;
+    const std::optional<double>& top_vol = side == Side::SELL ? ticker.bid_vol : ticker.ask_vol;
+    if (top_vol && top_vol.value() < total_qty) {
+      BOOST_LOG_TRIVIAL(info) << "Order quantity above best ticker volume";
+    }
+    order.SetPrice(price);
+    ApplyFill(order, total_qty, total_qty*price, m_settings.slippage);
+    order.SetStatus(OrderStatus::FILLED);
+    NotifyFill(order);
+  }
+
+  /**
+   * Update balances and order's executed quantity and total cost with a (partial) fill.
+   *
+   * @param notional sum of price * quantity of the fill
+   * @param slippage additional price penalty per unit
+   */
+  void ApplyFill(Order& order, double qty, double notional, double slippage) {
+    const SymbolPair sp(order.GetSymbolId());
+    SymbolId base_asset_id = sp.GetBaseAsset();
+    SymbolId quote_asset_id = sp.GetQuoteAsset();
+    double cost;
+    if (order.GetSide() == Side::SELL) {
+      cost = (notional - qty*slippage)*(1.0 - m_settings.fee);
       m_account_balance.AddBalance(quote_asset_id, cost);
-      m_account_balance.AddBalance(base_asset_id, -total_qty);
-      BOOST_LOG_TRIVIAL(info) << "Sold " << total_qty << " for " << cost;
+      m_account_balance.AddBalance(base_asset_id, -qty);
+      BOOST_LOG_TRIVIAL(info) << "Sold " << qty << " for " << cost;
     } else { // Buying
-      price = ticker.ask;
-      BOOST_LOG_TRIVIAL(info) << "Current ticker " << ticker << ", market buying " << total_qty;
-      if (ticker.ask_vol && ticker.ask_vol.value() < total_qty) {
-        BOOST_LOG_TRIVIAL(info) << "Order quantity above best ticker volume";
-      }
-      cost = total_qty*(price + m_settings.slippage)*(1.0 + m_settings.fee);
+      cost = (notional + qty*slippage)*(1.0 + m_settings.fee);
       m_account_balance.AddBalance(quote_asset_id, -cost);
-      m_account_balance.AddBalance(base_asset_id, total_qty);
-      BOOST_LOG_TRIVIAL(info) << "Bought " << total_qty << " for " << cost;
+      m_account_balance.AddBalance(base_asset_id, qty);
+      BOOST_LOG_TRIVIAL(info) << "Bought " << qty << " for " << cost;
+    }
+    order.SetExecutedQuantity(order.GetExecutedQuantity() + qty);
+    order.SetTotalCost(order.GetTotalCost() + cost);
+  }
+
+  void NotifyFill(const Order& order) {
+    NotifyOrderUpdate(order, true);
+  }
+
+  /**
+   * Delivers an order update produced by the exchange now, on the simulated clock.
+   * The exchange produced it one market data latency before we observe it, it reaches us one response latency after that.
+   */
+  void NotifyOrderUpdate(const Order& order, bool balance_changed) {
+    const uint64_t now = m_scheduler->Now();
+    const uint64_t market_data_latency = m_settings.latency_model->Sample();
+    const uint64_t response_latency = m_settings.latency_model->Sample();
+    const uint64_t delivery_ts = now - std::min(now, market_data_latency) + response_latency;
+    std::optional<AccountBalance> balance;
+    if (balance_changed) {
+      balance = m_account_balance;
+    }
+    if (delivery_ts <= now) {
+      DeliverOrderUpdate(order, balance);
+      return;
     }
+    m_scheduler->Schedule(delivery_ts, [this, order, balance]() {
+      DeliverOrderUpdate(order, balance);
+    });
+  }
+
+  void DeliverOrderUpdate(const Order& order, const std::optional<AccountBalance>& balance) {
     if (m_user_data_listener) {
-      order.SetPrice(price);
-      order.SetTotalCost(cost);
-      order.SetExecutedQuantity(total_qty);
-      order.SetStatus(OrderStatus::FILLED);
       m_user_data_listener->OnOrderUpdate(order);
     }
-    m_balance_listener.OnAccountBalanceUpdate(m_account_balance);
-    BOOST_LOG_TRIVIAL(info) << "Account value: " << GetAccountValue(SymbolId::USDT);
+    if (balance) {
+      m_balance_listener.OnAccountBalanceUpdate(balance.value());
+      BOOST_LOG_TRIVIAL(info) << "Account value: " << GetAccountValue(SymbolId::USDT);
+    }
   }
 
-  void HandlePendingLimitOrders(const Ticker& ticker) {
-    BOOST_LOG_TRIVIAL(trace) << "HandlePendingLimitOrders begin";
-    for (size_t i = 0; i < m_pending_limit_orders.size(); ++i) {
-      auto& order_request = m_pending_limit_orders[i];
-      auto& order = order_request.order;
-      if (order.GetSymbolId() != SymbolPairId(ticker.symbol)) {
-        continue;
+  void MatchLimitOrder(Order& order) {
+    BOOST_LOG_TRIVIAL(trace) << "MatchLimitOrder begin";
+    const OrderBook* ob = GetOrderBook(order.GetSymbolId());
+    if (ob) {
+      // Marketable part takes liquidity up to the limit price, the rest rests in the book
+      MarketFill fill = ob->GetMarketFill(order.GetSide(), order.GetQuantity(), ob->ToPrice(order.GetPrice()));
+      if (fill.quantity > 0) {
+        BOOST_LOG_TRIVIAL(info) << "Marketable limit order walked " << fill.levels << " levels, average price " << fill.GetAveragePrice();
+        ApplyFill(order, fill.quantity, fill.notional, 0);
+        order.SetStatus(fill.quantity < order.GetQuantity() ? OrderStatus::PARTIALLY_FILLED : OrderStatus::FILLED);
+        NotifyFill(order);
       }
-      // Take network latency twice: once for incoming data delay and once for sending order delay
-      if (order_request.creation_timestamp_us + 2 * m_settings.network_latency_us + m_settings.execution_delay_us < ticker.arrived_ts) {
-        double price = order.GetPrice();
-        // Currently for simplicity we assume that limit order will be executed,
-        // if current mid price crosses order's limit price
-        // This will not be accurate for HFT algorithms
-        // TODO: take book volumes and trade tickers into account
-        double mid_price = (ticker.bid + ticker.ask) / 2.0;
-        Side side = order.GetSide();
-        if (Side::SELL == side) {
-          if (price <= mid_price) {
-            // TODO: trade ticker should invoke limit order execution
-            // HACK: right now 
-            Ticker limit_ticker = ticker;
-            limit_ticker.bid = price;
-            ExecuteMarketOrder(order, ticker);
-          } else {
-            m_limit_orders.push_back(order);
-          }
-        } else { // BUY
-          if (price >= mid_price) {
-            BOOST_LOG_TRIVIAL(trace) << "Ticker limit_ticker = ticker";
-            Ticker limit_ticker = ticker;
-            limit_ticker.ask = price;
-            BOOST_LOG_TRIVIAL(trace) << "ExecuteMarketOrder(order, ticker)";
-            ExecuteMarketOrder(order, ticker);
-          } else {
-            m_limit_orders.push_back(order);
-          }
-        }
-        m_pending_limit_orders.erase(m_pending_limit_orders.begin() + i);
-        --i;
+      if (fill.quantity < order.GetQuantity()) {
+        price_t price = ob->ToPrice(order.GetPrice());
+        m_queue_models[order.GetSymbolId()].Add(order, price, ob->GetLevelVolume(order.GetSide(), price));
       }
+    } else {
+      MatchLimitOrderWithoutBook(order);
     }
-    BOOST_LOG_TRIVIAL(trace) << "HandlePendingLimitOrders end";
+    BOOST_LOG_TRIVIAL(trace) << "MatchLimitOrder end";
+  }
+
+  void MatchLimitOrderWithoutBook(Order& order) {
+    double price = order.GetPrice();
+    Side side = order.GetSide();
+    auto ticker_it = m_tickers.find(order.GetSymbolId());
+    // Currently for simplicity we assume that limit order will be executed,
+    // if current mid price crosses order's limit price
+    // This will not be accurate for HFT algorithms
+    // TODO: take book volumes and trade tickers into account
+    if (ticker_it != m_tickers.end()) {
+      const Ticker& ticker = ticker_it->second;
+      double mid_price = (ticker.bid + ticker.ask) / 2.0;
+      if (Side::SELL == side ? price <= mid_price : price >= mid_price) {
+        ExecuteMarketOrder(order, ticker);
+        return;
+      }
+    }
+    TickerLimitOrders& limit_orders = m_limit_orders[order.GetSymbolId()];
+    auto& orders = Side::SELL == side ? limit_orders.sells : limit_orders.buys;
+    auto it = orders.emplace(price, order);
+    m_limit_order_index.insert_or_assign(order.GetId(), LimitOrderLocation{&orders, it});
   }
 
   void HandleLimitOrders(const Ticker& ticker) {
     BOOST_LOG_TRIVIAL(trace) << "HandleLimitOrders begin";
-    // Check if any limit order got filled
-    SymbolId base_asset_id = ticker.symbol.GetBaseAsset();
-    SymbolId quote_asset_id = ticker.symbol.GetQuoteAsset();
-    for (size_t i = 0; i < m_limit_orders.size(); ++i) {
-      auto& order = m_limit_orders[i];
-      if (order.GetSymbolId() != SymbolPairId(ticker.symbol)) {
-        continue;
-      }
-      double order_price = order.GetPrice();
-      if (order.GetSide() == Side::SELL) {
-        if (ticker.bid >= order_price) {
-          // Fill
-          // TODO: implement partial fill ?
-          BOOST_LOG_TRIVIAL(info) << "Filled sell limit order: " << order;
-          double cost = ticker.bid * order.GetQuantity() * (1.0 - m_settings.fee);
-          m_account_balance.AddBalance(quote_asset_id, cost);
-          m_account_balance.AddBalance(base_asset_id, -order.GetQuantity());
-          if (m_user_data_listener) {
-            order.SetTotalCost(cost);
-            order.SetExecutedQuantity(order.GetQuantity());
-            order.SetStatus(OrderStatus::FILLED);
-            m_user_data_listener->OnOrderUpdate(order);
-          }
-          m_limit_orders.erase(m_limit_orders.begin() + i);
-          m_balance_listener.OnAccountBalanceUpdate(m_account_balance);
-          BOOST_LOG_TRIVIAL(info) << "Account value: " << GetAccountValue(SymbolId::USDT);
-        }
-      } else { // BUY
-        if (ticker.ask <= order_price) {
-          // Fill
-          // TODO: implement partial fill ?
-          BOOST_LOG_TRIVIAL(info) << "Filled buy limit order: " << order;
-          double cost = ticker.ask * order.GetQuantity() * (1.0 + m_settings.fee);
-          m_account_balance.AddBalance(quote_asset_id, -cost);
-          m_account_balance.AddBalance(base_asset_id, order.GetQuantity());
-          if (m_user_data_listener) {
-            order.SetTotalCost(cost);
-            order.SetExecutedQuantity(order.GetQuantity());
-            order.SetStatus(OrderStatus::FILLED);
-            m_user_data_listener->OnOrderUpdate(order);
-          }
-          m_limit_orders.erase(m_limit_orders.begin() + i);
-          m_balance_listener.OnAccountBalanceUpdate(m_account_balance);
-          BOOST_LOG_TRIVIAL(info) << "Account value: " << GetAccountValue(SymbolId::USDT);
+    auto orders_it = m_limit_orders.find(ticker.symbol);
+    if (orders_it == m_limit_orders.end()) {
+      return;
+    }
+    // Check if any limit order got filled, only orders with crossed price are touched
+    auto& sells = orders_it->second.sells;
+    while (!sells.empty() && ticker.bid >= sells.begin()->first) {
+      BOOST_LOG_TRIVIAL(info) << "Filled sell limit order: " << sells.begin()->second;
+      FillTickerLimitOrder(sells, sells.begin(), ticker.bid);
+    }
+    auto& buys = orders_it->second.buys;
+    while (!buys.empty() && ticker.ask <= std::prev(buys.end())->first) {
+      BOOST_LOG_TRIVIAL(info) << "Filled buy limit order: " << std::prev(buys.end())->second;
+      FillTickerLimitOrder(buys, std::prev(buys.end()), ticker.ask);
+    }
+  }
+
+  // TODO: implement partial fill ?
+  void FillTickerLimitOrder(std::multimap<double, Order>& orders, std::multimap<double, Order>::iterator it, double price) {
+    Order order = std::move(it->second);
+    orders.erase(it);
+    m_limit_order_index.erase(order.GetId());
+    double left_qty = order.GetQuantity() - order.GetExecutedQuantity();
+    ApplyFill(order, left_qty, price * left_qty, 0);
+    order.SetStatus(OrderStatus::FILLED);
+    NotifyFill(order);
+  }
+
+  // Resting order (partially) filled at its limit price
+  void FillLimitOrder(Order& order, quantity_t qty, bool completed) {
+    BOOST_LOG_TRIVIAL(info) << "Filled " << qty << " of limit order: " << order;
+    ApplyFill(order, qty, qty * order.GetPrice(), 0);
+    order.SetStatus(completed ? OrderStatus::FILLED : OrderStatus::PARTIALLY_FILLED);
+    NotifyFill(order);
+  }
+
+  // Resting orders, both with and without order book data
+  template <typename F>
+  void ForEachLimitOrder(F&& f) const {
+    for (const auto& p : m_limit_orders) {
+      for (const auto& orders : {&p.second.buys, &p.second.sells}) {
+        for (const auto& price_order : *orders) {
+          f(price_order.second);
         }
       }
     }
+    for (const auto& p : m_queue_models) {
+      p.second.ForEach([&](const QueuePositionModel::QueuedOrder& queued) {
+        f(queued.order);
+      });
+    }
+  }
+
+  const OrderBook* GetOrderBook(SymbolPairId symbol) const {
+    auto it = m_order_books.find(symbol);
+    if (it == m_order_books.end()) {
+      return nullptr;
+    }
+    return &it->second;
   }
 
   double GetAccountValue(SymbolId quote_symbol_id) const {
@@ -420,13 +720,20 @@ private:
 private:
   BacktestSettings m_settings;
   AccountBalance m_account_balance;
-  std::vector<OrderRequest> m_pending_market_orders;
-  std::vector<OrderRequest> m_pending_limit_orders;
-  std::vector<Order> m_limit_orders;
-  uint64_t m_update_timestamp_us;
+  EventScheduler* m_scheduler;
+  std::unique_ptr<EventScheduler> m_own_scheduler;
+  // Resting orders of symbols without order book data, filled when ticker crosses their price
+  std::unordered_map<SymbolPairId, TickerLimitOrders> m_limit_orders;
+  // Order id -> position in m_limit_orders
+  std::unordered_map<std::string, LimitOrderLocation> m_limit_order_index;
+  // Resting orders of symbols with order book data
+  std::unordered_map<SymbolPairId, QueuePositionModel> m_queue_models;
   std::unordered_map<SymbolPairId, Ticker> m_tickers;
+  std::unordered_map<SymbolPairId, OrderBook> m_order_books;
   // std::unordered_map<SymbolPairId, Ticker> m_previous_tickers;
   AccountBalanceListener& m_balance_listener;
   UserDataListener* m_user_data_listener;
   uint64_t m_last_order_id;
+  // Sent orders not yet matched by the exchange
+  size_t m_orders_in_flight;
 };
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "backtest_exchange_client.hpp"
 
+#include "model/ticker_test_utils.hpp"
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
@@ -15,6 +17,70 @@ public:
   MOCK_METHOD(void, OnAccountBalanceUpdate, (const AccountBalance& balance), (override));
 };
 
+class MockUserDataListener : public UserDataListener {
+public:
+  virtual ~MockUserDataListener() {
+
+  }
+
+  MOCK_METHOD(void, OnConnectionOpen, (const std::string& name), (override));
+  MOCK_METHOD(void, OnConnectionClose, (const std::string& name), (override));
+  MOCK_METHOD(void, OnAccountBalanceUpdate, (const AccountBalance& balance), (override));
+  MOCK_METHOD(void, OnOrderUpdate, (const Order& order), (override));
+};
+
+namespace {
+
+class ScriptedLatencyModel : public LatencyModel {
+public:
+  explicit ScriptedLatencyModel(std::vector<uint64_t> latencies) : m_latencies(std::move(latencies)), m_next(0) {}
+
+  virtual uint64_t Sample() override {
+    return m_latencies[m_next++ % m_latencies.size()];
+  }
+
+private:
+  std::vector<uint64_t> m_latencies;
+  size_t m_next;
+};
+
+BacktestSettings CreateSettings() {
+  BacktestSettings settings;
+  settings.exchange = "test";
+  settings.fee = 0.001;
+  settings.slippage = 0.0;
+  settings.network_latency_us = 100000;
+  settings.execution_delay_us = 20000;
+  settings.initial_balances = {
+    {SymbolId::ADA, 100000.0},
+    {SymbolId::USDT, 100000}
+  };
+  return settings;
+}
+
+OrderBookUpdate::Level CreateLevel(const std::string& price, const std::string& volume) {
+  OrderBookUpdate::Level level;
+  level.price = Decimal::Parse(price);
+  level.volume = Decimal::Parse(volume);
+  return level;
+}
+
+// Asks: 400 @ 1.11, 300 @ 1.12, 1000 @ 1.13, bids: 2000 @ 1.10
+OrderBook CreateOrderBook() {
+  OrderBook ob{"test", SymbolPairId::ADA_USDT, 1000, PrecisionSettings{2, 0, 6}};
+  OrderBookUpdate update;
+  update.is_snapshot = true;
+  update.exchange = "test";
+  update.symbol = SymbolPairId::ADA_USDT;
+  update.arrived_ts = 1;
+  update.bids = {CreateLevel("1.10", "2000")};
+  update.asks = {CreateLevel("1.11", "400"), CreateLevel("1.12", "300"), CreateLevel("1.13", "1000")};
+  ob.Update(update);
+  return ob;
+}
+
+}
+
 TEST(BacktestExchangeClientTest, TestSingleMarketOrder) {
   BacktestSettings settings;
   settings.exchange = "test";
@@ -123,4 +189,218 @@ TEST(BacktestExchangeClientTest, TestSingleLimitOrder) {
 
 TEST(BacktestExchangeClientTest, TestSingleLimitOrderAsMarket) {
   
-}
\ No newline at end of file
+}
+
+TEST(BacktestExchangeClientTest, TestMarketOrderWalksBook) {
+  NiceMock<MockAccountBalanceListener> balance_listener;
+  MockUserDataListener user_data_listener;
+  BacktestExchangeClient backtest_client(CreateSettings(), balance_listener);
+  backtest_client.RegisterUserDataListener(&user_data_listener);
+
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 1));
+  backtest_client.OnOrderBookUpdate(CreateOrderBook());
+  backtest_client.MarketOrder(SymbolPairId::ADA_USDT, Side::BUY, 1000);
+
+  Order order;
+  EXPECT_CALL(user_data_listener, OnOrderUpdate(_))
+    .WillOnce(testing::SaveArg<0>(&order));
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 230000));
+
+  // 400*1.11 + 300*1.12 + 300*1.13
+  EXPECT_EQ(OrderStatus::FILLED, order.GetStatus());
+  EXPECT_DOUBLE_EQ(1000, order.GetExecutedQuantity());
+  EXPECT_DOUBLE_EQ(1.119, order.GetPrice());
+  EXPECT_DOUBLE_EQ(1119*1.001, order.GetTotalCost());
+  auto balance = backtest_client.GetAccountBalance().Get();
+  EXPECT_DOUBLE_EQ(100000 - 1119*1.001, balance.GetFreeBalance(SymbolId::USDT));
+  EXPECT_DOUBLE_EQ(101000, balance.GetFreeBalance(SymbolId::ADA));
+}
+
+TEST(BacktestExchangeClientTest, TestMarketOrderExhaustsBook) {
+  NiceMock<MockAccountBalanceListener> balance_listener;
+  MockUserDataListener user_data_listener;
+  BacktestExchangeClient backtest_client(CreateSettings(), balance_listener);
+  backtest_client.RegisterUserDataListener(&user_data_listener);
+
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 1));
+  backtest_client.OnOrderBookUpdate(CreateOrderBook());
+  backtest_client.MarketOrder(SymbolPairId::ADA_USDT, Side::BUY, 2000);
+
+  Order order;
+  EXPECT_CALL(user_data_listener, OnOrderUpdate(_))
+    .WillOnce(testing::SaveArg<0>(&order));
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 230000));
+
+  EXPECT_EQ(OrderStatus::EXPIRED, order.GetStatus());
+  EXPECT_DOUBLE_EQ(1700, order.GetExecutedQuantity());
+  EXPECT_DOUBLE_EQ(1910*1.001, order.GetTotalCost());
+}
+
+TEST(BacktestExchangeClientTest, TestMarketableLimitOrderPartialFill) {
+  NiceMock<MockAccountBalanceListener> balance_listener;
+  MockUserDataListener user_data_listener;
+  BacktestExchangeClient backtest_client(CreateSettings(), balance_listener);
+  backtest_client.RegisterUserDataListener(&user_data_listener);
+
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 1));
+  backtest_client.OnOrderBookUpdate(CreateOrderBook());
+  backtest_client.LimitOrder(SymbolPairId::ADA_USDT, Side::BUY, 1000, 1.12);
+
+  Order order;
+  EXPECT_CALL(user_data_listener, OnOrderUpdate(_))
+    .WillOnce(testing::SaveArg<0>(&order));
+  // Ticker already reflects the taken liquidity, so the rest is not filled
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.13, 230000));
+
+  EXPECT_EQ(OrderStatus::PARTIALLY_FILLED, order.GetStatus());
+  EXPECT_DOUBLE_EQ(700, order.GetExecutedQuantity());
+  EXPECT_DOUBLE_EQ(780*1.001, order.GetTotalCost());
+  // Rest of the order stays in the book
+  auto open_orders = backtest_client.GetOpenOrders().Get();
+  ASSERT_EQ(1u, open_orders.size());
+  EXPECT_DOUBLE_EQ(700, open_orders[0].GetExecutedQuantity());
+}
+TEST(BacktestExchangeClientTest, TestRestingLimitOrderQueue) {
+  NiceMock<MockAccountBalanceListener> balance_listener;
+  MockUserDataListener user_data_listener;
+  BacktestExchangeClient backtest_client(CreateSettings(), balance_listener);
+  backtest_client.RegisterUserDataListener(&user_data_listener);
+
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 1));
+  backtest_client.OnOrderBookUpdate(CreateOrderBook());
+  // 300 already queued at 1.12
+  backtest_client.LimitOrder(SymbolPairId::ADA_USDT, Side::SELL, 500, 1.12);
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 230000));
+  ASSERT_TRUE(backtest_client.HasOpenOrders(SymbolPairId::ADA_USDT));
+
+  TradeTicker trade;
+  trade.symbol = SymbolPairId::ADA_USDT;
+  trade.exchange = "test";
+  trade.price = 1.12;
+  trade.qty = 400;
+  trade.is_market_maker = false;
+  trade.arrived_ts = 240000;
+
+  Order order;
+  EXPECT_CALL(user_data_listener, OnOrderUpdate(_))
+    .WillOnce(testing::SaveArg<0>(&order));
+  backtest_client.OnTradeTicker(trade);
+  EXPECT_EQ(OrderStatus::PARTIALLY_FILLED, order.GetStatus());
+  EXPECT_DOUBLE_EQ(100, order.GetExecutedQuantity());
+  EXPECT_DOUBLE_EQ(112*0.999, order.GetTotalCost());
+
+  EXPECT_CALL(user_data_listener, OnOrderUpdate(_))
+    .WillOnce(testing::SaveArg<0>(&order));
+  backtest_client.OnTradeTicker(trade);
+  EXPECT_EQ(OrderStatus::FILLED, order.GetStatus());
+  EXPECT_DOUBLE_EQ(500, order.GetExecutedQuantity());
+  EXPECT_FALSE(backtest_client.HasOpenOrders());
+  auto balance = backtest_client.GetAccountBalance().Get();
+  EXPECT_DOUBLE_EQ(99500, balance.GetFreeBalance(SymbolId::ADA));
+}
+
+TEST(BacktestExchangeClientTest, TestCancelRestingOrders) {
+  NiceMock<MockAccountBalanceListener> balance_listener;
+  NiceMock<MockUserDataListener> user_data_listener;
+  BacktestExchangeClient backtest_client(CreateSettings(), balance_listener);
+  backtest_client.RegisterUserDataListener(&user_data_listener);
+
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 1));
+  std::vector<Order> orders;
+  for (int i = 0; i < 10; ++i) {
+    orders.push_back(backtest_client.LimitOrder(SymbolPairId::ADA_USDT, Side::BUY, 10, 1.00 + i*0.001).Get());
+  }
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 230000));
+  EXPECT_EQ(10u, backtest_client.GetOpenOrders().Get().size());
+  EXPECT_FALSE(backtest_client.HasOpenOrders(SymbolPairId::BTC_USDT));
+
+  EXPECT_TRUE(backtest_client.CancelOrder(orders[9]).Get());
+  EXPECT_FALSE(static_cast<bool>(backtest_client.CancelOrder(orders[9])));
+
+  // Only orders with price at or above 1.005 are crossed
+  EXPECT_CALL(user_data_listener, OnOrderUpdate(_)).Times(4);
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.00, 1.005, 240000));
+  EXPECT_EQ(5u, backtest_client.GetOpenOrders().Get().size());
+
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_TRUE(backtest_client.CancelOrder(orders[i]).Get());
+  }
+  EXPECT_FALSE(backtest_client.HasOpenOrders());
+}
+
+TEST(BacktestExchangeClientTest, TestOrderMatchedOnSharedClock) {
+  NiceMock<MockAccountBalanceListener> balance_listener;
+  MockUserDataListener user_data_listener;
+  EventScheduler scheduler;
+  BacktestSettings settings = CreateSettings();
+  settings.notify_order_acks = true;
+  BacktestExchangeClient backtest_client(settings, balance_listener, &scheduler);
+  BacktestExchangeClient other_client(CreateSettings(), balance_listener, &scheduler);
+  backtest_client.RegisterUserDataListener(&user_data_listener);
+
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 1));
+  other_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 1));
+  backtest_client.MarketOrder(SymbolPairId::ADA_USDT, Side::BUY, 100);
+  EXPECT_FALSE(backtest_client.IsAccountSynced());
+
+  // Data of other symbols moves the clock, quiet symbol gets filled in time
+  Ticker btc_ticker = CreateTicker("test", SymbolPairId::ADA_USDT, 30000, 30001, 200002);
+  btc_ticker.symbol = SymbolPairId::BTC_USDT;
+  std::vector<Order> updates;
+  EXPECT_CALL(user_data_listener, OnOrderUpdate(_))
+    .Times(2)
+    .WillRepeatedly([&](const Order& order) { updates.push_back(order); });
+  other_client.OnBookTicker(btc_ticker);
+  ASSERT_EQ(1u, updates.size());
+  EXPECT_EQ(OrderStatus::NEW, updates[0].GetStatus());
+
+  btc_ticker.arrived_ts = 220002;
+  other_client.OnBookTicker(btc_ticker);
+  ASSERT_EQ(2u, updates.size());
+  EXPECT_EQ(OrderStatus::FILLED, updates[1].GetStatus());
+  EXPECT_DOUBLE_EQ(1.11, updates[1].GetPrice());
+  EXPECT_TRUE(backtest_client.IsAccountSynced());
+}
+
+TEST(BacktestExchangeClientTest, TestFillsDelayedByResponseLatency) {
+  NiceMock<MockAccountBalanceListener> balance_listener;
+  MockUserDataListener user_data_listener;
+  BacktestSettings settings = CreateSettings();
+  // Order: market data and request latency, fill: market data and response latency
+  settings.latency_model = std::make_shared<ScriptedLatencyModel>(std::vector<uint64_t>{100000, 100000, 50000, 100000});
+  BacktestExchangeClient backtest_client(settings, balance_listener);
+  backtest_client.RegisterUserDataListener(&user_data_listener);
+
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 1));
+  backtest_client.OnOrderBookUpdate(CreateOrderBook());
+  backtest_client.LimitOrder(SymbolPairId::ADA_USDT, Side::SELL, 500, 1.12);
+  EXPECT_CALL(user_data_listener, OnOrderUpdate(_)).Times(0);
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 230000));
+  Mock::VerifyAndClearExpectations(&user_data_listener);
+
+  TradeTicker trade;
+  trade.symbol = SymbolPairId::ADA_USDT;
+  trade.exchange = "test";
+  trade.price = 1.12;
+  trade.qty = 1000;
+  trade.is_market_maker = false;
+  trade.arrived_ts = 240000;
+  backtest_client.OnTradeTicker(trade);
+  // Balance changes on the exchange right away, the update is delivered later
+  auto balance = backtest_client.GetAccountBalance().Get();
+  EXPECT_DOUBLE_EQ(99500, balance.GetFreeBalance(SymbolId::ADA));
+
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 240001));
+
+  // Filled at 240000 as seen with 50ms delay, 100ms response latency
+  Order order;
+  AccountBalance delivered_balance;
+  EXPECT_CALL(user_data_listener, OnOrderUpdate(_))
+    .WillOnce(testing::SaveArg<0>(&order));
+  EXPECT_CALL(balance_listener, OnAccountBalanceUpdate(_))
+    .WillOnce(testing::SaveArg<0>(&delivered_balance));
+  backtest_client.OnBookTicker(CreateTicker("test", SymbolPairId::ADA_USDT, 1.10, 1.11, 290001));
+  EXPECT_EQ(OrderStatus::FILLED, order.GetStatus());
+  EXPECT_EQ("test", delivered_balance.GetExchange());
+  EXPECT_DOUBLE_EQ(99500, delivered_balance.GetFreeBalance(SymbolId::ADA));
+}
@@ -2,103 +2,212 @@
 
 #include "utils/string.h"
 
-BacktestResultsProcessor::BacktestResultsProcessor(const std::string& results_file, std::initializer_list<SymbolId> symbols)
-    : m_results_file(results_file, std::ios::out | std::ios::app | std::ios::binary), m_symbols(symbols) {
-      for (auto it = m_symbols.begin(); it != m_symbols.end(); ++it) {
-        m_results_file << *it;
-        if (std::next(it) != m_symbols.end()) {
-          m_results_file << ",";
-        } else {
-          m_results_file << "\n";
-        }
-      }
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+BacktestResultsProcessor::BacktestResultsProcessor(const std::string& results_file, std::initializer_list<SymbolId> symbols,
+    const ResultsOptions& options)
+    : m_results_file(results_file, std::ios::out | std::ios::binary
+          | (options.format == ResultsFormat::CSV ? std::ios::app : std::ios::trunc)),
+      m_symbols(symbols), m_options(options), m_cumulative_balances(), m_prices(),
+      m_columns(m_symbols.size() + (options.valuation_asset != SymbolId::UNKNOWN_ASSET ? 1 : 0)), m_flushed_rows(0) {
+  if (m_options.flush_rows == 0) {
+    throw std::invalid_argument("BacktestResultsProcessor: flush_rows must be positive");
+  }
+  for (auto& column : m_columns) {
+    column.reserve(m_options.flush_rows);
+  }
+  if (m_options.valuation_asset != SymbolId::UNKNOWN_ASSET) {
+    SetPrice(m_options.valuation_asset, 1.0);
+  }
+  WriteHeader();
 }
 
 BacktestResultsProcessor::~BacktestResultsProcessor() {
+  Flush();
   m_results_file.close();
 }
 
-std::unordered_map<SymbolId, double> BacktestResultsProcessor::GetCumulativeBalances() {
+std::unordered_map<SymbolId, double> BacktestResultsProcessor::GetCumulativeBalances() const {
   std::unordered_map<SymbolId, double> res;
-  for (const auto& p : m_exchange_balances) {
-    const auto& balance_map = p.second;
-    for (const auto& balance : balance_map) {
-      if (res.find(balance.first) == res.end()) {
-        res.emplace(balance.first, 0.0d);
-      }
-      res[balance.first] += balance.second;
+  for (size_t i = 0; i < m_assets.size(); ++i) {
+    if (m_assets.test(i)) {
+      res.emplace(static_cast<SymbolId>(i), m_cumulative_balances[i]);
     }
   }
   return res;
 }
 
-// double BacktestResultsProcessor::CalculateAssetsValue(const std::unordered_map<SymbolPairId, double>& prices, SymbolId quote_asset) {
-//   double account_value = 0;
-//   for (auto* client : m_backtest_clients) {
-//     auto balance_map = GetBalanceMap(client);
-//     for (const auto& p : balance_map) {
-//       if (p.first == quote_asset) {
-//         account_value += p.second;
-//         continue;
-//       }
-//       SymbolPair sp(p.first, quote_asset);
-//       SymbolPairId spid = SymbolPairId(sp);
-//       assert(prices.find(spid) != prices.end());
-//       double price = prices.at(SymbolPairId(sp));
-//       account_value += p.second * price;
-//     }
-//   }
-//   return account_value;
-// }
-
-  // void PrintBalances() {
-  //   const size_t sz = m_balances.size();
-  //   for (auto it = m_balances.begin(); it != m_balances.end(); ++it) {
-  //     const SymbolId& spid = it->first;
-  //     // TODO: FIXME: set correct precision!!
-  //     std::string b = std::to_string(m_balances.at(spid));
-  //     m_results_file << b;
-  //     if (std::next(it) != m_balances.end()) {
-  //       m_results_file << ",";
-  //     } else {
-  //       // TODO: initial tickers can vary depending on exchanges, you want some fixed initial tickers probably...
-  //       double account_value = CalculateAccountValue(SymbolId::USDT, m_initial_tickers);
-  //       m_results_file << "," << std::to_string(account_value) << "\n";
-  //     }
-  //   }
-  //   m_results_file.flush();
-  // }
+void BacktestResultsProcessor::SetInitialBalance(const AccountBalance& account_balance) {
+  if (m_exchange_index.count(account_balance.GetExchange()) == 0) {
+    ApplyBalance(GetExchangeBalances(account_balance.GetExchange()), account_balance);
+  }
+}
+
+void BacktestResultsProcessor::SetPrice(SymbolId asset, double price) {
+  m_prices[asset] = price;
+  m_priced_assets.set(asset);
+}
+
+EquityMetrics::Summary BacktestResultsProcessor::GetMetrics() const {
+  return m_metrics.GetSummary();
+}
+
+size_t BacktestResultsProcessor::GetRowCount() const {
+  return m_flushed_rows + (m_columns.empty() ? 0 : m_columns.front().size());
+}
+
+void BacktestResultsProcessor::Flush() {
+  const size_t rows = m_columns.empty() ? 0 : m_columns.front().size();
+  if (rows == 0) {
+    return;
+  }
+  if (m_options.format == ResultsFormat::CSV) {
+    // Same format as cryptobot::to_string(value, 10), without a string stream per value
+    std::string out;
+    out.reserve(rows * m_columns.size() * 24);
+    char buf[512];
+    for (size_t row = 0; row < rows; ++row) {
+      for (size_t col = 0; col < m_columns.size(); ++col) {
+        const int n = std::snprintf(buf, sizeof(buf), "%.10f", m_columns[col][row]);
+        out.append(buf, std::min<size_t>(n, sizeof(buf) - 1));
+        out.push_back(col + 1 < m_columns.size() ? ',' : '\n');
+      }
+    }
+    m_results_file.write(out.data(), out.size());
+  } else {
+    // Chunk of row count, then the rows of each column
+    const uint64_t count = rows;
+    m_results_file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const auto& column : m_columns) {
+      m_results_file.write(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(double));
+    }
+  }
+  m_results_file.flush();
+  m_flushed_rows += rows;
+  for (auto& column : m_columns) {
+    column.clear();
+  }
+}
 
 void BacktestResultsProcessor::OnAccountBalanceUpdate(const AccountBalance& account_balance) {
-  BOOST_LOG_TRIVIAL(info) << "BacktestResultsProcessor::OnBalanceUpdate";
-  m_exchange_balances[account_balance.GetExchange()] = account_balance.GetBalanceMap();
-  const auto& cumulative_balances = GetCumulativeBalances();
-  for (auto it = m_symbols.begin(); it != m_symbols.end(); ++it) {
-    m_results_file << cryptobot::to_string(cumulative_balances.at(*it), 10);
-    if (std::next(it) != m_symbols.end()) {
-      m_results_file << ",";
-    } else {
-      m_results_file << "\n";
+  BOOST_LOG_TRIVIAL(trace) << "BacktestResultsProcessor::OnBalanceUpdate";
+  const bool known_exchange = m_exchange_index.count(account_balance.GetExchange()) > 0;
+  double traded_value = ApplyBalance(GetExchangeBalances(account_balance.GetExchange()), account_balance);
+  if (!known_exchange) {
+    traded_value = 0.0;
+  }
+  for (size_t i = 0; i < m_symbols.size(); ++i) {
+    m_columns[i].push_back(m_cumulative_balances[m_symbols[i]]);
+  }
+  if (m_options.valuation_asset != SymbolId::UNKNOWN_ASSET) {
+    const double equity = GetEquity();
+    m_columns.back().push_back(equity);
+    // Both legs of a trade change balances by its notional
+    m_metrics.AddSample(equity, traded_value / 2);
+  }
+  if (!m_columns.empty() && m_columns.front().size() >= m_options.flush_rows) {
+    Flush();
+  }
+}
+
+void BacktestResultsProcessor::OnBookTicker(const Ticker& ticker) {
+  if (m_options.valuation_asset == SymbolId::UNKNOWN_ASSET || ticker.symbol < 0 || ticker.symbol >= SymbolPairId::UNKNOWN) {
+    return;
+  }
+  const double mid = (ticker.bid + ticker.ask) / 2;
+  if (mid <= 0) {
+    return;
+  }
+  const SymbolPair& pair = ticker.symbol;
+  if (pair.GetQuoteAsset() == m_options.valuation_asset) {
+    SetPrice(pair.GetBaseAsset(), mid);
+  } else if (pair.GetBaseAsset() == m_options.valuation_asset) {
+    SetPrice(pair.GetQuoteAsset(), 1.0 / mid);
+  }
+}
+
+BacktestResultsProcessor::Balances& BacktestResultsProcessor::GetExchangeBalances(const std::string& exchange) {
+  auto it = m_exchange_index.find(exchange);
+  if (it == m_exchange_index.end()) {
+    it = m_exchange_index.emplace(exchange, m_exchange_balances.size()).first;
+    m_exchange_balances.emplace_back().fill(0.0);
+  }
+  return m_exchange_balances[it->second];
+}
+
+double BacktestResultsProcessor::ApplyBalance(Balances& balances, const AccountBalance& account_balance) {
+  // An update replaces all balances of the exchange
+  Balances updated;
+  updated.fill(0.0);
+  for (const auto& p : account_balance.GetBalanceMap()) {
+    if (p.first >= 0 && p.first < SymbolId::UNKNOWN_ASSET) {
+      updated[p.first] = p.second;
+      m_assets.set(p.first);
     }
   }
+  double traded_value = 0.0;
+  for (size_t i = 0; i < updated.size(); ++i) {
+    if (updated[i] == balances[i]) {
+      continue;
+    }
+    if (m_priced_assets.test(i)) {
+      traded_value += std::fabs(updated[i] - balances[i]) * m_prices[i];
+    }
+    balances[i] = updated[i];
+    // Summed again rather than adjusted by the difference, so rounding errors do not pile up
+    double sum = 0.0;
+    for (const auto& exchange_balances : m_exchange_balances) {
+      sum += exchange_balances[i];
+    }
+    m_cumulative_balances[i] = sum;
+  }
+  return traded_value;
+}
+
+double BacktestResultsProcessor::GetEquity() const {
+  double equity = 0.0;
+  for (size_t i = 0; i < m_cumulative_balances.size(); ++i) {
+    if (m_priced_assets.test(i)) {
+      equity += m_cumulative_balances[i] * m_prices[i];
+    }
+  }
+  return equity;
 }
 
-// void BacktestResultsProcessor::WriteBalanceCsvHeaders() {
-//   std::ostringstream oss;
-//   for (auto it = m_balances.begin(); it != m_balances.end(); ++it) {
-//     const SymbolId& spid = it->first;
-//     if (std::next(it) != m_balances.end()) {
-//       oss << spid << ",";
-//     } else {
-//       oss << spid << "," << "Account Value" << "\n";
-//     }
-//   }
-//   m_results_file << oss.str();
-// }
+void BacktestResultsProcessor::WriteHeader() {
+  std::vector<std::string> names;
+  for (SymbolId symbol : m_symbols) {
+    std::ostringstream oss;
+    oss << symbol;
+    names.push_back(oss.str());
+  }
+  if (m_options.valuation_asset != SymbolId::UNKNOWN_ASSET) {
+    names.push_back("equity");
+  }
+  if (m_options.format == ResultsFormat::CSV) {
+    for (size_t i = 0; i < names.size(); ++i) {
+      m_results_file << names[i] << (i + 1 < names.size() ? "," : "\n");
+    }
+    return;
+  }
+  // Column count, then length prefixed column names
+  const uint32_t count = names.size();
+  m_results_file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+  for (const auto& name : names) {
+    const uint32_t length = name.size();
+    m_results_file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    m_results_file.write(name.data(), length);
+  }
+}
 
 std::ostream& operator<<(std::ostream& os, const std::unordered_map<SymbolId, double>& sdmap) {
   for (const auto& p : sdmap) {
     os << p.first << ": " << cryptobot::to_string(p.second, 10) << std::endl;
   }
   return os;
-}
\ No newline at end of file
+}
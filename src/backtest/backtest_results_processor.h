@@ -1,28 +1,103 @@
+#pragma once
+
 #include "backtest_exchange_client.hpp"
+#include "equity_metrics.hpp"
 #include "exchange/account_balance_listener.h"
+#include "exchange/exchange_listener.h"
 #include "model/symbol.h"
 #include "model/ticker.h"
 
+#include <array>
+#include <bitset>
+#include <fstream>
 #include <initializer_list>
 #include <iostream>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
+
+enum class ResultsFormat {
+  CSV,
+  // Header of column names, then chunks of rows stored column by column, see BacktestResultsProcessor::Flush()
+  BINARY
+};
+
+struct ResultsOptions {
+  ResultsFormat format = ResultsFormat::CSV;
+  // Rows buffered before they are written out
+  size_t flush_rows = 1 << 16;
+  // Asset to value the equity in, from book ticker mid prices, UNKNOWN_ASSET for no equity column and metrics
+  SymbolId valuation_asset = SymbolId::UNKNOWN_ASSET;
+};
 
-class BacktestResultsProcessor : public AccountBalanceListener {
+/**
+ * Writes a row of cumulative balances of all exchanges per balance update, with the equity in the valuation
+ * asset as the last column if there is one. Balances are kept per asset in arrays indexed by SymbolId,
+ * rows are buffered in columns and written out in chunks of `flush_rows`, and when destroyed.
+ *
+ * Registered as an exchange listener it follows mid prices for the equity, assets without a price are not counted.
+ * The first update of an exchange is not counted as turnover, initial balances should be set up front
+ * so the equity curve starts from all of them.
+ */
+class BacktestResultsProcessor : public AccountBalanceListener, public ExchangeListener {
 public:
-  BacktestResultsProcessor(const std::string& results_file, std::initializer_list<SymbolId> symbols);
+  BacktestResultsProcessor(const std::string& results_file, std::initializer_list<SymbolId> symbols,
+      const ResultsOptions& options = ResultsOptions());
   ~BacktestResultsProcessor();
 
-  std::unordered_map<SymbolId, double> GetCumulativeBalances();
-  // double CalculateAssetsValue(const std::unordered_map<SymbolPairId, double>& prices, SymbolId quote_asset);
+  std::unordered_map<SymbolId, double> GetCumulativeBalances() const;
+
+  /**
+   * Balance of an exchange before its first update, counted in cumulative balances without writing a row.
+   */
+  void SetInitialBalance(const AccountBalance& account_balance);
+
+  /**
+   * Price of an asset in the valuation asset.
+   */
+  void SetPrice(SymbolId asset, double price);
+
+  EquityMetrics::Summary GetMetrics() const;
+
+  /**
+   * @return rows written or buffered so far
+   */
+  size_t GetRowCount() const;
+
+  void Flush();
 
   virtual void OnAccountBalanceUpdate(const AccountBalance& account_balance) override;
-// private:
-//   void WriteBalanceCsvHeaders();
+
+  virtual void OnConnectionOpen(const std::string&) override {}
+
+  virtual void OnConnectionClose(const std::string&) override {}
+
+  virtual void OnBookTicker(const Ticker& ticker) override;
+
 private:
+  typedef std::array<double, SymbolId::UNKNOWN_ASSET + 1> Balances;
+
+  Balances& GetExchangeBalances(const std::string& exchange);
+  // @return value of the balance changes, in the valuation asset
+  double ApplyBalance(Balances& balances, const AccountBalance& account_balance);
+  double GetEquity() const;
+  void WriteHeader();
+
   std::ofstream m_results_file;
   std::vector<SymbolId> m_symbols;
-  std::unordered_map<std::string, std::unordered_map<SymbolId, double>> m_exchange_balances;
+  ResultsOptions m_options;
+  std::unordered_map<std::string, size_t> m_exchange_index;
+  std::vector<Balances> m_exchange_balances;
+  Balances m_cumulative_balances;
+  // Assets any exchange reported a balance for
+  std::bitset<SymbolId::UNKNOWN_ASSET + 1> m_assets;
+  Balances m_prices;
+  std::bitset<SymbolId::UNKNOWN_ASSET + 1> m_priced_assets;
+  // One column per symbol, then the equity
+  std::vector<std::vector<double>> m_columns;
+  size_t m_flushed_rows;
+  EquityMetrics m_metrics;
 };
 
-std::ostream& operator<<(std::ostream& os, const std::unordered_map<SymbolId, double>& sdmap);
\ No newline at end of file
+std::ostream& operator<<(std::ostream& os, const std::unordered_map<SymbolId, double>& sdmap);
@@ -0,0 +1,106 @@
+#include "backtest_results_processor.h"
+
+#include "model/ticker_test_utils.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace {
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  std::ostringstream oss;
+  oss << file.rdbuf();
+  return oss.str();
+}
+
+}
+
+TEST(BacktestResultsProcessorTest, TestCumulativeBalancesAndCsv) {
+  const std::string path = "/tmp/backtest_results_processor_unittest.csv";
+  std::remove(path.c_str());
+  {
+    ResultsOptions options;
+    options.flush_rows = 2;
+    BacktestResultsProcessor processor(path, {SymbolId::USDT, SymbolId::BTC}, options);
+    processor.SetInitialBalance(AccountBalance({{SymbolId::USDT, 100.0}}, "kraken"));
+    processor.OnAccountBalanceUpdate(AccountBalance({{SymbolId::USDT, 50.0}, {SymbolId::BTC, 1.0}}, "binance"));
+    // Initial balance is only taken before the first update
+    processor.SetInitialBalance(AccountBalance({{SymbolId::USDT, 1000.0}}, "binance"));
+    processor.OnAccountBalanceUpdate(AccountBalance({{SymbolId::USDT, 40.0}, {SymbolId::BTC, 1.5}}, "binance"));
+    // An update replaces all balances of the exchange
+    processor.OnAccountBalanceUpdate(AccountBalance({{SymbolId::BTC, 0.5}}, "kraken"));
+    EXPECT_EQ(processor.GetRowCount(), 3);
+    EXPECT_THAT(processor.GetCumulativeBalances(), UnorderedElementsAre(Pair(SymbolId::USDT, 40.0), Pair(SymbolId::BTC, 2.0)));
+    // First two rows written in a chunk, the last one when destroyed
+    EXPECT_EQ(ReadFile(path), "USDT,BTC\n150.0000000000,1.0000000000\n140.0000000000,1.5000000000\n");
+  }
+  EXPECT_EQ(ReadFile(path), "USDT,BTC\n150.0000000000,1.0000000000\n140.0000000000,1.5000000000\n40.0000000000,2.0000000000\n");
+  std::remove(path.c_str());
+}
+
+TEST(BacktestResultsProcessorTest, TestEquityMetrics) {
+  const std::string path = "/tmp/backtest_results_processor_unittest_equity.csv";
+  std::remove(path.c_str());
+  ResultsOptions options;
+  options.valuation_asset = SymbolId::USDT;
+  BacktestResultsProcessor processor(path, {SymbolId::USDT, SymbolId::BTC}, options);
+  processor.OnBookTicker(CreateTicker("binance", SymbolPairId::BTC_USDT, 99.0, 101.0, 1));
+  // Not in the valuation asset
+  processor.OnBookTicker(CreateTicker("binance", SymbolPairId::ETH_BTC, 0.5, 0.5, 1));
+  processor.SetInitialBalance(AccountBalance({{SymbolId::USDT, 1000.0}, {SymbolId::BTC, 1.0}, {SymbolId::ETH, 5.0}}, "binance"));
+
+  // Buy 1 BTC for 100 USDT, then the price drops and 2 BTC are sold for 180 USDT
+  processor.OnAccountBalanceUpdate(AccountBalance({{SymbolId::USDT, 900.0}, {SymbolId::BTC, 2.0}, {SymbolId::ETH, 5.0}}, "binance"));
+  processor.OnBookTicker(CreateTicker("binance", SymbolPairId::BTC_USDT, 89.0, 91.0, 1));
+  processor.OnAccountBalanceUpdate(AccountBalance({{SymbolId::USDT, 1080.0}, {SymbolId::ETH, 5.0}}, "binance"));
+
+  const auto metrics = processor.GetMetrics();
+  EXPECT_EQ(metrics.samples, 2);
+  EXPECT_DOUBLE_EQ(metrics.initial_equity, 1100.0);
+  EXPECT_DOUBLE_EQ(metrics.equity, 1080.0);
+  EXPECT_DOUBLE_EQ(metrics.pnl, -20.0);
+  EXPECT_DOUBLE_EQ(metrics.max_drawdown, 20.0);
+  EXPECT_DOUBLE_EQ(metrics.turnover, 100.0 + 180.0);
+  processor.Flush();
+  EXPECT_EQ(ReadFile(path), "USDT,BTC,equity\n900.0000000000,2.0000000000,1100.0000000000\n1080.0000000000,0.0000000000,1080.0000000000\n");
+  std::remove(path.c_str());
+}
+
+TEST(BacktestResultsProcessorTest, TestBinaryFormat) {
+  const std::string path = "/tmp/backtest_results_processor_unittest.bin";
+  {
+    ResultsOptions options;
+    options.format = ResultsFormat::BINARY;
+    BacktestResultsProcessor processor(path, {SymbolId::ADA}, options);
+    processor.OnAccountBalanceUpdate(AccountBalance({{SymbolId::ADA, 1.0}}, "binance"));
+    processor.OnAccountBalanceUpdate(AccountBalance({{SymbolId::ADA, 2.0}}, "binance"));
+  }
+  const std::string data = ReadFile(path);
+  ASSERT_EQ(data.size(), 4 + 4 + 3 + 8 + 2 * 8);
+  uint32_t columns;
+  uint32_t name_length;
+  uint64_t rows;
+  double values[2];
+  std::memcpy(&columns, data.data(), 4);
+  std::memcpy(&name_length, data.data() + 4, 4);
+  std::memcpy(&rows, data.data() + 11, 8);
+  std::memcpy(values, data.data() + 19, 16);
+  EXPECT_EQ(columns, 1);
+  EXPECT_EQ(name_length, 3);
+  EXPECT_EQ(data.substr(8, 3), "ADA");
+  EXPECT_EQ(rows, 2);
+  EXPECT_EQ(values[0], 1.0);
+  EXPECT_EQ(values[1], 2.0);
+  std::remove(path.c_str());
+}
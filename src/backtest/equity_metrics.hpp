@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+
+/**
+ * Streaming statistics of an equity curve, each sample updates them in O(1) without keeping the curve.
+ *
+ * Sharpe ratio is the mean over the standard deviation of returns between consecutive samples,
+ * not annualized, since samples are balance updates rather than fixed periods.
+ */
+class EquityMetrics {
+public:
+  struct Summary {
+    size_t samples = 0;
+    double initial_equity = 0.0;
+    double equity = 0.0;
+    double pnl = 0.0;
+    // Largest drop from a previous peak, absolute and relative to the peak
+    double max_drawdown = 0.0;
+    double max_drawdown_pct = 0.0;
+    // Traded notional
+    double turnover = 0.0;
+    double sharpe = 0.0;
+  };
+
+  /**
+   * @param traded_notional value traded since the previous sample, added to turnover
+   */
+  void AddSample(double equity, double traded_notional = 0.0) {
+    if (m_summary.samples == 0) {
+      m_summary.initial_equity = equity;
+      m_peak = equity;
+    } else if (m_summary.equity > 0) {
+      AddReturn(equity / m_summary.equity - 1.0);
+    }
+    ++m_summary.samples;
+    m_summary.equity = equity;
+    m_summary.pnl = equity - m_summary.initial_equity;
+    m_summary.turnover += traded_notional;
+    m_peak = std::max(m_peak, equity);
+    const double drawdown = m_peak - equity;
+    if (drawdown > m_summary.max_drawdown) {
+      m_summary.max_drawdown = drawdown;
+      m_summary.max_drawdown_pct = m_peak > 0 ? drawdown / m_peak : 0.0;
+    }
+  }
+
+  Summary GetSummary() const {
+    Summary summary = m_summary;
+    const double variance = m_returns > 1 ? m_m2 / (m_returns - 1) : 0.0;
+    summary.sharpe = variance > 0 ? m_mean / std::sqrt(variance) : 0.0;
+    return summary;
+  }
+
+private:
+  // Welford's online mean and variance
+  void AddReturn(double r) {
+    ++m_returns;
+    const double delta = r - m_mean;
+    m_mean += delta / m_returns;
+    m_m2 += delta * (r - m_mean);
+  }
+
+  Summary m_summary;
+  double m_peak = 0.0;
+  size_t m_returns = 0;
+  double m_mean = 0.0;
+  double m_m2 = 0.0;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const EquityMetrics::Summary& summary) {
+  os << "samples: " << summary.samples << ", equity: " << summary.equity << ", pnl: " << summary.pnl
+     << ", max drawdown: " << summary.max_drawdown << " (" << summary.max_drawdown_pct * 100 << "%)"
+     << ", turnover: " << summary.turnover << ", sharpe: " << summary.sharpe;
+  return os;
+}
@@ -0,0 +1,40 @@
+#include "equity_metrics.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+
+using namespace testing;
+
+TEST(EquityMetricsTest, TestDrawdownAndPnl) {
+  EquityMetrics metrics;
+  EXPECT_EQ(metrics.GetSummary().samples, 0);
+  for (double equity : {100.0, 120.0, 90.0, 110.0, 130.0, 117.0}) {
+    metrics.AddSample(equity, 10.0);
+  }
+  const auto summary = metrics.GetSummary();
+  EXPECT_EQ(summary.samples, 6);
+  EXPECT_DOUBLE_EQ(summary.initial_equity, 100.0);
+  EXPECT_DOUBLE_EQ(summary.equity, 117.0);
+  EXPECT_DOUBLE_EQ(summary.pnl, 17.0);
+  EXPECT_DOUBLE_EQ(summary.max_drawdown, 30.0);
+  EXPECT_DOUBLE_EQ(summary.max_drawdown_pct, 0.25);
+  EXPECT_DOUBLE_EQ(summary.turnover, 60.0);
+}
+
+TEST(EquityMetricsTest, TestSharpe) {
+  EquityMetrics metrics;
+  // Returns 10% and -5%, mean 2.5%, sample standard deviation 10.6066%
+  metrics.AddSample(100.0);
+  metrics.AddSample(110.0);
+  metrics.AddSample(104.5);
+  EXPECT_NEAR(metrics.GetSummary().sharpe, 0.025 / (0.15 / std::sqrt(2.0)), 1e-9);
+
+  // Constant equity has no volatility
+  EquityMetrics flat;
+  flat.AddSample(100.0);
+  flat.AddSample(100.0);
+  flat.AddSample(100.0);
+  EXPECT_EQ(flat.GetSummary().sharpe, 0.0);
+}
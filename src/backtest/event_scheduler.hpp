@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+/**
+ * Simulated clock with a queue of timed callbacks, shared by the backtest clients of one run
+ * so order events of all exchanges are ordered on one timeline.
+ *
+ * The clock follows the arrival timestamps of replayed market data. Callbacks run in time order,
+ * callbacks due at the same time in the order they were scheduled, which keeps replays deterministic.
+ */
+class EventScheduler {
+public:
+  typedef std::function<void()> Callback;
+
+  uint64_t Now() const {
+    return m_now;
+  }
+
+  /**
+   * Schedule a callback, a time in the past runs it on the next AdvanceTo().
+   */
+  void Schedule(uint64_t ts, Callback callback) {
+    m_events.push(Event{std::max(ts, m_now), m_next_seq++, std::move(callback)});
+  }
+
+  /**
+   * Runs callbacks due before `ts`, including the ones they schedule, then moves the clock to `ts`.
+   * The clock never goes backwards.
+   */
+  void AdvanceTo(uint64_t ts) {
+    while (!m_events.empty() && m_events.top().ts < ts) {
+      RunNext();
+    }
+    m_now = std::max(m_now, ts);
+  }
+
+  /**
+   * Runs all scheduled callbacks, eg. at the end of a replay.
+   */
+  void RunAll() {
+    while (!m_events.empty()) {
+      RunNext();
+    }
+  }
+
+  size_t size() const {
+    return m_events.size();
+  }
+
+  bool empty() const {
+    return m_events.empty();
+  }
+
+private:
+  struct Event {
+    uint64_t ts;
+    uint64_t seq;
+    Callback callback;
+
+    bool operator>(const Event& o) const {
+      return ts != o.ts ? ts > o.ts : seq > o.seq;
+    }
+  };
+
+  void RunNext() {
+    // Moved out before popping, the callback may schedule more events
+    Event event = std::move(const_cast<Event&>(m_events.top()));
+    m_events.pop();
+    m_now = std::max(m_now, event.ts);
+    event.callback();
+  }
+
+  uint64_t m_now = 0;
+  uint64_t m_next_seq = 0;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> m_events;
+};
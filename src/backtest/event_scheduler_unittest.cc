@@ -0,0 +1,48 @@
+#include "event_scheduler.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace testing;
+
+TEST(EventSchedulerTest, TestRunsInTimeOrder) {
+  EventScheduler scheduler;
+  std::vector<int> calls;
+  std::vector<uint64_t> times;
+  scheduler.Schedule(300, [&]() { calls.push_back(3); times.push_back(scheduler.Now()); });
+  scheduler.Schedule(100, [&]() { calls.push_back(1); times.push_back(scheduler.Now()); });
+  // Same time runs in scheduling order
+  scheduler.Schedule(100, [&]() { calls.push_back(2); times.push_back(scheduler.Now()); });
+
+  scheduler.AdvanceTo(100);
+  EXPECT_TRUE(calls.empty());
+  EXPECT_EQ(scheduler.Now(), 100);
+
+  scheduler.AdvanceTo(301);
+  EXPECT_THAT(calls, ElementsAre(1, 2, 3));
+  EXPECT_THAT(times, ElementsAre(100, 100, 300));
+  EXPECT_EQ(scheduler.Now(), 301);
+  EXPECT_TRUE(scheduler.empty());
+}
+
+TEST(EventSchedulerTest, TestCallbacksScheduleMore) {
+  EventScheduler scheduler;
+  std::vector<uint64_t> times;
+  scheduler.Schedule(10, [&]() {
+    times.push_back(scheduler.Now());
+    scheduler.Schedule(scheduler.Now() + 5, [&]() { times.push_back(scheduler.Now()); });
+    scheduler.Schedule(scheduler.Now() + 50, [&]() { times.push_back(scheduler.Now()); });
+  });
+  scheduler.AdvanceTo(20);
+  EXPECT_THAT(times, ElementsAre(10, 15));
+  EXPECT_EQ(scheduler.size(), 1);
+
+  // Clock does not go backwards, past events run on the next advance
+  scheduler.AdvanceTo(5);
+  EXPECT_EQ(scheduler.Now(), 20);
+  scheduler.Schedule(1, [&]() { times.push_back(scheduler.Now()); });
+  scheduler.RunAll();
+  EXPECT_THAT(times, ElementsAre(10, 15, 20, 60));
+}
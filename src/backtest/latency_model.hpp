@@ -0,0 +1,190 @@
+#pragma once
+
+#include "exchange/exchange_listener.h"
+#include "model/ticker.h"
+#include "utils/checkpoint.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include "json/json.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * One way network latency between us and an exchange, in microseconds.
+ *
+ * Random models are seeded, so a backtest replays with the same latencies every time.
+ */
+class LatencyModel : public cryptobot::Checkpointable {
+public:
+  virtual ~LatencyModel() = default;
+
+  virtual uint64_t Sample() = 0;
+
+  // Stateless by default
+  virtual void SaveState(cryptobot::CheckpointWriter&) const override {}
+
+  virtual void LoadState(cryptobot::CheckpointReader&) override {}
+
+  /**
+   * Creates a model from its config, eg. {"type": "fixed", "latency_us": 100000},
+   * {"type": "pareto", "min_us": 50000, "alpha": 2.5, "max_us": 2000000} or
+   * {"type": "recorded", "exchange": "kraken", "fallback_us": 100000, "window": 10000}.
+   *
+   * @throws std::invalid_argument for an unknown type
+   */
+  static std::shared_ptr<LatencyModel> FromJson(const nlohmann::json& json);
+};
+
+class FixedLatencyModel : public LatencyModel {
+public:
+  explicit FixedLatencyModel(uint64_t latency_us) : m_latency_us(latency_us) {}
+
+  virtual uint64_t Sample() override {
+    return m_latency_us;
+  }
+
+private:
+  uint64_t m_latency_us;
+};
+
+/**
+ * Heavy tailed latency, Pareto distributed with scale `min_us` and shape `alpha`, capped at `max_us`.
+ * Smaller alpha means heavier tail, alpha > 1 for a finite mean.
+ */
+class ParetoLatencyModel : public LatencyModel {
+public:
+  ParetoLatencyModel(uint64_t min_us, double alpha, uint64_t max_us, uint64_t seed = 1)
+      : m_min_us(min_us), m_alpha(alpha), m_max_us(max_us), m_rng(seed), m_uniform(0.0, 1.0) {
+    if (alpha <= 0 || max_us < min_us) {
+      throw std::invalid_argument("ParetoLatencyModel: alpha must be positive and max_us at least min_us");
+    }
+  }
+
+  virtual uint64_t Sample() override {
+    // Inverse CDF, 1 - u keeps the base away from zero
+    const double u = 1.0 - m_uniform(m_rng);
+    const double latency = m_min_us / std::pow(u, 1.0 / m_alpha);
+    return latency >= m_max_us ? m_max_us : static_cast<uint64_t>(latency);
+  }
+
+  virtual void SaveState(cryptobot::CheckpointWriter& writer) const override {
+    writer.WriteEngine(m_rng);
+  }
+
+  virtual void LoadState(cryptobot::CheckpointReader& reader) override {
+    reader.ReadEngine(m_rng);
+  }
+
+private:
+  uint64_t m_min_us;
+  double m_alpha;
+  uint64_t m_max_us;
+  std::mt19937_64 m_rng;
+  std::uniform_real_distribution<double> m_uniform;
+};
+
+/**
+ * Samples latencies observed in the replayed data, ie. arrived_ts - source_ts of the exchange's
+ * book tickers, from a window of the most recent ones. Registered with the producer ahead of
+ * the backtest clients, so latency follows the conditions at the time of replay.
+ * Returns `fallback_us` until the first delay is seen, and warns once if it has to, since replay
+ * sources without source timestamps (eg. exchanges that send none) never yield a delay.
+ */
+class RecordedLatencyModel : public LatencyModel, public ExchangeListener {
+public:
+  RecordedLatencyModel(const std::string& exchange, uint64_t fallback_us, size_t window = 10000, uint64_t seed = 1)
+      : m_exchange(exchange), m_fallback_us(fallback_us), m_window(window), m_next(0), m_rng(seed), m_fallback_warned(false) {
+    if (window == 0) {
+      throw std::invalid_argument("RecordedLatencyModel: window must be positive");
+    }
+    m_delays.reserve(window);
+  }
+
+  virtual uint64_t Sample() override {
+    if (m_delays.empty()) {
+      if (!m_fallback_warned) {
+        m_fallback_warned = true;
+        BOOST_LOG_TRIVIAL(warning) << "RecordedLatencyModel: no source timestamps of " << m_exchange << " replayed yet, using "
+            << m_fallback_us << " us";
+      }
+      return m_fallback_us;
+    }
+    std::uniform_int_distribution<size_t> index(0, m_delays.size() - 1);
+    return m_delays[index(m_rng)];
+  }
+
+  size_t GetSampleCount() const {
+    return m_delays.size();
+  }
+
+  virtual void SaveState(cryptobot::CheckpointWriter& writer) const override {
+    writer.WriteVector(m_delays);
+    writer.Write<uint64_t>(m_next);
+    writer.WriteEngine(m_rng);
+  }
+
+  virtual void LoadState(cryptobot::CheckpointReader& reader) override {
+    std::vector<uint64_t> delays = reader.ReadVector<uint64_t>();
+    const size_t next = reader.Read<uint64_t>();
+    if (delays.size() > m_window || next >= m_window) {
+      throw std::runtime_error("RecordedLatencyModel: checkpoint window larger than " + std::to_string(m_window));
+    }
+    m_delays = std::move(delays);
+    m_next = next;
+    reader.ReadEngine(m_rng);
+  }
+
+  virtual void OnConnectionOpen(const std::string&) override {}
+
+  virtual void OnConnectionClose(const std::string&) override {}
+
+  virtual void OnBookTicker(const Ticker& ticker) override {
+    // Skips exchanges without source timestamps and clock skew
+    if (ticker.exchange != m_exchange || !ticker.source_ts || ticker.source_ts.value() == 0
+        || ticker.source_ts.value() > ticker.arrived_ts) {
+      return;
+    }
+    const uint64_t delay = ticker.arrived_ts - ticker.source_ts.value();
+    if (m_delays.size() < m_window) {
+      m_delays.push_back(delay);
+    } else {
+      m_delays[m_next] = delay;
+      m_next = (m_next + 1) % m_window;
+    }
+  }
+
+private:
+  std::string m_exchange;
+  uint64_t m_fallback_us;
+  size_t m_window;
+  // Ring buffer once full
+  std::vector<uint64_t> m_delays;
+  size_t m_next;
+  std::mt19937_64 m_rng;
+  bool m_fallback_warned;
+};
+
+inline std::shared_ptr<LatencyModel> LatencyModel::FromJson(const nlohmann::json& json) {
+  const std::string type = json.at("type").get<std::string>();
+  const uint64_t seed = json.contains("seed") ? json["seed"].get<uint64_t>() : 1;
+  if (type == "fixed") {
+    return std::make_shared<FixedLatencyModel>(json.at("latency_us").get<uint64_t>());
+  }
+  if (type == "pareto") {
+    return std::make_shared<ParetoLatencyModel>(json.at("min_us").get<uint64_t>(), json.at("alpha").get<double>(),
+        json.at("max_us").get<uint64_t>(), seed);
+  }
+  if (type == "recorded") {
+    return std::make_shared<RecordedLatencyModel>(json.at("exchange").get<std::string>(), json.at("fallback_us").get<uint64_t>(),
+        json.contains("window") ? json["window"].get<size_t>() : 10000, seed);
+  }
+  throw std::invalid_argument("LatencyModel: unknown type " + type);
+}
@@ -0,0 +1,91 @@
+#include "latency_model.hpp"
+
+#include "db/event_run_merger.hpp"
+#include "model/ticker_test_utils.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace testing;
+
+namespace {
+
+std::vector<uint64_t> SampleMany(LatencyModel& model, size_t count) {
+  std::vector<uint64_t> samples;
+  for (size_t i = 0; i < count; ++i) {
+    samples.push_back(model.Sample());
+  }
+  return samples;
+}
+
+}
+
+TEST(LatencyModelTest, TestParetoIsDeterministicAndBounded) {
+  ParetoLatencyModel model1(1000, 1.5, 50000, 7);
+  ParetoLatencyModel model2(1000, 1.5, 50000, 7);
+  const auto samples = SampleMany(model1, 10000);
+  EXPECT_EQ(samples, SampleMany(model2, 10000));
+  EXPECT_GE(*std::min_element(samples.begin(), samples.end()), 1000);
+  EXPECT_EQ(*std::max_element(samples.begin(), samples.end()), 50000);
+  // Heavy tail, but most samples close to the minimum
+  auto fast = std::count_if(samples.begin(), samples.end(), [](uint64_t s) { return s < 2000; });
+  EXPECT_GT(fast, 5000);
+  EXPECT_THROW(ParetoLatencyModel(1000, 0, 50000), std::invalid_argument);
+}
+
+TEST(LatencyModelTest, TestRecordedSamplesObservedDelays) {
+  RecordedLatencyModel model("kraken", 777, 2);
+  EXPECT_EQ(model.Sample(), 777);
+  model.OnBookTicker(CreateTicker("binance", SymbolPairId::ADA_USDT, 0.0, 0.0, 1000, 0, 100));
+  model.OnBookTicker(CreateTicker("kraken", SymbolPairId::ADA_USDT, 0.0, 0.0, 1000));
+  // Clock skew
+  model.OnBookTicker(CreateTicker("kraken", SymbolPairId::ADA_USDT, 0.0, 0.0, 1000, 0, 2000));
+  EXPECT_EQ(model.GetSampleCount(), 0);
+
+  model.OnBookTicker(CreateTicker("kraken", SymbolPairId::ADA_USDT, 0.0, 0.0, 1000, 0, 900));
+  model.OnBookTicker(CreateTicker("kraken", SymbolPairId::ADA_USDT, 0.0, 0.0, 2000, 0, 1800));
+  // Window of 2, replaces the oldest delay
+  model.OnBookTicker(CreateTicker("kraken", SymbolPairId::ADA_USDT, 0.0, 0.0, 3000, 0, 2700));
+  EXPECT_EQ(model.GetSampleCount(), 2);
+  EXPECT_THAT(SampleMany(model, 100), Each(AnyOf(200, 300)));
+}
+
+TEST(LatencyModelTest, TestFromJson) {
+  auto fixed = LatencyModel::FromJson(nlohmann::json::parse(R"({"type": "fixed", "latency_us": 1234})"));
+  EXPECT_EQ(fixed->Sample(), 1234);
+  auto recorded = LatencyModel::FromJson(nlohmann::json::parse(R"({"type": "recorded", "exchange": "kraken", "fallback_us": 10})"));
+  EXPECT_NE(dynamic_cast<RecordedLatencyModel*>(recorded.get()), nullptr);
+  EXPECT_THROW(LatencyModel::FromJson(nlohmann::json::parse(R"({"type": "normal"})")), std::invalid_argument);
+}
+
+// Book tickers decoded as MongoTickerProducer does, source timestamps of 0 are the ones not recorded
+TEST(LatencyModelTest, TestRecordedFromReplayedEvents) {
+  auto batch = std::make_unique<EventBatch>();
+  for (const auto& [arrived_ts, source_ts] : std::vector<std::pair<uint64_t, uint64_t>>{{1000, 0}, {2000, 1600}, {3000, 2500}}) {
+    CompactEvent& event = batch->AddEvent(EventType::BOOK_TICKER, arrived_ts, "kraken", SymbolPairId::ADA_USDT);
+    event.ticker = CompactEvent::TickerData{1.0, 10.0, 1.1, 10.0, 0};
+    event.flags = CompactEvent::HAS_BID_VOL | CompactEvent::HAS_ASK_VOL;
+    event.SetSourceTs(source_ts);
+  }
+  batch->EndRun();
+
+  RecordedLatencyModel model("kraken", 777);
+  EventRunMerger merger;
+  EventMaterializer materializer;
+  merger.AddBatch(std::move(batch));
+  merger.PopAll([&](const EventBatch& batch, const CompactEvent& event) {
+    materializer.Visit(batch, event, [&](const auto& e) {
+      if constexpr (std::is_same_v<std::decay_t<decltype(e)>, Ticker>) {
+        model.OnBookTicker(e);
+      }
+    });
+  });
+  EXPECT_EQ(model.GetSampleCount(), 2);
+  EXPECT_THAT(SampleMany(model, 100), Each(AnyOf(400, 500)));
+}
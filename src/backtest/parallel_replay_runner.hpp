@@ -0,0 +1,350 @@
+#pragma once
+
+#include "exchange/exchange_listener.h"
+#include "model/compact_event.h"
+#include "model/order_book.h"
+#include "model/symbol.h"
+
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct ParallelReplayOptions {
+  // Worker threads, each replays the events into its share of instances
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  // Events per block handed over to the workers
+  size_t block_size = 4096;
+  // Blocks published but not yet processed by all workers, bounds memory when workers fall behind
+  size_t max_blocks_in_flight = 4;
+};
+
+/**
+ * Replays one pass of market data into many independent strategy instances, eg. one per
+ * parameter set of a sweep or one per shard of symbols.
+ *
+ * Registered with a producer like any other listener. Events are copied into compact blocks
+ * once and every block is processed by all worker threads, each worker dispatching it to the
+ * instances assigned to it (instance i runs on worker i % threads). Workers keep their own
+ * order books, so an instance sees the same sequence of callbacks as when registered with the
+ * producer directly, limited to its symbols. Instances must not share mutable state with
+ * instances on other workers.
+ */
+class ParallelReplayRunner : public ExchangeListener {
+public:
+  explicit ParallelReplayRunner(const ParallelReplayOptions& options = ParallelReplayOptions())
+      : m_options(options), m_current(std::make_unique<Block>()) {
+    if (m_options.threads == 0 || m_options.block_size == 0 || m_options.max_blocks_in_flight == 0) {
+      throw std::invalid_argument("ParallelReplayRunner: threads, block size and blocks in flight must be positive");
+    }
+  }
+
+  ParallelReplayRunner(const ParallelReplayRunner&) = delete;
+  ParallelReplayRunner& operator=(const ParallelReplayRunner&) = delete;
+
+  virtual ~ParallelReplayRunner() {
+    StopWorkers();
+  }
+
+  /**
+   * Add an instance, ie. listeners called in the given order for every event of the given symbols.
+   *
+   * @param symbols symbols of the events the instance receives, all symbols if empty
+   * @return index of the instance
+   * @throws std::runtime_error if replay already started
+   */
+  size_t AddInstance(std::vector<ExchangeListener*> listeners, const std::vector<SymbolPairId>& symbols = {}) {
+    if (!m_workers.empty()) {
+      throw std::runtime_error("ParallelReplayRunner: instances must be added before replay starts");
+    }
+    Instance instance;
+    instance.listeners = std::move(listeners);
+    if (symbols.empty()) {
+      instance.symbols.set();
+    }
+    for (SymbolPairId symbol : symbols) {
+      instance.symbols.set(SymbolIndex(symbol));
+    }
+    m_instances.push_back(std::move(instance));
+    return m_instances.size() - 1;
+  }
+
+  /**
+   * Hands over the remaining events and waits until all workers processed them, ends the replay.
+   *
+   * @throws the first exception thrown by an instance
+   */
+  void Finish() {
+    Publish();
+    StopWorkers();
+    if (m_error) {
+      std::rethrow_exception(std::exchange(m_error, nullptr));
+    }
+    BOOST_LOG_TRIVIAL(info) << "ParallelReplayRunner: replayed " << m_event_count << " events into "
+        << m_instances.size() << " instances";
+  }
+
+  uint64_t GetEventCount() const {
+    return m_event_count;
+  }
+
+  virtual void OnConnectionOpen(const std::string& name) override {
+    BOOST_LOG_TRIVIAL(debug) << "ParallelReplayRunner::OnConnectionOpen " << name;
+  }
+
+  virtual void OnConnectionClose(const std::string& name) override {
+    BOOST_LOG_TRIVIAL(debug) << "ParallelReplayRunner::OnConnectionClose " << name;
+  }
+
+  virtual void OnBookTicker(const Ticker& ticker) override {
+    m_current->events.Add(ticker);
+    OnEventAdded();
+  }
+
+  virtual void OnTradeTicker(const TradeTicker& ticker) override {
+    m_current->events.Add(ticker);
+    OnEventAdded();
+  }
+
+  virtual void OnOrderBookUpdate(const OrderBook& order_book) override {
+    const OrderBookUpdate& update = order_book.GetLastUpdate();
+    auto known = std::find(m_known_books.begin(), m_known_books.end(), std::make_pair(order_book.GetExchangeName(), order_book.GetSymbolPairId()));
+    if (known == m_known_books.end()) {
+      // Workers build their books with the same settings as the producer
+      m_known_books.emplace_back(order_book.GetExchangeName(), order_book.GetSymbolPairId());
+      m_current->new_books.push_back(BookSpec{order_book.GetExchangeName(), order_book.GetSymbolPairId(),
+          order_book.GetDepth(), order_book.GetPrecisionSettings()});
+    }
+    m_current->events.Add(update);
+    OnEventAdded();
+  }
+
+private:
+  struct BookSpec {
+    std::string exchange;
+    SymbolPairId symbol;
+    size_t depth;
+    PrecisionSettings precision;
+  };
+
+  struct Block {
+    EventBatch events;
+    // Books first updated in this block
+    std::vector<BookSpec> new_books;
+    size_t pending_workers = 0;
+  };
+
+  // Bit per SymbolPairId, the last one for UNKNOWN and symbols out of range
+  typedef std::bitset<SymbolPairId::UNKNOWN + 1> SymbolSet;
+
+  struct Instance {
+    std::vector<ExchangeListener*> listeners;
+    SymbolSet symbols;
+  };
+
+  struct Worker {
+    std::vector<const Instance*> instances;
+    // Union of the instances' symbols, other events are skipped
+    SymbolSet symbols;
+    EventMaterializer materializer;
+    std::vector<OrderBook> order_books;
+    std::thread thread;
+  };
+
+  void OnEventAdded() {
+    ++m_event_count;
+    if (m_current->events.size() >= m_options.block_size) {
+      Publish();
+    }
+  }
+
+  void Publish() {
+    if (m_current->events.empty()) {
+      return;
+    }
+    StartWorkers();
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_producer_cv.wait(lock, [this]() { return m_published.size() < m_options.max_blocks_in_flight; });
+      if (m_error) {
+        // Stop the replay early, Finish() or the destructor joins the workers
+        std::rethrow_exception(m_error);
+      }
+      m_current->pending_workers = m_workers.size();
+      m_published.push_back(std::move(m_current));
+      if (!m_free.empty()) {
+        m_current = std::move(m_free.back());
+        m_free.pop_back();
+      } else {
+        m_current = std::make_unique<Block>();
+      }
+    }
+    m_worker_cv.notify_all();
+  }
+
+  void StartWorkers() {
+    if (!m_workers.empty()) {
+      return;
+    }
+    if (m_instances.empty()) {
+      throw std::runtime_error("ParallelReplayRunner: no instances");
+    }
+    const size_t threads = std::min(m_options.threads, m_instances.size());
+    for (size_t i = 0; i < threads; ++i) {
+      m_workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < m_instances.size(); ++i) {
+      Worker& worker = *m_workers[i % threads];
+      worker.instances.push_back(&m_instances[i]);
+      worker.symbols |= m_instances[i].symbols;
+    }
+    for (auto& worker : m_workers) {
+      worker->thread = std::thread([this, w = worker.get()]() { RunWorker(*w); });
+    }
+  }
+
+  void StopWorkers() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_finished = true;
+    }
+    m_worker_cv.notify_all();
+    for (auto& worker : m_workers) {
+      if (worker->thread.joinable()) {
+        worker->thread.join();
+      }
+    }
+  }
+
+  void RunWorker(Worker& worker) {
+    uint64_t seq = 0;
+    for (;;) {
+      Block* block;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_worker_cv.wait(lock, [&]() { return seq < m_front_seq + m_published.size() || m_finished; });
+        if (seq >= m_front_seq + m_published.size()) {
+          return;
+        }
+        block = m_published[seq - m_front_seq].get();
+      }
+      try {
+        if (!m_failed.load(std::memory_order_relaxed)) {
+          Process(worker, *block);
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_error) {
+          m_error = std::current_exception();
+        }
+        m_failed = true;
+      }
+      ++seq;
+      bool released = false;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --block->pending_workers;
+        // Workers process blocks in order, so blocks complete in order
+        while (!m_published.empty() && m_published.front()->pending_workers == 0) {
+          m_published.front()->events.Clear();
+          m_published.front()->new_books.clear();
+          m_free.push_back(std::move(m_published.front()));
+          m_published.pop_front();
+          ++m_front_seq;
+          released = true;
+        }
+      }
+      if (released) {
+        m_producer_cv.notify_one();
+      }
+    }
+  }
+
+  static void Process(Worker& worker, const Block& block) {
+    for (const BookSpec& spec : block.new_books) {
+      worker.order_books.emplace_back(spec.exchange, spec.symbol, spec.depth, spec.precision);
+    }
+    const EventBatch& batch = block.events;
+    for (const CompactEvent& event : batch.GetEvents()) {
+      const size_t symbol = SymbolIndex(event.symbol);
+      if (!worker.symbols.test(symbol)) {
+        continue;
+      }
+      switch (event.type) {
+        case EventType::BOOK_TICKER: {
+          const Ticker& ticker = worker.materializer.GetTicker(batch, event);
+          ForEachListener(worker, symbol, [&](ExchangeListener* listener) { listener->OnBookTicker(ticker); });
+          break;
+        }
+        case EventType::TRADE_TICKER: {
+          const TradeTicker& trade_ticker = worker.materializer.GetTradeTicker(batch, event);
+          ForEachListener(worker, symbol, [&](ExchangeListener* listener) { listener->OnTradeTicker(trade_ticker); });
+          break;
+        }
+        case EventType::BOOK_DIFF: {
+          OrderBook& ob = FindOrderBook(worker, batch.GetExchangeName(event.exchange), event.symbol);
+          ob.Update(worker.materializer.GetOrderBookUpdate(batch, event));
+          ForEachListener(worker, symbol, [&](ExchangeListener* listener) { listener->OnOrderBookUpdate(ob); });
+          break;
+        }
+      }
+    }
+  }
+
+  template <typename F>
+  static void ForEachListener(const Worker& worker, size_t symbol, F&& f) {
+    for (const Instance* instance : worker.instances) {
+      if (!instance->symbols.test(symbol)) {
+        continue;
+      }
+      for (auto* listener : instance->listeners) {
+        f(listener);
+      }
+    }
+  }
+
+  static size_t SymbolIndex(SymbolPairId symbol) {
+    return symbol >= 0 && symbol < SymbolPairId::UNKNOWN ? static_cast<size_t>(symbol) : static_cast<size_t>(SymbolPairId::UNKNOWN);
+  }
+
+  static OrderBook& FindOrderBook(Worker& worker, const std::string& exchange, SymbolPairId symbol) {
+    for (auto& ob : worker.order_books) {
+      if (ob.GetSymbolPairId() == symbol && ob.GetExchangeName() == exchange) {
+        return ob;
+      }
+    }
+    // Specs are published no later than the first update of a book
+    throw std::runtime_error("ParallelReplayRunner: unknown order book " + exchange);
+  }
+
+  ParallelReplayOptions m_options;
+  std::vector<Instance> m_instances;
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  // Producer side
+  std::unique_ptr<Block> m_current;
+  std::vector<std::pair<std::string, SymbolPairId>> m_known_books;
+  uint64_t m_event_count = 0;
+  // Shared with workers, guarded by m_mutex
+  std::mutex m_mutex;
+  std::condition_variable m_worker_cv;
+  std::condition_variable m_producer_cv;
+  std::deque<std::unique_ptr<Block>> m_published;
+  // Sequence number of m_published.front()
+  uint64_t m_front_seq = 0;
+  std::vector<std::unique_ptr<Block>> m_free;
+  bool m_finished = false;
+  std::exception_ptr m_error;
+  std::atomic<bool> m_failed{false};
+};
@@ -0,0 +1,159 @@
+#include "parallel_replay_runner.hpp"
+
+#include "model/ticker_test_utils.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+
+namespace {
+
+class RecordingListener : public ExchangeListener {
+public:
+  virtual void OnConnectionOpen(const std::string&) override {}
+  virtual void OnConnectionClose(const std::string&) override {}
+
+  virtual void OnBookTicker(const Ticker& ticker) override {
+    events.push_back("ticker " + ticker.exchange + " " + std::to_string(ticker.arrived_ts) + " " + std::to_string(ticker.bid));
+    thread_ids.push_back(std::this_thread::get_id());
+  }
+
+  virtual void OnTradeTicker(const TradeTicker& ticker) override {
+    events.push_back("trade " + ticker.exchange + " " + ticker.trade_id);
+    thread_ids.push_back(std::this_thread::get_id());
+  }
+
+  virtual void OnOrderBookUpdate(const OrderBook& order_book) override {
+    events.push_back("book " + order_book.GetExchangeName() + " " + std::to_string(order_book.GetBids().size())
+        + " " + std::to_string(order_book.ToDouble(order_book.GetBestBid().GetPrice())));
+    thread_ids.push_back(std::this_thread::get_id());
+  }
+
+  std::vector<std::string> events;
+  std::vector<std::thread::id> thread_ids;
+};
+
+class ThrowingListener : public RecordingListener {
+public:
+  virtual void OnBookTicker(const Ticker&) override {
+    throw std::runtime_error("strategy failed");
+  }
+};
+
+TradeTicker CreateTradeTicker(uint64_t arrived_ts) {
+  TradeTicker trade;
+  trade.exchange = "kraken";
+  trade.symbol = SymbolPairId::ADA_USDT;
+  trade.arrived_ts = arrived_ts;
+  trade.event_time = arrived_ts;
+  trade.trade_time = arrived_ts;
+  trade.trade_id = std::to_string(arrived_ts * 10);
+  trade.price = 1.2;
+  trade.qty = 5;
+  trade.is_market_maker = false;
+  return trade;
+}
+
+OrderBookUpdate CreateUpdate(uint64_t arrived_ts, const std::string& bid) {
+  OrderBookUpdate update;
+  update.exchange = "binance";
+  update.symbol = SymbolPairId::ADA_USDT;
+  update.arrived_ts = arrived_ts;
+  update.last_update_id = arrived_ts;
+  update.is_snapshot = false;
+  update.bids.push_back(OrderBookUpdate::Level{Decimal::Parse(bid), Decimal::Parse("10.5"), std::nullopt});
+  return update;
+}
+
+// Feeds the same events to the given listener the way a producer does
+void Produce(ExchangeListener& listener) {
+  OrderBook ob("binance", SymbolPairId::ADA_USDT, 100, PrecisionSettings(2, 1, 3));
+  for (uint64_t i = 1; i <= 20; ++i) {
+    if (i % 3 == 0) {
+      listener.OnTradeTicker(CreateTradeTicker(i));
+    } else if (i % 3 == 1) {
+      ob.Update(CreateUpdate(i, "1.0" + std::to_string(i % 10)));
+      listener.OnOrderBookUpdate(ob);
+    } else {
+      listener.OnBookTicker(CreateTicker("binance", SymbolPairId::ADA_USDT, 1.0 + i / 100.0, 1.0 + i / 100.0 + 0.01, i));
+    }
+  }
+}
+
+}
+
+TEST(ParallelReplayRunnerTest, TestSameEventsAsDirectReplay) {
+  RecordingListener direct;
+  Produce(direct);
+
+  ParallelReplayOptions options;
+  options.threads = 2;
+  options.block_size = 3;
+  options.max_blocks_in_flight = 2;
+  ParallelReplayRunner runner(options);
+  std::vector<RecordingListener> listeners(6);
+  for (size_t i = 0; i < listeners.size(); i += 2) {
+    runner.AddInstance({&listeners[i], &listeners[i + 1]});
+  }
+  Produce(runner);
+  runner.Finish();
+
+  EXPECT_EQ(runner.GetEventCount(), 20);
+  for (const auto& listener : listeners) {
+    EXPECT_EQ(listener.events, direct.events);
+  }
+  // Instances 0 and 2 run on the first worker, instance 1 on the second
+  EXPECT_EQ(listeners[0].thread_ids.front(), listeners[4].thread_ids.front());
+  EXPECT_EQ(listeners[0].thread_ids.front(), listeners[1].thread_ids.front());
+  EXPECT_NE(listeners[0].thread_ids.front(), listeners[2].thread_ids.front());
+  EXPECT_NE(listeners[0].thread_ids.front(), std::this_thread::get_id());
+}
+
+TEST(ParallelReplayRunnerTest, TestInstanceErrorIsRethrown) {
+  ParallelReplayOptions options;
+  options.threads = 2;
+  options.block_size = 100;
+  ParallelReplayRunner runner(options);
+  RecordingListener ok;
+  ThrowingListener failing;
+  runner.AddInstance({&ok});
+  runner.AddInstance({&failing});
+  Produce(runner);
+  EXPECT_THROW(runner.Finish(), std::runtime_error);
+  EXPECT_THROW(runner.AddInstance({&ok}), std::runtime_error);
+}
+
+TEST(ParallelReplayRunnerTest, TestNoInstances) {
+  ParallelReplayRunner runner;
+  Produce(runner);
+  EXPECT_THROW(runner.Finish(), std::runtime_error);
+}
+
+TEST(ParallelReplayRunnerTest, TestInstancesSeeOnlyTheirSymbols) {
+  ParallelReplayOptions options;
+  options.threads = 2;
+  options.block_size = 4;
+  ParallelReplayRunner runner(options);
+  RecordingListener ada, btc, all;
+  runner.AddInstance({&ada}, {SymbolPairId::ADA_USDT});
+  runner.AddInstance({&btc}, {SymbolPairId::BTC_USDT, SymbolPairId::ETH_BTC});
+  runner.AddInstance({&all});
+
+  RecordingListener ada_direct, btc_direct;
+  for (uint64_t i = 1; i <= 10; ++i) {
+    Ticker ticker = CreateTicker("binance", SymbolPairId::ADA_USDT, 1.0 + i / 100.0, 1.0 + i / 100.0 + 0.01, i);
+    ticker.symbol = i % 2 ? SymbolPairId::ADA_USDT : SymbolPairId::BTC_USDT;
+    runner.OnBookTicker(ticker);
+    (i % 2 ? ada_direct : btc_direct).OnBookTicker(ticker);
+  }
+  runner.Finish();
+
+  EXPECT_EQ(ada.events, ada_direct.events);
+  EXPECT_EQ(btc.events, btc_direct.events);
+  EXPECT_EQ(all.events.size(), 10u);
+}
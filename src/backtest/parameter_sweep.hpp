@@ -0,0 +1,127 @@
+#pragma once
+
+#include "json/json.hpp"
+
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Cartesian product of named parameter values, eg. {"fee": [0.001, 0.002], "margin": [0, 0.0005]}
+ * expands to 4 parameter sets. The last added parameter varies fastest.
+ */
+class ParameterGrid {
+public:
+  typedef std::map<std::string, double> ParameterSet;
+
+  /**
+   * @throws std::invalid_argument if values are empty or the parameter was already added
+   */
+  void Add(const std::string& name, std::vector<double> values) {
+    if (values.empty()) {
+      throw std::invalid_argument("ParameterGrid: no values for " + name);
+    }
+    for (const auto& p : m_parameters) {
+      if (p.first == name) {
+        throw std::invalid_argument("ParameterGrid: duplicate parameter " + name);
+      }
+    }
+    m_parameters.emplace_back(name, std::move(values));
+  }
+
+  /**
+   * Parses an object of parameter names to arrays of values, a single number is a one value array.
+   *
+   * @throws std::invalid_argument if the json is not an object of numbers or arrays of numbers
+   */
+  static ParameterGrid FromJson(const nlohmann::json& json) {
+    if (!json.is_object()) {
+      throw std::invalid_argument("ParameterGrid: expected an object of parameter values");
+    }
+    ParameterGrid grid;
+    for (auto it = json.begin(); it != json.end(); ++it) {
+      std::vector<double> values;
+      if (it.value().is_number()) {
+        values.push_back(it.value().get<double>());
+      } else if (it.value().is_array()) {
+        for (const auto& value : it.value()) {
+          if (!value.is_number()) {
+            throw std::invalid_argument("ParameterGrid: non numeric value for " + it.key());
+          }
+          values.push_back(value.get<double>());
+        }
+      } else {
+        throw std::invalid_argument("ParameterGrid: expected number or array for " + it.key());
+      }
+      grid.Add(it.key(), std::move(values));
+    }
+    return grid;
+  }
+
+  std::vector<ParameterSet> Expand() const {
+    std::vector<ParameterSet> sets;
+    if (m_parameters.empty()) {
+      return sets;
+    }
+    sets.reserve(size());
+    std::vector<size_t> indices(m_parameters.size(), 0);
+    for (;;) {
+      ParameterSet& set = sets.emplace_back();
+      for (size_t i = 0; i < m_parameters.size(); ++i) {
+        set.emplace(m_parameters[i].first, m_parameters[i].second[indices[i]]);
+      }
+      size_t i = m_parameters.size();
+      while (i > 0 && ++indices[i - 1] == m_parameters[i - 1].second.size()) {
+        indices[i - 1] = 0;
+        --i;
+      }
+      if (i == 0) {
+        return sets;
+      }
+    }
+  }
+
+  std::vector<std::string> GetNames() const {
+    std::vector<std::string> names;
+    for (const auto& p : m_parameters) {
+      names.push_back(p.first);
+    }
+    return names;
+  }
+
+  /**
+   * @return number of parameter sets, 0 for an empty grid
+   */
+  size_t size() const {
+    if (m_parameters.empty()) {
+      return 0;
+    }
+    size_t count = 1;
+    for (const auto& p : m_parameters) {
+      count *= p.second.size();
+    }
+    return count;
+  }
+
+  static double GetValue(const ParameterSet& set, const std::string& name, double default_value) {
+    auto it = set.find(name);
+    return it != set.end() ? it->second : default_value;
+  }
+
+  static std::string ToString(const ParameterSet& set) {
+    std::ostringstream oss;
+    for (auto it = set.begin(); it != set.end(); ++it) {
+      if (it != set.begin()) {
+        oss << ",";
+      }
+      oss << it->first << "=" << it->second;
+    }
+    return oss.str();
+  }
+
+private:
+  std::vector<std::pair<std::string, std::vector<double>>> m_parameters;
+};
@@ -0,0 +1,33 @@
+#include "parameter_sweep.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using namespace testing;
+
+TEST(ParameterGridTest, TestExpand) {
+  ParameterGrid grid;
+  grid.Add("fee", {0.001, 0.002});
+  grid.Add("margin", {0, 0.5, 1});
+  EXPECT_EQ(grid.size(), 6);
+  const auto sets = grid.Expand();
+  ASSERT_EQ(sets.size(), 6);
+  EXPECT_EQ(sets[0], (ParameterGrid::ParameterSet{{"fee", 0.001}, {"margin", 0}}));
+  EXPECT_EQ(sets[1], (ParameterGrid::ParameterSet{{"fee", 0.001}, {"margin", 0.5}}));
+  EXPECT_EQ(sets[3], (ParameterGrid::ParameterSet{{"fee", 0.002}, {"margin", 0}}));
+  EXPECT_EQ(sets[5], (ParameterGrid::ParameterSet{{"fee", 0.002}, {"margin", 1}}));
+  EXPECT_EQ(ParameterGrid::ToString(sets[1]), "fee=0.001,margin=0.5");
+  EXPECT_EQ(ParameterGrid::GetValue(sets[1], "margin", 7), 0.5);
+  EXPECT_EQ(ParameterGrid::GetValue(sets[1], "latency", 7), 7);
+  EXPECT_TRUE(ParameterGrid().Expand().empty());
+}
+
+TEST(ParameterGridTest, TestFromJson) {
+  auto grid = ParameterGrid::FromJson(nlohmann::json::parse(R"({"latency": [100, 200, 300], "fee": 0.001})"));
+  EXPECT_EQ(grid.size(), 3);
+  EXPECT_THAT(grid.GetNames(), UnorderedElementsAre("fee", "latency"));
+
+  EXPECT_THROW(ParameterGrid::FromJson(nlohmann::json::parse(R"({"fee": []})")), std::invalid_argument);
+  EXPECT_THROW(ParameterGrid::FromJson(nlohmann::json::parse(R"({"fee": ["a"]})")), std::invalid_argument);
+  EXPECT_THROW(ParameterGrid::FromJson(nlohmann::json::parse(R"([1, 2])")), std::invalid_argument);
+}
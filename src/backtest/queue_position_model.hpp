@@ -0,0 +1,221 @@
+#pragma once
+
+#include "model/order.h"
+#include "model/order_book.h"
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Fill model for resting limit orders of a single symbol, which takes into account
+ * volume queued ahead of our order at its price level (price-time priority).
+ *
+ * Queue ahead starts at the book volume of the order's price level when the order reaches
+ * the exchange. It shrinks with trades at that price and with volume removed from the level
+ * by cancels, which are assumed to be spread evenly over the queue. Once the queue ahead
+ * is consumed, further trades at the price fill the order, possibly partially.
+ * Trades through the price, or the opposite side of the book reaching it, fill the order completely.
+ *
+ * Orders are bucketed by price level, so an event only touches orders at the affected levels,
+ * and indexed by id, so removing an order does not involve any search.
+ */
+class QueuePositionModel {
+public:
+  struct QueuedOrder {
+    Order order;
+    price_t price;
+    quantity_t left_qty;
+    // Estimated market volume in front of our order
+    quantity_t queue_ahead;
+    // Last known total volume of the level
+    quantity_t level_volume;
+  };
+
+  /**
+   * @param queue_ahead current volume of the order's price level on its side of the book
+   */
+  void Add(const Order& order, price_t price, quantity_t queue_ahead) {
+    Levels& levels = GetLevels(order.GetSide());
+    quantity_t left_qty = order.GetQuantity() - order.GetExecutedQuantity();
+    auto level_it = levels.try_emplace(price).first;
+    Queue& queue = level_it->second;
+    queue.push_back(QueuedOrder{order, price, left_qty, queue_ahead, queue_ahead});
+    m_index.insert_or_assign(order.GetId(), Location{&levels, level_it, std::prev(queue.end())});
+  }
+
+  /**
+   * Queues an order with its saved queue position, behind orders already at its price, eg. from a checkpoint.
+   */
+  void Restore(const QueuedOrder& queued) {
+    Levels& levels = GetLevels(queued.order.GetSide());
+    auto level_it = levels.try_emplace(queued.price).first;
+    Queue& queue = level_it->second;
+    queue.push_back(queued);
+    m_index.insert_or_assign(queued.order.GetId(), Location{&levels, level_it, std::prev(queue.end())});
+  }
+
+  /**
+   * @return false if order is not queued
+   */
+  bool Remove(const Order& order) {
+    auto index_it = m_index.find(order.GetId());
+    if (index_it == m_index.end()) {
+      return false;
+    }
+    const Location& location = index_it->second;
+    location.level_it->second.erase(location.order_it);
+    if (location.level_it->second.empty()) {
+      location.levels->erase(location.level_it);
+    }
+    m_index.erase(index_it);
+    return true;
+  }
+
+  const QueuedOrder* Find(const std::string& order_id) const {
+    auto index_it = m_index.find(order_id);
+    if (index_it == m_index.end()) {
+      return nullptr;
+    }
+    return &*index_it->second.order_it;
+  }
+
+  /**
+   * Trade printed at `price`.
+   *
+   * @param resting_side side of the book the trade executed against (BUY when the seller was the aggressor)
+   * @param on_fill called as on_fill(Order&, quantity_t fill_qty, bool completed) for every fill
+   *     at the order's limit price, completed orders are removed afterwards
+   */
+  template <typename F>
+  void OnTrade(price_t price, quantity_t qty, Side resting_side, F&& on_fill) {
+    Levels& levels = GetLevels(resting_side);
+    // Aggressor swept through our price first
+    if (resting_side == Side::BUY) {
+      FillAll(levels, levels.upper_bound(price), levels.end(), on_fill);
+    } else {
+      FillAll(levels, levels.begin(), levels.lower_bound(price), on_fill);
+    }
+
+    auto level_it = levels.find(price);
+    if (level_it == levels.end()) {
+      return;
+    }
+    Queue& queue = level_it->second;
+    // Our earlier orders at the level take their share of the trade first
+    quantity_t filled_ahead = 0;
+    for (auto it = queue.begin(); it != queue.end();) {
+      QueuedOrder& queued = *it;
+      quantity_t available = qty - queued.queue_ahead - filled_ahead;
+      queued.queue_ahead = std::max(queued.queue_ahead - qty, 0.0);
+      queued.level_volume = std::max(queued.level_volume - qty, 0.0);
+      if (available <= 0) {
+        ++it;
+        continue;
+      }
+      quantity_t fill_qty = std::min(available, queued.left_qty);
+      filled_ahead += fill_qty;
+      queued.left_qty -= fill_qty;
+      const bool completed = queued.left_qty <= 0;
+      on_fill(queued.order, fill_qty, completed);
+      if (completed) {
+        m_index.erase(queued.order.GetId());
+        it = queue.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    if (queue.empty()) {
+      levels.erase(level_it);
+    }
+  }
+
+  /**
+   * Volume of a price level changed to `volume` (0 when the level was removed).
+   * A decrease not explained by trades is treated as cancels.
+   */
+  void OnLevelVolume(Side side, price_t price, quantity_t volume) {
+    Levels& levels = GetLevels(side);
+    auto level_it = levels.find(price);
+    if (level_it == levels.end()) {
+      return;
+    }
+    for (QueuedOrder& queued : level_it->second) {
+      if (volume < queued.level_volume && queued.level_volume > 0) {
+        quantity_t cancelled = queued.level_volume - volume;
+        queued.queue_ahead -= cancelled * queued.queue_ahead / queued.level_volume;
+      }
+      // Volume added to the level queues behind us
+      queued.queue_ahead = std::min(queued.queue_ahead, volume);
+      queued.level_volume = volume;
+    }
+  }
+
+  /**
+   * Opposite side of the book reached our price, ie. it would have traded with our orders.
+   * Prices of an empty book side are ignored.
+   */
+  template <typename F>
+  void OnBestPrices(const OrderBook& ob, F&& on_fill) {
+    if (!ob.GetAsks().empty()) {
+      price_t best_ask = ob.GetBestAsk().GetPrice();
+      FillAll(m_bids, m_bids.lower_bound(best_ask), m_bids.end(), on_fill);
+    }
+    if (!ob.GetBids().empty()) {
+      price_t best_bid = ob.GetBestBid().GetPrice();
+      FillAll(m_asks, m_asks.begin(), m_asks.upper_bound(best_bid), on_fill);
+    }
+  }
+
+  template <typename F>
+  void ForEach(F&& f) const {
+    for (const Levels* levels : {&m_bids, &m_asks}) {
+      for (const auto& level : *levels) {
+        for (const QueuedOrder& queued : level.second) {
+          f(queued);
+        }
+      }
+    }
+  }
+
+  bool empty() const {
+    return m_index.empty();
+  }
+
+  size_t size() const {
+    return m_index.size();
+  }
+
+private:
+  // Orders in arrival order per price level
+  using Queue = std::list<QueuedOrder>;
+  using Levels = std::map<price_t, Queue>;
+
+  struct Location {
+    Levels* levels;
+    Levels::iterator level_it;
+    Queue::iterator order_it;
+  };
+
+  Levels& GetLevels(Side side) {
+    return side == Side::BUY ? m_bids : m_asks;
+  }
+
+  template <typename F>
+  void FillAll(Levels& levels, Levels::iterator first, Levels::iterator last, F&& on_fill) {
+    for (auto it = first; it != last; ++it) {
+      for (QueuedOrder& queued : it->second) {
+        on_fill(queued.order, queued.left_qty, true);
+        m_index.erase(queued.order.GetId());
+      }
+    }
+    levels.erase(first, last);
+  }
+
+private:
+  Levels m_bids;
+  Levels m_asks;
+  std::unordered_map<std::string, Location> m_index;
+};
@@ -0,0 +1,135 @@
+#include "queue_position_model.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <vector>
+
+using namespace testing;
+
+namespace {
+
+Order CreateOrder(const std::string& id, Side side, double qty, double price) {
+  return Order::CreateBuilder()
+      .Id(id)
+      .ClientId(id)
+      .Symbol(SymbolPairId::ADA_USDT)
+      .Side_(side)
+      .OrderType_(OrderType::LIMIT)
+      .Quantity(qty)
+      .Price(price)
+      .Build();
+}
+
+struct FillRecord {
+  std::string id;
+  quantity_t qty;
+  bool completed;
+};
+
+class FillRecorder {
+public:
+  void operator()(Order& order, quantity_t qty, bool completed) {
+    fills.push_back({order.GetId(), qty, completed});
+  }
+
+  std::vector<FillRecord> fills;
+};
+
+}
+
+TEST(QueuePositionModelTest, QueueAheadTest) {
+  QueuePositionModel model;
+  model.Add(CreateOrder("1", Side::SELL, 10, 1.01), price_t(101), 50);
+  FillRecorder recorder;
+
+  model.OnTrade(price_t(101), 30, Side::SELL, std::ref(recorder));
+  EXPECT_TRUE(recorder.fills.empty());
+
+  model.OnTrade(price_t(101), 25, Side::SELL, std::ref(recorder));
+  ASSERT_EQ(1u, recorder.fills.size());
+  EXPECT_DOUBLE_EQ(5, recorder.fills[0].qty);
+  EXPECT_FALSE(recorder.fills[0].completed);
+
+  // Trade on the other side of the book
+  model.OnTrade(price_t(101), 100, Side::BUY, std::ref(recorder));
+  EXPECT_EQ(1u, recorder.fills.size());
+
+  model.OnTrade(price_t(101), 100, Side::SELL, std::ref(recorder));
+  ASSERT_EQ(2u, recorder.fills.size());
+  EXPECT_DOUBLE_EQ(5, recorder.fills[1].qty);
+  EXPECT_TRUE(recorder.fills[1].completed);
+  EXPECT_TRUE(model.empty());
+}
+
+TEST(QueuePositionModelTest, SameLevelOrdersTest) {
+  QueuePositionModel model;
+  model.Add(CreateOrder("1", Side::BUY, 10, 1.00), price_t(100), 20);
+  model.Add(CreateOrder("2", Side::BUY, 10, 1.00), price_t(100), 20);
+  FillRecorder recorder;
+
+  // 20 ahead of both, then first order takes 10 and the second one the rest
+  model.OnTrade(price_t(100), 35, Side::BUY, std::ref(recorder));
+  ASSERT_EQ(2u, recorder.fills.size());
+  EXPECT_EQ("1", recorder.fills[0].id);
+  EXPECT_DOUBLE_EQ(10, recorder.fills[0].qty);
+  EXPECT_TRUE(recorder.fills[0].completed);
+  EXPECT_EQ("2", recorder.fills[1].id);
+  EXPECT_DOUBLE_EQ(5, recorder.fills[1].qty);
+  EXPECT_FALSE(recorder.fills[1].completed);
+}
+
+TEST(QueuePositionModelTest, CancelsTest) {
+  QueuePositionModel model;
+  model.Add(CreateOrder("1", Side::BUY, 10, 1.00), price_t(100), 40);
+  FillRecorder recorder;
+
+  // Half of the level cancelled, half of it was in front of us
+  model.OnLevelVolume(Side::BUY, price_t(100), 20);
+  // New volume joins behind us
+  model.OnLevelVolume(Side::BUY, price_t(100), 60);
+  model.OnTrade(price_t(100), 25, Side::BUY, std::ref(recorder));
+  ASSERT_EQ(1u, recorder.fills.size());
+  EXPECT_DOUBLE_EQ(5, recorder.fills[0].qty);
+
+  // Level removed, we are at the front
+  model.OnLevelVolume(Side::BUY, price_t(100), 0);
+  model.OnTrade(price_t(100), 1, Side::BUY, std::ref(recorder));
+  ASSERT_EQ(2u, recorder.fills.size());
+  EXPECT_DOUBLE_EQ(1, recorder.fills[1].qty);
+}
+
+TEST(QueuePositionModelTest, TradeThroughTest) {
+  QueuePositionModel model;
+  model.Add(CreateOrder("1", Side::BUY, 10, 1.00), price_t(100), 1000);
+  model.Add(CreateOrder("2", Side::BUY, 10, 0.98), price_t(98), 0);
+  FillRecorder recorder;
+
+  model.OnTrade(price_t(99), 1, Side::BUY, std::ref(recorder));
+  ASSERT_EQ(1u, recorder.fills.size());
+  EXPECT_EQ("1", recorder.fills[0].id);
+  EXPECT_DOUBLE_EQ(10, recorder.fills[0].qty);
+  EXPECT_TRUE(recorder.fills[0].completed);
+  EXPECT_FALSE(model.empty());
+}
+
+TEST(QueuePositionModelTest, BookCrossTest) {
+  QueuePositionModel model;
+  model.Add(CreateOrder("1", Side::SELL, 10, 1.05), price_t(105), 100);
+  model.Add(CreateOrder("2", Side::SELL, 10, 1.06), price_t(106), 100);
+  FillRecorder recorder;
+
+  OrderBook ob{"test", SymbolPairId::ADA_USDT, 10, PrecisionSettings{2, 0, 6}};
+  PriceLevel bid(price_t(105), 5, 1);
+  ob.UpsertBid(bid);
+  model.OnBestPrices(ob, std::ref(recorder));
+  ASSERT_EQ(1u, recorder.fills.size());
+  EXPECT_EQ("1", recorder.fills[0].id);
+
+  EXPECT_EQ(nullptr, model.Find("1"));
+  ASSERT_NE(nullptr, model.Find("2"));
+  EXPECT_EQ(price_t(106), model.Find("2")->price);
+  EXPECT_FALSE(model.Remove(CreateOrder("1", Side::SELL, 10, 1.05)));
+  EXPECT_TRUE(model.Remove(CreateOrder("2", Side::SELL, 10, 1.06)));
+  EXPECT_TRUE(model.empty());
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "event_scheduler.hpp"
+
+#include "exchange/account_balance_listener.h"
+#include "model/account_balance.h"
+#include "model/symbol.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Splits a backtest by symbol into shards replayed in parallel, see ParallelReplayRunner.
+ *
+ * Shards do not share account balances, each one trades with its own allocation of the initial
+ * balances. Every asset is split evenly between the shards trading it, so allocations add up
+ * to the initial balances and do not depend on thread scheduling.
+ */
+class SymbolSharding {
+public:
+  /**
+   * Round robin partition of symbols, keeps their order within a shard.
+   *
+   * @return at most `shards` non empty shards
+   * @throws std::invalid_argument if shards is 0
+   */
+  static std::vector<std::vector<SymbolPairId>> Partition(const std::vector<SymbolPairId>& symbols, size_t shards) {
+    if (shards == 0) {
+      throw std::invalid_argument("SymbolSharding: shards must be positive");
+    }
+    std::vector<std::vector<SymbolPairId>> partition(std::min(shards, symbols.size()));
+    for (size_t i = 0; i < symbols.size(); ++i) {
+      partition[i % partition.size()].push_back(symbols[i]);
+    }
+    return partition;
+  }
+
+  /**
+   * @return initial balances per shard, assets not traded by any shard go to the first one
+   */
+  static std::vector<std::unordered_map<SymbolId, double>> AllocateBalances(const std::unordered_map<SymbolId, double>& balances,
+      const std::vector<std::vector<SymbolPairId>>& shards) {
+    std::vector<std::unordered_map<SymbolId, double>> allocations(shards.size());
+    for (const auto& p : balances) {
+      std::vector<size_t> users;
+      for (size_t i = 0; i < shards.size(); ++i) {
+        if (std::any_of(shards[i].begin(), shards[i].end(), [&](SymbolPairId symbol) { return Trades(symbol, p.first); })) {
+          users.push_back(i);
+        }
+      }
+      if (users.empty() && !shards.empty()) {
+        users.push_back(0);
+      }
+      for (size_t i = 0; i < allocations.size(); ++i) {
+        // Every shard gets every asset, so balance maps have the same keys
+        allocations[i].emplace(p.first, 0.0);
+      }
+      for (size_t shard : users) {
+        allocations[shard][p.first] = p.second / users.size();
+      }
+    }
+    return allocations;
+  }
+
+private:
+  static bool Trades(SymbolPairId symbol, SymbolId asset) {
+    SymbolPair pair(symbol);
+    return pair.GetBaseAsset() == asset || pair.GetQuoteAsset() == asset;
+  }
+};
+
+/**
+ * Records balance updates of one shard with their simulated time, for the final merge.
+ */
+class ShardBalanceRecorder : public AccountBalanceListener {
+public:
+  struct Update {
+    uint64_t ts;
+    AccountBalance balance;
+  };
+
+  explicit ShardBalanceRecorder(size_t shard) : m_shard(shard), m_clock(nullptr) {}
+
+  /**
+   * @param clock simulated clock of the shard's backtest clients
+   */
+  void SetClock(const EventScheduler* clock) {
+    m_clock = clock;
+  }
+
+  virtual void OnAccountBalanceUpdate(const AccountBalance& balance) override {
+    m_updates.push_back(Update{m_clock ? m_clock->Now() : 0, balance});
+  }
+
+  size_t GetShard() const {
+    return m_shard;
+  }
+
+  const std::vector<Update>& GetUpdates() const {
+    return m_updates;
+  }
+
+  /**
+   * Feeds the balance updates of all shards to `listener` in simulated time order,
+   * ties broken by shard index. Exchange names get the shard index appended, so cumulative
+   * balances of the listener add up all shards.
+   */
+  static void Merge(const std::vector<const ShardBalanceRecorder*>& recorders, AccountBalanceListener& listener) {
+    // (ts, shard, position), updates of a shard are already in time order
+    std::vector<std::tuple<uint64_t, size_t, size_t>> order;
+    for (const ShardBalanceRecorder* recorder : recorders) {
+      for (size_t i = 0; i < recorder->m_updates.size(); ++i) {
+        order.emplace_back(recorder->m_updates[i].ts, recorder->m_shard, i);
+      }
+    }
+    std::sort(order.begin(), order.end());
+    std::unordered_map<size_t, const ShardBalanceRecorder*> by_shard;
+    for (const ShardBalanceRecorder* recorder : recorders) {
+      if (!by_shard.emplace(recorder->m_shard, recorder).second) {
+        throw std::invalid_argument("ShardBalanceRecorder: duplicate shard " + std::to_string(recorder->m_shard));
+      }
+    }
+    for (const auto& [ts, shard, i] : order) {
+      const AccountBalance& balance = by_shard.at(shard)->m_updates[i].balance;
+      listener.OnAccountBalanceUpdate(AccountBalance(balance.GetBalanceMap(), balance.m_locked_balance_map,
+          GetShardExchange(balance.GetExchange(), shard)));
+    }
+  }
+
+  static std::string GetShardExchange(const std::string& exchange, size_t shard) {
+    return exchange + "#" + std::to_string(shard);
+  }
+
+private:
+  size_t m_shard;
+  const EventScheduler* m_clock;
+  std::vector<Update> m_updates;
+};
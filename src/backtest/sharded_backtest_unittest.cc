@@ -0,0 +1,79 @@
+#include "sharded_backtest.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace {
+
+class RecordingBalanceListener : public AccountBalanceListener {
+public:
+  virtual void OnAccountBalanceUpdate(const AccountBalance& balance) override {
+    updates.push_back(balance.GetExchange() + " " + std::to_string(balance.GetTotalBalance(SymbolId::USDT)));
+  }
+
+  std::vector<std::string> updates;
+};
+
+}
+
+TEST(SymbolShardingTest, TestPartition) {
+  auto shards = SymbolSharding::Partition({SymbolPairId::ADA_USDT, SymbolPairId::BTC_USDT, SymbolPairId::ETH_USDT, SymbolPairId::ETH_BTC, SymbolPairId::ADA_BTC}, 2);
+  EXPECT_THAT(shards, ElementsAre(
+      ElementsAre(SymbolPairId::ADA_USDT, SymbolPairId::ETH_USDT, SymbolPairId::ADA_BTC),
+      ElementsAre(SymbolPairId::BTC_USDT, SymbolPairId::ETH_BTC)));
+  EXPECT_EQ(SymbolSharding::Partition({SymbolPairId::ADA_USDT}, 4).size(), 1u);
+  EXPECT_THROW(SymbolSharding::Partition({SymbolPairId::ADA_USDT}, 0), std::invalid_argument);
+}
+
+TEST(SymbolShardingTest, TestAllocateBalances) {
+  std::vector<std::vector<SymbolPairId>> shards = {
+    {SymbolPairId::ADA_USDT, SymbolPairId::ETH_BTC},
+    {SymbolPairId::BTC_USDT},
+    {SymbolPairId::ETH_USDT}
+  };
+  auto allocations = SymbolSharding::AllocateBalances({
+    {SymbolId::USDT, 3000},
+    {SymbolId::BTC, 1},
+    {SymbolId::ADA, 100},
+    {SymbolId::XLM, 50}
+  }, shards);
+  ASSERT_EQ(allocations.size(), 3u);
+  for (const auto& allocation : allocations) {
+    EXPECT_DOUBLE_EQ(allocation.at(SymbolId::USDT), 1000);
+  }
+  EXPECT_DOUBLE_EQ(allocations[0].at(SymbolId::BTC), 0.5);
+  EXPECT_DOUBLE_EQ(allocations[1].at(SymbolId::BTC), 0.5);
+  EXPECT_DOUBLE_EQ(allocations[2].at(SymbolId::BTC), 0);
+  EXPECT_DOUBLE_EQ(allocations[0].at(SymbolId::ADA), 100);
+  EXPECT_DOUBLE_EQ(allocations[1].at(SymbolId::ADA), 0);
+  // Not traded by any shard
+  EXPECT_DOUBLE_EQ(allocations[0].at(SymbolId::XLM), 50);
+}
+
+TEST(ShardBalanceRecorderTest, TestMergeInTimeOrder) {
+  EventScheduler clock0, clock1;
+  ShardBalanceRecorder recorder0(0), recorder1(1);
+  recorder0.SetClock(&clock0);
+  recorder1.SetClock(&clock1);
+
+  clock0.AdvanceTo(100);
+  recorder0.OnAccountBalanceUpdate(AccountBalance({{SymbolId::USDT, 1}}, "binance"));
+  clock0.AdvanceTo(300);
+  recorder0.OnAccountBalanceUpdate(AccountBalance({{SymbolId::USDT, 2}}, "kraken"));
+  clock1.AdvanceTo(100);
+  recorder1.OnAccountBalanceUpdate(AccountBalance({{SymbolId::USDT, 3}}, "binance"));
+  clock1.AdvanceTo(200);
+  recorder1.OnAccountBalanceUpdate(AccountBalance({{SymbolId::USDT, 4}}, "binance"));
+
+  RecordingBalanceListener listener;
+  ShardBalanceRecorder::Merge({&recorder1, &recorder0}, listener);
+  EXPECT_THAT(listener.updates, ElementsAre(
+      "binance#0 1.000000", "binance#1 3.000000", "binance#1 4.000000", "kraken#0 2.000000"));
+
+  EXPECT_THROW(ShardBalanceRecorder::Merge({&recorder0, &recorder0}, listener), std::invalid_argument);
+}
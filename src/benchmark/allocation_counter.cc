@@ -0,0 +1,70 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> g_allocations{0};
+
+// Counting replacements of all the non-aligned forms, so every allocation is counted and freed by its match
+
+void* CountedAlloc(size_t size) noexcept {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+// Not inlined, gcc would otherwise pair free() inlined into the caller with operator new and warn about the mismatch
+[[gnu::noinline]] void FreeAllocation(void* p) noexcept {
+  std::free(p);
+}
+
+}
+
+void* operator new(size_t size) {
+  if (void* p = CountedAlloc(size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return CountedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return CountedAlloc(size);
+}
+
+void operator delete(void* p) noexcept {
+  FreeAllocation(p);
+}
+
+void operator delete[](void* p) noexcept {
+  FreeAllocation(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  FreeAllocation(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  FreeAllocation(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  FreeAllocation(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  FreeAllocation(p);
+}
+
+uint64_t GetAllocationCount() {
+  return g_allocations.load();
+}
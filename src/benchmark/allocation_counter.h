@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Number of heap allocations made so far by the process.
+ *
+ * Counted by the global operator new replacements in allocation_counter.cc,
+ * which has to be linked into the benchmark binary.
+ */
+uint64_t GetAllocationCount();
@@ -0,0 +1,168 @@
+#include "allocation_counter.h"
+#include "db/capture_file_reader.hpp"
+#include "websocket/binance_message_decoders.hpp"
+#include "websocket/kraken_message_decoder.hpp"
+#include "websocket/replay_messages.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Binance diff depth event, with levels as recorded
+std::string BinanceDepth(const OrderBookUpdate& update, uint64_t update_id) {
+  auto levels = [](const std::vector<OrderBookUpdate::Level>& side) {
+    nlohmann::json res = nlohmann::json::array();
+    for (const auto& level : side) {
+      res.push_back({level.price.ToString(), level.volume.ToString()});
+    }
+    return res;
+  };
+  nlohmann::json msg = {
+    {"e", "depthUpdate"},
+    {"E", update.arrived_ts / 1000},
+    {"s", replay_messages::BinanceSymbol(update.symbol)},
+    {"U", update_id},
+    {"u", update_id},
+    {"b", levels(update.bids)},
+    {"a", levels(update.asks)}
+  };
+  return msg.dump();
+}
+
+struct Payloads {
+  std::vector<std::string> binance_tickers;
+  std::vector<std::string> binance_trades;
+  std::vector<std::string> binance_depth;
+  std::vector<std::string> kraken_tickers;
+  std::vector<std::string> kraken_books;
+
+  void operator()(const Ticker& ticker) {
+    if (ticker.exchange == "binance") {
+      binance_tickers.push_back(replay_messages::BinanceBookTicker(ticker));
+    } else if (ticker.exchange == "kraken") {
+      kraken_tickers.push_back(replay_messages::KrakenTicker(ticker));
+    }
+  }
+
+  void operator()(const TradeTicker& trade) {
+    if (trade.exchange == "binance") {
+      binance_trades.push_back(replay_messages::BinanceTrade(trade));
+    }
+  }
+
+  void operator()(const OrderBookUpdate& update) {
+    if (update.exchange == "binance") {
+      binance_depth.push_back(BinanceDepth(update, binance_depth.size() + 1));
+    } else if (update.exchange == "kraken") {
+      kraken_books.push_back(replay_messages::KrakenBook(update));
+    }
+  }
+};
+
+OrderBookUpdate::Level CreateLevel(uint64_t price, uint64_t volume, uint64_t ts) {
+  return OrderBookUpdate::Level{Decimal(price, 5), Decimal(volume, 8), ts};
+}
+
+// Stands in for a capture file, with the shapes of the recorded messages
+Payloads CreatePayloads(size_t count) {
+  Payloads payloads;
+  for (size_t i = 0; i < count; ++i) {
+    const uint64_t ts = 1614556800000000 + i * 1000;
+    Ticker ticker;
+    ticker.arrived_ts = ts;
+    ticker.symbol = SymbolPairId::BTC_USDT;
+    ticker.id = i;
+    ticker.bid = 55412.01 + i % 100;
+    ticker.bid_vol = 0.0125 * (i % 7 + 1);
+    ticker.ask = ticker.bid + 0.01;
+    ticker.ask_vol = 0.5;
+    ticker.exchange = "binance";
+    payloads(ticker);
+    ticker.exchange = "kraken";
+    payloads(ticker);
+
+    TradeTicker trade;
+    trade.exchange = "binance";
+    trade.symbol = SymbolPairId::BTC_USDT;
+    trade.event_time = ts / 1000;
+    trade.trade_time = ts / 1000;
+    trade.trade_id = std::to_string(700000000 + i);
+    trade.price = ticker.bid;
+    trade.qty = 0.00213;
+    trade.is_market_maker = i % 2;
+    payloads(trade);
+
+    OrderBookUpdate update{};
+    update.arrived_ts = ts;
+    update.symbol = SymbolPairId::BTC_USDT;
+    update.is_snapshot = false;
+    for (uint64_t l = 0; l < 3; ++l) {
+      update.bids.push_back(CreateLevel(5541200000 - l * 1000, 12500000 * (i % 5), ts - l));
+      update.asks.push_back(CreateLevel(5541300000 + l * 1000, 50000000, ts - l));
+    }
+    update.exchange = "binance";
+    payloads(update);
+    update.exchange = "kraken";
+    payloads(update);
+  }
+  return payloads;
+}
+
+template <typename Decoder, typename T>
+void Measure(const std::string& name, const std::vector<std::string>& payloads) {
+  if (payloads.empty()) {
+    return;
+  }
+  constexpr size_t ROUNDS = 10;
+  size_t decoded = 0;
+  auto run = [&](auto&& decode) {
+    const uint64_t allocations_before = GetAllocationCount();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < ROUNDS; ++r) {
+      for (const std::string& payload : payloads) {
+        T out{};
+        decoded += decode(payload, out);
+      }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    const double messages = static_cast<double>(ROUNDS * payloads.size());
+    std::cout << std::fixed << std::setprecision(2)
+        << std::setw(12) << std::chrono::duration<double, std::nano>(elapsed).count() / messages << " ns/msg"
+        << std::setw(10) << (GetAllocationCount() - allocations_before) / messages << " allocs/msg";
+  };
+  std::cout << std::left << std::setw(16) << name << std::right << std::setw(8) << payloads.size() << " msgs  dom:";
+  run([](const std::string& payload, T& out) {
+    return Decoder::DecodeJson(json::parse(payload), out);
+  });
+  std::cout << "  fast:";
+  run([](const std::string& payload, T& out) {
+    return Decoder::DecodeFast(payload, out);
+  });
+  std::cout << "  (decoded " << decoded << ")" << std::endl;
+}
+
+}
+
+/**
+ * Decoding cost of feed messages, with a DOM and with the fast path of the decoders.
+ * Messages are encoded from the events of a capture file, if given, or generated.
+ */
+int main(int argc, char** argv) {
+  Payloads payloads;
+  if (argc > 1) {
+    CaptureFileReader reader(argv[1]);
+    reader.ForEach(payloads);
+  } else {
+    payloads = CreatePayloads(50000);
+  }
+  Measure<binance_decoders::BookTickerDecoder, Ticker>("binance ticker", payloads.binance_tickers);
+  Measure<binance_decoders::TradeDecoder, TradeTicker>("binance trade", payloads.binance_trades);
+  Measure<binance_decoders::DepthDecoder, binance_decoders::DepthUpdate>("binance depth", payloads.binance_depth);
+  Measure<KrakenMessageDecoder, KrakenMessage>("kraken ticker", payloads.kraken_tickers);
+  Measure<KrakenMessageDecoder, KrakenMessage>("kraken book", payloads.kraken_books);
+  return 0;
+}
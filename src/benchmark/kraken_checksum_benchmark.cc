@@ -0,0 +1,82 @@
+#include "utils/math.h"
+#include "websocket/kraken_order_book_handler.hpp"
+
+#include <boost/crc.hpp>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Previous implementation: one std::string per level, concatenated, then boost CRC
+uint32_t LegacyChecksum(const OrderBook& ob) {
+  const auto& precision_settings = ob.GetPrecisionSettings();
+  std::vector<std::string> partial_input;
+  const auto& asks = ob.GetAsks();
+  std::transform(asks.rbegin(), asks.rend(), std::back_inserter(partial_input),
+      [&](const PriceLevel& pl) -> std::string {
+        return std::to_string(uint64_t(pl.GetPrice())) + std::to_string(uint64_t(pl.GetVolume()*cryptobot::quick_pow10(precision_settings.m_volume_precision)));
+      });
+  const auto& bids = ob.GetBids();
+  std::transform(bids.rbegin(), bids.rend(), std::back_inserter(partial_input),
+      [&](const PriceLevel& pl) -> std::string {
+        return std::to_string(uint64_t(pl.GetPrice())) + std::to_string(uint64_t(pl.GetVolume()*cryptobot::quick_pow10(precision_settings.m_volume_precision)));
+      });
+  std::string res;
+  for (const auto &piece : partial_input) res += piece;
+  boost::crc_32_type crc;
+  crc.process_bytes(res.c_str(), res.size());
+  return crc.checksum();
+}
+
+OrderBook CreateOrderBook(size_t depth) {
+  OrderBook ob{"kraken", SymbolPairId::BTC_USDT, depth, PrecisionSettings{5, 8, 6}};
+  for (size_t i = 0; i < depth; ++i) {
+    PriceLevel ask(price_t(5541300000 + 1000 * i), 0.5 + 0.1 * i, 1616663113240127);
+    ob.UpsertAsk(ask);
+    PriceLevel bid(price_t(5541200000 - 1000 * i), 1.25 * (i + 1), 1616663113240127);
+    ob.UpsertBid(bid);
+  }
+  return ob;
+}
+
+template <typename F>
+double MeasureNs(F&& f, size_t iterations) {
+  uint32_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    sink ^= f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  // Prevent the loop from being optimized away
+  volatile uint32_t keep = sink;
+  (void)keep;
+  return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  size_t iterations = argc > 1 ? std::stoul(argv[1]) : 100000;
+  std::cout << "Hardware CRC32 support: " << (cryptobot::crc32_has_hw_support() ? "yes" : "no") << std::endl;
+  std::cout << std::setw(8) << "depth" << std::setw(16) << "legacy [ns]" << std::setw(16) << "current [ns]" << std::setw(10) << "speedup" << std::endl;
+  for (size_t depth : {10, 25, 100, 500}) {
+    OrderBook ob = CreateOrderBook(depth);
+    double legacy_ns = MeasureNs([&]() { return LegacyChecksum(ob); }, iterations);
+    double current_ns = MeasureNs([&]() { return KrakenOrderBookHandler::CalculateChecksum(ob); }, iterations);
+    std::cout << std::setw(8) << depth << std::setw(16) << std::fixed << std::setprecision(1) << legacy_ns
+        << std::setw(16) << current_ns << std::setw(9) << legacy_ns / current_ns << "x" << std::endl;
+  }
+
+  std::cout << std::endl << std::setw(8) << "bytes" << std::setw(16) << "portable [ns]" << std::setw(16) << "dispatch [ns]" << std::endl;
+  std::string input(4096, '7');
+  for (size_t len : {64, 256, 800, 4096}) {
+    double portable_ns = MeasureNs([&]() { return cryptobot::crc32_portable(input.data(), len); }, iterations);
+    double dispatch_ns = MeasureNs([&]() { return cryptobot::crc32(input.data(), len); }, iterations);
+    std::cout << std::setw(8) << len << std::setw(16) << portable_ns << std::setw(16) << dispatch_ns << std::endl;
+  }
+  return 0;
+}
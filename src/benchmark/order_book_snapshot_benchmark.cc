@@ -0,0 +1,168 @@
+#include "exchange/exchange_listener.h"
+#include "model/order_book_snapshot.h"
+#include "utils/seqlock.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Stands in for indicator calculation and prediction
+double StrategyWork(const OrderBookSnapshot& snapshot, std::chrono::microseconds duration) {
+  double acc = 0;
+  auto deadline = std::chrono::steady_clock::now() + duration;
+  do {
+    for (size_t i = 0; i < snapshot.bid_count; ++i) {
+      acc += snapshot.bids[i].volume;
+    }
+  } while (std::chrono::steady_clock::now() < deadline);
+  return acc;
+}
+
+// Previous approach: strategy work done on the feed thread under a mutex
+class InlineStrategy : public ExchangeListener {
+public:
+  InlineStrategy(std::chrono::microseconds work) : m_work(work), m_sink(0) {}
+
+  virtual void OnConnectionOpen(const std::string&) override {}
+  virtual void OnConnectionClose(const std::string&) override {}
+
+  virtual void OnOrderBookUpdate(const OrderBook& order_book) override {
+    std::scoped_lock<std::mutex> lock{m_mutex};
+    m_snapshot.Assign(order_book, 0);
+    m_sink += StrategyWork(m_snapshot, m_work);
+  }
+
+private:
+  std::chrono::microseconds m_work;
+  std::mutex m_mutex;
+  OrderBookSnapshot m_snapshot;
+  double m_sink;
+};
+
+// Feed thread only publishes snapshots, strategy threads consume the latest one
+class SnapshotStrategy : public ExchangeListener {
+public:
+  SnapshotStrategy(std::chrono::microseconds work, size_t threads) : m_work(work), m_running(true), m_processed(0) {
+    for (size_t i = 0; i < threads; ++i) {
+      m_threads.emplace_back([this]() { Run(); });
+    }
+  }
+
+  virtual ~SnapshotStrategy() {
+    m_running = false;
+    for (auto& thread : m_threads) {
+      thread.join();
+    }
+  }
+
+  virtual void OnConnectionOpen(const std::string&) override {}
+  virtual void OnConnectionClose(const std::string&) override {}
+
+  virtual void OnOrderBookUpdate(const OrderBook& order_book) override {
+    m_feed_snapshot.Assign(order_book, 0);
+    m_snapshot.store(m_feed_snapshot);
+  }
+
+  size_t GetProcessed() const { return m_processed.load(); }
+
+private:
+  void Run() {
+    uint64_t seen_version = 0;
+    double sink = 0;
+    while (m_running.load(std::memory_order_relaxed)) {
+      const uint64_t version = m_snapshot.version();
+      if (version == seen_version) {
+        std::this_thread::yield();
+        continue;
+      }
+      seen_version = version;
+      OrderBookSnapshot snapshot = m_snapshot.load();
+      sink += StrategyWork(snapshot, m_work);
+      m_processed.fetch_add(1, std::memory_order_relaxed);
+    }
+    volatile double keep = sink;
+    (void)keep;
+  }
+
+  std::chrono::microseconds m_work;
+  OrderBookSnapshot m_feed_snapshot;
+  cryptobot::seqlock<OrderBookSnapshot> m_snapshot;
+  std::atomic<bool> m_running;
+  std::atomic<size_t> m_processed;
+  std::vector<std::thread> m_threads;
+};
+
+struct LatencyStats {
+  double mean_ns;
+  double p50_ns;
+  double p99_ns;
+};
+
+// Simulates the feed thread: apply a level update, notify listener, measure the notification
+LatencyStats MeasureFeed(ExchangeListener& listener, size_t messages) {
+  OrderBook ob{"binance", SymbolPairId::BTC_USDT, 100, PrecisionSettings{2, 8, 8}};
+  for (uint64_t i = 0; i < 100; ++i) {
+    PriceLevel bid(price_t(5000000 - i), 1.0, i);
+    ob.UpsertBid(bid);
+    PriceLevel ask(price_t(5000001 + i), 1.0, i);
+    ob.UpsertAsk(ask);
+  }
+  std::vector<double> latencies;
+  latencies.reserve(messages);
+  for (size_t i = 0; i < messages; ++i) {
+    PriceLevel bid(price_t(5000000 - i % 10), 1.0 + i % 7, i);
+    ob.UpsertBid(bid);
+    auto start = std::chrono::steady_clock::now();
+    listener.OnOrderBookUpdate(ob);
+    auto end = std::chrono::steady_clock::now();
+    latencies.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+  }
+  LatencyStats stats;
+  double sum = 0;
+  for (double l : latencies) {
+    sum += l;
+  }
+  stats.mean_ns = sum / messages;
+  std::sort(latencies.begin(), latencies.end());
+  stats.p50_ns = latencies[messages / 2];
+  stats.p99_ns = latencies[messages * 99 / 100];
+  return stats;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  size_t messages = argc > 1 ? std::stoul(argv[1]) : 20000;
+  size_t readers = argc > 2 ? std::stoul(argv[2]) : 2;
+  std::cout << "Feed thread latency per order book message, " << readers << " strategy threads, "
+      << std::thread::hardware_concurrency() << " cores" << std::endl;
+  std::cout << std::setw(10) << "work [us]"
+      << std::setw(16) << "inline mean" << std::setw(16) << "inline p99"
+      << std::setw(16) << "snapshot mean" << std::setw(16) << "snapshot p99"
+      << std::setw(12) << "processed" << "   [ns]" << std::endl;
+  for (int work_us : {0, 1, 10, 50}) {
+    std::chrono::microseconds work(work_us);
+    InlineStrategy inline_strategy(work);
+    LatencyStats inline_stats = MeasureFeed(inline_strategy, messages);
+    size_t processed = 0;
+    LatencyStats snapshot_stats;
+    {
+      SnapshotStrategy snapshot_strategy(work, readers);
+      snapshot_stats = MeasureFeed(snapshot_strategy, messages);
+      processed = snapshot_strategy.GetProcessed();
+    }
+    std::cout << std::setw(10) << work_us << std::fixed << std::setprecision(0)
+        << std::setw(16) << inline_stats.mean_ns << std::setw(16) << inline_stats.p99_ns
+        << std::setw(16) << snapshot_stats.mean_ns << std::setw(16) << snapshot_stats.p99_ns
+        << std::setw(12) << processed << std::endl;
+  }
+  return 0;
+}
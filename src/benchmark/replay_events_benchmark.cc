@@ -0,0 +1,148 @@
+#include "allocation_counter.h"
+#include "model/compact_event.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace {
+
+// Stands in for decoded BSON fields, which are string views into the fetched documents
+struct RawLevel {
+  std::string price;
+  std::string volume;
+};
+
+struct RawEvent {
+  EventType type;
+  uint64_t arrived_ts;
+  std::string exchange;
+  std::string trade_id;
+  std::vector<RawLevel> levels;
+};
+
+std::vector<RawEvent> CreateRawEvents(size_t count) {
+  std::vector<RawEvent> events;
+  events.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    RawEvent event;
+    event.type = static_cast<EventType>(i % 3);
+    event.arrived_ts = 1600000000000000 + i * 1000;
+    // Longer than the small string buffer
+    event.exchange = i % 2 ? "binance_spot_stream" : "kraken_spot_stream";
+    event.trade_id = std::to_string(900000000 + i);
+    if (event.type == EventType::BOOK_DIFF) {
+      for (size_t l = 0; l < 10; ++l) {
+        event.levels.push_back(RawLevel{"1." + std::to_string(1000 + l), std::to_string(100 + l) + ".5"});
+      }
+    }
+    events.push_back(std::move(event));
+  }
+  return events;
+}
+
+struct Sink {
+  uint64_t acc = 0;
+
+  void operator()(const Ticker& ticker) { acc += ticker.arrived_ts + ticker.exchange.size(); }
+  void operator()(const TradeTicker& trade) { acc += trade.arrived_ts + trade.trade_id.size(); }
+  void operator()(const OrderBookUpdate& update) { acc += update.arrived_ts + update.bids.size(); }
+};
+
+typedef std::vector<std::variant<Ticker, TradeTicker, OrderBookUpdate>> EventsVector;
+
+// Previous approach: one vector of variants per batch, owning strings and level vectors
+void ReplayVariants(const std::vector<RawEvent>& raw_events, Sink& sink) {
+  EventsVector events_vec;
+  for (const RawEvent& raw : raw_events) {
+    if (raw.type == EventType::BOOK_TICKER) {
+      Ticker ticker;
+      ticker.arrived_ts = raw.arrived_ts;
+      ticker.exchange = raw.exchange;
+      ticker.bid = 1.1;
+      ticker.ask = 1.2;
+      events_vec.push_back(ticker);
+    } else if (raw.type == EventType::TRADE_TICKER) {
+      TradeTicker trade;
+      trade.arrived_ts = raw.arrived_ts;
+      trade.exchange = raw.exchange;
+      trade.trade_id = raw.trade_id;
+      events_vec.push_back(trade);
+    } else {
+      OrderBookUpdate update;
+      update.arrived_ts = raw.arrived_ts;
+      update.exchange = raw.exchange;
+      for (const RawLevel& level : raw.levels) {
+        update.bids.push_back(OrderBookUpdate::Level{Decimal::Parse(level.price), Decimal::Parse(level.volume), std::nullopt});
+      }
+      events_vec.push_back(update);
+    }
+  }
+  for (const auto& event : events_vec) {
+    std::visit(sink, event);
+  }
+}
+
+// Compact events in a reused batch, fed to listeners through the materializer
+void ReplayCompact(const std::vector<RawEvent>& raw_events, EventBatch& batch, EventMaterializer& materializer, Sink& sink) {
+  for (const RawEvent& raw : raw_events) {
+    CompactEvent& event = batch.AddEvent(raw.type, raw.arrived_ts, raw.exchange, SymbolPairId::ADA_USDT);
+    if (raw.type == EventType::BOOK_TICKER) {
+      event.ticker = CompactEvent::TickerData{1.1, 0, 1.2, 0, 0};
+    } else if (raw.type == EventType::TRADE_TICKER) {
+      event.trade = CompactEvent::TradeData{};
+      batch.SetTradeId(event, raw.trade_id);
+    } else {
+      OrderBookUpdate::Level* levels = batch.AllocateLevels(raw.levels.size());
+      for (size_t i = 0; i < raw.levels.size(); ++i) {
+        new (levels + i) OrderBookUpdate::Level{Decimal::Parse(raw.levels[i].price), Decimal::Parse(raw.levels[i].volume), std::nullopt};
+      }
+      event.diff = CompactEvent::DiffData{0, levels, static_cast<uint32_t>(raw.levels.size()), 0};
+    }
+  }
+  batch.EndRun();
+  for (const CompactEvent& event : batch.GetEvents()) {
+    materializer.Visit(batch, event, sink);
+  }
+  batch.Clear();
+}
+
+template <typename F>
+void Measure(const std::string& name, size_t rounds, size_t events_per_round, F&& replay) {
+  // Warm up, lets reused buffers grow
+  replay();
+  const uint64_t allocations_before = GetAllocationCount();
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rounds; ++i) {
+    replay();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  const uint64_t allocations = GetAllocationCount() - allocations_before;
+  const double events = static_cast<double>(rounds * events_per_round);
+  std::cout << std::left << std::setw(10) << name
+      << std::right << std::fixed << std::setprecision(2)
+      << std::setw(12) << allocations / events << " allocs/event"
+      << std::setw(12) << std::chrono::duration<double, std::nano>(elapsed).count() / events << " ns/event"
+      << std::endl;
+}
+
+}
+
+int main() {
+  constexpr size_t EVENTS_PER_BATCH = 60000;
+  constexpr size_t ROUNDS = 20;
+  const std::vector<RawEvent> raw_events = CreateRawEvents(EVENTS_PER_BATCH);
+
+  Sink sink;
+  Measure("variant", ROUNDS, EVENTS_PER_BATCH, [&]() { ReplayVariants(raw_events, sink); });
+  EventBatch batch;
+  EventMaterializer materializer;
+  Measure("compact", ROUNDS, EVENTS_PER_BATCH, [&]() { ReplayCompact(raw_events, batch, materializer, sink); });
+  std::cout << "sizeof(variant) " << sizeof(EventsVector::value_type) << ", sizeof(CompactEvent) " << sizeof(CompactEvent)
+      << " (checksum " << sink.acc << ")" << std::endl;
+  return 0;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * Append-only columnar market data capture file.
+ *
+ * Layout (host byte order, every block padded to 8 bytes so that columns can be read in place):
+ *
+ *   FileHeader
+ *   Chunk*
+ *
+ *   Chunk:   ChunkHeader, exchange name table, Segment[segment_count]
+ *   Segment: SegmentHeader, columns of the event type, each column holding
+ *            row_count (or level_count) fixed width values
+ *
+ * Exchange name table: u16 name length[exchange_count], name bytes.
+ *
+ * A chunk holds all events written between two flushes, with one segment per event type.
+ * Events inside a segment are sorted by arrival timestamp, so a chunk can be replayed
+ * in order by merging its segments. Exchange names are stored once per chunk and referenced
+ * by index. Chunks are self-contained, a truncated chunk at the end of the file
+ * (eg. after a crash) is ignored by the reader.
+ *
+ * Columns per segment type:
+ *   BOOK_TICKER:  u64 arrived_ts, i64 source_ts (NO_SOURCE_TS if not set), f64 bid, f64 bid_vol,
+ *                 f64 ask, f64 ask_vol (NaN if not set), u16 symbol, u8 exchange
+ *   TRADE_TICKER: u64 arrived_ts, u64 event_time, u64 trade_time, f64 price, f64 qty,
+ *                 u32 trade_id_offset[row_count + 1], u16 symbol, u8 exchange, u8 is_market_maker,
+ *                 trade id bytes (trade_id_size)
+ *   BOOK_DIFF:    u64 arrived_ts, u64 last_update_id, u32 bid_count, u32 ask_count, u16 symbol,
+ *                 u8 exchange, u8 is_snapshot,
+ *                 per level (bids then asks of every update): u64 price mantissa, u64 volume mantissa,
+ *                 u64 timestamp, u8 price scale, u8 volume scale, u8 has_timestamp
+ */
+namespace capture {
+
+constexpr char FILE_MAGIC[8] = {'C', 'B', 'O', 'T', 'C', 'A', 'P', '1'};
+constexpr uint32_t CHUNK_MAGIC = 0x4b4e4843; // "CHNK"
+constexpr uint32_t FORMAT_VERSION = 1;
+constexpr int64_t NO_SOURCE_TS = INT64_MIN;
+
+enum class SegmentType : uint32_t {
+  BOOK_TICKER = 1,
+  TRADE_TICKER = 2,
+  BOOK_DIFF = 3
+};
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+};
+
+struct ChunkHeader {
+  uint32_t magic;
+  uint32_t segment_count;
+  // Size of the chunk without the header
+  uint64_t size;
+  uint32_t exchange_count;
+  uint32_t reserved;
+};
+
+struct SegmentHeader {
+  SegmentType type;
+  uint32_t row_count;
+  // BOOK_DIFF: total number of price levels, TRADE_TICKER: trade id bytes
+  uint32_t extra_count;
+  uint32_t reserved;
+  // Size of the columns without the header
+  uint64_t size;
+};
+
+static_assert(sizeof(FileHeader) == 16, "unexpected FileHeader padding");
+static_assert(sizeof(ChunkHeader) == 24, "unexpected ChunkHeader padding");
+static_assert(sizeof(SegmentHeader) == 24, "unexpected SegmentHeader padding");
+
+inline size_t Padded(size_t size) {
+  return (size + 7) & ~size_t(7);
+}
+
+template <typename T>
+void AppendColumn(std::string& out, const std::vector<T>& column) {
+  const size_t bytes = column.size() * sizeof(T);
+  out.append(reinterpret_cast<const char*>(column.data()), bytes);
+  out.append(Padded(bytes) - bytes, '\0');
+}
+
+template <typename T>
+void AppendStruct(std::string& out, const T& value) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  out.append(Padded(sizeof(T)) - sizeof(T), '\0');
+}
+
+}
@@ -0,0 +1,403 @@
+#pragma once
+
+#include "capture_file.h"
+
+#include "exchange/exchange_listener.h"
+#include "model/model_checkpoint.hpp"
+#include "model/order_book.h"
+#include "model/order_book_update.h"
+#include "model/ticker.h"
+#include "model/trade_ticker.h"
+#include "utils/checkpoint.hpp"
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Replays a columnar capture file (see capture_file.h) written by CaptureFileWriter.
+ *
+ * The file is memory mapped and decoded straight from the mapped columns, a chunk at a time,
+ * without intermediate documents. Events of a chunk are replayed in arrival timestamp order.
+ *
+ * A checkpoint saves the replay position and the order books of the reader, Produce() continues
+ * from a restored position.
+ */
+class CaptureFileReader : public cryptobot::Checkpointable {
+public:
+  /**
+   * @throws std::runtime_error if the file can't be mapped or is not a capture file
+   */
+  explicit CaptureFileReader(const std::string& path) : m_position{sizeof(capture::FileHeader), 0} {
+    try {
+      m_file.open(path);
+    } catch (const std::exception& e) {
+      throw std::runtime_error("CaptureFileReader: can't map " + path + ": " + e.what());
+    }
+    if (m_file.size() < sizeof(capture::FileHeader)) {
+      throw std::runtime_error("CaptureFileReader: file too small: " + path);
+    }
+    capture::FileHeader header;
+    std::memcpy(&header, m_file.data(), sizeof(header));
+    if (std::memcmp(header.magic, capture::FILE_MAGIC, sizeof(header.magic)) != 0) {
+      throw std::runtime_error("CaptureFileReader: not a capture file: " + path);
+    }
+    if (header.version != capture::FORMAT_VERSION) {
+      throw std::runtime_error("CaptureFileReader: unsupported version " + std::to_string(header.version));
+    }
+  }
+
+  void Register(ExchangeListener* exchange_listener) {
+    m_exchange_listeners.push_back(exchange_listener);
+  }
+
+  void Unregister(ExchangeListener* exchange_listener) {
+    size_t i = 0;
+    while (i < m_exchange_listeners.size()) {
+      if (m_exchange_listeners.at(i) == exchange_listener) {
+        m_exchange_listeners.erase(m_exchange_listeners.begin() + i);
+      } else {
+        ++i;
+      }
+    }
+  }
+
+  /**
+   * Replays all events after the current position to registered listeners. Order book updates
+   * are applied to order books maintained by the reader, listeners receive the updated book.
+   *
+   * @return number of replayed events
+   */
+  int64_t Produce() {
+    // Position is moved before dispatching, so a checkpoint taken by a listener resumes after the event
+    return Replay(m_position, [this](const auto& event) {
+      ++m_position.event;
+      Dispatch(event);
+    }, [this](uint64_t chunk_offset) {
+      if (chunk_offset != m_position.chunk_offset) {
+        m_position = Position{chunk_offset, 0};
+      }
+    });
+  }
+
+  /**
+   * Calls visitor(const Ticker&), visitor(const TradeTicker&) or visitor(const OrderBookUpdate&)
+   * for every event in the file. Event objects are reused, the references are only valid during the call.
+   *
+   * @return number of visited events
+   */
+  template <typename Visitor>
+  int64_t ForEach(Visitor&& visitor) const {
+    return Replay(Position{sizeof(capture::FileHeader), 0}, visitor, [](uint64_t) {});
+  }
+
+  virtual void SaveState(cryptobot::CheckpointWriter& writer) const override {
+    writer.Write(m_position);
+    writer.Write<uint64_t>(m_order_books.size());
+    for (const auto& ob : m_order_books) {
+      SaveOrderBook(writer, ob);
+    }
+  }
+
+  virtual void LoadState(cryptobot::CheckpointReader& reader) override {
+    const Position position = reader.Read<Position>();
+    if (position.chunk_offset < sizeof(capture::FileHeader) || position.chunk_offset > m_file.size()) {
+      throw std::runtime_error("CaptureFileReader: checkpoint position outside of the file");
+    }
+    m_position = position;
+    m_order_books.clear();
+    for (uint64_t i = reader.Read<uint64_t>(); i > 0; --i) {
+      m_order_books.push_back(LoadOrderBook(reader));
+    }
+  }
+
+private:
+  // Offset of the chunk being replayed and number of its events already replayed
+  struct Position {
+    uint64_t chunk_offset;
+    uint64_t event;
+  };
+
+  /**
+   * @param on_chunk called with the offset of every chunk before its events are visited
+   */
+  template <typename Visitor, typename OnChunk>
+  int64_t Replay(const Position& start, Visitor&& visitor, OnChunk&& on_chunk) const {
+    const char* data = m_file.data();
+    const size_t file_size = m_file.size();
+    size_t offset = start.chunk_offset;
+    uint64_t skip = start.event;
+    int64_t events = 0;
+    while (offset < file_size) {
+      capture::ChunkHeader header;
+      if (file_size - offset < sizeof(header)) {
+        BOOST_LOG_TRIVIAL(warning) << "CaptureFileReader: truncated chunk header at offset " << offset;
+        break;
+      }
+      std::memcpy(&header, data + offset, sizeof(header));
+      if (header.magic != capture::CHUNK_MAGIC) {
+        BOOST_LOG_TRIVIAL(error) << "CaptureFileReader: bad chunk magic at offset " << offset;
+        break;
+      }
+      if (file_size - offset - sizeof(header) < header.size) {
+        BOOST_LOG_TRIVIAL(warning) << "CaptureFileReader: truncated chunk at offset " << offset;
+        break;
+      }
+      on_chunk(offset);
+      offset += sizeof(header);
+      events += ReplayChunk(header, data + offset, skip, visitor);
+      skip = 0;
+      offset += header.size;
+    }
+    return events;
+  }
+
+  // Read only view of a segment's columns
+  struct Cursor {
+    const char* p;
+
+    template <typename T>
+    const T* Column(size_t count) {
+      const T* column = reinterpret_cast<const T*>(p);
+      p += capture::Padded(count * sizeof(T));
+      return column;
+    }
+  };
+
+  struct BookTickerColumns {
+    size_t rows = 0;
+    const uint64_t* arrived_ts;
+    const int64_t* source_ts;
+    const double* bid;
+    const double* bid_vol;
+    const double* ask;
+    const double* ask_vol;
+    const uint16_t* symbol;
+    const uint8_t* exchange;
+  };
+
+  struct TradeTickerColumns {
+    size_t rows = 0;
+    const uint64_t* arrived_ts;
+    const uint64_t* event_time;
+    const uint64_t* trade_time;
+    const double* price;
+    const double* qty;
+    const uint32_t* trade_id_offset;
+    const uint16_t* symbol;
+    const uint8_t* exchange;
+    const uint8_t* is_market_maker;
+    const char* trade_ids;
+  };
+
+  struct BookDiffColumns {
+    size_t rows = 0;
+    const uint64_t* arrived_ts;
+    const uint64_t* last_update_id;
+    const uint32_t* bid_count;
+    const uint32_t* ask_count;
+    const uint16_t* symbol;
+    const uint8_t* exchange;
+    const uint8_t* is_snapshot;
+    const uint64_t* price_mantissa;
+    const uint64_t* volume_mantissa;
+    const uint64_t* timestamp;
+    const uint8_t* price_scale;
+    const uint8_t* volume_scale;
+    const uint8_t* has_timestamp;
+  };
+
+  // Events before `skip` are decoded but not visited
+  template <typename Visitor>
+  static int64_t ReplayChunk(const capture::ChunkHeader& header, const char* data, uint64_t skip, Visitor& visitor) {
+    Cursor cursor{data};
+    const uint16_t* name_lengths = cursor.Column<uint16_t>(header.exchange_count);
+    size_t names_size = 0;
+    for (size_t i = 0; i < header.exchange_count; ++i) {
+      names_size += name_lengths[i];
+    }
+    const char* names = cursor.Column<char>(names_size);
+    std::vector<std::string> exchanges;
+    exchanges.reserve(header.exchange_count);
+    for (size_t i = 0; i < header.exchange_count; ++i) {
+      exchanges.emplace_back(names, name_lengths[i]);
+      names += name_lengths[i];
+    }
+
+    BookTickerColumns tickers{};
+    TradeTickerColumns trades{};
+    BookDiffColumns diffs{};
+    for (size_t s = 0; s < header.segment_count; ++s) {
+      capture::SegmentHeader segment;
+      std::memcpy(&segment, cursor.p, sizeof(segment));
+      cursor.p += capture::Padded(sizeof(segment));
+      Cursor columns{cursor.p};
+      const size_t n = segment.row_count;
+      switch (segment.type) {
+        case capture::SegmentType::BOOK_TICKER:
+          tickers.rows = n;
+          tickers.arrived_ts = columns.Column<uint64_t>(n);
+          tickers.source_ts = columns.Column<int64_t>(n);
+          tickers.bid = columns.Column<double>(n);
+          tickers.bid_vol = columns.Column<double>(n);
+          tickers.ask = columns.Column<double>(n);
+          tickers.ask_vol = columns.Column<double>(n);
+          tickers.symbol = columns.Column<uint16_t>(n);
+          tickers.exchange = columns.Column<uint8_t>(n);
+          break;
+        case capture::SegmentType::TRADE_TICKER:
+          trades.rows = n;
+          trades.arrived_ts = columns.Column<uint64_t>(n);
+          trades.event_time = columns.Column<uint64_t>(n);
+          trades.trade_time = columns.Column<uint64_t>(n);
+          trades.price = columns.Column<double>(n);
+          trades.qty = columns.Column<double>(n);
+          trades.trade_id_offset = columns.Column<uint32_t>(n + 1);
+          trades.symbol = columns.Column<uint16_t>(n);
+          trades.exchange = columns.Column<uint8_t>(n);
+          trades.is_market_maker = columns.Column<uint8_t>(n);
+          trades.trade_ids = columns.Column<char>(segment.extra_count);
+          break;
+        case capture::SegmentType::BOOK_DIFF:
+          diffs.rows = n;
+          diffs.arrived_ts = columns.Column<uint64_t>(n);
+          diffs.last_update_id = columns.Column<uint64_t>(n);
+          diffs.bid_count = columns.Column<uint32_t>(n);
+          diffs.ask_count = columns.Column<uint32_t>(n);
+          diffs.symbol = columns.Column<uint16_t>(n);
+          diffs.exchange = columns.Column<uint8_t>(n);
+          diffs.is_snapshot = columns.Column<uint8_t>(n);
+          diffs.price_mantissa = columns.Column<uint64_t>(segment.extra_count);
+          diffs.volume_mantissa = columns.Column<uint64_t>(segment.extra_count);
+          diffs.timestamp = columns.Column<uint64_t>(segment.extra_count);
+          diffs.price_scale = columns.Column<uint8_t>(segment.extra_count);
+          diffs.volume_scale = columns.Column<uint8_t>(segment.extra_count);
+          diffs.has_timestamp = columns.Column<uint8_t>(segment.extra_count);
+          break;
+        default:
+          BOOST_LOG_TRIVIAL(warning) << "CaptureFileReader: skipping unknown segment type " << static_cast<uint32_t>(segment.type);
+      }
+      cursor.p += segment.size;
+    }
+
+    // Merge the sorted segments by arrival timestamp
+    Ticker ticker;
+    TradeTicker trade;
+    OrderBookUpdate diff;
+    size_t ti = 0, tri = 0, di = 0, level = 0;
+    uint64_t index = 0;
+    constexpr uint64_t END = std::numeric_limits<uint64_t>::max();
+    while (ti < tickers.rows || tri < trades.rows || di < diffs.rows) {
+      const uint64_t ticker_ts = ti < tickers.rows ? tickers.arrived_ts[ti] : END;
+      const uint64_t trade_ts = tri < trades.rows ? trades.arrived_ts[tri] : END;
+      const uint64_t diff_ts = di < diffs.rows ? diffs.arrived_ts[di] : END;
+      if (ti < tickers.rows && ticker_ts <= trade_ts && ticker_ts <= diff_ts) {
+        ticker.arrived_ts = ticker_ts;
+        ticker.source_ts = tickers.source_ts[ti] == capture::NO_SOURCE_TS
+            ? std::nullopt : std::optional<uint64_t>(static_cast<uint64_t>(tickers.source_ts[ti]));
+        ticker.bid = tickers.bid[ti];
+        ticker.bid_vol = std::isnan(tickers.bid_vol[ti]) ? std::nullopt : std::optional<double>(tickers.bid_vol[ti]);
+        ticker.ask = tickers.ask[ti];
+        ticker.ask_vol = std::isnan(tickers.ask_vol[ti]) ? std::nullopt : std::optional<double>(tickers.ask_vol[ti]);
+        ticker.symbol = SymbolPairId(tickers.symbol[ti]);
+        ticker.exchange = exchanges.at(tickers.exchange[ti]);
+        if (index++ >= skip) {
+          visitor(static_cast<const Ticker&>(ticker));
+        }
+        ++ti;
+      } else if (tri < trades.rows && trade_ts <= diff_ts) {
+        trade.arrived_ts = trade_ts;
+        trade.event_time = trades.event_time[tri];
+        trade.trade_time = trades.trade_time[tri];
+        trade.price = trades.price[tri];
+        trade.qty = trades.qty[tri];
+        trade.trade_id.assign(trades.trade_ids + trades.trade_id_offset[tri],
+            trades.trade_id_offset[tri + 1] - trades.trade_id_offset[tri]);
+        trade.symbol = SymbolPairId(trades.symbol[tri]);
+        trade.exchange = exchanges.at(trades.exchange[tri]);
+        trade.is_market_maker = trades.is_market_maker[tri];
+        if (index++ >= skip) {
+          visitor(static_cast<const TradeTicker&>(trade));
+        }
+        ++tri;
+      } else {
+        diff.arrived_ts = diff_ts;
+        diff.last_update_id = diffs.last_update_id[di];
+        diff.is_snapshot = diffs.is_snapshot[di];
+        diff.symbol = SymbolPairId(diffs.symbol[di]);
+        diff.exchange = exchanges.at(diffs.exchange[di]);
+        ReadLevels(diffs, level, diffs.bid_count[di], diff.bids);
+        ReadLevels(diffs, level, diffs.ask_count[di], diff.asks);
+        if (index++ >= skip) {
+          visitor(static_cast<const OrderBookUpdate&>(diff));
+        }
+        ++di;
+      }
+    }
+    const uint64_t rows = tickers.rows + trades.rows + diffs.rows;
+    return rows - std::min(rows, skip);
+  }
+
+  static void ReadLevels(const BookDiffColumns& diffs, size_t& level, size_t count, std::vector<OrderBookUpdate::Level>& levels) {
+    levels.resize(count);
+    for (auto& l : levels) {
+      l.price = Decimal(diffs.price_mantissa[level], diffs.price_scale[level]);
+      l.volume = Decimal(diffs.volume_mantissa[level], diffs.volume_scale[level]);
+      l.timestamp = diffs.has_timestamp[level] ? std::optional<uint64_t>(diffs.timestamp[level]) : std::nullopt;
+      ++level;
+    }
+  }
+
+  void Dispatch(const Ticker& ticker) {
+    for (const auto& listener_ptr : m_exchange_listeners) {
+      listener_ptr->OnBookTicker(ticker);
+    }
+  }
+
+  void Dispatch(const TradeTicker& trade_ticker) {
+    for (const auto& listener_ptr : m_exchange_listeners) {
+      listener_ptr->OnTradeTicker(trade_ticker);
+    }
+  }
+
+  void Dispatch(const OrderBookUpdate& ob_update) {
+    OrderBook* ob = GetOrCreateOrderBook(ob_update);
+    if (ob == nullptr) {
+      return;
+    }
+    ob->Update(ob_update);
+    for (const auto& listener_ptr : m_exchange_listeners) {
+      listener_ptr->OnOrderBookUpdate(*ob);
+    }
+  }
+
+  OrderBook* GetOrCreateOrderBook(const OrderBookUpdate& update) {
+    for (auto& ob : m_order_books) {
+      if (ob.GetExchangeName() == update.exchange && ob.GetSymbolPairId() == update.symbol) {
+        return &ob;
+      }
+    }
+    const auto& levels = update.bids.empty() ? update.asks : update.bids;
+    if (levels.empty()) {
+      BOOST_LOG_TRIVIAL(warning) << "CaptureFileReader: skipping empty first update for " << update.exchange << " " << update.symbol;
+      return nullptr;
+    }
+    // TODO: configurable depth
+    m_order_books.emplace_back(update.exchange, update.symbol, 1000,
+        PrecisionSettings(levels[0].price.GetPrecision(), levels[0].volume.GetPrecision(), 3));
+    return &m_order_books.back();
+  }
+
+  boost::iostreams::mapped_file_source m_file;
+  Position m_position;
+  std::vector<OrderBook> m_order_books;
+  std::vector<ExchangeListener*> m_exchange_listeners;
+};
@@ -0,0 +1,196 @@
+#include "capture_file_reader.hpp"
+#include "capture_file_writer.hpp"
+
+#include "model/ticker_test_utils.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <variant>
+
+using namespace testing;
+
+namespace {
+
+using Event = std::variant<Ticker, TradeTicker, OrderBookUpdate>;
+
+class CaptureFileTest : public Test {
+protected:
+  void SetUp() override {
+    m_path = (std::filesystem::temp_directory_path() / ("capture_file_unittest_" + std::to_string(::getpid()))).string();
+    std::remove(m_path.c_str());
+  }
+
+  void TearDown() override {
+    std::remove(m_path.c_str());
+  }
+
+  std::vector<Event> ReadAll() const {
+    std::vector<Event> events;
+    CaptureFileReader reader(m_path);
+    reader.ForEach([&](const auto& event) {
+      events.push_back(event);
+    });
+    return events;
+  }
+
+  static TradeTicker CreateTradeTicker(uint64_t arrived_ts, const std::string& trade_id) {
+    TradeTicker trade;
+    trade.exchange = "binance";
+    trade.symbol = SymbolPairId::ETH_USDT;
+    trade.arrived_ts = arrived_ts;
+    trade.event_time = arrived_ts - 2;
+    trade.trade_time = arrived_ts - 3;
+    trade.trade_id = trade_id;
+    trade.price = 2000.5;
+    trade.qty = 0.25;
+    trade.is_market_maker = true;
+    return trade;
+  }
+
+  static OrderBookUpdate CreateUpdate(uint64_t arrived_ts, bool is_snapshot) {
+    OrderBookUpdate update;
+    update.exchange = "kraken";
+    update.symbol = SymbolPairId::ADA_USDT;
+    update.arrived_ts = arrived_ts;
+    update.last_update_id = arrived_ts * 10;
+    update.is_snapshot = is_snapshot;
+    update.bids = {{Decimal::Parse("1.09"), Decimal::Parse("2000"), std::nullopt}};
+    update.asks = {{Decimal::Parse("1.11"), Decimal::Parse("400.5"), 123u},
+        {Decimal::Parse("1.12"), Decimal::Parse("300"), std::nullopt}};
+    return update;
+  }
+
+  std::string m_path;
+};
+
+class MockExchangeListener : public ExchangeListener {
+public:
+  MOCK_METHOD1(OnConnectionOpen, void(const std::string&));
+  MOCK_METHOD1(OnConnectionClose, void(const std::string&));
+  MOCK_METHOD1(OnBookTicker, void(const Ticker&));
+  MOCK_METHOD1(OnTradeTicker, void(const TradeTicker&));
+  MOCK_METHOD1(OnOrderBookUpdate, void(const OrderBook&));
+};
+
+}
+
+TEST_F(CaptureFileTest, RoundTripTest) {
+  {
+    CaptureFileWriter writer(m_path);
+    Ticker ticker = CreateTicker("binance", SymbolPairId::BTC_USDT, 1.5, 1.6, 100, 0, 90);
+    ticker.bid_vol = 1.5;
+    ticker.ask_vol = std::nullopt;
+    writer.OnBookTicker(ticker);
+    writer.OnTradeTicker(CreateTradeTicker(101, "t-1"));
+    // Not flushed yet
+    EXPECT_EQ(0u, ReadAll().size());
+  }
+
+  std::vector<Event> events = ReadAll();
+  ASSERT_EQ(2u, events.size());
+
+  const Ticker& ticker = std::get<Ticker>(events[0]);
+  EXPECT_EQ("binance", ticker.exchange);
+  EXPECT_EQ(SymbolPairId::BTC_USDT, ticker.symbol);
+  EXPECT_EQ(100u, ticker.arrived_ts);
+  EXPECT_EQ(std::optional<uint64_t>(90), ticker.source_ts);
+  EXPECT_DOUBLE_EQ(1.5, ticker.bid);
+  EXPECT_EQ(std::optional<double>(1.5), ticker.bid_vol);
+  EXPECT_DOUBLE_EQ(1.6, ticker.ask);
+  EXPECT_FALSE(ticker.ask_vol.has_value());
+
+  const TradeTicker& trade = std::get<TradeTicker>(events[1]);
+  EXPECT_EQ("binance", trade.exchange);
+  EXPECT_EQ(SymbolPairId::ETH_USDT, trade.symbol);
+  EXPECT_EQ(101u, trade.arrived_ts);
+  EXPECT_EQ(99u, trade.event_time);
+  EXPECT_EQ(98u, trade.trade_time);
+  EXPECT_EQ("t-1", trade.trade_id);
+  EXPECT_DOUBLE_EQ(2000.5, trade.price);
+  EXPECT_DOUBLE_EQ(0.25, trade.qty);
+  EXPECT_TRUE(trade.is_market_maker);
+}
+
+TEST_F(CaptureFileTest, ArrivalOrderTest) {
+  std::vector<Ticker> tickers{CreateTicker("binance", SymbolPairId::BTC_USDT, 1.5, 1.6, 30), CreateTicker("kraken", SymbolPairId::BTC_USDT, 1.4, 1.7, 10)};
+  std::vector<TradeTicker> trades{CreateTradeTicker(20, "a"), CreateTradeTicker(50, "b")};
+  std::vector<OrderBookUpdate> updates{CreateUpdate(40, false), CreateUpdate(5, true)};
+  std::string chunk = CaptureFileWriter::EncodeChunk(tickers, trades, updates);
+  {
+    CaptureFileWriter writer(m_path);
+  }
+  std::ofstream(m_path, std::ios::binary | std::ios::app).write(chunk.data(), chunk.size());
+  // Appends a second chunk to the existing file
+  {
+    CaptureFileWriter writer(m_path);
+    writer.OnBookTicker(CreateTicker("binance", SymbolPairId::BTC_USDT, 1.5, 1.6, 60));
+  }
+
+  std::vector<uint64_t> arrived;
+  for (const Event& event : ReadAll()) {
+    arrived.push_back(std::visit([](const auto& e) { return e.arrived_ts; }, event));
+  }
+  EXPECT_THAT(arrived, ElementsAre(5, 10, 20, 30, 40, 50, 60));
+
+  std::vector<Event> events = ReadAll();
+  const OrderBookUpdate& update = std::get<OrderBookUpdate>(events[0]);
+  EXPECT_EQ("kraken", update.exchange);
+  EXPECT_EQ(SymbolPairId::ADA_USDT, update.symbol);
+  EXPECT_EQ(50u, update.last_update_id);
+  EXPECT_TRUE(update.is_snapshot);
+  ASSERT_EQ(1u, update.bids.size());
+  EXPECT_DOUBLE_EQ(1.09, update.bids[0].price.ToDouble());
+  EXPECT_DOUBLE_EQ(2000, update.bids[0].volume.ToDouble());
+  EXPECT_FALSE(update.bids[0].timestamp.has_value());
+  ASSERT_EQ(2u, update.asks.size());
+  EXPECT_DOUBLE_EQ(400.5, update.asks[0].volume.ToDouble());
+  EXPECT_EQ(std::optional<uint64_t>(123), update.asks[0].timestamp);
+  EXPECT_DOUBLE_EQ(1.12, update.asks[1].price.ToDouble());
+  EXPECT_EQ("kraken", std::get<Ticker>(events[1]).exchange);
+}
+
+TEST_F(CaptureFileTest, TruncatedChunkTest) {
+  {
+    CaptureFileWriter writer(m_path);
+    writer.OnBookTicker(CreateTicker("binance", SymbolPairId::BTC_USDT, 1.5, 1.6, 1));
+    writer.Flush();
+    writer.OnBookTicker(CreateTicker("binance", SymbolPairId::BTC_USDT, 1.5, 1.6, 2));
+  }
+  std::filesystem::resize_file(m_path, std::filesystem::file_size(m_path) - 8);
+  EXPECT_EQ(1u, ReadAll().size());
+}
+
+TEST_F(CaptureFileTest, ProduceOrderBookTest) {
+  {
+    CaptureFileWriter writer(m_path);
+  }
+  std::vector<Ticker> tickers;
+  std::vector<TradeTicker> trades;
+  std::vector<OrderBookUpdate> updates{CreateUpdate(1, true), CreateUpdate(2, false)};
+  // Removes the best ask
+  updates[1].asks = {{Decimal::Parse("1.11"), Decimal::Parse("0"), std::nullopt}};
+  updates[1].bids.clear();
+  std::string chunk = CaptureFileWriter::EncodeChunk(tickers, trades, updates);
+  std::ofstream(m_path, std::ios::binary | std::ios::app).write(chunk.data(), chunk.size());
+
+  CaptureFileReader reader(m_path);
+  StrictMock<MockExchangeListener> listener;
+  reader.Register(&listener);
+  std::vector<double> best_asks;
+  EXPECT_CALL(listener, OnOrderBookUpdate(_)).Times(2).WillRepeatedly(Invoke([&](const OrderBook& ob) {
+    EXPECT_EQ("kraken", ob.GetExchangeName());
+    best_asks.push_back(ob.ToDouble(ob.GetBestAsk().GetPrice()));
+  }));
+  EXPECT_EQ(2, reader.Produce());
+  EXPECT_THAT(best_asks, ElementsAre(DoubleEq(1.11), DoubleEq(1.12)));
+}
+
+TEST_F(CaptureFileTest, NotCaptureFileTest) {
+  std::ofstream(m_path) << "definitely not a capture file";
+  EXPECT_THROW(CaptureFileReader reader(m_path), std::runtime_error);
+  EXPECT_THROW(CaptureFileWriter writer(m_path), std::runtime_error);
+}
@@ -0,0 +1,327 @@
+#pragma once
+
+#include "capture_file.h"
+
+#include "exchange/exchange_listener.h"
+#include "model/order_book_update.h"
+#include "model/ticker.h"
+#include "model/trade_ticker.h"
+
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Captures market data events to a columnar capture file (see capture_file.h).
+ *
+ * Events are buffered in memory and appended as one chunk every `flush_rows` events,
+ * on Flush() and on destruction. Appending to an existing capture file is supported.
+ */
+class CaptureFileWriter : public ExchangeListener {
+public:
+  static constexpr size_t DEFAULT_FLUSH_ROWS = 16384;
+
+  /**
+   * @throws std::runtime_error if the file can't be opened or is not a capture file
+   */
+  CaptureFileWriter(const std::string& path, size_t flush_rows = DEFAULT_FLUSH_ROWS) : m_flush_rows(flush_rows) {
+    std::ifstream existing(path, std::ios::binary | std::ios::ate);
+    const bool is_new = !existing.is_open() || existing.tellg() == 0;
+    if (!is_new) {
+      capture::FileHeader header;
+      existing.seekg(0);
+      if (!existing.read(reinterpret_cast<char*>(&header), sizeof(header))
+          || std::memcmp(header.magic, capture::FILE_MAGIC, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("CaptureFileWriter: not a capture file: " + path);
+      }
+    }
+    existing.close();
+    m_file.open(path, std::ios::binary | std::ios::app);
+    if (!m_file.is_open()) {
+      throw std::runtime_error("CaptureFileWriter: can't open " + path);
+    }
+    if (is_new) {
+      capture::FileHeader header{};
+      std::memcpy(header.magic, capture::FILE_MAGIC, sizeof(header.magic));
+      header.version = capture::FORMAT_VERSION;
+      m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      m_file.flush();
+    }
+  }
+
+  virtual ~CaptureFileWriter() {
+    Flush();
+  }
+
+  virtual void OnConnectionOpen(const std::string&) override {
+
+  }
+
+  virtual void OnConnectionClose(const std::string&) override {
+
+  }
+
+  // This can be called from multiple threads
+  virtual void OnBookTicker(const Ticker& ticker) override {
+    std::scoped_lock<std::mutex> lock{m_mutex};
+    m_tickers.push_back(ticker);
+    FlushIfFull();
+  }
+
+  virtual void OnTradeTicker(const TradeTicker& ticker) override {
+    std::scoped_lock<std::mutex> lock{m_mutex};
+    m_trade_tickers.push_back(ticker);
+    FlushIfFull();
+  }
+
+  virtual void OnOrderBookUpdate(const OrderBook& order_book) override {
+    if (order_book.GetDepth() == 1) {
+      OnBookTicker(ExchangeListener::TickerFromOrderBook(order_book));
+      return;
+    }
+    std::scoped_lock<std::mutex> lock{m_mutex};
+    m_book_diffs.push_back(order_book.GetLastUpdate());
+    // Streams do not always fill these in
+    m_book_diffs.back().exchange = order_book.GetExchangeName();
+    m_book_diffs.back().symbol = order_book.GetSymbolPairId();
+    FlushIfFull();
+  }
+
+  void Flush() {
+    std::scoped_lock<std::mutex> lock{m_mutex};
+    FlushLocked();
+  }
+
+  /**
+   * Encode events as a single chunk. Sorts the events by arrival timestamp.
+   */
+  static std::string EncodeChunk(std::vector<Ticker>& tickers, std::vector<TradeTicker>& trade_tickers,
+      std::vector<OrderBookUpdate>& book_diffs) {
+    auto by_arrival = [](const auto& lhs, const auto& rhs) {
+      return lhs.arrived_ts < rhs.arrived_ts;
+    };
+    std::stable_sort(tickers.begin(), tickers.end(), by_arrival);
+    std::stable_sort(trade_tickers.begin(), trade_tickers.end(), by_arrival);
+    std::stable_sort(book_diffs.begin(), book_diffs.end(), by_arrival);
+
+    ExchangeTable exchanges;
+    std::string segments;
+    uint32_t segment_count = 0;
+    if (!tickers.empty()) {
+      EncodeTickers(tickers, exchanges, segments);
+      ++segment_count;
+    }
+    if (!trade_tickers.empty()) {
+      EncodeTradeTickers(trade_tickers, exchanges, segments);
+      ++segment_count;
+    }
+    if (!book_diffs.empty()) {
+      EncodeBookDiffs(book_diffs, exchanges, segments);
+      ++segment_count;
+    }
+
+    std::string names;
+    std::vector<uint16_t> name_lengths;
+    for (const auto& name : exchanges.names) {
+      name_lengths.push_back(static_cast<uint16_t>(name.size()));
+      names += name;
+    }
+    std::string table;
+    capture::AppendColumn(table, name_lengths);
+    capture::AppendColumn(table, std::vector<char>(names.begin(), names.end()));
+
+    capture::ChunkHeader header{};
+    header.magic = capture::CHUNK_MAGIC;
+    header.segment_count = segment_count;
+    header.size = table.size() + segments.size();
+    header.exchange_count = static_cast<uint32_t>(exchanges.names.size());
+    std::string chunk;
+    chunk.reserve(sizeof(header) + header.size);
+    capture::AppendStruct(chunk, header);
+    chunk += table;
+    chunk += segments;
+    return chunk;
+  }
+
+private:
+  struct ExchangeTable {
+    std::unordered_map<std::string, uint8_t> indices;
+    std::vector<std::string> names;
+
+    uint8_t GetIndex(const std::string& name) {
+      auto it = indices.find(name);
+      if (it != indices.end()) {
+        return it->second;
+      }
+      if (names.size() > std::numeric_limits<uint8_t>::max()) {
+        throw std::runtime_error("CaptureFileWriter: too many exchanges in one chunk");
+      }
+      uint8_t index = static_cast<uint8_t>(names.size());
+      indices.emplace(name, index);
+      names.push_back(name);
+      return index;
+    }
+  };
+
+  static void AppendSegment(capture::SegmentType type, uint32_t row_count, uint32_t extra_count,
+      const std::string& columns, std::string& out) {
+    capture::SegmentHeader header{};
+    header.type = type;
+    header.row_count = row_count;
+    header.extra_count = extra_count;
+    header.size = columns.size();
+    capture::AppendStruct(out, header);
+    out += columns;
+  }
+
+  static void EncodeTickers(const std::vector<Ticker>& tickers, ExchangeTable& exchanges, std::string& out) {
+    const size_t n = tickers.size();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<uint64_t> arrived_ts(n);
+    std::vector<int64_t> source_ts(n);
+    std::vector<double> bid(n), bid_vol(n), ask(n), ask_vol(n);
+    std::vector<uint16_t> symbol(n);
+    std::vector<uint8_t> exchange(n);
+    for (size_t i = 0; i < n; ++i) {
+      const Ticker& t = tickers[i];
+      arrived_ts[i] = t.arrived_ts;
+      source_ts[i] = t.source_ts.has_value() ? static_cast<int64_t>(t.source_ts.value()) : capture::NO_SOURCE_TS;
+      bid[i] = t.bid;
+      bid_vol[i] = t.bid_vol.value_or(nan);
+      ask[i] = t.ask;
+      ask_vol[i] = t.ask_vol.value_or(nan);
+      symbol[i] = static_cast<uint16_t>(SymbolPairId(t.symbol));
+      exchange[i] = exchanges.GetIndex(t.exchange);
+    }
+    std::string columns;
+    capture::AppendColumn(columns, arrived_ts);
+    capture::AppendColumn(columns, source_ts);
+    capture::AppendColumn(columns, bid);
+    capture::AppendColumn(columns, bid_vol);
+    capture::AppendColumn(columns, ask);
+    capture::AppendColumn(columns, ask_vol);
+    capture::AppendColumn(columns, symbol);
+    capture::AppendColumn(columns, exchange);
+    AppendSegment(capture::SegmentType::BOOK_TICKER, static_cast<uint32_t>(n), 0, columns, out);
+  }
+
+  static void EncodeTradeTickers(const std::vector<TradeTicker>& trade_tickers, ExchangeTable& exchanges, std::string& out) {
+    const size_t n = trade_tickers.size();
+    std::vector<uint64_t> arrived_ts(n), event_time(n), trade_time(n);
+    std::vector<double> price(n), qty(n);
+    std::vector<uint32_t> trade_id_offset(n + 1);
+    std::vector<uint16_t> symbol(n);
+    std::vector<uint8_t> exchange(n), is_market_maker(n);
+    std::vector<char> trade_ids;
+    for (size_t i = 0; i < n; ++i) {
+      const TradeTicker& t = trade_tickers[i];
+      arrived_ts[i] = t.arrived_ts;
+      event_time[i] = t.event_time;
+      trade_time[i] = t.trade_time;
+      price[i] = t.price;
+      qty[i] = t.qty;
+      trade_id_offset[i] = static_cast<uint32_t>(trade_ids.size());
+      trade_ids.insert(trade_ids.end(), t.trade_id.begin(), t.trade_id.end());
+      symbol[i] = static_cast<uint16_t>(SymbolPairId(t.symbol));
+      exchange[i] = exchanges.GetIndex(t.exchange);
+      is_market_maker[i] = t.is_market_maker;
+    }
+    trade_id_offset[n] = static_cast<uint32_t>(trade_ids.size());
+    std::string columns;
+    capture::AppendColumn(columns, arrived_ts);
+    capture::AppendColumn(columns, event_time);
+    capture::AppendColumn(columns, trade_time);
+    capture::AppendColumn(columns, price);
+    capture::AppendColumn(columns, qty);
+    capture::AppendColumn(columns, trade_id_offset);
+    capture::AppendColumn(columns, symbol);
+    capture::AppendColumn(columns, exchange);
+    capture::AppendColumn(columns, is_market_maker);
+    capture::AppendColumn(columns, trade_ids);
+    AppendSegment(capture::SegmentType::TRADE_TICKER, static_cast<uint32_t>(n), static_cast<uint32_t>(trade_ids.size()), columns, out);
+  }
+
+  static void EncodeBookDiffs(const std::vector<OrderBookUpdate>& book_diffs, ExchangeTable& exchanges, std::string& out) {
+    const size_t n = book_diffs.size();
+    std::vector<uint64_t> arrived_ts(n), last_update_id(n);
+    std::vector<uint32_t> bid_count(n), ask_count(n);
+    std::vector<uint16_t> symbol(n);
+    std::vector<uint8_t> exchange(n), is_snapshot(n);
+    std::vector<uint64_t> price_mantissa, volume_mantissa, timestamp;
+    std::vector<uint8_t> price_scale, volume_scale, has_timestamp;
+    auto append_level = [&](const OrderBookUpdate::Level& level) {
+      price_mantissa.push_back(level.price.GetMantissa());
+      volume_mantissa.push_back(level.volume.GetMantissa());
+      timestamp.push_back(level.timestamp.value_or(0));
+      price_scale.push_back(static_cast<uint8_t>(level.price.GetScale()));
+      volume_scale.push_back(static_cast<uint8_t>(level.volume.GetScale()));
+      has_timestamp.push_back(level.timestamp.has_value());
+    };
+    for (size_t i = 0; i < n; ++i) {
+      const OrderBookUpdate& u = book_diffs[i];
+      arrived_ts[i] = u.arrived_ts;
+      last_update_id[i] = u.last_update_id;
+      bid_count[i] = static_cast<uint32_t>(u.bids.size());
+      ask_count[i] = static_cast<uint32_t>(u.asks.size());
+      symbol[i] = static_cast<uint16_t>(u.symbol);
+      exchange[i] = exchanges.GetIndex(u.exchange);
+      is_snapshot[i] = u.is_snapshot;
+      std::for_each(u.bids.begin(), u.bids.end(), append_level);
+      std::for_each(u.asks.begin(), u.asks.end(), append_level);
+    }
+    std::string columns;
+    capture::AppendColumn(columns, arrived_ts);
+    capture::AppendColumn(columns, last_update_id);
+    capture::AppendColumn(columns, bid_count);
+    capture::AppendColumn(columns, ask_count);
+    capture::AppendColumn(columns, symbol);
+    capture::AppendColumn(columns, exchange);
+    capture::AppendColumn(columns, is_snapshot);
+    capture::AppendColumn(columns, price_mantissa);
+    capture::AppendColumn(columns, volume_mantissa);
+    capture::AppendColumn(columns, timestamp);
+    capture::AppendColumn(columns, price_scale);
+    capture::AppendColumn(columns, volume_scale);
+    capture::AppendColumn(columns, has_timestamp);
+    AppendSegment(capture::SegmentType::BOOK_DIFF, static_cast<uint32_t>(n), static_cast<uint32_t>(price_mantissa.size()), columns, out);
+  }
+
+  // m_mutex should be locked
+  void FlushIfFull() {
+    if (m_tickers.size() + m_trade_tickers.size() + m_book_diffs.size() >= m_flush_rows) {
+      FlushLocked();
+    }
+  }
+
+  // m_mutex should be locked
+  void FlushLocked() {
+    if (m_tickers.empty() && m_trade_tickers.empty() && m_book_diffs.empty()) {
+      return;
+    }
+    const std::string chunk = EncodeChunk(m_tickers, m_trade_tickers, m_book_diffs);
+    m_file.write(chunk.data(), chunk.size());
+    m_file.flush();
+    if (!m_file) {
+      BOOST_LOG_TRIVIAL(error) << "CaptureFileWriter: failed to write chunk";
+    }
+    m_tickers.clear();
+    m_trade_tickers.clear();
+    m_book_diffs.clear();
+  }
+
+private:
+  const size_t m_flush_rows;
+  std::ofstream m_file;
+  std::mutex m_mutex;
+  std::vector<Ticker> m_tickers;
+  std::vector<TradeTicker> m_trade_tickers;
+  std::vector<OrderBookUpdate> m_book_diffs;
+};
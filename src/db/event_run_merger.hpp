@@ -0,0 +1,147 @@
+#pragma once
+
+#include "model/compact_event.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <queue>
+#include <vector>
+
+/**
+ * Streaming k-way merge of event runs by arrival timestamp.
+ *
+ * Every run of a batch (eg. the events of one stored bucket) must already be in arrival order.
+ * Merging keeps one heap entry per run instead of sorting all events. Batches are added
+ * one at a time (eg. one batch per stored document as it is decoded), events of a batch can be
+ * emitted before later batches are added. As soon as all runs of a batch are consumed, the batch
+ * is cleared and handed back through TakeConsumedBatch() for reuse, even if batches added before
+ * it are still being merged, so memory is bounded by the batches whose events are pending.
+ * Ties are broken by the order in which the runs were added, which makes replay deterministic.
+ */
+class EventRunMerger {
+public:
+  /**
+   * Add a batch of runs. A run that is not in arrival order is sorted first.
+   */
+  void AddBatch(std::unique_ptr<EventBatch> batch) {
+    m_batches.push_back(Batch{std::move(batch), 0, {}});
+    Batch& added = m_batches.back();
+    added.it = std::prev(m_batches.end());
+    std::vector<CompactEvent>& events = added.batch->GetEvents();
+    for (const EventBatch::Run& run : added.batch->GetRuns()) {
+      CompactEvent* begin = events.data() + run.first;
+      CompactEvent* end = events.data() + run.second;
+      if (begin == end) {
+        continue;
+      }
+      if (!std::is_sorted(begin, end, ByArrival)) {
+        std::stable_sort(begin, end, ByArrival);
+      }
+      m_heap.push(Head{begin->arrived_ts, m_next_run_seq++, begin, end, &added});
+      ++added.active_runs;
+    }
+    if (added.active_runs == 0) {
+      Release(added);
+    }
+  }
+
+  /**
+   * Emits all events arriving before `until_ts` in arrival order.
+   *
+   * @param f called as f(const EventBatch&, const CompactEvent&)
+   * @return number of emitted events
+   */
+  template <typename F>
+  size_t PopUntil(uint64_t until_ts, F&& f) {
+    size_t emitted = 0;
+    while (!m_heap.empty() && m_heap.top().ts < until_ts) {
+      Head head = m_heap.top();
+      m_heap.pop();
+      if (head.ts < m_last_ts) {
+        // Stored in a bucket that was already replayed
+        ++m_out_of_order;
+      } else {
+        m_last_ts = head.ts;
+      }
+      f(static_cast<const EventBatch&>(*head.batch->batch), static_cast<const CompactEvent&>(*head.pos));
+      ++emitted;
+      if (++head.pos != head.end) {
+        head.ts = head.pos->arrived_ts;
+        m_heap.push(head);
+      } else if (--head.batch->active_runs == 0) {
+        Release(*head.batch);
+      }
+    }
+    return emitted;
+  }
+
+  template <typename F>
+  size_t PopAll(F&& f) {
+    return PopUntil(std::numeric_limits<uint64_t>::max(), std::forward<F>(f));
+  }
+
+  /**
+   * @return a consumed and cleared batch, or nullptr
+   */
+  std::unique_ptr<EventBatch> TakeConsumedBatch() {
+    if (m_consumed.empty()) {
+      return nullptr;
+    }
+    std::unique_ptr<EventBatch> batch = std::move(m_consumed.back());
+    m_consumed.pop_back();
+    return batch;
+  }
+
+  bool empty() const {
+    return m_heap.empty();
+  }
+
+  /**
+   * Number of events emitted after a later event, which happens only when a run
+   * added in a later batch contains events arriving before the previous batches ended.
+   */
+  uint64_t GetOutOfOrderCount() const {
+    return m_out_of_order;
+  }
+
+private:
+  struct Batch {
+    std::unique_ptr<EventBatch> batch;
+    size_t active_runs;
+    std::list<Batch>::iterator it;
+  };
+
+  struct Head {
+    uint64_t ts;
+    uint64_t run_seq;
+    CompactEvent* pos;
+    CompactEvent* end;
+    Batch* batch;
+
+    bool operator>(const Head& o) const {
+      return ts != o.ts ? ts > o.ts : run_seq > o.run_seq;
+    }
+  };
+
+  static bool ByArrival(const CompactEvent& lhs, const CompactEvent& rhs) {
+    return lhs.arrived_ts < rhs.arrived_ts;
+  }
+
+  void Release(Batch& batch) {
+    batch.batch->Clear();
+    m_consumed.push_back(std::move(batch.batch));
+    // List keeps references to the remaining batches valid
+    m_batches.erase(batch.it);
+  }
+
+  std::list<Batch> m_batches;
+  std::vector<std::unique_ptr<EventBatch>> m_consumed;
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head>> m_heap;
+  uint64_t m_next_run_seq = 0;
+  uint64_t m_last_ts = 0;
+  uint64_t m_out_of_order = 0;
+};
@@ -0,0 +1,146 @@
+#include "event_run_merger.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using namespace testing;
+
+namespace {
+
+void AddRun(EventBatch& batch, EventType type, const std::vector<uint64_t>& arrived) {
+  for (uint64_t arrived_ts : arrived) {
+    CompactEvent& event = batch.AddEvent(type, arrived_ts, "binance", SymbolPairId::ADA_USDT);
+    event.diff = CompactEvent::DiffData{0, nullptr, 0, 0};
+  }
+  batch.EndRun();
+}
+
+}
+
+TEST(EventRunMergerTest, MergeRunsTest) {
+  EventRunMerger merger;
+  auto batch = std::make_unique<EventBatch>();
+  AddRun(*batch, EventType::BOOK_TICKER, {1, 4, 7});
+  AddRun(*batch, EventType::TRADE_TICKER, {2, 4, 9});
+  AddRun(*batch, EventType::BOOK_DIFF, {3, 8});
+  merger.AddBatch(std::move(batch));
+
+  std::vector<uint64_t> arrived;
+  std::vector<EventType> types;
+  auto collect = [&](const EventBatch& batch, const CompactEvent& event) {
+    EXPECT_EQ("binance", batch.GetExchangeName(event.exchange));
+    arrived.push_back(event.arrived_ts);
+    types.push_back(event.type);
+  };
+  EXPECT_EQ(8u, merger.PopAll(collect));
+  EXPECT_THAT(arrived, ElementsAre(1, 2, 3, 4, 4, 7, 8, 9));
+  // Ties keep the order of the runs
+  EXPECT_THAT(types, ElementsAre(EventType::BOOK_TICKER, EventType::TRADE_TICKER, EventType::BOOK_DIFF,
+      EventType::BOOK_TICKER, EventType::TRADE_TICKER, EventType::BOOK_TICKER, EventType::BOOK_DIFF,
+      EventType::TRADE_TICKER));
+  EXPECT_TRUE(merger.empty());
+  EXPECT_EQ(0u, merger.GetOutOfOrderCount());
+
+  // Consumed batch is handed back cleared
+  std::unique_ptr<EventBatch> consumed = merger.TakeConsumedBatch();
+  ASSERT_NE(nullptr, consumed);
+  EXPECT_TRUE(consumed->empty());
+  EXPECT_TRUE(consumed->GetRuns().empty());
+  EXPECT_EQ(nullptr, merger.TakeConsumedBatch());
+}
+
+TEST(EventRunMergerTest, BatchBoundaryTest) {
+  EventRunMerger merger;
+  std::vector<uint64_t> arrived;
+  auto collect = [&](const EventBatch&, const CompactEvent& event) {
+    arrived.push_back(event.arrived_ts);
+  };
+
+  auto first = std::make_unique<EventBatch>();
+  // Last event arrived after the next batch starts
+  AddRun(*first, EventType::BOOK_TICKER, {10, 20, 65});
+  merger.AddBatch(std::move(first));
+  EXPECT_EQ(2u, merger.PopUntil(60, collect));
+  EXPECT_THAT(arrived, ElementsAre(10, 20));
+  // Still has events to replay
+  EXPECT_EQ(nullptr, merger.TakeConsumedBatch());
+
+  auto second = std::make_unique<EventBatch>();
+  AddRun(*second, EventType::TRADE_TICKER, {60, 70});
+  // Unsorted run
+  AddRun(*second, EventType::BOOK_DIFF, {66, 61});
+  merger.AddBatch(std::move(second));
+  EXPECT_EQ(5u, merger.PopAll(collect));
+  EXPECT_THAT(arrived, ElementsAre(10, 20, 60, 61, 65, 66, 70));
+  EXPECT_EQ(0u, merger.GetOutOfOrderCount());
+}
+
+TEST(EventRunMergerTest, OutOfOrderTest) {
+  EventRunMerger merger;
+  std::vector<uint64_t> arrived;
+  auto collect = [&](const EventBatch&, const CompactEvent& event) {
+    arrived.push_back(event.arrived_ts);
+  };
+  auto first = std::make_unique<EventBatch>();
+  AddRun(*first, EventType::BOOK_TICKER, {10, 20});
+  merger.AddBatch(std::move(first));
+  merger.PopUntil(60, collect);
+  auto second = std::make_unique<EventBatch>();
+  // Stored in a later batch than it arrived
+  AddRun(*second, EventType::BOOK_TICKER, {15, 70});
+  merger.AddBatch(std::move(second));
+  merger.PopAll(collect);
+  EXPECT_THAT(arrived, ElementsAre(10, 20, 15, 70));
+  EXPECT_EQ(1u, merger.GetOutOfOrderCount());
+}
+
+TEST(EventRunMergerTest, StreamedBatchesTest) {
+  EventRunMerger merger;
+  std::vector<uint64_t> arrived;
+  auto collect = [&](const EventBatch&, const CompactEvent& event) {
+    arrived.push_back(event.arrived_ts);
+  };
+  // One batch per stored document, added as it is decoded, documents of minute 0 span [0, 60)
+  auto ticker_doc = std::make_unique<EventBatch>();
+  AddRun(*ticker_doc, EventType::BOOK_TICKER, {10, 50});
+  merger.AddBatch(std::move(ticker_doc));
+  auto trade_doc = std::make_unique<EventBatch>();
+  AddRun(*trade_doc, EventType::TRADE_TICKER, {5, 20});
+  merger.AddBatch(std::move(trade_doc));
+  // Next document of minute 0 may still overlap
+  EXPECT_EQ(0u, merger.PopUntil(0, collect));
+
+  // First document of minute 1 arrived, everything before it is complete
+  auto next_doc = std::make_unique<EventBatch>();
+  AddRun(*next_doc, EventType::BOOK_TICKER, {60, 70});
+  EXPECT_EQ(4u, merger.PopUntil(60, collect));
+  merger.AddBatch(std::move(next_doc));
+  EXPECT_THAT(arrived, ElementsAre(5, 10, 20, 50));
+  ASSERT_NE(nullptr, merger.TakeConsumedBatch());
+  ASSERT_NE(nullptr, merger.TakeConsumedBatch());
+  EXPECT_EQ(nullptr, merger.TakeConsumedBatch());
+}
+
+TEST(EventRunMergerTest, ReleaseOutOfAddOrderTest) {
+  EventRunMerger merger;
+  auto collect = [](const EventBatch&, const CompactEvent&) {};
+  auto long_doc = std::make_unique<EventBatch>();
+  AddRun(*long_doc, EventType::BOOK_TICKER, {10, 90});
+  merger.AddBatch(std::move(long_doc));
+  auto short_doc = std::make_unique<EventBatch>();
+  AddRun(*short_doc, EventType::TRADE_TICKER, {20, 30});
+  merger.AddBatch(std::move(short_doc));
+  EXPECT_EQ(3u, merger.PopUntil(60, collect));
+  // Released although the batch added before it is still pending
+  std::unique_ptr<EventBatch> consumed = merger.TakeConsumedBatch();
+  ASSERT_NE(nullptr, consumed);
+  EXPECT_TRUE(consumed->empty());
+  EXPECT_EQ(nullptr, merger.TakeConsumedBatch());
+
+  // Batch without events is handed back right away
+  merger.AddBatch(std::make_unique<EventBatch>());
+  EXPECT_NE(nullptr, merger.TakeConsumedBatch());
+  EXPECT_EQ(1u, merger.PopAll(collect));
+  EXPECT_NE(nullptr, merger.TakeConsumedBatch());
+  EXPECT_TRUE(merger.empty());
+}
@@ -1,16 +1,28 @@
 #include "db/mongo_client.hpp"
 #include "model/ticker.h"
+#include "utils/bounded_queue.hpp"
 #include "websocket/websocket_client.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <variant>
 #include <vector>
 #include <bsoncxx/json.hpp>
 #include <mongocxx/client.hpp>
+#include <mongocxx/exception/exception.hpp>
+#include <mongocxx/model/update_one.hpp>
 #include <mongocxx/stdx.hpp>
 #include <mongocxx/uri.hpp>
 #include <mongocxx/instance.hpp>
+#include <bsoncxx/builder/basic/array.hpp>
+#include <bsoncxx/builder/basic/document.hpp>
 #include <bsoncxx/builder/stream/helpers.hpp>
 #include <bsoncxx/builder/stream/document.hpp>
 #include <bsoncxx/builder/stream/array.hpp>
@@ -23,10 +35,47 @@ using bsoncxx::builder::stream::finalize;
 using bsoncxx::builder::stream::open_array;
 using bsoncxx::builder::stream::open_document;
 
+struct MongoWriterOptions {
+    // Events waiting to be written, events arriving when the queue is full are dropped
+    size_t queue_capacity = 65536;
+    // Max time an event waits in a batch before it is written
+    std::chrono::milliseconds flush_interval{1000};
+    // Batch is written as soon as it holds this many events
+    size_t max_batch_size = 4096;
+};
+
+struct MongoWriterStats {
+    size_t queue_depth;
+    uint64_t dropped_events;
+    uint64_t written_events;
+    uint64_t flushes;
+    uint64_t last_flush_latency_us;
+    uint64_t max_flush_latency_us;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const MongoWriterStats& stats) {
+    os << "queue_depth: " << stats.queue_depth
+        << ", dropped_events: " << stats.dropped_events
+        << ", written_events: " << stats.written_events
+        << ", flushes: " << stats.flushes
+        << ", last_flush_latency_us: " << stats.last_flush_latency_us
+        << ", max_flush_latency_us: " << stats.max_flush_latency_us;
+    return os;
+}
+
+/**
+ * Stores market data events in per minute buckets, one document per (exchange, symbol, minute, type).
+ *
+ * Listener callbacks only enqueue the event, so websocket threads never wait for Mongo.
+ * A background writer coalesces queued events by bucket and writes each batch with a single
+ * unordered bulk_write, pushing all events of a bucket in one upsert.
+ */
 class MongoTickerConsumer : public ExchangeListener {
 public:
-    MongoTickerConsumer(MongoClient* mongo_client, const std::string& db_name, const std::string& coll_name)
-            : m_mongo_client(mongo_client), m_db_name(db_name), m_coll_name(coll_name) {
+    MongoTickerConsumer(MongoClient* mongo_client, const std::string& db_name, const std::string& coll_name,
+            const MongoWriterOptions& options = MongoWriterOptions())
+            : m_mongo_client(mongo_client), m_db_name(db_name), m_coll_name(coll_name), m_options(options),
+              m_queue(options.queue_capacity) {
         // Create index
         mongocxx::pool::entry client_entry = m_mongo_client->Get();
         mongocxx::client& client = *client_entry;
@@ -43,6 +92,14 @@ public:
             << "symbol" << 1
             << "type" << 1;
         coll.create_index(compound_index_builder.view(), index_options);
+
+        m_writer_thread = std::thread(&MongoTickerConsumer::Run, this);
+    }
+
+    virtual ~MongoTickerConsumer() {
+        // Writer drains the queue before exiting
+        m_running.store(false, std::memory_order_release);
+        m_writer_thread.join();
     }
 
     virtual void OnConnectionOpen(const std::string& name) override {
@@ -56,42 +113,7 @@ public:
     // This can be called from multiple threads
     virtual void OnBookTicker(const Ticker& ticker) {
         BOOST_LOG_TRIVIAL(trace) << "ExchangeListener::OnBookTicker, ticker: " << ticker;
-        mongocxx::pool::entry client_entry = m_mongo_client->Get();
-        mongocxx::client& client = *client_entry;
-        auto db = client[m_db_name];
-        auto coll = db[m_coll_name];
-
-        using namespace std::chrono;
-        microseconds us = microseconds(ticker.arrived_ts);
-        minutes mins = duration_cast<minutes>(us);
-        // Save in bucket related to arrival minute (now)
-        // Then during backtesting check what was the delay
-        // and its impact on order execution.
-        std::ostringstream symbol_name_stream;
-        symbol_name_stream << SymbolPairId(ticker.symbol);
-        coll.update_one(
-            document{}
-                << "exchange" << ticker.exchange
-                << "symbol" << symbol_name_stream.str()
-                << "minute_utc" << mins.count()
-                // TODO: put all market data stream events in one collection this way
-                << "type" << "BOOK_TICKER"
-                << finalize,
-            document{}
-                << "$push" << bsoncxx::builder::stream::open_document << "tickers"
-                << bsoncxx::builder::stream::open_document
-                << "bid" << double(ticker.bid)
-                << "bid_vol" << (ticker.bid_vol.has_value() ? ticker.bid_vol.value() : 0.0)
-                << "ask" << ticker.ask
-                << "ask_vol" << (ticker.ask_vol.has_value() ? ticker.ask_vol.value() : 0.0)
-                // Arrived timestamp in microseconds
-                << "a_us" << static_cast<int64_t>(ticker.arrived_ts)
-                // Source timestamp in microseconds
-                << "s_us" << (ticker.source_ts.has_value() ? ticker.source_ts.value() : 0.0)
-                << bsoncxx::builder::stream::close_document
-                << bsoncxx::builder::stream::close_document
-                << finalize,
-            mongocxx::options::update().upsert(true));
+        Enqueue(Event(ticker));
     }
 
     virtual void OnOrderBookUpdate(const OrderBook& order_book) {
@@ -100,111 +122,212 @@ public:
             OnBookTicker(ExchangeListener::TickerFromOrderBook(order_book));
             return;
         }
-        const OrderBookUpdate& ob_update = order_book.GetLastUpdate();
-        mongocxx::pool::entry client_entry = m_mongo_client->Get();
-        mongocxx::client& client = *client_entry;
-        auto db = client[m_db_name];
-        auto coll = db[m_coll_name];
-
-        using namespace std::chrono;
-        microseconds us = microseconds(ob_update.arrived_ts);
-        minutes mins = duration_cast<minutes>(us);
-        // Save in bucket related to arrival minute (now)
-        // Then during backtesting check what was the delay
-        // and its impact on order execution.
-        std::ostringstream symbol_name_stream;
-        symbol_name_stream << order_book.GetSymbolPairId();
-        // Build bids array
-        auto push_doc = bsoncxx::builder::basic::document{};
-        using bsoncxx::builder::basic::sub_array;
-        using bsoncxx::builder::basic::sub_document;
-        using bsoncxx::builder::basic::kvp;
-        push_doc.append(kvp("$push", [&ob_update](sub_document subdoc) {
-            subdoc.append(kvp("updates", [&ob_update](sub_document subdoc2) {
-                subdoc2.append(
-                    kvp("bids", [&ob_update](sub_array subarr) {
-                        for (const auto& bid : ob_update.bids) {
-                            subarr.append([&bid](sub_array subarr2) {
-                                subarr2.append(bid.price);
-                                subarr2.append(bid.volume);
-                                if (bid.timestamp.has_value()) {
-                                    subarr2.append(static_cast<int64_t>(bid.timestamp.value()));
-                                }
-                            });
-                        }
-                }));
-                subdoc2.append(
-                    kvp("asks", [&ob_update](sub_array subarr) {
-                        for (const auto& ask : ob_update.asks) {
-                            subarr.append([&ask](sub_array subarr2) {
-                                subarr2.append(ask.price);
-                                subarr2.append(ask.volume);
-                                if (ask.timestamp.has_value()) {
-                                    subarr2.append(static_cast<int64_t>(ask.timestamp.value()));
-                                }
-                            });
-                        }
-                }));
-                    subdoc2.append(kvp("a_us", bsoncxx::types::b_int64{ob_update.arrived_ts}));
-                    subdoc2.append(kvp("is_snapshot", bsoncxx::types::b_bool{ob_update.is_snapshot}));
-                    subdoc2.append(kvp("last_update_id", bsoncxx::types::b_int64{static_cast<int64_t>(ob_update.last_update_id)}));
-            }));
-        }));
-        BOOST_LOG_TRIVIAL(trace) << "Push: " << bsoncxx::to_json(push_doc.view());
-        coll.update_one(
-            document{}
-                << "exchange" << order_book.GetExchangeName()
-                << "symbol" << symbol_name_stream.str()
-                << "minute_utc" << mins.count()
-                << "type" << "ORDER_BOOK"
-                << finalize,
-            push_doc.view(),
-            mongocxx::options::update().upsert(true));
+        OrderBookUpdate ob_update = order_book.GetLastUpdate();
+        ob_update.exchange = order_book.GetExchangeName();
+        ob_update.symbol = order_book.GetSymbolPairId();
+        Enqueue(Event(std::move(ob_update)));
     }
 
     virtual void OnTradeTicker(const TradeTicker& ticker) {
         BOOST_LOG_TRIVIAL(debug) << "MongoTickerConsumer::OnTradeTicker, ticker: " << ticker;
-        mongocxx::pool::entry client_entry = m_mongo_client->Get();
-        mongocxx::client& client = *client_entry;
-        auto db = client[m_db_name];
-        auto coll = db[m_coll_name];
+        Enqueue(Event(ticker));
+    }
 
-        using namespace std::chrono;
-        microseconds us = microseconds(ticker.arrived_ts);
-        minutes mins = duration_cast<minutes>(us);
-        // Save in bucket related to arrival minute (now)
-        // Then during backtesting check what was the delay
-        // and its impact on order execution.
-        std::ostringstream symbol_name_stream;
-        symbol_name_stream << SymbolPairId(ticker.symbol);
-        coll.update_one(
-            document{}
-                << "exchange" << ticker.exchange
-                << "symbol" << symbol_name_stream.str()
-                << "minute_utc" << mins.count()
-                // TODO: put all market data stream events in one collection this way
-                << "type" << "TRADE_TICKER"
-                << finalize,
-            document{}
-                << "$push" << bsoncxx::builder::stream::open_document << "tickers"
-                << bsoncxx::builder::stream::open_document
-                << "event_time" << int64_t(ticker.event_time)
-                << "trade_time" << int64_t(ticker.trade_time)
-                << "trade_id" << ticker.trade_id
-                << "price" << ticker.price
-                << "qty" << ticker.qty
-                << "is_market_maker" << ticker.is_market_maker
-                // Arrived timestamp in microseconds
-                << "a_us" << static_cast<int64_t>(ticker.arrived_ts)
-                // Source timestamp in microseconds
-                << "s_us" << int64_t(ticker.trade_time)
-                << bsoncxx::builder::stream::close_document
-                << bsoncxx::builder::stream::close_document
-                << finalize,
-            mongocxx::options::update().upsert(true));
+    MongoWriterStats GetStats() const {
+        MongoWriterStats stats;
+        stats.queue_depth = m_queue.size();
+        stats.dropped_events = m_dropped_events.load(std::memory_order_relaxed);
+        stats.written_events = m_written_events.load(std::memory_order_relaxed);
+        stats.flushes = m_flushes.load(std::memory_order_relaxed);
+        stats.last_flush_latency_us = m_last_flush_latency_us.load(std::memory_order_relaxed);
+        stats.max_flush_latency_us = m_max_flush_latency_us.load(std::memory_order_relaxed);
+        return stats;
     }
+
 private:
+    typedef std::variant<Ticker, TradeTicker, OrderBookUpdate> Event;
+    // exchange, symbol, minute_utc, type
+    typedef std::tuple<std::string, std::string, int64_t, std::string> BucketKey;
+
+    void Enqueue(Event&& event) {
+        if (!m_queue.TryPush(std::move(event))) {
+            uint64_t dropped = m_dropped_events.fetch_add(1, std::memory_order_relaxed) + 1;
+            // Do not flood the log when the writer can't keep up
+            if ((dropped & (dropped - 1)) == 0) {
+                BOOST_LOG_TRIVIAL(warning) << "MongoTickerConsumer: queue full, dropped " << dropped << " events so far";
+            }
+        }
+    }
+
+    void Run() {
+        // Don't spin when there is nothing to write, but wake up often enough to respect the flush interval
+        const auto idle_sleep = std::min<std::chrono::milliseconds>(m_options.flush_interval, std::chrono::milliseconds(10));
+        auto last_flush = std::chrono::steady_clock::now();
+        Event event;
+        for (;;) {
+            const bool stopping = !m_running.load(std::memory_order_acquire);
+            size_t popped = 0;
+            while (m_pending_events < m_options.max_batch_size && m_queue.TryPop(event)) {
+                AddToBucket(event);
+                ++popped;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            if (m_pending_events >= m_options.max_batch_size || now - last_flush >= m_options.flush_interval || stopping) {
+                Flush();
+                last_flush = now;
+            }
+            if (stopping && popped == 0) {
+                break;
+            }
+            if (popped == 0) {
+                std::this_thread::sleep_for(idle_sleep);
+            }
+        }
+    }
+
+    void AddToBucket(const Event& event) {
+        std::visit([this](const auto& e) {
+            using namespace std::chrono;
+            minutes mins = duration_cast<minutes>(microseconds(e.arrived_ts));
+            // Save in bucket related to arrival minute (now)
+            // Then during backtesting check what was the delay
+            // and its impact on order execution.
+            std::ostringstream symbol_name_stream;
+            symbol_name_stream << SymbolPairId(e.symbol);
+            BucketKey key(e.exchange, symbol_name_stream.str(), mins.count(), GetType(e));
+            m_buckets[key].append(ToDocument(e));
+        }, event);
+        ++m_pending_events;
+    }
+
+    void Flush() {
+        if (m_buckets.empty()) {
+            return;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            mongocxx::pool::entry client_entry = m_mongo_client->Get();
+            mongocxx::client& client = *client_entry;
+            auto db = client[m_db_name];
+            auto coll = db[m_coll_name];
+            mongocxx::options::bulk_write bulk_options;
+            // Buckets are independent documents
+            bulk_options.ordered(false);
+            auto bulk = coll.create_bulk_write(bulk_options);
+            using bsoncxx::builder::basic::kvp;
+            using bsoncxx::builder::basic::make_document;
+            for (auto& [key, events] : m_buckets) {
+                const std::string& type = std::get<3>(key);
+                // Order book updates are pushed to "updates", tickers to "tickers"
+                const char* field = type == "ORDER_BOOK" ? "updates" : "tickers";
+                mongocxx::model::update_one upsert{
+                    make_document(
+                        kvp("exchange", std::get<0>(key)),
+                        kvp("symbol", std::get<1>(key)),
+                        kvp("minute_utc", std::get<2>(key)),
+                        kvp("type", type)),
+                    make_document(kvp("$push", make_document(kvp(field,
+                        make_document(kvp("$each", bsoncxx::types::b_array{events.view()}))))))};
+                upsert.upsert(true);
+                bulk.append(upsert);
+            }
+            bulk.execute();
+            m_written_events.fetch_add(m_pending_events, std::memory_order_relaxed);
+        } catch (const mongocxx::exception& e) {
+            BOOST_LOG_TRIVIAL(error) << "MongoTickerConsumer: failed to write " << m_pending_events << " events: " << e.what();
+        }
+        const uint64_t latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        m_last_flush_latency_us.store(latency_us, std::memory_order_relaxed);
+        if (latency_us > m_max_flush_latency_us.load(std::memory_order_relaxed)) {
+            m_max_flush_latency_us.store(latency_us, std::memory_order_relaxed);
+        }
+        m_flushes.fetch_add(1, std::memory_order_relaxed);
+        BOOST_LOG_TRIVIAL(debug) << "MongoTickerConsumer: flushed " << m_pending_events << " events in "
+            << m_buckets.size() << " buckets, took " << latency_us << " us, queue depth " << m_queue.size();
+        m_buckets.clear();
+        m_pending_events = 0;
+    }
+
+    static const char* GetType(const Ticker&) {
+        // TODO: put all market data stream events in one collection this way
+        return "BOOK_TICKER";
+    }
+
+    static const char* GetType(const TradeTicker&) {
+        return "TRADE_TICKER";
+    }
+
+    static const char* GetType(const OrderBookUpdate&) {
+        return "ORDER_BOOK";
+    }
+
+    static bsoncxx::document::value ToDocument(const Ticker& ticker) {
+        return document{}
+            << "bid" << double(ticker.bid)
+            << "bid_vol" << (ticker.bid_vol.has_value() ? ticker.bid_vol.value() : 0.0)
+            << "ask" << ticker.ask
+            << "ask_vol" << (ticker.ask_vol.has_value() ? ticker.ask_vol.value() : 0.0)
+            // Arrived timestamp in microseconds
+            << "a_us" << static_cast<int64_t>(ticker.arrived_ts)
+            // Source timestamp in microseconds
+            << "s_us" << (ticker.source_ts.has_value() ? ticker.source_ts.value() : 0.0)
+            << finalize;
+    }
+
+    static bsoncxx::document::value ToDocument(const TradeTicker& ticker) {
+        return document{}
+            << "event_time" << int64_t(ticker.event_time)
+            << "trade_time" << int64_t(ticker.trade_time)
+            << "trade_id" << ticker.trade_id
+            << "price" << ticker.price
+            << "qty" << ticker.qty
+            << "is_market_maker" << ticker.is_market_maker
+            // Arrived timestamp in microseconds
+            << "a_us" << static_cast<int64_t>(ticker.arrived_ts)
+            // Source timestamp in microseconds
+            << "s_us" << int64_t(ticker.trade_time)
+            << finalize;
+    }
+
+    static bsoncxx::document::value ToDocument(const OrderBookUpdate& ob_update) {
+        using bsoncxx::builder::basic::sub_array;
+        using bsoncxx::builder::basic::kvp;
+        auto append_levels = [](const std::vector<OrderBookUpdate::Level>& levels) {
+            return [&levels](sub_array subarr) {
+                for (const auto& level : levels) {
+                    subarr.append([&level](sub_array subarr2) {
+                        subarr2.append(level.price.ToString());
+                        subarr2.append(level.volume.ToString());
+                        if (level.timestamp.has_value()) {
+                            subarr2.append(static_cast<int64_t>(level.timestamp.value()));
+                        }
+                    });
+                }
+            };
+        };
+        auto update_doc = bsoncxx::builder::basic::document{};
+        update_doc.append(kvp("bids", append_levels(ob_update.bids)));
+        update_doc.append(kvp("asks", append_levels(ob_update.asks)));
+        update_doc.append(kvp("a_us", bsoncxx::types::b_int64{static_cast<int64_t>(ob_update.arrived_ts)}));
+        update_doc.append(kvp("is_snapshot", bsoncxx::types::b_bool{ob_update.is_snapshot}));
+        update_doc.append(kvp("last_update_id", bsoncxx::types::b_int64{static_cast<int64_t>(ob_update.last_update_id)}));
+        return update_doc.extract();
+    }
+
     MongoClient* m_mongo_client;
     std::string m_db_name;
     std::string m_coll_name;
-};
\ No newline at end of file
+    const MongoWriterOptions m_options;
+    cryptobot::BoundedQueue<Event> m_queue;
+    std::atomic<uint64_t> m_dropped_events{0};
+    std::atomic<uint64_t> m_written_events{0};
+    std::atomic<uint64_t> m_flushes{0};
+    std::atomic<uint64_t> m_last_flush_latency_us{0};
+    std::atomic<uint64_t> m_max_flush_latency_us{0};
+    // Writer thread only
+    std::map<BucketKey, bsoncxx::builder::basic::array> m_buckets;
+    size_t m_pending_events = 0;
+    std::atomic<bool> m_running{true};
+    std::thread m_writer_thread;
+};
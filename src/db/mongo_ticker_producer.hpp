@@ -1,3 +1,4 @@
+#include "db/event_run_merger.hpp"
 #include "db/mongo_client.hpp"
 #include "exchange/connection_listener.h"
 #include "exchange/exchange_listener.h"
@@ -6,8 +7,11 @@
 #include "model/real_time_event.h"
 #include "model/ticker.h"
 #include "model/trade_ticker.h"
+#include "utils/blocking_queue.hpp"
 #include "utils/string.h"
 
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
 #include <boost/log/trivial.hpp>
 
 #include <bsoncxx/json.hpp>
@@ -19,10 +23,18 @@
 #include <bsoncxx/builder/stream/document.hpp>
 #include <bsoncxx/builder/stream/array.hpp>
 
-#include <cassert>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <exception>
 #include <iterator>
 #include <limits>
-#include <variant>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
 #include <vector>
 
 using bsoncxx::builder::stream::close_array;
@@ -32,54 +44,124 @@ using bsoncxx::builder::stream::finalize;
 using bsoncxx::builder::stream::open_array;
 using bsoncxx::builder::stream::open_document;
 
-// Produces book tickers
+struct MongoProducerOptions {
+  // Threads fetching and decoding shards
+  size_t threads = 4;
+  // Minutes fetched by one query
+  int64_t shard_minutes = 1;
+  // Max shards fetched ahead of the one being replayed
+  size_t prefetch_shards = 8;
+  // Max decoded documents a shard fetch runs ahead of replay, with prefetch_shards bounds memory use
+  size_t queued_documents = 64;
+};
+
+/**
+ * Replays market data events stored by MongoTickerConsumer.
+ *
+ * The requested minute range is split into shards that are fetched and decoded
+ * on a thread pool, up to `prefetch_shards` ahead of replay. Shards are replayed
+ * in minute order on the calling thread, so decoding of the next minutes overlaps
+ * with listeners processing the current one.
+ *
+ * A shard fetch hands every stored document to replay as soon as it is decoded, through a queue
+ * of at most `queued_documents`. Events of every stored bucket are already in arrival order, so
+ * replay merges the documents with EventRunMerger instead of sorting. Documents come in minute
+ * order and buckets of the same minute overlap, so events are emitted up to the start of the minute
+ * of the latest document: events of a minute are replayed once the first document of a later
+ * minute is decoded. Memory is bounded by the documents of the minute being replayed plus the
+ * queued ones, not by the size of a shard. Events stored in a later minute than they arrived
+ * are merged late (see EventRunMerger::GetOutOfOrderCount()).
+ *
+ * Documents are decoded into compact events (see EventBatch), one batch per document, recycled
+ * as soon as its events are replayed, and listeners are fed through an EventMaterializer, so
+ * replay does not allocate per event.
+ */
 class MongoTickerProducer {
 public:
-  typedef std::vector<std::variant<Ticker, TradeTicker, OrderBookUpdate>> EventsVector;
-
   MongoTickerProducer(MongoClient* mongo_client, const std::string& db_name,
-      const std::string &coll_name)
-      : m_mongo_client(mongo_client), m_db_name(db_name), m_coll_name(coll_name) {
-
+      const std::string &coll_name, const MongoProducerOptions& options = MongoProducerOptions())
+      : m_mongo_client(mongo_client), m_db_name(db_name), m_coll_name(coll_name), m_options(options) {
+    if (m_options.threads == 0 || m_options.shard_minutes <= 0 || m_options.prefetch_shards == 0 || m_options.queued_documents == 0) {
+      throw std::invalid_argument("MongoTickerProducer: threads, shard_minutes, prefetch_shards and queued_documents must be positive");
+    }
   }
 
-  void Produce(const int64_t last_mins) {
+  int64_t Produce(const int64_t last_mins) {
     using namespace std::chrono;
     auto now = system_clock::now();
     system_clock::duration dur = now.time_since_epoch();
     minutes mins = duration_cast<minutes>(dur);
-    Produce(mins.count() - last_mins, mins.count());
+    return Produce(mins.count() - last_mins, mins.count());
   }
 
-  void Produce(const int64_t from_min, const int64_t to_min) {
-    mongocxx::pool::entry client_entry = m_mongo_client->Get();
-    mongocxx::client& client = *client_entry;
-    auto db = client[m_db_name];
-    auto coll = db[m_coll_name];
-    mongocxx::options::find opts;
-    // It is best to also make sure there is an ascending index for minute_utc
-    opts.sort(document{} << "minute_utc" << 1 << finalize);
-    // Get Mongo cursor
-    mongocxx::cursor cursor = coll.find(document{} << "minute_utc"
-        << open_document
-        << "$gte" << from_min
-        << "$lt" << to_min
-        << close_document << finalize,
-        opts);
-    Produce(cursor);
+  /**
+   * Replays events of minutes [from_min, to_min).
+   *
+   * @return number of replayed events
+   */
+  int64_t Produce(const int64_t from_min, const int64_t to_min) {
+    boost::asio::thread_pool pool(m_options.threads);
+    std::deque<std::unique_ptr<Shard>> shards;
+    int64_t next_min = from_min;
+    auto schedule = [&]() {
+      while (next_min < to_min && shards.size() < m_options.prefetch_shards) {
+        const int64_t shard_from = next_min;
+        const int64_t shard_to = std::min(next_min + m_options.shard_minutes, to_min);
+        shards.push_back(std::make_unique<Shard>(shard_to, m_options.queued_documents));
+        ShardQueue* queue = &shards.back()->queue;
+        // Pool runs fetches in the order they were posted, so the shard being replayed is always fetched
+        boost::asio::post(pool, [this, shard_from, shard_to, queue]() {
+          FetchShard(shard_from, shard_to, *queue);
+        });
+        next_min = shard_to;
+      }
+    };
+
+    auto dispatch = [this](const EventBatch& batch, const CompactEvent& event) {
+      m_materializer.Visit(batch, event, [this](const auto& e) {
+        Dispatch(e);
+      });
+    };
+    EventRunMerger merger;
+    int64_t total_tickers = 0;
+    try {
+      schedule();
+      while (!shards.empty()) {
+        // Rethrows fetch errors
+        while (std::optional<ShardDocument> doc = shards.front()->queue.Pop()) {
+          // Documents of earlier minutes are all merged
+          total_tickers += merger.PopUntil(MinuteToMicroseconds(doc->minute), dispatch);
+          merger.AddBatch(std::move(doc->batch));
+          RecycleBatches(merger);
+        }
+        BOOST_LOG_TRIVIAL(info) << "Fetched tickers until minute " << shards.front()->to_min << "... " << total_tickers;
+        shards.pop_front();
+        schedule();
+      }
+    } catch (...) {
+      // Stop fetches blocked on full queues before waiting for them
+      for (auto& shard : shards) {
+        shard->queue.Close();
+      }
+      pool.join();
+      throw;
+    }
+    total_tickers += merger.PopAll(dispatch);
+    RecycleBatches(merger);
+    pool.join();
+    if (merger.GetOutOfOrderCount() > 0) {
+      BOOST_LOG_TRIVIAL(warning) << merger.GetOutOfOrderCount() << " events were stored in a later minute than they arrived";
+    }
+    return total_tickers;
   }
 
   int64_t Produce() {
-    mongocxx::pool::entry client_entry = m_mongo_client->Get();
-    mongocxx::client& client = *client_entry;
-    auto db = client[m_db_name];
-    auto coll = db[m_coll_name];
-    mongocxx::options::find opts;
-    // It is best to also make sure there is an ascending index for minute_utc
-    opts.sort(document{} << "minute_utc" << 1 << finalize);
-    // Get Mongo cursor
-    mongocxx::cursor cursor = coll.find({}, opts);
-    return Produce(cursor);
+    std::optional<int64_t> first_min = GetBoundaryMinute(1);
+    std::optional<int64_t> last_min = GetBoundaryMinute(-1);
+    if (!first_min.has_value() || !last_min.has_value()) {
+      return 0;
+    }
+    return Produce(first_min.value(), last_min.value() + 1);
   }
 
   void Register(ExchangeListener* exchange_listener) {
@@ -97,174 +179,220 @@ public:
     }
   }
 private:
+  struct ShardDocument {
+    int64_t minute;
+    std::unique_ptr<EventBatch> batch;
+  };
 
-  int64_t Produce(mongocxx::cursor& cursor) {
-    // Put all tickers in a vector
-    EventsVector events_vec;
-    // std::holds_alternative<std::string>(v)
-    int64_t prev_min_bucket = 0;
-    int64_t total_tickers = 0;
-    for(auto doc : cursor) {
-      // std::getchar();
-      // std::cout << bsoncxx::to_json(doc) << "\n";
-      bsoncxx::document::element minute_utc_elem = doc["minute_utc"];
-      int64_t minute_utc = minute_utc_elem.get_int64().value;
-      if (prev_min_bucket == 0) {
-        prev_min_bucket = minute_utc;
-      }
-      if (minute_utc > prev_min_bucket) {
-        total_tickers += events_vec.size();
-        BOOST_LOG_TRIVIAL(info) << "Flushing tickers for minute " << prev_min_bucket << "... " << total_tickers;
-        FlushEvents(events_vec);
-      }
+  typedef cryptobot::BlockingQueue<ShardDocument> ShardQueue;
 
-      //bsoncxx::document::element exchange_elem = doc["exchange"];
-      bsoncxx::document::element type_elem = doc["type"];
-      const std::string& type = type_elem.get_value().get_utf8().value.to_string();
+  struct Shard {
+    Shard(int64_t to_min, size_t queued_documents) : to_min(to_min), queue(queued_documents) {}
 
-      if (type == "BOOK_TICKER") {
-        PushBookTickers(doc, events_vec);
-      } else if (type == "TRADE_TICKER") {
-        PushTradeTickers(doc, events_vec);
-      } else if (type == "ORDER_BOOK") {
-        PushOrderBookUpdates(doc, events_vec);
-      } else {
-        BOOST_LOG_TRIVIAL(error) << "Unsupported event";
-      }
+    const int64_t to_min;
+    ShardQueue queue;
+  };
 
-      assert(minute_utc >= prev_min_bucket);
-      prev_min_bucket = minute_utc;
+  /**
+   * @param direction 1 for the first minute in the collection, -1 for the last one
+   */
+  std::optional<int64_t> GetBoundaryMinute(int direction) const {
+    mongocxx::pool::entry client_entry = m_mongo_client->Get();
+    mongocxx::client& client = *client_entry;
+    auto coll = client[m_db_name][m_coll_name];
+    mongocxx::options::find opts;
+    // It is best to also make sure there is an ascending index for minute_utc
+    opts.sort(document{} << "minute_utc" << direction << finalize);
+    opts.projection(document{} << "minute_utc" << 1 << finalize);
+    auto doc = coll.find_one({}, opts);
+    if (!doc) {
+      return std::nullopt;
     }
-    return total_tickers;
-    
+    return doc->view()["minute_utc"].get_int64().value;
+  }
+
+  static uint64_t MinuteToMicroseconds(const int64_t minute) {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(minutes(minute)).count();
   }
 
-  void FlushEvents(EventsVector& events_vec) {
-    // std::sort(events_vec.begin(), events_vec.end(), [](const auto& lhs, const auto& rhs) -> bool {
-    //   // Here we assume ticks always arrive in the right order
-    //   // In strategy part we can verify it and compare source timestamps and arrived timestamps
-    //   return a.arrived_ts < b.arrived_ts;
-    // });
-    std::sort(std::begin(events_vec), std::end(events_vec),
-    [](auto const& lhs, auto const& rhs)
-    {
-        return std::visit([](auto const& x, auto const& y){
-            return x.arrived_ts < y.arrived_ts;
-        }, lhs, rhs);
-    });
-    std::for_each(events_vec.begin(), events_vec.end(), [&](const auto& obj) {
-      for (const auto& listener_ptr : m_exchange_listeners) {
-        if (std::holds_alternative<Ticker>(obj)) {
-          listener_ptr->OnBookTicker(std::get<Ticker>(obj));
-        } else if (std::holds_alternative<TradeTicker>(obj)) {
-          listener_ptr->OnTradeTicker(std::get<TradeTicker>(obj));
-        } else if (std::holds_alternative<OrderBookUpdate>(obj)) {
-          const auto& ob_update = std::get<OrderBookUpdate>(obj);
-          OrderBook& ob = GetOrCreateOrderBook(ob_update);
-          ob.Update(ob_update);
-          listener_ptr->OnOrderBookUpdate(ob);
+  /**
+   * Called from pool threads. Pushes a batch with the run of every stored bucket in minute order,
+   * closes the queue at the end or with the fetch error, stops if replay closed it.
+   */
+  void FetchShard(const int64_t from_min, const int64_t to_min, ShardQueue& queue) {
+    try {
+      mongocxx::pool::entry client_entry = m_mongo_client->Get();
+      mongocxx::client& client = *client_entry;
+      auto coll = client[m_db_name][m_coll_name];
+      mongocxx::options::find opts;
+      // Replay relies on the minute order, see GetBoundaryMinute() about the index
+      opts.sort(document{} << "minute_utc" << 1 << finalize);
+      mongocxx::cursor cursor = coll.find(document{} << "minute_utc"
+          << open_document
+          << "$gte" << from_min
+          << "$lt" << to_min
+          << close_document << finalize, opts);
+      for (auto doc : cursor) {
+        std::unique_ptr<EventBatch> batch = AcquireBatch();
+        bsoncxx::document::element type_elem = doc["type"];
+        const std::string& type = type_elem.get_value().get_utf8().value.to_string();
+
+        if (type == "BOOK_TICKER") {
+          PushBookTickers(doc, *batch);
+        } else if (type == "TRADE_TICKER") {
+          PushTradeTickers(doc, *batch);
+        } else if (type == "ORDER_BOOK") {
+          PushOrderBookUpdates(doc, *batch);
         } else {
-          BOOST_LOG_TRIVIAL(error) << "Unsupported event in events vector. Impossible!";
+          BOOST_LOG_TRIVIAL(error) << "Unsupported event";
+        }
+        batch->EndRun();
+        if (!queue.Push(ShardDocument{doc["minute_utc"].get_int64().value, std::move(batch)})) {
+          // Replay stopped
+          return;
         }
       }
-    });
-    events_vec.clear();
+      queue.Close();
+    } catch (...) {
+      queue.Close(std::current_exception());
+    }
+  }
+
+  std::unique_ptr<EventBatch> AcquireBatch() {
+    std::scoped_lock<std::mutex> lock{m_free_batches_mutex};
+    if (m_free_batches.empty()) {
+      return std::make_unique<EventBatch>();
+    }
+    std::unique_ptr<EventBatch> batch = std::move(m_free_batches.back());
+    m_free_batches.pop_back();
+    return batch;
+  }
+
+  void RecycleBatches(EventRunMerger& merger) {
+    std::scoped_lock<std::mutex> lock{m_free_batches_mutex};
+    while (std::unique_ptr<EventBatch> batch = merger.TakeConsumedBatch()) {
+      m_free_batches.push_back(std::move(batch));
+    }
+  }
+
+  void Dispatch(const Ticker& ticker) {
+    for (const auto& listener_ptr : m_exchange_listeners) {
+      listener_ptr->OnBookTicker(ticker);
+    }
   }
 
-  void PushBookTickers(const bsoncxx::document::view& doc, EventsVector& events_vec) {
-    bsoncxx::document::element exchange_elem = doc["exchange"];
+  void Dispatch(const TradeTicker& trade_ticker) {
+    for (const auto& listener_ptr : m_exchange_listeners) {
+      listener_ptr->OnTradeTicker(trade_ticker);
+    }
+  }
+
+  void Dispatch(const OrderBookUpdate& ob_update) {
+    OrderBook& ob = GetOrCreateOrderBook(ob_update);
+    ob.Update(ob_update);
+    for (const auto& listener_ptr : m_exchange_listeners) {
+      listener_ptr->OnOrderBookUpdate(ob);
+    }
+  }
+
+  static std::string_view GetExchange(const bsoncxx::document::view& doc) {
+    auto exchange = doc["exchange"].get_utf8().value;
+    return std::string_view(exchange.data(), exchange.size());
+  }
+
+  static void PushBookTickers(const bsoncxx::document::view& doc, EventBatch& batch) {
+    std::string_view exchange = GetExchange(doc);
     SymbolPairId symbol = GetSymbol(doc);
     bsoncxx::document::element tickers_elem = doc["tickers"];
     bsoncxx::types::b_array arr = tickers_elem.get_array();
 
     for (bsoncxx::array::element ticker_doc : arr.value) {
-      Ticker ticker;
       if (ticker_doc["bid"].type() != bsoncxx::type::k_double) {
         BOOST_LOG_TRIVIAL(warning) << "Bid value does not have double type! The type is " << int(ticker_doc["bid"].type());
         continue;
       }
-      ticker.bid = ticker_doc["bid"].get_double();
-      ticker.bid_vol = ticker_doc["bid_vol"].get_double();
-      ticker.ask = ticker_doc["ask"].get_double();
-      ticker.ask_vol = ticker_doc["ask_vol"].get_double();
-      // if (ticker_doc["s_us"].type() == bsoncxx::type::k_int64) {
-      //   ticker.source_ts = ticker_doc["s_us"].get_int64().value;
-      // } else {
-      //   BOOST_LOG_TRIVIAL(debug) << "Source timestamp value does not have int64 type! The type is " << int(ticker_doc["s_us"].type());
-      // }
-      ticker.source_ts = std::nullopt;
-      ticker.arrived_ts = static_cast<uint64_t>(ticker_doc["a_us"].get_int64().value);
-      ticker.exchange = exchange_elem.get_value().get_utf8().value.to_string();
-      ticker.symbol = symbol;
-      //BOOST_LOG_TRIVIAL(info) << "Ticker: " << ticker;
-      events_vec.push_back(ticker);
-      // std::cout << "Added ticker:" << std::endl;
-      // std::cout << ticker;
+      const uint64_t arrived_ts = static_cast<uint64_t>(ticker_doc["a_us"].get_int64().value);
+      CompactEvent& event = batch.AddEvent(EventType::BOOK_TICKER, arrived_ts, exchange, symbol);
+      event.ticker.bid = ticker_doc["bid"].get_double();
+      event.ticker.bid_vol = ticker_doc["bid_vol"].get_double();
+      event.ticker.ask = ticker_doc["ask"].get_double();
+      event.ticker.ask_vol = ticker_doc["ask_vol"].get_double();
+      event.flags = CompactEvent::HAS_BID_VOL | CompactEvent::HAS_ASK_VOL;
+      event.SetSourceTs(GetSourceTs(ticker_doc));
     }
   }
 
-  void PushTradeTickers(const bsoncxx::document::view& doc, EventsVector& events_vec) {
-    bsoncxx::document::element exchange_elem = doc["exchange"];
-    std::string exchange = exchange_elem.get_value().get_utf8().value.to_string();
+  // MongoTickerConsumer stores the source timestamp of book tickers as a double, 0 if the exchange has none
+  static uint64_t GetSourceTs(const bsoncxx::array::element& ticker_doc) {
+    bsoncxx::document::element s_us = ticker_doc["s_us"];
+    switch (s_us.type()) {
+      case bsoncxx::type::k_double:
+        return s_us.get_double().value > 0 ? static_cast<uint64_t>(s_us.get_double().value) : 0;
+      case bsoncxx::type::k_int64:
+        return s_us.get_int64().value > 0 ? static_cast<uint64_t>(s_us.get_int64().value) : 0;
+      default:
+        return 0;
+    }
+  }
+
+  static void PushTradeTickers(const bsoncxx::document::view& doc, EventBatch& batch) {
+    std::string_view exchange = GetExchange(doc);
     SymbolPairId symbol = GetSymbol(doc);
     bsoncxx::document::element tickers_elem = doc["tickers"];
     bsoncxx::types::b_array arr = tickers_elem.get_array();
 
     for (bsoncxx::array::element ticker_doc : arr.value) {
-      TradeTicker trade_ticker;
-      trade_ticker.symbol = symbol;
-      trade_ticker.exchange = exchange;
-      trade_ticker.event_time = static_cast<uint64_t>(ticker_doc["event_time"].get_int64().value);
-      trade_ticker.trade_time = static_cast<uint64_t>(ticker_doc["trade_time"].get_int64().value);
-      trade_ticker.trade_id = ticker_doc["trade_id"].get_utf8().value.to_string();
-      trade_ticker.price = ticker_doc["price"].get_double();
-      trade_ticker.qty = ticker_doc["qty"].get_double();
-      trade_ticker.is_market_maker = ticker_doc["is_market_maker"].get_bool();
-      trade_ticker.arrived_ts = static_cast<uint64_t>(ticker_doc["a_us"].get_int64().value);
-      events_vec.push_back(trade_ticker);
+      const uint64_t arrived_ts = static_cast<uint64_t>(ticker_doc["a_us"].get_int64().value);
+      CompactEvent& event = batch.AddEvent(EventType::TRADE_TICKER, arrived_ts, exchange, symbol);
+      event.trade.event_time = static_cast<uint64_t>(ticker_doc["event_time"].get_int64().value);
+      event.trade.trade_time = static_cast<uint64_t>(ticker_doc["trade_time"].get_int64().value);
+      event.trade.price = ticker_doc["price"].get_double();
+      event.trade.qty = ticker_doc["qty"].get_double();
+      event.flags = ticker_doc["is_market_maker"].get_bool() ? CompactEvent::IS_MARKET_MAKER : 0;
+      auto trade_id = ticker_doc["trade_id"].get_utf8().value;
+      batch.SetTradeId(event, std::string_view(trade_id.data(), trade_id.size()));
     }
   }
 
-  void PushOrderBookUpdates(const bsoncxx::document::view& doc, EventsVector& events_vec) {
-    bsoncxx::document::element exchange_elem = doc["exchange"];
-    const auto& exchange = exchange_elem.get_value().get_utf8().value.to_string();
+  static void PushOrderBookUpdates(const bsoncxx::document::view& doc, EventBatch& batch) {
+    std::string_view exchange = GetExchange(doc);
     SymbolPairId symbol = GetSymbol(doc);
     bsoncxx::types::b_array updates_arr = doc["updates"].get_array();
 
     for (bsoncxx::array::element update_doc : updates_arr.value) {
-      OrderBookUpdate ob_update;
-      ob_update.exchange = exchange;
-      ob_update.symbol = symbol;
+      const uint64_t arrived_ts = static_cast<uint64_t>(update_doc["a_us"].get_int64().value);
       bsoncxx::array::view bids_arr = update_doc["bids"].get_array();
-      for (bsoncxx::array::element bid_doc : bids_arr) {
-        bsoncxx::array::view bid_arr = bid_doc.get_array();
-        OrderBookUpdate::Level level;
-        level.price = bid_arr[0].get_utf8().value.to_string();
-        level.volume = bid_arr[1].get_utf8().value.to_string();
-        if (std::distance(bid_arr.begin(), bid_arr.end()) > 2) {
-          level.timestamp = static_cast<uint64_t>(bid_arr[2].get_int64().value);
-        }
-        ob_update.bids.push_back(level);
-      }
       bsoncxx::array::view asks_arr = update_doc["asks"].get_array();
-      for (bsoncxx::array::element ask_doc : asks_arr) {
-        bsoncxx::array::view ask_arr = ask_doc.get_array();
-        OrderBookUpdate::Level level;
-        level.price = ask_arr[0].get_utf8().value.to_string();
-        level.volume = ask_arr[1].get_utf8().value.to_string();
-        if (std::distance(ask_arr.begin(), ask_arr.end()) > 2) {
-          level.timestamp = static_cast<uint64_t>(ask_arr[2].get_int64().value);
+      const size_t bid_count = std::distance(bids_arr.begin(), bids_arr.end());
+      const size_t ask_count = std::distance(asks_arr.begin(), asks_arr.end());
+      OrderBookUpdate::Level* levels = batch.AllocateLevels(bid_count + ask_count);
+      OrderBookUpdate::Level* level = levels;
+      for (const bsoncxx::array::view& side_arr : {bids_arr, asks_arr}) {
+        for (bsoncxx::array::element level_doc : side_arr) {
+          bsoncxx::array::view level_arr = level_doc.get_array();
+          std::optional<uint64_t> timestamp;
+          if (std::distance(level_arr.begin(), level_arr.end()) > 2) {
+            timestamp = static_cast<uint64_t>(level_arr[2].get_int64().value);
+          }
+          new (level++) OrderBookUpdate::Level{ParseDecimal(level_arr[0]), ParseDecimal(level_arr[1]), timestamp};
         }
-        ob_update.asks.push_back(level);
       }
-      ob_update.last_update_id = static_cast<uint64_t>(update_doc["last_update_id"].get_int64().value);
-      ob_update.is_snapshot = update_doc["is_snapshot"].get_bool();
-      ob_update.arrived_ts = static_cast<uint64_t>(update_doc["a_us"].get_int64().value);
-      events_vec.push_back(ob_update);
+      CompactEvent& event = batch.AddEvent(EventType::BOOK_DIFF, arrived_ts, exchange, symbol);
+      event.diff.last_update_id = static_cast<uint64_t>(update_doc["last_update_id"].get_int64().value);
+      event.diff.levels = levels;
+      event.diff.bid_count = static_cast<uint32_t>(bid_count);
+      event.diff.ask_count = static_cast<uint32_t>(ask_count);
+      event.flags = update_doc["is_snapshot"].get_bool() ? CompactEvent::IS_SNAPSHOT : 0;
     }
   }
 
-  SymbolPairId GetSymbol(const bsoncxx::document::view& doc) const {
+  static Decimal ParseDecimal(const bsoncxx::array::element& elem) {
+    auto str = elem.get_utf8().value;
+    return Decimal::Parse(std::string_view(str.data(), str.size()));
+  }
+
+  static SymbolPairId GetSymbol(const bsoncxx::document::view& doc) {
     if (doc["symbol"].type() == bsoncxx::type::k_int32) {
       return SymbolPairId(doc["symbol"].get_int32().value);
     } else if (doc["symbol"].type() == bsoncxx::type::k_int64) { 
@@ -285,13 +413,18 @@ private:
     }
 
     // TODO: configurable depth
-    m_order_books.emplace_back(update.exchange, update.symbol, 1000, PrecisionSettings(cryptobot::precision_from_string(update.bids[0].price), cryptobot::precision_from_string(update.bids[0].volume), 3));
+    m_order_books.emplace_back(update.exchange, update.symbol, 1000, PrecisionSettings(update.bids[0].price.GetPrecision(), update.bids[0].volume.GetPrecision(), 3));
     return m_order_books[m_order_books.size() - 1];
   }
 
   MongoClient* m_mongo_client;
   const std::string m_db_name;
   const std::string m_coll_name;
+  const MongoProducerOptions m_options;
+  // Consumed batches, reused by shard fetches to avoid allocating event memory again
+  std::mutex m_free_batches_mutex;
+  std::vector<std::unique_ptr<EventBatch>> m_free_batches;
+  EventMaterializer m_materializer;
   std::vector<OrderBook> m_order_books;
   std::vector<ExchangeListener*> m_exchange_listeners;
 };
\ No newline at end of file
@@ -8,12 +8,14 @@
 
 #include <atomic>
 #include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <unordered_set>
 
 AccountManagerImpl::AccountManagerImpl(ExchangeClient* exchange_client)
-    : m_client(exchange_client), m_account_refresher(this), m_is_account_synced(false) {
+    : m_client(exchange_client), m_orders_in_flight(0), m_account_refresher(this), m_is_account_synced(false) {
 }
 
 AccountManagerImpl::~AccountManagerImpl() {
@@ -65,7 +67,7 @@ void AccountManagerImpl::RefreshAccountBalance() {
   m_account_balance_lock.lock();
   BOOST_LOG_TRIVIAL(debug) << GetExchange() + " - account balance after refresh: " << m_account_balance;
   m_account_balance_lock.unlock();
-  m_is_account_synced = true;
+  m_is_account_synced = m_orders_in_flight == 0;
 }
 
 std::string AccountManagerImpl::GetExchange() {
@@ -89,7 +91,7 @@ Result<Order> AccountManagerImpl::MarketOrder(SymbolPairId symbol, Side side, do
     AddLockedBalance(order);
     BOOST_LOG_TRIVIAL(debug) << "Account balance after placing market order: " << m_account_balance;
   }
-  m_is_account_synced = true;
+  m_is_account_synced = m_orders_in_flight == 0;
   return res;
 }
 
@@ -97,19 +99,43 @@ Result<Order> AccountManagerImpl::LimitOrder(SymbolPairId symbol, Side side, dou
   std::scoped_lock<std::mutex> order_lock{m_order_mutex};
   m_is_account_synced = false;
   auto res = m_client->LimitOrder(symbol, side, qty, price);
-  if (res) {
-    auto& order = res.Get();
-    order.SetPrice(price);
-    m_our_orders_lock.lock();
-    m_our_orders.insert_or_assign(order.GetId(), std::move(order));
-    m_our_orders_lock.unlock();
-    AddLockedBalance(order);
-    BOOST_LOG_TRIVIAL(debug) << "Account balance after placing limit order: " << m_account_balance;
-  }
-  m_is_account_synced = true;
+  AddLimitOrder(res, price);
+  m_is_account_synced = m_orders_in_flight == 0;
   return res;
 }
 
+std::future<Result<Order>> AccountManagerImpl::LimitOrderAsync(SymbolPairId symbol, Side side, double qty, double price) {
+  // The order is marked in flight instead of keeping m_order_mutex locked until the response is handled,
+  // updates for orders we do not know yet are deferred until then (see OnOrderUpdate())
+  {
+    std::scoped_lock<std::mutex> order_lock{m_order_mutex};
+    ++m_orders_in_flight;
+    m_is_account_synced = false;
+  }
+  std::future<Result<Order>> response;
+  try {
+    response = m_client->LimitOrderAsync(symbol, side, qty, price);
+  } catch (...) {
+    std::scoped_lock<std::mutex> order_lock{m_order_mutex};
+    FinishOrderInFlight();
+    throw;
+  }
+  return std::async(std::launch::deferred, [this, response = std::move(response), price]() mutable {
+    std::optional<Result<Order>> res;
+    try {
+      res.emplace(response.get());
+    } catch (...) {
+      std::scoped_lock<std::mutex> order_lock{m_order_mutex};
+      FinishOrderInFlight();
+      throw;
+    }
+    std::scoped_lock<std::mutex> order_lock{m_order_mutex};
+    AddLimitOrder(*res, price);
+    FinishOrderInFlight();
+    return std::move(*res);
+  });
+}
+
 Result<Order> AccountManagerImpl::SendOrder(const Order&) {
   throw std::runtime_error("AccountManagerImpl::SendOrder is not implemented");
 }
@@ -162,27 +188,8 @@ void AccountManagerImpl::OnOrderUpdate(const Order& order_update) {
       BOOST_LOG_TRIVIAL(warning) << "Order for unknown pair!";
       return;
   }
-  {
-    std::scoped_lock<std::mutex> order_lock{m_order_mutex};
-    // TODO: remove m_our_orders_lock ?
-    m_our_orders_lock.lock();
-    auto it_our = m_our_orders.find(order_update.GetId());
-    bool is_our = it_our != m_our_orders.end();
-    m_our_orders_lock.unlock();
-    if (!is_our) {
-      BOOST_LOG_TRIVIAL(info) << "Update for order, which did not originate from here";
-      HandleExternalOrder(order_update);
-    } else {
-      m_our_orders_lock.lock();
-      Order& order = it_our->second;
-      BOOST_LOG_TRIVIAL(trace) << "AccountManagerImpl::UpdateOurOrder";
-      UpdateOurOrder(order_update, order);
-      m_our_orders_lock.unlock();
-    }
-    m_account_balance_lock.lock();
-    BOOST_LOG_TRIVIAL(debug) << "Account balance after order update: " << m_account_balance;
-    m_account_balance_lock.unlock();
-  }
+  std::scoped_lock<std::mutex> order_lock{m_order_mutex};
+  ApplyOrderUpdate(order_update, m_orders_in_flight > 0);
 }
 
 bool AccountManagerImpl::HasOpenOrders() {
@@ -267,6 +274,59 @@ void AccountManagerImpl::UpdateOurOrder(const Order& order_update, Order& order)
   }
 }
 
+bool AccountManagerImpl::ApplyOrderUpdate(const Order& order_update, bool defer_unknown) {
+  // TODO: remove m_our_orders_lock ?
+  m_our_orders_lock.lock();
+  auto it_our = m_our_orders.find(order_update.GetId());
+  bool is_our = it_our != m_our_orders.end();
+  m_our_orders_lock.unlock();
+  if (!is_our && defer_unknown) {
+    BOOST_LOG_TRIVIAL(debug) << "Deferring update for unknown order until placed orders are registered";
+    m_deferred_updates.push_back(order_update);
+    return false;
+  }
+  if (!is_our) {
+    BOOST_LOG_TRIVIAL(info) << "Update for order, which did not originate from here";
+    HandleExternalOrder(order_update);
+  } else {
+    m_our_orders_lock.lock();
+    Order& order = it_our->second;
+    BOOST_LOG_TRIVIAL(trace) << "AccountManagerImpl::UpdateOurOrder";
+    UpdateOurOrder(order_update, order);
+    m_our_orders_lock.unlock();
+  }
+  m_account_balance_lock.lock();
+  BOOST_LOG_TRIVIAL(debug) << "Account balance after order update: " << m_account_balance;
+  m_account_balance_lock.unlock();
+  return true;
+}
+
+void AccountManagerImpl::FinishOrderInFlight() {
+  bool last = --m_orders_in_flight == 0;
+  // Replay in the order received, updates of orders that are still unknown are kept unless
+  // no other order is in flight
+  std::vector<Order> deferred_updates;
+  deferred_updates.swap(m_deferred_updates);
+  for (const Order& order_update : deferred_updates) {
+    ApplyOrderUpdate(order_update, !last);
+  }
+  if (last) {
+    m_is_account_synced = true;
+  }
+}
+
+void AccountManagerImpl::AddLimitOrder(Result<Order>& res, double price) {
+  if (res) {
+    auto& order = res.Get();
+    order.SetPrice(price);
+    m_our_orders_lock.lock();
+    m_our_orders.insert_or_assign(order.GetId(), std::move(order));
+    m_our_orders_lock.unlock();
+    AddLockedBalance(order);
+    BOOST_LOG_TRIVIAL(debug) << "Account balance after placing limit order: " << m_account_balance;
+  }
+}
+
 void AccountManagerImpl::HandleExternalOrder(const Order& order) {
   m_external_orders_lock.lock();
   auto it = m_external_orders.find(order.GetId());
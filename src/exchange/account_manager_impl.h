@@ -8,9 +8,11 @@
 
 #include <atomic>
 #include <functional>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <unordered_set>
+#include <vector>
 
 class AccountManagerImpl : public AccountManager, public UserDataListener {
 public:
@@ -51,6 +53,9 @@ public:
 
   virtual Result<Order> LimitOrder(SymbolPairId symbol, Side side, double qty, double price) override;
 
+  // The order is sent at once, the result has to be got (on any thread) for the order to be registered
+  virtual std::future<Result<Order>> LimitOrderAsync(SymbolPairId symbol, Side side, double qty, double price) override;
+
   virtual Result<Order> SendOrder(const Order& order) override;
 
   // UserDataListener
@@ -67,6 +72,15 @@ protected:
   // m_our_orders_lock should be locked
   void UpdateOurOrder(const Order& order_update, Order& order);
 
+  // Registers the placed order, m_order_mutex should be locked
+  void AddLimitOrder(Result<Order>& res, double price);
+
+  // Returns false if the update was deferred, m_order_mutex should be locked
+  bool ApplyOrderUpdate(const Order& order_update, bool defer_unknown);
+
+  // Handles the end of an asynchronous order request and replays deferred updates, m_order_mutex should be locked
+  void FinishOrderInFlight();
+
   void HandleExternalOrder(const Order& order);
 
   void AddLockedBalance(const Order& order);
@@ -94,6 +108,10 @@ protected:
   // 3. Response from order request is received and order is added to m_our_orders.
   // 4. The balance has locked amount, which will never be freed.
   std::mutex m_order_mutex;
+  // Asynchronous order requests without handled response, guarded by m_order_mutex. While there are any,
+  // updates for unknown orders are kept in m_deferred_updates instead of being handled as external orders.
+  size_t m_orders_in_flight;
+  std::vector<Order> m_deferred_updates;
   AccountRefresher m_account_refresher;
   std::atomic<bool> m_is_account_synced;
 };
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+#include <optional>
+#include <thread>
+
 using namespace testing;
 
 class MockExchangeClient : public ExchangeClient {
@@ -49,4 +52,79 @@ TEST(AccountManagerTest, OnOrderUpdateTest) {
   EXPECT_NEAR(-50.0, usdt_balance, std::numeric_limits<double>::min());
 }
 
-// TODO: more tests, this is very stateful and thus pretty complex class
\ No newline at end of file
+// TODO: more tests, this is very stateful and thus pretty complex class
+TEST(AccountManagerTest, LimitOrderAsyncTest) {
+  std::unique_ptr<MockExchangeClient> mec{new MockExchangeClient()};
+  AccountManagerImpl account_manager{mec.get()};
+
+  Order new_order = Order::CreateBuilder()
+      .Id("TEST_ID")
+      .ClientId("")
+      .Symbol(SymbolPairId::BTC_USDT)
+      .Side_(Side::BUY)
+      .OrderType_(OrderType::LIMIT)
+      .Quantity(0.001)
+      .OrderStatus_(OrderStatus::NEW)
+      .Build();
+  EXPECT_CALL(*mec.get(), LimitOrder(_, _, _, _))
+    .Times(1)
+    .WillOnce(Return(Result<Order>("", new_order)));
+  auto future = account_manager.LimitOrderAsync(SymbolPairId::BTC_USDT, Side::BUY, 0.001, 50000);
+  EXPECT_FALSE(account_manager.IsAccountSynced());
+
+  // The fill arrives before the response is handled, it is deferred instead of being taken for an external order.
+  // No lock is held while the order is in flight, so this does not block.
+  Order closed_order = Order::CreateBuilder()
+      .Id("TEST_ID")
+      .OrderStatus_(OrderStatus::FILLED)
+      .Build();
+  account_manager.OnOrderUpdate(closed_order);
+  EXPECT_FALSE(account_manager.IsAccountSynced());
+  EXPECT_NEAR(0.0, account_manager.GetTotalBalance(SymbolId::BTC), std::numeric_limits<double>::min());
+
+  // The result can be got on another thread
+  std::optional<Result<Order>> res;
+  std::thread order_thread([&]() {
+    res.emplace(future.get());
+  });
+  order_thread.join();
+  ASSERT_TRUE(res);
+  ASSERT_TRUE(*res);
+  EXPECT_TRUE(account_manager.IsAccountSynced());
+  EXPECT_EQ(50000, res->Get().GetPrice());
+  EXPECT_FALSE(account_manager.HasOpenOrders());
+
+  double btc_balance = account_manager.GetTotalBalance(SymbolId::BTC);
+  EXPECT_NEAR(0.001, btc_balance, std::numeric_limits<double>::min());
+  double usdt_balance = account_manager.GetTotalBalance(SymbolId::USDT);
+  EXPECT_NEAR(-50.0, usdt_balance, std::numeric_limits<double>::min());
+}
+
+TEST(AccountManagerTest, LimitOrderAsyncFailedTest) {
+  std::unique_ptr<MockExchangeClient> mec{new MockExchangeClient()};
+  AccountManagerImpl account_manager{mec.get()};
+
+  EXPECT_CALL(*mec.get(), LimitOrder(_, _, _, _))
+    .Times(1)
+    .WillOnce(Return(Result<Order>("", std::string("Insufficient balance"))));
+  auto future = account_manager.LimitOrderAsync(SymbolPairId::BTC_USDT, Side::BUY, 0.001, 50000);
+
+  // Deferred while the order is in flight, handled as external order once the failed response is handled
+  Order external_order = Order::CreateBuilder()
+      .Id("EXTERNAL_ID")
+      .Symbol(SymbolPairId::BTC_USDT)
+      .Side_(Side::SELL)
+      .OrderType_(OrderType::LIMIT)
+      .Quantity(0.002)
+      .Price(60000)
+      .OrderStatus_(OrderStatus::NEW)
+      .Build();
+  account_manager.OnOrderUpdate(external_order);
+  EXPECT_NEAR(0.0, account_manager.GetFreeBalance(SymbolId::BTC), std::numeric_limits<double>::min());
+
+  auto res = future.get();
+  EXPECT_FALSE(res);
+  EXPECT_TRUE(account_manager.IsAccountSynced());
+  EXPECT_FALSE(account_manager.HasOpenOrders());
+  EXPECT_NEAR(-0.002, account_manager.GetFreeBalance(SymbolId::BTC), std::numeric_limits<double>::min());
+}
@@ -4,6 +4,7 @@
 #include "model/order.h"
 #include "model/symbol.h"
 
+#include <future>
 #include <iostream>
 #include <optional>
 #include <string>
@@ -54,6 +55,13 @@ public:
   //virtual Result<bool> Ping() = 0;
   virtual Result<Order> MarketOrder(SymbolPairId symbol, Side side, double qty) = 0;
   virtual Result<Order> LimitOrder(SymbolPairId symbol, Side side, double qty, double price) = 0;
+  // Sends the order without waiting for the response, clients without asynchronous requests
+  // place it synchronously
+  virtual std::future<Result<Order>> LimitOrderAsync(SymbolPairId symbol, Side side, double qty, double price) {
+    std::promise<Result<Order>> promise;
+    promise.set_value(LimitOrder(symbol, side, qty, price));
+    return promise.get_future();
+  }
   virtual Result<Order> SendOrder(const Order& order) = 0;
   virtual Result<AccountBalance> GetAccountBalance() = 0;
   virtual Result<std::vector<Order>> GetOpenOrders() = 0;
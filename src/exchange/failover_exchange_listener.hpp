@@ -0,0 +1,129 @@
+#pragma once
+
+#include "exchange_listener.h"
+
+#include <boost/log/trivial.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Hot standby of a market data stream: several connections to the same stream each report to a
+ * listener of their own (see GetConnectionListener()), and only the events of the active connection
+ * reach the strategy. When the active connection closes, the first other open connection takes
+ * over at once, already subscribed, while the closed one reconnects in the background.
+ * The strategy sees the exchange closed only once all connections are.
+ */
+class FailoverExchangeListener {
+public:
+  /**
+   * @throws std::invalid_argument for less than one connection
+   */
+  FailoverExchangeListener(ExchangeListener& listener, size_t connections)
+      : m_listener(listener), m_open(connections, false), m_active(NONE), m_failovers(0) {
+    if (connections < 1) {
+      throw std::invalid_argument("FailoverExchangeListener: at least one connection is needed");
+    }
+    for (size_t i = 0; i < connections; ++i) {
+      m_connections.push_back(std::make_unique<Connection>(*this, i));
+    }
+  }
+
+  // Listener the connection is to be created with
+  ExchangeListener* GetConnectionListener(size_t connection) {
+    return m_connections.at(connection).get();
+  }
+
+  // Connection events are forwarded from, if any is open
+  std::optional<size_t> GetActive() const {
+    const int active = m_active.load(std::memory_order_relaxed);
+    return active == NONE ? std::nullopt : std::optional<size_t>(active);
+  }
+
+  // Takeovers of a standby connection since the start
+  uint64_t GetFailovers() const {
+    return m_failovers.load(std::memory_order_relaxed);
+  }
+
+private:
+  static constexpr int NONE = -1;
+
+  class Connection : public ExchangeListener {
+  public:
+    Connection(FailoverExchangeListener& parent, size_t index) : m_parent(parent), m_index(index) {}
+
+    virtual void OnConnectionOpen(const std::string& name) override {
+      m_parent.OnConnectionOpen(m_index, name);
+    }
+
+    virtual void OnConnectionClose(const std::string& name) override {
+      m_parent.OnConnectionClose(m_index, name);
+    }
+
+    virtual void OnBookTicker(const Ticker& ticker) override {
+      if (IsActive()) {
+        m_parent.m_listener.OnBookTicker(ticker);
+      }
+    }
+
+    virtual void OnTradeTicker(const TradeTicker& ticker) override {
+      if (IsActive()) {
+        m_parent.m_listener.OnTradeTicker(ticker);
+      }
+    }
+
+    virtual void OnOrderBookUpdate(const OrderBook& order_book) override {
+      if (IsActive()) {
+        m_parent.m_listener.OnOrderBookUpdate(order_book);
+      }
+    }
+
+  private:
+    bool IsActive() const {
+      return m_parent.m_active.load(std::memory_order_relaxed) == static_cast<int>(m_index);
+    }
+
+    FailoverExchangeListener& m_parent;
+    const size_t m_index;
+  };
+
+  void OnConnectionOpen(size_t index, const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_open[index] = true;
+    if (m_active.load(std::memory_order_relaxed) == NONE) {
+      m_active.store(static_cast<int>(index), std::memory_order_relaxed);
+      BOOST_LOG_TRIVIAL(info) << name << ": Connection " << index << " active";
+      m_listener.OnConnectionOpen(name);
+    }
+  }
+
+  void OnConnectionClose(size_t index, const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_open[index] = false;
+    if (m_active.load(std::memory_order_relaxed) != static_cast<int>(index)) {
+      return;
+    }
+    for (size_t i = 0; i < m_open.size(); ++i) {
+      if (m_open[i]) {
+        m_active.store(static_cast<int>(i), std::memory_order_relaxed);
+        m_failovers.fetch_add(1, std::memory_order_relaxed);
+        BOOST_LOG_TRIVIAL(warning) << name << ": Connection " << index << " closed, standby connection " << i << " took over";
+        return;
+      }
+    }
+    m_active.store(NONE, std::memory_order_relaxed);
+    m_listener.OnConnectionClose(name);
+  }
+
+  ExchangeListener& m_listener;
+  std::vector<std::unique_ptr<Connection>> m_connections;
+  std::mutex m_mutex;
+  std::vector<bool> m_open;
+  std::atomic<int> m_active;
+  std::atomic<uint64_t> m_failovers;
+};
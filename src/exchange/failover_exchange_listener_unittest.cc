@@ -0,0 +1,80 @@
+#include "failover_exchange_listener.hpp"
+
+#include "model/ticker_test_utils.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace {
+
+class RecordingListener : public ExchangeListener {
+public:
+  virtual void OnConnectionOpen(const std::string& name) override {
+    events.push_back("open " + name);
+  }
+
+  virtual void OnConnectionClose(const std::string& name) override {
+    events.push_back("close " + name);
+  }
+
+  virtual void OnBookTicker(const Ticker& ticker) override {
+    events.push_back("ticker " + std::to_string(ticker.id));
+  }
+
+  virtual void OnTradeTicker(const TradeTicker& ticker) override {
+    events.push_back("trade " + ticker.trade_id);
+  }
+
+  std::vector<std::string> events;
+};
+
+}
+
+TEST(FailoverExchangeListenerTest, TestFailover) {
+  RecordingListener listener;
+  FailoverExchangeListener failover(listener, 2);
+  ExchangeListener* primary = failover.GetConnectionListener(0);
+  ExchangeListener* standby = failover.GetConnectionListener(1);
+  EXPECT_EQ(std::nullopt, failover.GetActive());
+
+  // First open connection is active, the other one stands by
+  standby->OnConnectionOpen("binance");
+  primary->OnConnectionOpen("binance");
+  EXPECT_EQ(1u, failover.GetActive());
+  standby->OnBookTicker(CreateTicker("binance", SymbolPairId::ADA_USDT, 0.0, 0.0, 0, 1));
+  primary->OnBookTicker(CreateTicker("binance", SymbolPairId::ADA_USDT, 0.0, 0.0, 0, 1));
+  TradeTicker trade;
+  trade.trade_id = "7";
+  standby->OnTradeTicker(trade);
+  primary->OnTradeTicker(trade);
+
+  // Takes over without the strategy seeing the close
+  standby->OnConnectionClose("binance");
+  EXPECT_EQ(0u, failover.GetActive());
+  EXPECT_EQ(1u, failover.GetFailovers());
+  standby->OnBookTicker(CreateTicker("binance", SymbolPairId::ADA_USDT, 0.0, 0.0, 0, 2));
+  primary->OnBookTicker(CreateTicker("binance", SymbolPairId::ADA_USDT, 0.0, 0.0, 0, 3));
+
+  // Reconnected connection stands by
+  standby->OnConnectionOpen("binance");
+  standby->OnBookTicker(CreateTicker("binance", SymbolPairId::ADA_USDT, 0.0, 0.0, 0, 4));
+  EXPECT_EQ(0u, failover.GetActive());
+
+  primary->OnConnectionClose("binance");
+  standby->OnConnectionClose("binance");
+  EXPECT_EQ(std::nullopt, failover.GetActive());
+  EXPECT_EQ(2u, failover.GetFailovers());
+  EXPECT_THAT(listener.events, ElementsAre("open binance", "ticker 1", "trade 7", "ticker 3", "close binance"));
+}
+
+TEST(FailoverExchangeListenerTest, TestInvalid) {
+  RecordingListener listener;
+  EXPECT_THROW(FailoverExchangeListener(listener, 0), std::invalid_argument);
+  FailoverExchangeListener failover(listener, 1);
+  EXPECT_THROW(failover.GetConnectionListener(1), std::out_of_range);
+}
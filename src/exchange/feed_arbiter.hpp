@@ -0,0 +1,234 @@
+#pragma once
+
+#include "exchange_listener.h"
+#include "utils/latency_histogram.hpp"
+#include "utils/spinlock.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Arbitrates redundant connections to the same exchange stream: each connection reports to a listener
+ * of its own (see GetConnectionListener()), and of the copies of a message the listener gets only the
+ * first to arrive, whichever connection it comes from. A stall on one TCP path then costs nothing as
+ * long as another path delivers.
+ *
+ * Messages are told apart by the sequence numbers of the exchange, per symbol:
+ * - book tickers by Ticker::id, eg. the update id (u) of Binance book tickers
+ * - trades by their numeric trade id, trades with other ids are all forwarded
+ * - order books by the update id of their last update (Binance u), or by its latest level timestamp
+ *   where the exchange has no update ids (Kraken)
+ * A message is forwarded if its sequence is above the last forwarded one, copies and older messages are
+ * dropped in constant time. Messages of a stream are forwarded one at a time and the listener is called
+ * before the next one is checked, so it never gets a message after a newer one from another connection.
+ * Messages without a sequence (0), eg. Kraken tickers or books without update ids and level timestamps,
+ * can't be arbitrated and are all forwarded, copies included.
+ *
+ * The listener sees the exchange open once a connection is, and closed once all of them are.
+ */
+class FeedArbiter {
+public:
+  // Per connection counts, and how far behind the first copy its copies arrived
+  struct ConnectionStats {
+    // Messages the connection delivered first
+    uint64_t first = 0;
+    // Copies of messages another connection delivered first
+    uint64_t duplicates = 0;
+    // Copies too old to measure their lag
+    uint64_t stale = 0;
+    // Microseconds the duplicates arrived after the first copy
+    cryptobot::LatencyHistogram lag;
+  };
+
+  /**
+   * @throws std::invalid_argument for less than one connection
+   */
+  FeedArbiter(ExchangeListener& listener, size_t connections, const std::string& name = "")
+      : m_listener(listener), m_name(name), m_open(connections, false), m_open_count(0), m_stats(connections) {
+    if (connections < 1) {
+      throw std::invalid_argument("FeedArbiter: at least one connection is needed");
+    }
+    for (size_t i = 0; i < connections; ++i) {
+      m_connections.push_back(std::make_unique<Connection>(*this, i));
+    }
+  }
+
+  // Listener the connection is to be created with
+  ExchangeListener* GetConnectionListener(size_t connection) {
+    return m_connections.at(connection).get();
+  }
+
+  ConnectionStats GetStats(size_t connection) const {
+    std::lock_guard<cryptobot::spinlock> lock(m_lock);
+    return m_stats.at(connection);
+  }
+
+  void LogReport() const {
+    for (size_t i = 0; i < m_connections.size(); ++i) {
+      const ConnectionStats stats = GetStats(i);
+      BOOST_LOG_TRIVIAL(info) << "Feed arbiter " << m_name << " connection " << i << ": first=" << stats.first
+          << " duplicates=" << stats.duplicates << " stale=" << stats.stale << " lag_us: " << stats.lag;
+    }
+  }
+
+private:
+  enum Kind : size_t {
+    BOOK_TICKER = 0,
+    TRADE,
+    ORDER_BOOK,
+    KIND_COUNT
+  };
+
+  // Sequences of the latest messages of a stream, to measure the lag of late copies
+  static constexpr size_t RECENT_COUNT = 32;
+
+  struct Sequenced {
+    uint64_t sequence = 0;
+    uint64_t first_arrived_ts = 0;
+  };
+
+  struct StreamState {
+    // Held while the message is checked and forwarded
+    std::mutex mutex;
+    bool started = false;
+    uint64_t last_sequence = 0;
+    std::array<Sequenced, RECENT_COUNT> recent{};
+  };
+
+  class Connection : public ExchangeListener {
+  public:
+    Connection(FeedArbiter& parent, size_t index) : m_parent(parent), m_index(index) {}
+
+    virtual void OnConnectionOpen(const std::string& name) override {
+      m_parent.OnConnectionOpen(m_index, name);
+    }
+
+    virtual void OnConnectionClose(const std::string& name) override {
+      m_parent.OnConnectionClose(m_index, name);
+    }
+
+    virtual void OnBookTicker(const Ticker& ticker) override {
+      m_parent.Forward(BOOK_TICKER, SymbolPairId(ticker.symbol), ticker.id, ticker.arrived_ts, m_index, [&]() {
+        m_parent.m_listener.OnBookTicker(ticker);
+      });
+    }
+
+    virtual void OnTradeTicker(const TradeTicker& ticker) override {
+      uint64_t trade_id = 0;
+      const char* end = ticker.trade_id.data() + ticker.trade_id.size();
+      const auto res = std::from_chars(ticker.trade_id.data(), end, trade_id);
+      if (res.ec != std::errc() || res.ptr != end) {
+        trade_id = 0;
+      }
+      m_parent.Forward(TRADE, SymbolPairId(ticker.symbol), trade_id, ticker.arrived_ts, m_index, [&]() {
+        m_parent.m_listener.OnTradeTicker(ticker);
+      });
+    }
+
+    virtual void OnOrderBookUpdate(const OrderBook& order_book) override {
+      const OrderBookUpdate& update = order_book.GetLastUpdate();
+      m_parent.Forward(ORDER_BOOK, order_book.GetSymbolPairId(), BookSequence(update), update.arrived_ts, m_index, [&]() {
+        m_parent.m_listener.OnOrderBookUpdate(order_book);
+      });
+    }
+
+  private:
+    static uint64_t BookSequence(const OrderBookUpdate& update) {
+      if (update.last_update_id != 0) {
+        return update.last_update_id;
+      }
+      uint64_t latest_ts = 0;
+      for (const auto* levels : {&update.bids, &update.asks}) {
+        for (const auto& level : *levels) {
+          latest_ts = std::max(latest_ts, level.timestamp.value_or(0));
+        }
+      }
+      return latest_ts;
+    }
+
+    FeedArbiter& m_parent;
+    const size_t m_index;
+  };
+
+  /**
+   * Calls deliver if the message is the first copy of a message newer than the forwarded ones, or has no sequence.
+   * Messages of the stream from other connections wait meanwhile.
+   */
+  template <typename F>
+  void Forward(Kind kind, SymbolPairId symbol, uint64_t sequence, uint64_t arrived_ts, size_t connection, F&& deliver) {
+    if (sequence == 0) {
+      deliver();
+      return;
+    }
+    StreamState* state;
+    {
+      std::lock_guard<cryptobot::spinlock> lock(m_lock);
+      // References to the elements of unordered_map stay valid
+      state = &m_streams[kind][symbol];
+    }
+    std::lock_guard<std::mutex> stream_lock(state->mutex);
+    Sequenced& recent = state->recent[sequence % RECENT_COUNT];
+    if (!state->started || sequence > state->last_sequence) {
+      state->started = true;
+      state->last_sequence = sequence;
+      recent.sequence = sequence;
+      recent.first_arrived_ts = arrived_ts;
+      {
+        std::lock_guard<cryptobot::spinlock> lock(m_lock);
+        ++m_stats[connection].first;
+      }
+      deliver();
+      return;
+    }
+    std::lock_guard<cryptobot::spinlock> lock(m_lock);
+    ConnectionStats& stats = m_stats[connection];
+    if (recent.sequence == sequence) {
+      ++stats.duplicates;
+      stats.lag.Record(arrived_ts > recent.first_arrived_ts ? arrived_ts - recent.first_arrived_ts : 0);
+    } else {
+      ++stats.stale;
+    }
+  }
+
+  void OnConnectionOpen(size_t index, const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_connection_mutex);
+    if (!m_open[index]) {
+      m_open[index] = true;
+      if (m_open_count++ == 0) {
+        m_listener.OnConnectionOpen(name);
+      }
+    }
+  }
+
+  void OnConnectionClose(size_t index, const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_connection_mutex);
+    if (m_open[index]) {
+      m_open[index] = false;
+      if (--m_open_count == 0) {
+        m_listener.OnConnectionClose(name);
+      } else {
+        BOOST_LOG_TRIVIAL(warning) << "Feed arbiter " << m_name << ": connection " << index << " closed, " << m_open_count << " still open";
+      }
+    }
+  }
+
+  ExchangeListener& m_listener;
+  const std::string m_name;
+  std::vector<std::unique_ptr<Connection>> m_connections;
+  std::mutex m_connection_mutex;
+  std::vector<bool> m_open;
+  size_t m_open_count;
+  // Guards the stream map and the stats
+  mutable cryptobot::spinlock m_lock;
+  std::array<std::unordered_map<SymbolPairId, StreamState>, KIND_COUNT> m_streams;
+  std::vector<ConnectionStats> m_stats;
+};
@@ -0,0 +1,210 @@
+#include "feed_arbiter.hpp"
+
+#include "model/ticker_test_utils.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+
+namespace {
+
+class RecordingListener : public ExchangeListener {
+public:
+  virtual void OnConnectionOpen(const std::string& name) override {
+    events.push_back("open " + name);
+  }
+
+  virtual void OnConnectionClose(const std::string& name) override {
+    events.push_back("close " + name);
+  }
+
+  virtual void OnBookTicker(const Ticker& ticker) override {
+    events.push_back("ticker " + std::to_string(ticker.id) + " " + ticker.exchange);
+  }
+
+  virtual void OnTradeTicker(const TradeTicker& ticker) override {
+    events.push_back("trade " + ticker.trade_id);
+  }
+
+  virtual void OnOrderBookUpdate(const OrderBook& order_book) override {
+    events.push_back("book " + std::to_string(order_book.GetLastUpdate().last_update_id));
+  }
+
+  std::vector<std::string> events;
+};
+
+OrderBookUpdate CreateUpdate(uint64_t last_update_id, uint64_t level_ts, uint64_t arrived_ts) {
+  OrderBookUpdate update{};
+  update.last_update_id = last_update_id;
+  update.is_snapshot = false;
+  update.arrived_ts = arrived_ts;
+  update.symbol = SymbolPairId::ADA_USDT;
+  update.bids.push_back(OrderBookUpdate::Level{Decimal(120000, 5), Decimal(100, 0), level_ts});
+  return update;
+}
+
+}
+
+TEST(FeedArbiterTest, TestFirstArrivalWins) {
+  RecordingListener listener;
+  FeedArbiter arbiter(listener, 2, "binance");
+  ExchangeListener* a = arbiter.GetConnectionListener(0);
+  ExchangeListener* b = arbiter.GetConnectionListener(1);
+
+  // Exchange name of the tickers tells the connections apart
+  a->OnBookTicker(CreateTicker("a", SymbolPairId::ADA_USDT, 0.0, 0.0, 1000, 10));
+  b->OnBookTicker(CreateTicker("b", SymbolPairId::ADA_USDT, 0.0, 0.0, 1300, 10));
+  // b ahead for the next ones
+  b->OnBookTicker(CreateTicker("b", SymbolPairId::ADA_USDT, 0.0, 0.0, 2000, 11));
+  b->OnBookTicker(CreateTicker("b", SymbolPairId::ADA_USDT, 0.0, 0.0, 2100, 12));
+  a->OnBookTicker(CreateTicker("a", SymbolPairId::ADA_USDT, 0.0, 0.0, 2500, 11));
+  a->OnBookTicker(CreateTicker("a", SymbolPairId::ADA_USDT, 0.0, 0.0, 2600, 12));
+  // Sequences are per symbol
+  a->OnBookTicker(CreateTicker("a", SymbolPairId::BTC_USDT, 0.0, 0.0, 3000, 5));
+  b->OnBookTicker(CreateTicker("b", SymbolPairId::BTC_USDT, 0.0, 0.0, 3000, 5));
+  EXPECT_THAT(listener.events, ElementsAre("ticker 10 a", "ticker 11 b", "ticker 12 b", "ticker 5 a"));
+
+  const FeedArbiter::ConnectionStats a_stats = arbiter.GetStats(0);
+  EXPECT_EQ(2u, a_stats.first);
+  EXPECT_EQ(2u, a_stats.duplicates);
+  EXPECT_EQ(0u, a_stats.stale);
+  EXPECT_EQ(500u, a_stats.lag.GetMin());
+  const FeedArbiter::ConnectionStats b_stats = arbiter.GetStats(1);
+  EXPECT_EQ(2u, b_stats.first);
+  EXPECT_EQ(2u, b_stats.duplicates);
+  EXPECT_EQ(0u, b_stats.lag.GetMin());
+  EXPECT_EQ(300u, b_stats.lag.GetMax());
+}
+
+TEST(FeedArbiterTest, TestStaleCopies) {
+  RecordingListener listener;
+  FeedArbiter arbiter(listener, 2);
+  ExchangeListener* a = arbiter.GetConnectionListener(0);
+  ExchangeListener* b = arbiter.GetConnectionListener(1);
+  for (uint64_t id = 1; id <= 40; ++id) {
+    a->OnBookTicker(CreateTicker("a", SymbolPairId::ADA_USDT, 0.0, 0.0, id, id));
+  }
+  // Lagging too far behind to be measured
+  b->OnBookTicker(CreateTicker("b", SymbolPairId::ADA_USDT, 0.0, 0.0, 100, 1));
+  b->OnBookTicker(CreateTicker("b", SymbolPairId::ADA_USDT, 0.0, 0.0, 100, 39));
+  EXPECT_EQ(40u, listener.events.size());
+  EXPECT_EQ(1u, arbiter.GetStats(1).stale);
+  EXPECT_EQ(1u, arbiter.GetStats(1).duplicates);
+  EXPECT_EQ(61u, arbiter.GetStats(1).lag.GetMax());
+}
+
+TEST(FeedArbiterTest, TestTradesAndBooks) {
+  RecordingListener listener;
+  FeedArbiter arbiter(listener, 2);
+  ExchangeListener* a = arbiter.GetConnectionListener(0);
+  ExchangeListener* b = arbiter.GetConnectionListener(1);
+
+  TradeTicker trade;
+  trade.symbol = SymbolPairId::ADA_USDT;
+  trade.arrived_ts = 0;
+  trade.trade_id = "700";
+  a->OnTradeTicker(trade);
+  b->OnTradeTicker(trade);
+  // Not a sequence, forwarded from both
+  trade.trade_id = "x1";
+  a->OnTradeTicker(trade);
+  b->OnTradeTicker(trade);
+
+  // Each connection has its own book, sequenced by update id
+  OrderBook book_a("binance", SymbolPairId::ADA_USDT, PrecisionSettings(5, 0, 6));
+  OrderBook book_b("binance", SymbolPairId::ADA_USDT, PrecisionSettings(5, 0, 6));
+  book_a.Update(CreateUpdate(100, 1, 10));
+  a->OnOrderBookUpdate(book_a);
+  book_b.Update(CreateUpdate(100, 1, 20));
+  b->OnOrderBookUpdate(book_b);
+  book_b.Update(CreateUpdate(101, 2, 30));
+  b->OnOrderBookUpdate(book_b);
+  EXPECT_THAT(listener.events, ElementsAre("trade 700", "trade x1", "trade x1", "book 100", "book 101"));
+
+  // Or by the latest level timestamp without update ids
+  listener.events.clear();
+  FeedArbiter kraken_arbiter(listener, 2);
+  book_a.Update(CreateUpdate(0, 1614556800000001, 40));
+  kraken_arbiter.GetConnectionListener(0)->OnOrderBookUpdate(book_a);
+  book_b.Update(CreateUpdate(0, 1614556800000001, 50));
+  kraken_arbiter.GetConnectionListener(1)->OnOrderBookUpdate(book_b);
+  book_b.Update(CreateUpdate(0, 1614556800000002, 60));
+  kraken_arbiter.GetConnectionListener(1)->OnOrderBookUpdate(book_b);
+  EXPECT_THAT(listener.events, ElementsAre("book 0", "book 0"));
+  EXPECT_EQ(1u, kraken_arbiter.GetStats(1).duplicates);
+}
+
+TEST(FeedArbiterTest, TestUnsequenced) {
+  RecordingListener listener;
+  FeedArbiter arbiter(listener, 2);
+  ExchangeListener* a = arbiter.GetConnectionListener(0);
+  ExchangeListener* b = arbiter.GetConnectionListener(1);
+  // Tickers without ids, eg. Kraken tickers, are all forwarded
+  for (int i = 0; i < 5; ++i) {
+    a->OnBookTicker(CreateTicker("a", SymbolPairId::ADA_USDT, 0.0, 0.0, 1000 + i, 0));
+  }
+  b->OnBookTicker(CreateTicker("b", SymbolPairId::ADA_USDT, 0.0, 0.0, 1000, 0));
+  EXPECT_EQ(6u, listener.events.size());
+  // As are books without update ids and level timestamps
+  OrderBook book("kraken", SymbolPairId::ADA_USDT, PrecisionSettings(5, 0, 6));
+  OrderBookUpdate update = CreateUpdate(0, 0, 10);
+  update.bids[0].timestamp = std::nullopt;
+  book.Update(update);
+  a->OnOrderBookUpdate(book);
+  a->OnOrderBookUpdate(book);
+  EXPECT_EQ(8u, listener.events.size());
+  EXPECT_EQ(0u, arbiter.GetStats(0).duplicates);
+  EXPECT_EQ(0u, arbiter.GetStats(0).stale);
+}
+
+// A newer message from another connection waits until the listener handled the older one
+TEST(FeedArbiterTest, TestDeliveryOrder) {
+  class SlowListener : public RecordingListener {
+  public:
+    virtual void OnBookTicker(const Ticker& ticker) override {
+      if (ticker.id == 1) {
+        handling = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      }
+      std::scoped_lock<std::mutex> lock{mutex};
+      RecordingListener::OnBookTicker(ticker);
+    }
+
+    std::atomic<bool> handling{false};
+    std::mutex mutex;
+  };
+  SlowListener listener;
+  FeedArbiter arbiter(listener, 2);
+  std::thread a([&]() {
+    arbiter.GetConnectionListener(0)->OnBookTicker(CreateTicker("a", SymbolPairId::ADA_USDT, 0.0, 0.0, 1000, 1));
+  });
+  while (!listener.handling) {
+    std::this_thread::yield();
+  }
+  arbiter.GetConnectionListener(1)->OnBookTicker(CreateTicker("b", SymbolPairId::ADA_USDT, 0.0, 0.0, 1010, 2));
+  a.join();
+  EXPECT_THAT(listener.events, ElementsAre("ticker 1 a", "ticker 2 b"));
+}
+
+TEST(FeedArbiterTest, TestConnections) {
+  RecordingListener listener;
+  FeedArbiter arbiter(listener, 2);
+  arbiter.GetConnectionListener(0)->OnConnectionOpen("kraken");
+  arbiter.GetConnectionListener(1)->OnConnectionOpen("kraken");
+  arbiter.GetConnectionListener(0)->OnConnectionClose("kraken");
+  arbiter.GetConnectionListener(0)->OnConnectionOpen("kraken");
+  arbiter.GetConnectionListener(0)->OnConnectionClose("kraken");
+  arbiter.GetConnectionListener(1)->OnConnectionClose("kraken");
+  EXPECT_THAT(listener.events, ElementsAre("open kraken", "close kraken"));
+
+  EXPECT_THROW(FeedArbiter(listener, 0), std::invalid_argument);
+  EXPECT_THROW(arbiter.GetConnectionListener(2), std::out_of_range);
+}
@@ -0,0 +1,464 @@
+#pragma once
+#include "http_client.hpp"
+#include "utils/event_loop.hpp"
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/ssl/error.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <poll.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Asynchronous HTTPS client for latency sensitive requests like order entry. Requests are sent without
+ * blocking the caller, over a pool of kept-alive TLS connections per host, which can be opened before
+ * the first request (see Warmup()) so that no request pays for the TCP and TLS handshakes.
+ * A connection has one request in flight at a time, requests to the same host go out in parallel over
+ * the connections of its pool, and wait in a queue while all of them are busy.
+ *
+ * Every request has a deadline: a request not answered by then completes with an error, and its
+ * connection is closed. Idle connections are reopened from time to time, before the server drops them,
+ * and are checked for a close by the server before a request goes out on them. A request is resent only
+ * if it could not be written, never once written: the server may have executed it (eg. an order).
+ *
+ * Requests are built with HttpClient::Request, eg.
+ *   async_client.Send(http_client.post(host, port, path).QueryParam("symbol", "ADAUSDT"), callback);
+ * and complete on the loop thread, so callbacks should be quick.
+ */
+class AsyncHttpClient {
+public:
+  struct Options {
+    // Connections kept open per host, the most requests in flight to it
+    size_t connections_per_host = 2;
+    // Deadline of requests sent without one
+    std::chrono::milliseconds timeout = std::chrono::milliseconds(5000);
+    // Resends of a request that could not be written on a reused connection, eg. one the server closed while idle
+    size_t retry_count = 1;
+    // Connections idle for so long are reopened, to stay ahead of the keep-alive timeout of the server
+    std::chrono::milliseconds idle_reconnect = std::chrono::milliseconds(20000);
+  };
+
+  typedef std::function<void(HttpClient::Result)> Callback;
+
+  /**
+   * @param loop loop the connections run on, to be stopped before the client is destroyed;
+   *             the client starts a loop of its own if not set
+   * @throws std::invalid_argument for a pool without connections
+   */
+  AsyncHttpClient(const Options& options, cryptobot::EventLoop* loop = nullptr)
+      : m_options(options), m_ssl_ctx{boost::asio::ssl::context::tlsv12_client}, m_loop(loop) {
+    if (options.connections_per_host < 1) {
+      throw std::invalid_argument("AsyncHttpClient: at least one connection per host is needed");
+    }
+    if (m_loop == nullptr) {
+      cryptobot::EventLoopOptions loop_options;
+      loop_options.name = "http";
+      m_own_loop = std::make_unique<cryptobot::EventLoop>(loop_options);
+      m_own_loop->Start();
+      m_loop = m_own_loop.get();
+    }
+  }
+
+  AsyncHttpClient(const AsyncHttpClient&) = delete;
+  AsyncHttpClient& operator=(const AsyncHttpClient&) = delete;
+
+  ~AsyncHttpClient() {
+    if (m_own_loop) {
+      m_own_loop->Stop();
+    }
+  }
+
+  /**
+   * Opens the connections of the host, without waiting for them.
+   */
+  void Warmup(const std::string& host, const std::string& port) {
+    boost::asio::post(m_loop->GetIoContext(), [this, host, port]() {
+      HostPool& pool = GetPool(host, port);
+      for (const auto& connection : pool.connections) {
+        if (connection->state == Connection::State::CLOSED) {
+          Connect(pool, connection);
+        }
+      }
+    });
+  }
+
+  /**
+   * Builds (and signs) the request on the calling thread and sends it on the loop, the callback gets the
+   * response or an error.
+   */
+  void Send(HttpClient::Request& request, Callback callback, std::optional<std::chrono::milliseconds> timeout = std::nullopt) {
+    auto pending = std::make_shared<PendingRequest>(m_loop->GetIoContext());
+    pending->request = request.build();
+    pending->callback = std::move(callback);
+    pending->timeout = timeout.value_or(m_options.timeout);
+    boost::asio::post(m_loop->GetIoContext(), [this, pending, host = request.m_host, port = request.m_port]() {
+      Enqueue(GetPool(host, port), pending);
+    });
+  }
+
+  std::future<HttpClient::Result> Send(HttpClient::Request& request, std::optional<std::chrono::milliseconds> timeout = std::nullopt) {
+    auto promise = std::make_shared<std::promise<HttpClient::Result>>();
+    std::future<HttpClient::Result> future = promise->get_future();
+    Send(request, [promise](HttpClient::Result res) {
+      promise->set_value(std::move(res));
+    }, timeout);
+    return future;
+  }
+
+private:
+  typedef boost::beast::http::request<boost::beast::http::string_body> HttpRequest;
+  typedef boost::beast::http::response<boost::beast::http::string_body> HttpResponse;
+  typedef boost::asio::ssl::stream<boost::asio::ip::tcp::socket> SslStream;
+
+  struct Connection;
+
+  struct PendingRequest {
+    explicit PendingRequest(boost::asio::io_context& io_context) : deadline(io_context) {}
+
+    HttpRequest request;
+    Callback callback;
+    std::chrono::milliseconds timeout;
+    boost::asio::steady_timer deadline;
+    std::chrono::steady_clock::time_point sent_at;
+    size_t retries = 0;
+    bool done = false;
+    // Connection the request is in flight on
+    std::shared_ptr<Connection> connection;
+  };
+  typedef std::shared_ptr<PendingRequest> PendingRequestPtr;
+
+  // Stream with its read state, new for every connect: operations of a closed session still
+  // complete (aborted) while the connection already has the next one
+  struct Session {
+    Session(boost::asio::io_context& io_context, boost::asio::ssl::context& ssl_ctx) : stream(io_context, ssl_ctx) {}
+
+    SslStream stream;
+    boost::beast::flat_buffer buffer;
+    HttpResponse response;
+  };
+  typedef std::shared_ptr<Session> SessionPtr;
+
+  struct Connection {
+    enum class State {
+      CLOSED,
+      CONNECTING,
+      IDLE,
+      BUSY
+    };
+
+    explicit Connection(boost::asio::io_context& io_context) : idle_timer(io_context) {}
+
+    State state = State::CLOSED;
+    SessionPtr session;
+    // Served a request since opened, so a failure may just be a close by the server while idle
+    bool reused = false;
+    PendingRequestPtr request;
+    boost::asio::steady_timer idle_timer;
+  };
+  typedef std::shared_ptr<Connection> ConnectionPtr;
+
+  struct HostPool {
+    HostPool(boost::asio::io_context& io_context, const std::string& h, const std::string& p, size_t connection_count)
+        : host(h), port(p), resolver(io_context) {
+      for (size_t i = 0; i < connection_count; ++i) {
+        connections.push_back(std::make_shared<Connection>(io_context));
+      }
+    }
+
+    std::string host;
+    std::string port;
+    boost::asio::ip::tcp::resolver resolver;
+    // Resolved once, again after a failed connect
+    boost::asio::ip::tcp::resolver::results_type endpoints;
+    std::vector<ConnectionPtr> connections;
+    std::deque<PendingRequestPtr> queue;
+  };
+
+  // All of the following run on the loop thread
+
+  HostPool& GetPool(const std::string& host, const std::string& port) {
+    std::unique_ptr<HostPool>& pool = m_pools[host + ":" + port];
+    if (!pool) {
+      pool = std::make_unique<HostPool>(m_loop->GetIoContext(), host, port, m_options.connections_per_host);
+    }
+    return *pool;
+  }
+
+  void Enqueue(HostPool& pool, const PendingRequestPtr& pending) {
+    pending->sent_at = std::chrono::steady_clock::now();
+    pending->deadline.expires_after(pending->timeout);
+    pending->deadline.async_wait([this, &pool, pending](const boost::system::error_code& ec) {
+      if (ec != boost::asio::error::operation_aborted) {
+        OnDeadline(pool, pending);
+      }
+    });
+    pool.queue.push_back(pending);
+    Dispatch(pool);
+  }
+
+  // Hands queued requests to idle connections, and opens connections for the rest
+  void Dispatch(HostPool& pool) {
+    while (!pool.queue.empty()) {
+      ConnectionPtr idle;
+      ConnectionPtr closed;
+      size_t connecting = 0;
+      for (const auto& connection : pool.connections) {
+        if (connection->state == Connection::State::IDLE && !idle) {
+          idle = connection;
+        } else if (connection->state == Connection::State::CLOSED && !closed) {
+          closed = connection;
+        } else if (connection->state == Connection::State::CONNECTING) {
+          ++connecting;
+        }
+      }
+      if (idle) {
+        if (IsClosedByServer(*idle)) {
+          BOOST_LOG_TRIVIAL(debug) << "HTTPS connection to " << pool.host << ":" << pool.port << " closed by the server while idle";
+          Close(*idle);
+          continue;
+        }
+        PendingRequestPtr pending = std::move(pool.queue.front());
+        pool.queue.pop_front();
+        Write(pool, idle, pending);
+      } else if (closed && connecting < pool.queue.size()) {
+        Connect(pool, closed);
+      } else {
+        break;
+      }
+    }
+  }
+
+  void Connect(HostPool& pool, const ConnectionPtr& connection) {
+    connection->state = Connection::State::CONNECTING;
+    connection->reused = false;
+    connection->idle_timer.cancel();
+    SessionPtr session = std::make_shared<Session>(m_loop->GetIoContext(), m_ssl_ctx);
+    connection->session = session;
+    if (!SSL_set_tlsext_host_name(session->stream.native_handle(), pool.host.c_str())) {
+      boost::system::error_code ec{static_cast<int>(::ERR_get_error()), boost::asio::error::get_ssl_category()};
+      boost::asio::post(m_loop->GetIoContext(), [this, &pool, connection, session, ec]() {
+        if (connection->session == session) {
+          OnConnectError(pool, connection, "setting SNI of", ec);
+        }
+      });
+      return;
+    }
+    if (!pool.endpoints.empty()) {
+      ConnectEndpoints(pool, connection, session);
+      return;
+    }
+    pool.resolver.async_resolve(pool.host, pool.port,
+        [this, &pool, connection, session](const boost::system::error_code& ec, boost::asio::ip::tcp::resolver::results_type results) {
+          if (connection->session != session) {
+            return;
+          }
+          if (ec) {
+            OnConnectError(pool, connection, "resolving", ec);
+            return;
+          }
+          pool.endpoints = results;
+          ConnectEndpoints(pool, connection, session);
+        });
+  }
+
+  void ConnectEndpoints(HostPool& pool, const ConnectionPtr& connection, const SessionPtr& session) {
+    boost::asio::async_connect(session->stream.next_layer(), pool.endpoints,
+        [this, &pool, connection, session](const boost::system::error_code& ec, const boost::asio::ip::tcp::endpoint&) {
+          if (connection->session != session) {
+            return;
+          }
+          if (ec) {
+            OnConnectError(pool, connection, "connecting", ec);
+            return;
+          }
+          boost::system::error_code option_ec;
+          session->stream.next_layer().set_option(boost::asio::ip::tcp::no_delay(true), option_ec);
+          session->stream.async_handshake(boost::asio::ssl::stream_base::client,
+              [this, &pool, connection, session](const boost::system::error_code& ec) {
+                if (connection->session != session) {
+                  return;
+                }
+                if (ec) {
+                  OnConnectError(pool, connection, "handshaking", ec);
+                  return;
+                }
+                BOOST_LOG_TRIVIAL(debug) << "HTTPS connection to " << pool.host << ":" << pool.port << " open";
+                SetIdle(pool, connection);
+                Dispatch(pool);
+              });
+        });
+  }
+
+  void OnConnectError(HostPool& pool, const ConnectionPtr& connection, const std::string& what, const boost::system::error_code& ec) {
+    BOOST_LOG_TRIVIAL(error) << "Error " << what << " HTTPS connection to " << pool.host << ":" << pool.port << ": " << ec.message();
+    Close(*connection);
+    pool.endpoints = boost::asio::ip::tcp::resolver::results_type();
+    // Queued requests wait for the other connections, if there are any left
+    const bool has_open = std::any_of(pool.connections.begin(), pool.connections.end(), [](const ConnectionPtr& c) {
+      return c->state != Connection::State::CLOSED;
+    });
+    if (has_open) {
+      return;
+    }
+    while (!pool.queue.empty()) {
+      PendingRequestPtr pending = std::move(pool.queue.front());
+      pool.queue.pop_front();
+      Complete(pending, Error("Error " + what + " HTTPS connection: " + ec.message()));
+    }
+  }
+
+  void Write(HostPool& pool, const ConnectionPtr& connection, const PendingRequestPtr& pending) {
+    connection->state = Connection::State::BUSY;
+    connection->idle_timer.cancel();
+    connection->request = pending;
+    pending->connection = connection;
+    SessionPtr session = connection->session;
+    session->response = HttpResponse();
+    boost::beast::http::async_write(session->stream, pending->request,
+        [this, &pool, connection, session, pending](const boost::system::error_code& ec, std::size_t) {
+          if (connection->session != session) {
+            return;
+          }
+          if (ec) {
+            OnRequestError(pool, connection, ec, false);
+            return;
+          }
+          boost::beast::http::async_read(session->stream, session->buffer, session->response,
+              [this, &pool, connection, session](const boost::system::error_code& ec, std::size_t) {
+                if (connection->session != session) {
+                  return;
+                }
+                if (ec) {
+                  OnRequestError(pool, connection, ec, true);
+                  return;
+                }
+                OnResponse(pool, connection);
+              });
+        });
+  }
+
+  void OnResponse(HostPool& pool, const ConnectionPtr& connection) {
+    PendingRequestPtr pending = std::move(connection->request);
+    pending->connection.reset();
+    HttpResponse& response = connection->session->response;
+    BOOST_LOG_TRIVIAL(debug) << "HTTP request-response microseconds: " << std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - pending->sent_at).count();
+    BOOST_LOG_TRIVIAL(trace) << "HTTP response header: " << response.base();
+    HttpClient::Result res;
+    res.response = std::move(response.body());
+    connection->reused = true;
+    if (response.keep_alive()) {
+      SetIdle(pool, connection);
+    } else {
+      Close(*connection);
+    }
+    Complete(pending, std::move(res));
+    Dispatch(pool);
+  }
+
+  /**
+   * @param written whether the whole request was written, the server may then have received and executed it
+   */
+  void OnRequestError(HostPool& pool, const ConnectionPtr& connection, const boost::system::error_code& ec, bool written) {
+    PendingRequestPtr pending = std::move(connection->request);
+    pending->connection.reset();
+    const bool reused = connection->reused;
+    Close(*connection);
+    // Only part of the request reached a server that closed the connection while idle, it can't have executed it
+    if (!written && reused && pending->retries < m_options.retry_count) {
+      ++pending->retries;
+      BOOST_LOG_TRIVIAL(debug) << "Retrying HTTP request to " << pool.host << " on a new connection: " << ec.message();
+      pool.queue.push_front(pending);
+    } else {
+      BOOST_LOG_TRIVIAL(error) << "Error sending HTTP request to " << pool.host << ": " << ec.message();
+      Complete(pending, Error(ec.message()));
+    }
+    Dispatch(pool);
+  }
+
+  void OnDeadline(HostPool& pool, const PendingRequestPtr& pending) {
+    if (pending->done) {
+      return;
+    }
+    BOOST_LOG_TRIVIAL(warning) << "HTTP request to " << pool.host << " timed out after " << pending->timeout.count() << " ms";
+    if (pending->connection) {
+      ConnectionPtr connection = std::move(pending->connection);
+      connection->request.reset();
+      Close(*connection);
+    } else {
+      pool.queue.erase(std::remove(pool.queue.begin(), pool.queue.end(), pending), pool.queue.end());
+    }
+    Complete(pending, Error("Request timed out"));
+    Dispatch(pool);
+  }
+
+  // Requests are not pipelined, so anything to read on an idle connection is a TLS close_notify or a FIN
+  static bool IsClosedByServer(Connection& connection) {
+    pollfd fd{connection.session->stream.next_layer().native_handle(), POLLIN | POLLRDHUP, 0};
+    return ::poll(&fd, 1, 0) != 0;
+  }
+
+  void SetIdle(HostPool& pool, const ConnectionPtr& connection) {
+    connection->state = Connection::State::IDLE;
+    connection->idle_timer.expires_after(m_options.idle_reconnect);
+    connection->idle_timer.async_wait([this, &pool, connection, session = connection->session](const boost::system::error_code& ec) {
+      if (ec || connection->session != session || connection->state != Connection::State::IDLE) {
+        return;
+      }
+      Close(*connection);
+      Connect(pool, connection);
+    });
+  }
+
+  void Close(Connection& connection) {
+    if (connection.session) {
+      boost::system::error_code ec;
+      connection.session->stream.next_layer().close(ec);
+      connection.session.reset();
+    }
+    connection.state = Connection::State::CLOSED;
+    connection.reused = false;
+    connection.idle_timer.cancel();
+  }
+
+  void Complete(const PendingRequestPtr& pending, HttpClient::Result res) {
+    pending->done = true;
+    pending->deadline.cancel();
+    try {
+      pending->callback(std::move(res));
+    } catch (const std::exception& e) {
+      BOOST_LOG_TRIVIAL(error) << "HTTP request callback exception: " << e.what();
+    }
+  }
+
+  static HttpClient::Result Error(const std::string& errmsg) {
+    HttpClient::Result res;
+    res.errmsg = errmsg;
+    return res;
+  }
+
+private:
+  // Destroyed last, after the connections
+  std::unique_ptr<cryptobot::EventLoop> m_own_loop;
+  const Options m_options;
+  boost::asio::ssl::context m_ssl_ctx;
+  cryptobot::EventLoop* m_loop;
+  std::unordered_map<std::string, std::unique_ptr<HostPool>> m_pools;
+};
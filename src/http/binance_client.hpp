@@ -1,6 +1,7 @@
 #pragma once
 #include "exchange/binance_settings.hpp"
 #include "exchange/exchange_client.h"
+#include "async_http_client.hpp"
 #include "http_client.hpp"
 #include "model/symbol.h"
 #include "model/order_book_update.h"
@@ -15,6 +16,8 @@
 #include <openssl/sha.h>
 
 #include <cstdlib>
+#include <future>
+#include <memory>
 #include <optional>
 
 using json = nlohmann::json;
@@ -94,8 +97,11 @@ public:
   BinanceClient()
       : m_last_order_id(0),
         m_http_client(HttpClient::Options("cryptobot-1.0.0", 1)),
+        m_async_http_client(AsyncHttpClient::Options()),
         m_timeout(1000),
         m_binance_settings(BinanceSettings::Create(GetExchangeInfo())) {
+    // Orders should not wait for handshakes
+    m_async_http_client.Warmup(HOST, PORT);
   }
 
   virtual ~BinanceClient() {
@@ -140,35 +146,23 @@ public:
   }
 
   virtual Result<Order> LimitOrder(SymbolPairId symbol, Side side, double qty, double price) override {
-    const std::string& symbol_str = GetSymbolString(symbol);
-    auto pair_settings = m_binance_settings.GetPairSettings(symbol);
-    HttpClient::Result res = m_http_client.post(HOST, PORT, ADD_ORDER_PATH)
-      .Header("X-MBX-APIKEY", g_api_key)
-      .QueryParam("symbol", symbol_str)
-      .QueryParam("side", (side == Side::BUY ? "BUY" : "SELL"))
-      .QueryParam("type", "LIMIT")
-      .QueryParam("quantity", cryptobot::to_string(qty, pair_settings.order_precision))
-      .QueryParam("price", cryptobot::to_string(price, pair_settings.price_precision))
-      // TODO: for now always GTC
-      .QueryParam("timeInForce", "GTC")
-      .WithQueryParamSigning(std::bind(&BinanceClient::SignData, this, _1, _2))
-      .send();
-    if (!res) {
-      BOOST_LOG_TRIVIAL(error) << "Error making limit order request for " << GetExchange() << ": " << res.errmsg;
-      return Result<Order>(res.response, res.errmsg);
-    }
-    json res_json = json::parse(res.response);
-    if (!res_json.contains("orderId")) {
-      const auto& errmsg = res_json["msg"].get<std::string>();
-      BOOST_LOG_TRIVIAL(error) << "Error response making limit order request for "
-          << GetExchange() << ": " << errmsg;
-      return Result<Order>(res.response, errmsg);
-    }
-    auto order_id = res_json["orderId"].get<int64_t>();
-    auto client_order_id = res_json["clientOrderId"].get<std::string>();
-    const auto& status = res_json["status"].get<std::string>();
-    auto transact_time = res_json["transactTime"].get<int64_t>();
-    return Result<Order>(res.response, Order(std::move(std::to_string(order_id)), std::move(client_order_id), symbol, side, OrderType::LIMIT, qty, price, Order::GetStatus(status), transact_time));
+    HttpClient::Result res = LimitOrderRequest(symbol, side, qty, price).send();
+    return ParseLimitOrderResponse(res, symbol, side, qty, price);
+  }
+
+  // Sent over a warm connection of the pool, in parallel with other orders
+  virtual std::future<Result<Order>> LimitOrderAsync(SymbolPairId symbol, Side side, double qty, double price) override {
+    auto promise = std::make_shared<std::promise<Result<Order>>>();
+    std::future<Result<Order>> future = promise->get_future();
+    HttpClient::Request request = LimitOrderRequest(symbol, side, qty, price);
+    m_async_http_client.Send(request, [this, promise, symbol, side, qty, price](HttpClient::Result res) {
+      try {
+        promise->set_value(ParseLimitOrderResponse(res, symbol, side, qty, price));
+      } catch (...) {
+        promise->set_exception(std::current_exception());
+      }
+    });
+    return future;
   }
 
   virtual Result<Order> SendOrder(const Order& order) override {
@@ -352,6 +346,40 @@ private:
 
   }
 
+  HttpClient::Request LimitOrderRequest(SymbolPairId symbol, Side side, double qty, double price) {
+    const std::string& symbol_str = GetSymbolString(symbol);
+    auto pair_settings = m_binance_settings.GetPairSettings(symbol);
+    return m_http_client.post(HOST, PORT, ADD_ORDER_PATH)
+      .Header("X-MBX-APIKEY", g_api_key)
+      .QueryParam("symbol", symbol_str)
+      .QueryParam("side", (side == Side::BUY ? "BUY" : "SELL"))
+      .QueryParam("type", "LIMIT")
+      .QueryParam("quantity", cryptobot::to_string(qty, pair_settings.order_precision))
+      .QueryParam("price", cryptobot::to_string(price, pair_settings.price_precision))
+      // TODO: for now always GTC
+      .QueryParam("timeInForce", "GTC")
+      .WithQueryParamSigning(std::bind(&BinanceClient::SignData, this, _1, _2));
+  }
+
+  Result<Order> ParseLimitOrderResponse(const HttpClient::Result& res, SymbolPairId symbol, Side side, double qty, double price) {
+    if (!res) {
+      BOOST_LOG_TRIVIAL(error) << "Error making limit order request for " << GetExchange() << ": " << res.errmsg;
+      return Result<Order>(res.response, res.errmsg);
+    }
+    json res_json = json::parse(res.response);
+    if (!res_json.contains("orderId")) {
+      const auto& errmsg = res_json["msg"].get<std::string>();
+      BOOST_LOG_TRIVIAL(error) << "Error response making limit order request for "
+          << GetExchange() << ": " << errmsg;
+      return Result<Order>(res.response, errmsg);
+    }
+    auto order_id = res_json["orderId"].get<int64_t>();
+    auto client_order_id = res_json["clientOrderId"].get<std::string>();
+    const auto& status = res_json["status"].get<std::string>();
+    auto transact_time = res_json["transactTime"].get<int64_t>();
+    return Result<Order>(res.response, Order(std::move(std::to_string(order_id)), std::move(client_order_id), symbol, side, OrderType::LIMIT, qty, price, Order::GetStatus(status), transact_time));
+  }
+
   HttpClient::Result SendLimitOrder(const Order& order) {
     const auto& new_client_id = order.GetClientId();
     SymbolPairId symbol = order.GetSymbolId();
@@ -420,6 +448,7 @@ private:
 private:
   uint64_t m_last_order_id;
   HttpClient m_http_client;
+  AsyncHttpClient m_async_http_client;
   int m_timeout;
   BinanceSettings m_binance_settings;
 };
\ No newline at end of file
@@ -14,6 +14,8 @@
 #include <boost/asio/ssl/stream.hpp>
 #include <boost/log/trivial.hpp>
 
+#include <functional>
+#include <optional>
 #include <string>
 #include <unordered_map>
 
@@ -137,6 +139,7 @@ public:
     std::function<void(Request&, std::string&)> m_signing_function;
 
     friend class HttpClient;
+    friend class AsyncHttpClient;
   };
 
 public:
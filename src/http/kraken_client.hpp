@@ -1,6 +1,7 @@
 #pragma once
 
 #include "exchange/exchange_client.h"
+#include "async_http_client.hpp"
 #include "http_client.hpp"
 #include "model/kraken.h"
 #include "model/symbol.h"
@@ -12,6 +13,8 @@
 
 #include <array>
 #include <functional>
+#include <future>
+#include <memory>
 #include <sstream>
 #include <unordered_map>
 #include <vector>
@@ -113,8 +116,11 @@ public:
   inline static const std::string GET_OPEN_ORDERS_PATH = "/0/private/OpenOrders";
   inline static const std::string GET_WEB_SOCKETS_TOKEN_PATH = "/0/private/GetWebSocketsToken";
 
-  KrakenClient() : m_http_client(HttpClient::Options("cryptobot-1.0.0", 1)) {
-
+  KrakenClient()
+      : m_http_client(HttpClient::Options("cryptobot-1.0.0", 1)),
+        m_async_http_client(AsyncHttpClient::Options()) {
+    // Orders should not wait for handshakes
+    m_async_http_client.Warmup(HOST, PORT);
   }
 
   virtual std::string GetExchange() override {
@@ -149,35 +155,23 @@ public:
 
   // TODO: add expiration time ?
   virtual Result<Order> LimitOrder(SymbolPairId symbol, Side side, double qty, double price) override {
-    const std::string& symbol_str = GetSymbolString(symbol);
-    if (KRAKEN_ORDER_PRECISIONS_MAP.count(symbol) == 0) {
-      BOOST_LOG_TRIVIAL(error) << "Unknown Kraken order price precision for " << symbol << ". Exiting...";
-      // This should not happen, but in case it does better stop the bot
-      std::exit(1);
-    }
-    const auto& precision_settings = KRAKEN_ORDER_PRECISIONS_MAP.at(symbol);
-    HttpClient::Result res = m_http_client.post(HOST, PORT, ADD_ORDER_PATH)
-        .QueryParam("pair", symbol_str)
-        .QueryParam("type", (Side::BUY == side ? "buy" : "sell"))
-        .QueryParam("ordertype", "limit")
-        .QueryParam("price", cryptobot::to_string(price, precision_settings.m_price_precision))
-        .QueryParam("volume", std::to_string(qty))
-        .Header("API-Key", g_public_key)
-        .WithQueryParamSigning(std::bind(&KrakenClient::SignQueryString, this, _1, _2))
-        .send();
-      if (!res) {
-        BOOST_LOG_TRIVIAL(error) << "Error making limit order request for " << GetExchange() << ": " << res.errmsg;
-        return Result<Order>(res.response, res.errmsg);
-      }
-      json response_json = json::parse(res.response);
-      if (response_json["error"].size() > 0) {
-        // TODO: propagate all errors ?
-        return Result<Order>(res.response, response_json["error"][0]);
+    HttpClient::Result res = LimitOrderRequest(symbol, side, qty, price).send();
+    return ParseLimitOrderResponse(res, symbol, side, qty);
+  }
+
+  // Sent over a warm connection of the pool, in parallel with other orders
+  virtual std::future<Result<Order>> LimitOrderAsync(SymbolPairId symbol, Side side, double qty, double price) override {
+    auto promise = std::make_shared<std::promise<Result<Order>>>();
+    std::future<Result<Order>> future = promise->get_future();
+    HttpClient::Request request = LimitOrderRequest(symbol, side, qty, price);
+    m_async_http_client.Send(request, [this, promise, symbol, side, qty](HttpClient::Result res) {
+      try {
+        promise->set_value(ParseLimitOrderResponse(res, symbol, side, qty));
+      } catch (...) {
+        promise->set_exception(std::current_exception());
       }
-      // TODO: support multiple transaction ids per order ?
-      BOOST_LOG_TRIVIAL(debug) << "LimitOrder response from " << GetExchange() << ": " << std::endl << res.response << std::endl;
-      auto order_id = response_json["result"]["txid"][0].get<std::string>();
-      return Result<Order>(res.response, Order(order_id, order_id, symbol, side, OrderType::LIMIT, qty));
+    });
+    return future;
   }
 
   virtual Result<Order> SendOrder(const Order& order) override {
@@ -286,6 +280,40 @@ public:
   }
 
 private:
+  HttpClient::Request LimitOrderRequest(SymbolPairId symbol, Side side, double qty, double price) {
+    const std::string& symbol_str = GetSymbolString(symbol);
+    if (KRAKEN_ORDER_PRECISIONS_MAP.count(symbol) == 0) {
+      BOOST_LOG_TRIVIAL(error) << "Unknown Kraken order price precision for " << symbol << ". Exiting...";
+      // This should not happen, but in case it does better stop the bot
+      std::exit(1);
+    }
+    const auto& precision_settings = KRAKEN_ORDER_PRECISIONS_MAP.at(symbol);
+    return m_http_client.post(HOST, PORT, ADD_ORDER_PATH)
+        .QueryParam("pair", symbol_str)
+        .QueryParam("type", (Side::BUY == side ? "buy" : "sell"))
+        .QueryParam("ordertype", "limit")
+        .QueryParam("price", cryptobot::to_string(price, precision_settings.m_price_precision))
+        .QueryParam("volume", std::to_string(qty))
+        .Header("API-Key", g_public_key)
+        .WithQueryParamSigning(std::bind(&KrakenClient::SignQueryString, this, _1, _2));
+  }
+
+  Result<Order> ParseLimitOrderResponse(const HttpClient::Result& res, SymbolPairId symbol, Side side, double qty) {
+    if (!res) {
+      BOOST_LOG_TRIVIAL(error) << "Error making limit order request for " << GetExchange() << ": " << res.errmsg;
+      return Result<Order>(res.response, res.errmsg);
+    }
+    json response_json = json::parse(res.response);
+    if (response_json["error"].size() > 0) {
+      // TODO: propagate all errors ?
+      return Result<Order>(res.response, response_json["error"][0]);
+    }
+    // TODO: support multiple transaction ids per order ?
+    BOOST_LOG_TRIVIAL(debug) << "LimitOrder response from " << GetExchange() << ": " << std::endl << res.response << std::endl;
+    auto order_id = response_json["result"]["txid"][0].get<std::string>();
+    return Result<Order>(res.response, Order(order_id, order_id, symbol, side, OrderType::LIMIT, qty));
+  }
+
   void SignQueryString(HttpClient::Request& request, std::string& query_string) {
     struct timeval sys_time;
     gettimeofday(&sys_time, nullptr);
@@ -315,4 +343,5 @@ private:
 
 private:
   HttpClient m_http_client;
+  AsyncHttpClient m_async_http_client;
 };
\ No newline at end of file
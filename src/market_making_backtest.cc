@@ -1,9 +1,14 @@
+#include "backtest/backtest_checkpointer.hpp"
 #include "backtest/backtest_exchange_client.hpp"
 #include "backtest/backtest_results_processor.h"
+#include "backtest/parallel_replay_runner.hpp"
+#include "backtest/parameter_sweep.hpp"
 #include "exchange/exchange_client.h"
+#include "db/capture_file_reader.hpp"
 #include "db/mongo_client.hpp"
 #include "db/mongo_ticker_producer.hpp"
 #include "strategy/market_making/market_making_strategy.h"
+#include "utils/checkpoint.hpp"
 #include "utils/config.hpp"
 #include "utils/string.h"
 
@@ -13,12 +18,128 @@
 #include <boost/log/trivial.hpp>
 #include <boost/log/expressions.hpp>
 
+#include <algorithm>
 #include <cerrno>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
 
 namespace logging = boost::log;
 namespace keywords = boost::log::keywords;
 
+namespace {
+
+// Parameters that can be swept, see MarketMakingBacktest
+const char* const SWEEP_PARAMETERS[] = {
+  "fee",
+  "network_latency_us",
+  "execution_delay_us",
+  "default_order_qty",
+  "our_fee",
+  "order_expiration_us",
+  "max_orders_count",
+  "order_placing_probability",
+  "exp_rate_limit_coeff",
+};
+
+const std::unordered_map<SymbolId, double> INITIAL_BALANCES = {
+  {SymbolId::ADA, 10000.0},
+  {SymbolId::USDT, 24000}
+};
+
+/**
+ * Backtest client, risk manager and strategy of one run, parameters missing from the set take the default values.
+ */
+struct MarketMakingBacktest {
+  /**
+   * @param latency_config latency model config, see LatencyModel::FromJson()
+   * @param checkpoint state to resume from, nullptr to start from the initial balances
+   */
+  MarketMakingBacktest(const std::string& results_file, const ParameterGrid::ParameterSet& params, const cryptobot::json& latency_config,
+      const cryptobot::Checkpoint* checkpoint = nullptr)
+      : results_processor(results_file, {SymbolId::USDT, SymbolId::ADA}, CreateResultsOptions()),
+        binance_backtest_client(CreateBacktestSettings(params, latency_config), results_processor, &scheduler),
+        risk_manager(CreateRiskManagerOptions(params), &binance_backtest_client),
+        market_making_strategy(risk_manager) {
+    // Report back about order and account balance changes
+    binance_backtest_client.RegisterUserDataListener(&risk_manager);
+    if (checkpoint) {
+      checkpoint->Restore("binance_client", binance_backtest_client);
+      checkpoint->Restore("risk_manager", risk_manager);
+      checkpoint->Restore("strategy", market_making_strategy);
+      scheduler.AdvanceTo(checkpoint->GetTimestamp());
+    }
+    // Results of a resumed run start from the checkpointed balances
+    results_processor.SetInitialBalance(binance_backtest_client.GetAccountBalance().Get());
+  }
+
+  void AddTo(BacktestCheckpointer& checkpointer) const {
+    checkpointer.Add("binance_client", &binance_backtest_client);
+    checkpointer.Add("risk_manager", &risk_manager);
+    checkpointer.Add("strategy", &market_making_strategy);
+  }
+
+  // First latencies recorded from the data, then the client, so that execution price is same as seen price
+  std::vector<ExchangeListener*> GetListeners() {
+    std::vector<ExchangeListener*> listeners;
+    if (auto* recorded = dynamic_cast<RecordedLatencyModel*>(latency_model.get())) {
+      listeners.push_back(recorded);
+    }
+    listeners.insert(listeners.end(), {&results_processor, &binance_backtest_client, &market_making_strategy});
+    return listeners;
+  }
+
+  BacktestSettings CreateBacktestSettings(const ParameterGrid::ParameterSet& params, const cryptobot::json& latency_config) {
+    BacktestSettings settings;
+    // TODO: FIXME: slippage value per pair
+    settings.exchange = "binance";
+    settings.slippage = 0;
+    settings.fee = ParameterGrid::GetValue(params, "fee", 0.00075);
+    settings.network_latency_us = ParameterGrid::GetValue(params, "network_latency_us", 200000);
+    settings.execution_delay_us = ParameterGrid::GetValue(params, "execution_delay_us", 20000);
+    settings.initial_balances = INITIAL_BALANCES;
+    if (!latency_config.is_null()) {
+      latency_model = LatencyModel::FromJson(latency_config);
+      settings.latency_model = latency_model;
+    }
+    // Risk manager sees orders acknowledged with realistic delay
+    settings.notify_order_acks = true;
+    return settings;
+  }
+
+  // Equity valued in USDT
+  static ResultsOptions CreateResultsOptions() {
+    ResultsOptions options;
+    options.valuation_asset = SymbolId::USDT;
+    return options;
+  }
+
+  // Risk manager, manages orders
+  static MarketMakingRiskMangerOptions CreateRiskManagerOptions(const ParameterGrid::ParameterSet& params) {
+    MarketMakingRiskMangerOptions risk_manager_options;
+    risk_manager_options.default_order_qty = ParameterGrid::GetValue(params, "default_order_qty", 100);
+    risk_manager_options.exchange_fee = ParameterGrid::GetValue(params, "fee", 0.00075);
+    risk_manager_options.our_fee = ParameterGrid::GetValue(params, "our_fee", 0.00025);
+    risk_manager_options.order_expiration_us = ParameterGrid::GetValue(params, "order_expiration_us", 900000000); // 15 minutes
+    risk_manager_options.max_orders_count = ParameterGrid::GetValue(params, "max_orders_count", 10);
+    risk_manager_options.order_placing_probability = ParameterGrid::GetValue(params, "order_placing_probability", 0.02);
+    risk_manager_options.exp_rate_limit_coeff = ParameterGrid::GetValue(params, "exp_rate_limit_coeff", 10.0d);
+    return risk_manager_options;
+  }
+
+  std::shared_ptr<LatencyModel> latency_model;
+  // Clock of the client's order events
+  EventScheduler scheduler;
+  BacktestResultsProcessor results_processor;
+  BacktestExchangeClient binance_backtest_client;
+  MarketMakingRiskManager risk_manager;
+  MarketMakingStrategy market_making_strategy;
+};
+
+}
+
 int main(int argc, char* argv[]) {
   if (argc < 2) {
     std::cerr << "Please provide configuration file" << std::endl;
@@ -39,44 +160,98 @@ int main(int argc, char* argv[]) {
   std::cout << "Created Mongo client pool" << std::endl;
   pass.clear();
 
-  BacktestResultsProcessor backtest_results_processor("backtest_results.csv", {SymbolId::USDT, SymbolId::ADA});
-  BacktestSettings binance_backtest_settings;
-  // TODO: FIXME: slippage value per pair
-  binance_backtest_settings.exchange = "binance";
-  binance_backtest_settings.slippage = 0;
-  binance_backtest_settings.fee = 0.00075;
-  binance_backtest_settings.network_latency_us = 200000;
-  binance_backtest_settings.execution_delay_us = 20000;
-  binance_backtest_settings.initial_balances = {
-    {SymbolId::ADA, 10000.0},
-    {SymbolId::USDT, 24000}
-  };
-
-  BacktestExchangeClient binance_backtest_client(binance_backtest_settings, backtest_results_processor);
+  // Eg. {"type": "recorded", "exchange": "binance", "fallback_us": 200000}
+  const cryptobot::json latency_config = config_json.contains("latency") ? config_json["latency"] : cryptobot::json();
+  ParameterGrid grid;
+  if (config_json.contains("sweep")) {
+    grid = ParameterGrid::FromJson(config_json["sweep"]);
+    for (const auto& name : grid.GetNames()) {
+      if (std::find(std::begin(SWEEP_PARAMETERS), std::end(SWEEP_PARAMETERS), name) == std::end(SWEEP_PARAMETERS)) {
+        std::cerr << "Unknown sweep parameter " << name << std::endl;
+        return -1;
+      }
+    }
+  }
+  // Checkpoints are taken of a single run replayed from a capture file, every run of a sweep can resume from one,
+  // eg. "checkpoint": {"interval_minutes": 60, "prefix": "mm"}, "resume_from": "mm_1614556800000000.ckpt"
+  if ((config_json.contains("checkpoint") || config_json.contains("resume_from")) && !config_json.contains("capture_file")) {
+    std::cerr << "Checkpoints need a capture_file" << std::endl;
+    return -1;
+  }
+  if (config_json.contains("checkpoint") && grid.size() > 0) {
+    std::cerr << "Checkpoints are not taken in sweep mode" << std::endl;
+    return -1;
+  }
+  std::optional<cryptobot::Checkpoint> checkpoint;
+  if (config_json.contains("resume_from")) {
+    checkpoint = cryptobot::Checkpoint::Load(config_json["resume_from"].get<std::string>());
+    std::cout << "Resuming from " << config_json["resume_from"].get<std::string>() << std::endl;
+  }
+  // Without a sweep, a single run with the default parameters is registered with the producer directly
+  const auto parameter_sets = grid.size() > 0 ? grid.Expand() : std::vector<ParameterGrid::ParameterSet>(1);
+  std::vector<std::unique_ptr<MarketMakingBacktest>> backtests;
+  for (size_t i = 0; i < parameter_sets.size(); ++i) {
+    const std::string results_file = grid.size() > 0 ? "backtest_results_" + std::to_string(i) + ".csv" : "backtest_results.csv";
+    backtests.push_back(std::make_unique<MarketMakingBacktest>(results_file, parameter_sets[i], latency_config,
+        checkpoint ? &checkpoint.value() : nullptr));
+  }
+  ParallelReplayOptions sweep_options;
+  if (config_json.contains("sweep_threads")) {
+    sweep_options.threads = config_json["sweep_threads"].get<size_t>();
+  }
+  ParallelReplayRunner sweep_runner(sweep_options);
+  std::vector<ExchangeListener*> listeners;
+  if (grid.size() > 0) {
+    for (auto& backtest : backtests) {
+      sweep_runner.AddInstance(backtest->GetListeners());
+    }
+    listeners.push_back(&sweep_runner);
+    std::cout << "Sweeping " << parameter_sets.size() << " parameter sets on " << sweep_options.threads << " threads" << std::endl;
+  } else {
+    listeners = backtests.front()->GetListeners();
+  }
 
-  // Risk manager, manages orders
-  MarketMakingRiskMangerOptions risk_manager_options;
-  risk_manager_options.default_order_qty = 100;
-  risk_manager_options.exchange_fee = 0.00075;
-  risk_manager_options.our_fee = 0.00025;
-  risk_manager_options.order_expiration_us = 900000000; // 15 minutes
-  risk_manager_options.max_orders_count = 10;
-  risk_manager_options.order_placing_probability = 0.02;
-  risk_manager_options.exp_rate_limit_coeff = 10.0d;
-  MarketMakingRiskManager risk_manager(risk_manager_options, &binance_backtest_client);
-
-  // Report back about order and account balance changes
-  binance_backtest_client.RegisterUserDataListener(&risk_manager);
-
-  MarketMakingStrategy market_making_strategy(risk_manager);
-
-  MongoTickerProducer mongo_producer(mongo_client, config_json["db"].get<std::string>(), config_json["collection"].get<std::string>());
-  // First register clients, so that execution price is same as seen price
-  mongo_producer.Register(&binance_backtest_client);
-  mongo_producer.Register(&market_making_strategy);
-
-  int64_t count = mongo_producer.Produce();
+  int64_t count = 0;
+  if (config_json.contains("capture_file")) {
+    // Replay from a local capture file instead of Mongo
+    CaptureFileReader capture_reader(config_json["capture_file"].get<std::string>());
+    if (checkpoint) {
+      checkpoint->Restore("replay", capture_reader);
+    }
+    for (auto* listener : listeners) {
+      capture_reader.Register(listener);
+    }
+    std::unique_ptr<BacktestCheckpointer> checkpointer;
+    if (config_json.contains("checkpoint")) {
+      const auto& checkpoint_config = config_json["checkpoint"];
+      const uint64_t interval_us = checkpoint_config["interval_minutes"].get<uint64_t>() * 60 * 1000000;
+      MarketMakingBacktest& backtest = *backtests.front();
+      checkpointer = std::make_unique<BacktestCheckpointer>(checkpoint_config["prefix"].get<std::string>(), interval_us, backtest.scheduler);
+      backtest.AddTo(*checkpointer);
+      checkpointer->Add("replay", &capture_reader);
+      // After the backtest, so checkpoints hold the state after an event
+      capture_reader.Register(checkpointer.get());
+    }
+    count = capture_reader.Produce();
+  } else {
+    MongoTickerProducer mongo_producer(mongo_client, config_json["db"].get<std::string>(), config_json["collection"].get<std::string>());
+    for (auto* listener : listeners) {
+      mongo_producer.Register(listener);
+    }
+    count = mongo_producer.Produce();
+  }
+  if (grid.size() > 0) {
+    sweep_runner.Finish();
+  }
   std::cout << "Produced " + std::to_string(count) + " events" << std::endl;
 
+  for (size_t i = 0; i < backtests.size() && grid.size() > 0; ++i) {
+    BOOST_LOG_TRIVIAL(info) << "Run " << i << " (" << ParameterGrid::ToString(parameter_sets[i]) << "), balances:";
+    BOOST_LOG_TRIVIAL(info) << backtests[i]->results_processor.GetCumulativeBalances();
+  }
+  for (size_t i = 0; i < backtests.size(); ++i) {
+    BOOST_LOG_TRIVIAL(info) << "Run " << i << " metrics: " << backtests[i]->results_processor.GetMetrics();
+  }
+
   return 0;
 }
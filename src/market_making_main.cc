@@ -1,3 +1,5 @@
+#include "backtest/backtest_exchange_client.hpp"
+#include "db/capture_file_reader.hpp"
 #include "http/binance_client.hpp"
 #include "model/symbol.h"
 #include "strategy/market_making/market_making_strategy.h"
@@ -5,6 +7,10 @@
 #include "websocket/binance_order_book_stream.hpp"
 #include "websocket/binance_trade_ticker_stream.hpp"
 #include "websocket/binance_user_data_stream.hpp"
+#include "websocket/feed_replayer.hpp"
+#include "websocket/replay_messages.hpp"
+#include "utils/config.hpp"
+#include "utils/event_loop.hpp"
 
 #include <boost/log/core.hpp>
 #include <boost/log/trivial.hpp>
@@ -16,6 +22,7 @@
 #include <chrono>
 #include <future>
 #include <iostream>
+#include <memory>
 #include <thread>
 
 namespace logging = boost::log;
@@ -30,51 +37,138 @@ void InitLogging() {
   logging::add_common_attributes();
 }
 
-int main(int argc, char* argv[]) {
-  (void)argc;
-  (void)argv;
+class NoopAccountBalanceListener : public AccountBalanceListener {
+public:
+  virtual void OnAccountBalanceUpdate(const AccountBalance&) override {}
+};
+
+// Client of replay mode, orders are accepted but never filled since it gets no market data: it is not
+// thread safe, and would be fed by the capture reader while the strategy thread sends orders
+std::unique_ptr<ExchangeClient> CreatePaperClient(const std::string& exchange, AccountBalanceListener& balance_listener) {
+  BacktestSettings settings{};
+  settings.exchange = exchange;
+  return std::make_unique<BacktestExchangeClient>(settings, balance_listener);
+}
+
+// Runs the stream on the event loop it is assigned to, if any
+void AssignEventLoop(WebsocketClient& stream, const std::string& name, const cryptobot::EventLoopGroup& event_loops) {
+  if (cryptobot::EventLoop* event_loop = event_loops.GetStreamLoop(name)) {
+    stream.set_event_loop(*event_loop);
+  }
+}
 
+/**
+ * Usage: market_making_main [config.json]
+ *
+ * With a capture file in the config, eg. {"capture_file": "adausdt.cap", "speed": 10}, recorded market data
+ * is injected into the market data streams instead of connecting to Binance (see FeedReplayer), orders go
+ * to a paper client that never fills them, and stream latencies are logged at the end of the replay. The order
+ * book starts from the first recorded snapshot, precisions of ADAUSDT can be set with "price_precision" and
+ * "order_precision" since they are not requested from Binance.
+ *
+ * Streams run on threads of their own, unless assigned to a shared event loop (see cryptobot::EventLoopGroup)
+ * in "event_loops", eg. {"event_loops": {"feeds": {"cpu": 2, "busy_poll": true, "streams": ["binance_book_ticker",
+ * "binance_trade_ticker", "binance_order_book"]}}}. Streams are named binance_user_data, binance_book_ticker,
+ * binance_trade_ticker and binance_order_book.
+ */
+int main(int argc, char* argv[]) {
   InitLogging();
   BOOST_LOG_TRIVIAL(info) << "Boost logging configured";
 
+  const cryptobot::json config = argc > 1 ? cryptobot::GetConfigJson(argv[1]) : cryptobot::json::object();
+  const bool replay = config.contains("capture_file");
+  cryptobot::EventLoopGroup event_loops(config.value("event_loops", cryptobot::json::object()));
+  event_loops.Start();
+
   // Risk manager, manages orders
   MarketMakingRiskMangerOptions risk_manager_options;
   risk_manager_options.default_order_qty = 100;
   risk_manager_options.exchange_fee = 0.00075;
   risk_manager_options.our_fee = 0.00025;
-  BinanceClient binance_orders_client;
-  MarketMakingRiskManager risk_manager(risk_manager_options, &binance_orders_client);
+  NoopAccountBalanceListener paper_balance_listener;
+  std::unique_ptr<ExchangeClient> binance_orders_client = replay ? CreatePaperClient("binance", paper_balance_listener) : std::make_unique<BinanceClient>();
+  MarketMakingRiskManager risk_manager(risk_manager_options, binance_orders_client.get());
 
-  // User data stream
-  BinanceUserDataStream binance_stream = BinanceUserDataStream::Create(risk_manager);
-  std::promise<void> binance_stream_promise;
-  std::future<void> binance_user_future = binance_stream_promise.get_future();
-  binance_stream.start(std::move(binance_stream_promise));
-  binance_user_future.wait();
+  // User data stream, there is no account to follow in replay mode
+  std::unique_ptr<BinanceUserDataStream> binance_stream;
+  if (!replay) {
+    // Initialized in place, a started stream can't be moved
+    binance_stream.reset(new BinanceUserDataStream(BinanceUserDataStream::Create(risk_manager)));
+    AssignEventLoop(*binance_stream, "binance_user_data", event_loops);
+    std::promise<void> binance_stream_promise;
+    std::future<void> binance_user_future = binance_stream_promise.get_future();
+    binance_stream->start(std::move(binance_stream_promise));
+    binance_user_future.wait();
+  }
 
   MarketMakingStrategy market_making_strategy(risk_manager);
+  // Keep feed threads free of strategy work
+  market_making_strategy.Start();
 
   // Market data streams
   BinanceBookTickerStream binance_book_ticker_stream(&market_making_strategy);
+  AssignEventLoop(binance_book_ticker_stream, "binance_book_ticker", event_loops);
   std::promise<void> binance_book_ticker_promise;
   std::future<void> binance_book_ticker_future = binance_book_ticker_promise.get_future();
-  binance_book_ticker_stream.start(std::move(binance_book_ticker_promise));
+  if (replay) {
+    binance_book_ticker_stream.start_replay(std::move(binance_book_ticker_promise));
+  } else {
+    binance_book_ticker_stream.start(std::move(binance_book_ticker_promise));
+  }
   binance_book_ticker_future.wait();
 
   binance_book_ticker_stream.SubscribeTicker("adausdt");
 
   BinanceTradeTickerStream trade_ticker_stream(&market_making_strategy);
+  AssignEventLoop(trade_ticker_stream, "binance_trade_ticker", event_loops);
   std::promise<void> binance_trade_ticker_promise;
   std::future<void> binance_trade_ticker_future = binance_trade_ticker_promise.get_future();
-  trade_ticker_stream.start(std::move(binance_trade_ticker_promise));
+  if (replay) {
+    trade_ticker_stream.start_replay(std::move(binance_trade_ticker_promise));
+  } else {
+    trade_ticker_stream.start(std::move(binance_trade_ticker_promise));
+  }
   binance_trade_ticker_future.wait();
 
   trade_ticker_stream.SubscribeTicker("adausdt");
 
+  if (replay) {
+    SymbolPairSettings pair_settings{};
+    pair_settings.symbol = "ADAUSDT";
+    pair_settings.price_precision = config.value("price_precision", 4);
+    pair_settings.order_precision = config.value("order_precision", 1);
+    BinanceOrderBookStream binance_order_book_stream(pair_settings, nullptr, &market_making_strategy);
+    AssignEventLoop(binance_order_book_stream, "binance_order_book", event_loops);
+    std::promise<void> binance_order_book_promise;
+    std::future<void> binance_order_book_future = binance_order_book_promise.get_future();
+    binance_order_book_stream.start_replay(std::move(binance_order_book_promise));
+    binance_order_book_future.wait();
+
+    FeedReplayOptions replay_options;
+    replay_options.speed = config.value("speed", 1.0);
+    FeedReplayer replayer(replay_options);
+    replayer.AddBookTickerStream("binance", "binance book ticker", binance_book_ticker_stream, replay_messages::BinanceBookTicker);
+    replayer.AddTradeTickerStream("binance", "binance trade ticker", trade_ticker_stream, replay_messages::BinanceTrade);
+    replayer.AddOrderBookStream("binance", "binance order book", binance_order_book_stream, replay_messages::BinanceDepthEncoder());
+    CaptureFileReader capture_reader(config["capture_file"].get<std::string>());
+    capture_reader.Register(&replayer);
+    capture_reader.Produce();
+    replayer.Finish();
+    replayer.LogReport();
+    market_making_strategy.Stop();
+    binance_book_ticker_stream.stop_replay();
+    trade_ticker_stream.stop_replay();
+    binance_order_book_stream.stop_replay();
+    // Before the streams of the loops are gone
+    event_loops.Stop();
+    return 0;
+  }
+
   BinanceClient binance_client;
   BinanceSettings binance_settings = binance_client.GetBinanceSettings();
   // TODO: specify pair from config
   BinanceOrderBookStream binance_order_book_stream(binance_settings.GetPairSettings(SymbolPairId::ADA_USDT), &binance_client, &market_making_strategy);
+  AssignEventLoop(binance_order_book_stream, "binance_order_book", event_loops);
   std::promise<void> binance_order_book_promise;
   std::future<void> binance_order_book_future = binance_order_book_promise.get_future();
   binance_order_book_stream.start(std::move(binance_order_book_promise));
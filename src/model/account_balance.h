@@ -41,22 +41,24 @@ struct AccountBalance {
   }
 
   AccountBalance(AccountBalance&& b) : AccountBalance(std::move(b.m_asset_balance_map), std::move(b.m_locked_balance_map)) {
-    
+    m_exchange = std::move(b.m_exchange);
   }
 
-  AccountBalance(const AccountBalance& b) : AccountBalance(b.m_asset_balance_map, b.m_locked_balance_map) {
+  AccountBalance(const AccountBalance& b) : AccountBalance(b.m_asset_balance_map, b.m_locked_balance_map, b.m_exchange) {
     
   }
 
   AccountBalance& operator=(const AccountBalance& account_balance) {
     m_asset_balance_map = account_balance.m_asset_balance_map;
     m_locked_balance_map = account_balance.m_locked_balance_map;
+    m_exchange = account_balance.m_exchange;
     return *this;
   }
 
   AccountBalance& operator=(AccountBalance&& account_balance) {
     m_asset_balance_map = std::move(account_balance.m_asset_balance_map);
     m_locked_balance_map = std::move(account_balance.m_locked_balance_map);
+    m_exchange = std::move(account_balance.m_exchange);
     return *this;
   }
 
@@ -0,0 +1,149 @@
+#include "compact_event.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+void EventBatch::Add(const Ticker& ticker) {
+  CompactEvent& event = AddEvent(EventType::BOOK_TICKER, ticker.arrived_ts, ticker.exchange, ticker.symbol);
+  event.ticker.bid = ticker.bid;
+  event.ticker.bid_vol = ticker.bid_vol.value_or(0);
+  event.ticker.ask = ticker.ask;
+  event.ticker.ask_vol = ticker.ask_vol.value_or(0);
+  event.ticker.source_ts = ticker.source_ts.value_or(0);
+  event.flags = (ticker.bid_vol.has_value() ? CompactEvent::HAS_BID_VOL : 0)
+      | (ticker.ask_vol.has_value() ? CompactEvent::HAS_ASK_VOL : 0)
+      | (ticker.source_ts.has_value() ? CompactEvent::HAS_SOURCE_TS : 0);
+}
+
+void EventBatch::Add(const TradeTicker& trade_ticker) {
+  CompactEvent& event = AddEvent(EventType::TRADE_TICKER, trade_ticker.arrived_ts, trade_ticker.exchange, trade_ticker.symbol);
+  event.trade.event_time = trade_ticker.event_time;
+  event.trade.trade_time = trade_ticker.trade_time;
+  event.trade.price = trade_ticker.price;
+  event.trade.qty = trade_ticker.qty;
+  event.flags = trade_ticker.is_market_maker ? CompactEvent::IS_MARKET_MAKER : 0;
+  SetTradeId(event, trade_ticker.trade_id);
+}
+
+void EventBatch::Add(const OrderBookUpdate& ob_update) {
+  CompactEvent& event = AddEvent(EventType::BOOK_DIFF, ob_update.arrived_ts, ob_update.exchange, ob_update.symbol);
+  event.diff.last_update_id = ob_update.last_update_id;
+  event.diff.bid_count = static_cast<uint32_t>(ob_update.bids.size());
+  event.diff.ask_count = static_cast<uint32_t>(ob_update.asks.size());
+  OrderBookUpdate::Level* levels = AllocateLevels(ob_update.bids.size() + ob_update.asks.size());
+  std::uninitialized_copy(ob_update.bids.begin(), ob_update.bids.end(), levels);
+  std::uninitialized_copy(ob_update.asks.begin(), ob_update.asks.end(), levels + ob_update.bids.size());
+  event.diff.levels = levels;
+  event.flags = ob_update.is_snapshot ? CompactEvent::IS_SNAPSHOT : 0;
+}
+
+CompactEvent& EventBatch::AddEvent(EventType type, uint64_t arrived_ts, std::string_view exchange, SymbolPairId symbol) {
+  CompactEvent& event = m_events.emplace_back();
+  event.arrived_ts = arrived_ts;
+  event.type = type;
+  event.exchange = InternExchange(exchange);
+  event.flags = 0;
+  event.symbol = symbol;
+  return event;
+}
+
+void EventBatch::SetTradeId(CompactEvent& event, std::string_view trade_id) {
+  // Numbers with leading zeros would not format back to the same id
+  const bool canonical = !trade_id.empty() && (trade_id[0] != '0' || trade_id.size() == 1);
+  uint64_t id = 0;
+  if (canonical) {
+    auto [ptr, ec] = std::from_chars(trade_id.data(), trade_id.data() + trade_id.size(), id);
+    if (ec == std::errc() && ptr == trade_id.data() + trade_id.size()) {
+      event.trade.trade_id = id;
+      event.trade.trade_id_str = nullptr;
+      event.trade.trade_id_size = 0;
+      event.flags &= ~CompactEvent::TRADE_ID_STRING;
+      return;
+    }
+  }
+  char* str = m_arena.allocate<char>(trade_id.size());
+  std::memcpy(str, trade_id.data(), trade_id.size());
+  event.trade.trade_id = 0;
+  event.trade.trade_id_str = str;
+  event.trade.trade_id_size = static_cast<uint32_t>(trade_id.size());
+  event.flags |= CompactEvent::TRADE_ID_STRING;
+}
+
+void EventBatch::EndRun() {
+  const uint32_t end = static_cast<uint32_t>(m_events.size());
+  if (end > m_run_begin) {
+    m_runs.emplace_back(m_run_begin, end);
+  }
+  m_run_begin = end;
+}
+
+void EventBatch::Clear() {
+  m_events.clear();
+  m_runs.clear();
+  m_run_begin = 0;
+  m_exchanges.clear();
+  m_arena.reset();
+}
+
+uint8_t EventBatch::InternExchange(std::string_view exchange) {
+  // Batches see a handful of exchanges, linear search beats hashing
+  for (size_t i = 0; i < m_exchanges.size(); ++i) {
+    if (m_exchanges[i] == exchange) {
+      return static_cast<uint8_t>(i);
+    }
+  }
+  if (m_exchanges.size() > std::numeric_limits<uint8_t>::max()) {
+    throw std::runtime_error("EventBatch: too many exchanges");
+  }
+  m_exchanges.emplace_back(exchange);
+  return static_cast<uint8_t>(m_exchanges.size() - 1);
+}
+
+const Ticker& EventMaterializer::GetTicker(const EventBatch& batch, const CompactEvent& event) {
+  m_ticker.arrived_ts = event.arrived_ts;
+  m_ticker.exchange = batch.GetExchangeName(event.exchange);
+  m_ticker.symbol = event.symbol;
+  m_ticker.id = 0;
+  m_ticker.bid = event.ticker.bid;
+  m_ticker.ask = event.ticker.ask;
+  m_ticker.bid_vol = event.HasFlag(CompactEvent::HAS_BID_VOL) ? std::optional<double>(event.ticker.bid_vol) : std::nullopt;
+  m_ticker.ask_vol = event.HasFlag(CompactEvent::HAS_ASK_VOL) ? std::optional<double>(event.ticker.ask_vol) : std::nullopt;
+  m_ticker.source_ts = event.HasFlag(CompactEvent::HAS_SOURCE_TS) ? std::optional<uint64_t>(event.ticker.source_ts) : std::nullopt;
+  return m_ticker;
+}
+
+const TradeTicker& EventMaterializer::GetTradeTicker(const EventBatch& batch, const CompactEvent& event) {
+  m_trade_ticker.arrived_ts = event.arrived_ts;
+  m_trade_ticker.exchange = batch.GetExchangeName(event.exchange);
+  m_trade_ticker.symbol = event.symbol;
+  m_trade_ticker.event_time = event.trade.event_time;
+  m_trade_ticker.trade_time = event.trade.trade_time;
+  m_trade_ticker.price = event.trade.price;
+  m_trade_ticker.qty = event.trade.qty;
+  m_trade_ticker.is_market_maker = event.HasFlag(CompactEvent::IS_MARKET_MAKER);
+  if (event.HasFlag(CompactEvent::TRADE_ID_STRING)) {
+    m_trade_ticker.trade_id.assign(event.trade.trade_id_str, event.trade.trade_id_size);
+  } else {
+    char buf[std::numeric_limits<uint64_t>::digits10 + 1];
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), event.trade.trade_id);
+    m_trade_ticker.trade_id.assign(buf, ptr);
+  }
+  return m_trade_ticker;
+}
+
+const OrderBookUpdate& EventMaterializer::GetOrderBookUpdate(const EventBatch& batch, const CompactEvent& event) {
+  m_ob_update.arrived_ts = event.arrived_ts;
+  m_ob_update.exchange = batch.GetExchangeName(event.exchange);
+  m_ob_update.symbol = event.symbol;
+  m_ob_update.last_update_id = event.diff.last_update_id;
+  m_ob_update.is_snapshot = event.HasFlag(CompactEvent::IS_SNAPSHOT);
+  const OrderBookUpdate::Level* bids = event.diff.levels;
+  const OrderBookUpdate::Level* asks = bids + event.diff.bid_count;
+  m_ob_update.bids.assign(bids, asks);
+  m_ob_update.asks.assign(asks, asks + event.diff.ask_count);
+  return m_ob_update;
+}
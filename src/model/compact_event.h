@@ -0,0 +1,179 @@
+#pragma once
+
+#include "model/order_book_update.h"
+#include "model/ticker.h"
+#include "model/trade_ticker.h"
+#include "utils/arena.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+enum class EventType : uint8_t {
+  BOOK_TICKER = 0,
+  TRADE_TICKER,
+  BOOK_DIFF
+};
+
+/**
+ * Fixed size market data event without heap allocated members, used for replay.
+ *
+ * Exchange is an index into the exchange table of the EventBatch holding the event,
+ * trade ids are stored as numbers when they are plain decimal numbers, order book levels
+ * and other variable length data live in the batch arena.
+ */
+struct CompactEvent {
+  enum Flags : uint8_t {
+    HAS_BID_VOL = 1,
+    HAS_ASK_VOL = 2,
+    HAS_SOURCE_TS = 4,
+    IS_MARKET_MAKER = 8,
+    IS_SNAPSHOT = 16,
+    // Trade id is not numeric, see TradeData::trade_id_str
+    TRADE_ID_STRING = 32
+  };
+
+  struct TickerData {
+    double bid;
+    double bid_vol;
+    double ask;
+    double ask_vol;
+    uint64_t source_ts;
+  };
+
+  struct TradeData {
+    uint64_t event_time;
+    uint64_t trade_time;
+    double price;
+    double qty;
+    uint64_t trade_id;
+    const char* trade_id_str;
+    uint32_t trade_id_size;
+  };
+
+  struct DiffData {
+    uint64_t last_update_id;
+    // Bids followed by asks
+    const OrderBookUpdate::Level* levels;
+    uint32_t bid_count;
+    uint32_t ask_count;
+  };
+
+  uint64_t arrived_ts;
+  EventType type;
+  uint8_t exchange;
+  uint8_t flags;
+  SymbolPairId symbol;
+  union {
+    TickerData ticker;
+    TradeData trade;
+    DiffData diff;
+  };
+
+  bool HasFlag(Flags flag) const { return flags & flag; }
+
+  // Source timestamp of a book ticker as recorded, 0 (stored for exchanges without one) leaves it unset
+  void SetSourceTs(uint64_t source_ts) {
+    ticker.source_ts = source_ts;
+    if (source_ts != 0) {
+      flags |= HAS_SOURCE_TS;
+    }
+  }
+};
+
+static_assert(std::is_trivially_copyable_v<CompactEvent>, "CompactEvent must stay POD");
+static_assert(std::is_trivially_destructible_v<OrderBookUpdate::Level>, "levels are stored in an arena");
+
+/**
+ * Batch of compact events together with the memory they reference.
+ *
+ * Events are grouped in runs, ie. ranges of events that are in arrival order (one stored
+ * bucket for example). Clear() resets the batch for reuse, keeping the allocated memory.
+ */
+class EventBatch {
+public:
+  typedef std::pair<uint32_t, uint32_t> Run;
+
+  void Add(const Ticker& ticker);
+  void Add(const TradeTicker& trade_ticker);
+  void Add(const OrderBookUpdate& ob_update);
+
+  /**
+   * Append an event, its type specific fields are left to the caller.
+   *
+   * @throws std::runtime_error if the batch has more than 256 exchanges
+   */
+  CompactEvent& AddEvent(EventType type, uint64_t arrived_ts, std::string_view exchange, SymbolPairId symbol);
+
+  /**
+   * Storage for levels of a BOOK_DIFF event, valid until Clear().
+   */
+  OrderBookUpdate::Level* AllocateLevels(size_t count) {
+    return m_arena.allocate<OrderBookUpdate::Level>(count);
+  }
+
+  void SetTradeId(CompactEvent& event, std::string_view trade_id);
+
+  /**
+   * Closes the current run, all events added since the previous run belong to it.
+   */
+  void EndRun();
+
+  const std::vector<CompactEvent>& GetEvents() const { return m_events; }
+  std::vector<CompactEvent>& GetEvents() { return m_events; }
+  const std::vector<Run>& GetRuns() const { return m_runs; }
+  const std::string& GetExchangeName(uint8_t exchange) const { return m_exchanges[exchange]; }
+  size_t size() const { return m_events.size(); }
+  bool empty() const { return m_events.empty(); }
+
+  void Clear();
+
+private:
+  uint8_t InternExchange(std::string_view exchange);
+
+  std::vector<CompactEvent> m_events;
+  std::vector<Run> m_runs;
+  uint32_t m_run_begin = 0;
+  std::vector<std::string> m_exchanges;
+  cryptobot::arena m_arena;
+};
+
+/**
+ * Thin adapter feeding compact events to the existing listener interfaces.
+ *
+ * Events are written into objects owned by the materializer, which are reused for every event,
+ * so their strings and vectors stop allocating after the first few events.
+ * Returned references are valid until the next call.
+ */
+class EventMaterializer {
+public:
+  const Ticker& GetTicker(const EventBatch& batch, const CompactEvent& event);
+  const TradeTicker& GetTradeTicker(const EventBatch& batch, const CompactEvent& event);
+  const OrderBookUpdate& GetOrderBookUpdate(const EventBatch& batch, const CompactEvent& event);
+
+  /**
+   * Calls visitor(const Ticker&), visitor(const TradeTicker&) or visitor(const OrderBookUpdate&).
+   */
+  template <typename Visitor>
+  void Visit(const EventBatch& batch, const CompactEvent& event, Visitor&& visitor) {
+    switch (event.type) {
+      case EventType::BOOK_TICKER:
+        visitor(GetTicker(batch, event));
+        break;
+      case EventType::TRADE_TICKER:
+        visitor(GetTradeTicker(batch, event));
+        break;
+      case EventType::BOOK_DIFF:
+        visitor(GetOrderBookUpdate(batch, event));
+        break;
+    }
+  }
+
+private:
+  Ticker m_ticker;
+  TradeTicker m_trade_ticker;
+  OrderBookUpdate m_ob_update;
+};
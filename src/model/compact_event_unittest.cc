@@ -0,0 +1,106 @@
+#include "compact_event.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using namespace testing;
+
+TEST(CompactEventTest, TickerRoundTripTest) {
+  Ticker ticker;
+  ticker.exchange = "kraken";
+  ticker.symbol = SymbolPairId::BTC_USDT;
+  ticker.arrived_ts = 100;
+  ticker.source_ts = std::nullopt;
+  ticker.bid = 1.5;
+  ticker.bid_vol = 2.5;
+  ticker.ask = 1.6;
+  ticker.ask_vol = std::nullopt;
+
+  EventBatch batch;
+  batch.Add(ticker);
+  EventMaterializer materializer;
+  const Ticker& result = materializer.GetTicker(batch, batch.GetEvents()[0]);
+  EXPECT_EQ("kraken", result.exchange);
+  EXPECT_EQ(SymbolPairId::BTC_USDT, result.symbol);
+  EXPECT_EQ(100u, result.arrived_ts);
+  EXPECT_FALSE(result.source_ts.has_value());
+  EXPECT_DOUBLE_EQ(1.5, result.bid);
+  EXPECT_EQ(std::optional<double>(2.5), result.bid_vol);
+  EXPECT_DOUBLE_EQ(1.6, result.ask);
+  EXPECT_FALSE(result.ask_vol.has_value());
+}
+
+TEST(CompactEventTest, TradeIdTest) {
+  TradeTicker trade;
+  trade.exchange = "binance";
+  trade.symbol = SymbolPairId::ADA_USDT;
+  trade.arrived_ts = 1;
+  trade.event_time = 2;
+  trade.trade_time = 3;
+  trade.price = 1.25;
+  trade.qty = 100;
+  trade.is_market_maker = true;
+
+  EventBatch batch;
+  for (const char* trade_id : {"123456789", "18446744073709551615", "007", "T-42", "0"}) {
+    trade.trade_id = trade_id;
+    batch.Add(trade);
+  }
+  const auto& events = batch.GetEvents();
+  EXPECT_FALSE(events[0].HasFlag(CompactEvent::TRADE_ID_STRING));
+  EXPECT_EQ(123456789u, events[0].trade.trade_id);
+  EXPECT_FALSE(events[1].HasFlag(CompactEvent::TRADE_ID_STRING));
+  EXPECT_TRUE(events[2].HasFlag(CompactEvent::TRADE_ID_STRING));
+  EXPECT_TRUE(events[3].HasFlag(CompactEvent::TRADE_ID_STRING));
+  EXPECT_FALSE(events[4].HasFlag(CompactEvent::TRADE_ID_STRING));
+
+  EventMaterializer materializer;
+  std::vector<std::string> trade_ids;
+  for (const CompactEvent& event : events) {
+    const TradeTicker& result = materializer.GetTradeTicker(batch, event);
+    EXPECT_EQ("binance", result.exchange);
+    EXPECT_EQ(3u, result.trade_time);
+    EXPECT_DOUBLE_EQ(1.25, result.price);
+    EXPECT_TRUE(result.is_market_maker);
+    trade_ids.push_back(result.trade_id);
+  }
+  EXPECT_THAT(trade_ids, ElementsAre("123456789", "18446744073709551615", "007", "T-42", "0"));
+}
+
+TEST(CompactEventTest, OrderBookUpdateTest) {
+  OrderBookUpdate update;
+  update.exchange = "binance";
+  update.symbol = SymbolPairId::ADA_USDT;
+  update.arrived_ts = 5;
+  update.last_update_id = 77;
+  update.is_snapshot = false;
+  update.bids = {{Decimal::Parse("1.09"), Decimal::Parse("2000"), std::nullopt}};
+  update.asks = {{Decimal::Parse("1.11"), Decimal::Parse("400.5"), 123u},
+      {Decimal::Parse("1.12"), Decimal::Parse("0"), std::nullopt}};
+
+  EventBatch batch;
+  batch.Add(update);
+  Ticker ticker{};
+  ticker.exchange = "kraken";
+  batch.Add(ticker);
+  batch.EndRun();
+  ASSERT_EQ(2u, batch.size());
+  EXPECT_THAT(batch.GetRuns(), ElementsAre(EventBatch::Run(0, 2)));
+  EXPECT_EQ(1, batch.GetEvents()[1].exchange);
+
+  EventMaterializer materializer;
+  const OrderBookUpdate& result = materializer.GetOrderBookUpdate(batch, batch.GetEvents()[0]);
+  EXPECT_EQ("binance", result.exchange);
+  EXPECT_EQ(77u, result.last_update_id);
+  EXPECT_FALSE(result.is_snapshot);
+  ASSERT_EQ(1u, result.bids.size());
+  EXPECT_EQ(109u, result.bids[0].price.GetMantissa());
+  ASSERT_EQ(2u, result.asks.size());
+  EXPECT_EQ(4005u, result.asks[0].volume.GetMantissa());
+  EXPECT_EQ(std::optional<uint64_t>(123), result.asks[0].timestamp);
+  EXPECT_TRUE(result.asks[1].volume.IsZero());
+
+  batch.Clear();
+  EXPECT_TRUE(batch.empty());
+  EXPECT_TRUE(batch.GetRuns().empty());
+}
@@ -0,0 +1,90 @@
+#include "consolidated_book.h"
+
+ConsolidatedBook::ConsolidatedBook() {
+  for (auto& book : m_books) {
+    book.present.fill(false);
+    book.best_bid = EXCHANGE_COUNT;
+    book.best_ask = EXCHANGE_COUNT;
+    book.count = 0;
+  }
+}
+
+bool ConsolidatedBook::Update(ExchangeId exchange, const Ticker& ticker) {
+  SymbolPairId symbol = ticker.symbol;
+  if (!IsValid(symbol, exchange)) {
+    return false;
+  }
+  SymbolBook& book = m_books[symbol];
+  const size_t ex = static_cast<size_t>(exchange);
+  if (!book.present[ex]) {
+    book.present[ex] = true;
+    ++book.count;
+  }
+  book.tickers[ex] = ticker;
+
+  if (book.best_bid == EXCHANGE_COUNT || ticker.bid > book.tickers[book.best_bid].bid) {
+    book.best_bid = ex;
+  } else if (book.best_bid == ex) {
+    // Best bid could have got worse
+    RescanBestBid(book);
+  }
+  if (book.best_ask == EXCHANGE_COUNT || ticker.ask < book.tickers[book.best_ask].ask) {
+    book.best_ask = ex;
+  } else if (book.best_ask == ex) {
+    RescanBestAsk(book);
+  }
+  return true;
+}
+
+void ConsolidatedBook::Remove(ExchangeId exchange) {
+  for (size_t i = 0; i < SYMBOL_PAIR_COUNT; ++i) {
+    Remove(static_cast<SymbolPairId>(i), exchange);
+  }
+}
+
+void ConsolidatedBook::Remove(SymbolPairId symbol, ExchangeId exchange) {
+  if (!IsValid(symbol, exchange)) {
+    return;
+  }
+  SymbolBook& book = m_books[symbol];
+  const size_t ex = static_cast<size_t>(exchange);
+  if (!book.present[ex]) {
+    return;
+  }
+  book.present[ex] = false;
+  --book.count;
+  if (book.best_bid == ex) {
+    RescanBestBid(book);
+  }
+  if (book.best_ask == ex) {
+    RescanBestAsk(book);
+  }
+}
+
+void ConsolidatedBook::RefreshArrival(SymbolPairId symbol, ExchangeId exchange, uint64_t arrived_ts) {
+  if (!IsValid(symbol, exchange) || !m_books[symbol].present[exchange]) {
+    return;
+  }
+  Ticker& ticker = m_books[symbol].tickers[exchange];
+  if (arrived_ts > ticker.arrived_ts) {
+    ticker.arrived_ts = arrived_ts;
+  }
+}
+
+void ConsolidatedBook::RescanBestBid(SymbolBook& book) {
+  book.best_bid = EXCHANGE_COUNT;
+  for (size_t i = 0; i < EXCHANGE_COUNT; ++i) {
+    if (book.present[i] && (book.best_bid == EXCHANGE_COUNT || book.tickers[i].bid > book.tickers[book.best_bid].bid)) {
+      book.best_bid = i;
+    }
+  }
+}
+
+void ConsolidatedBook::RescanBestAsk(SymbolBook& book) {
+  book.best_ask = EXCHANGE_COUNT;
+  for (size_t i = 0; i < EXCHANGE_COUNT; ++i) {
+    if (book.present[i] && (book.best_ask == EXCHANGE_COUNT || book.tickers[i].ask < book.tickers[book.best_ask].ask)) {
+      book.best_ask = i;
+    }
+  }
+}
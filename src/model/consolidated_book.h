@@ -0,0 +1,101 @@
+#pragma once
+
+#include "symbol.h"
+#include "ticker.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Top of book of every exchange, for every symbol pair, with best bid and best ask
+ * across exchanges kept up to date on every update.
+ *
+ * Indexed by dense SymbolPairId and ExchangeId, so lookups involve no hashing
+ * and no string comparisons. Reading best bid/ask is O(1), update is O(1) unless
+ * it worsens the current best price, in which case exchanges of the symbol are rescanned.
+ *
+ * Not thread-safe.
+ */
+class ConsolidatedBook {
+public:
+  static constexpr size_t SYMBOL_PAIR_COUNT = static_cast<size_t>(SymbolPairId::UNKNOWN);
+  static constexpr size_t EXCHANGE_COUNT = static_cast<size_t>(ExchangeId::UNKNOWN_EXCHANGE);
+
+  ConsolidatedBook();
+
+  /**
+   * Insert or replace exchange's ticker for ticker's symbol pair.
+   *
+   * @return false if exchange or symbol pair is not supported (ticker is ignored)
+   */
+  bool Update(ExchangeId exchange, const Ticker& ticker);
+
+  /**
+   * Remove exchange's tickers for all symbol pairs (eg. when connection is closed).
+   */
+  void Remove(ExchangeId exchange);
+
+  void Remove(SymbolPairId symbol, ExchangeId exchange);
+
+  /**
+   * Update arrival timestamp of exchange's ticker, if present.
+   * Used when the exchange confirms that top of book did not change.
+   */
+  void RefreshArrival(SymbolPairId symbol, ExchangeId exchange, uint64_t arrived_ts);
+
+  /**
+   * @return ticker of the exchange with the highest bid, nullptr if there are no tickers
+   */
+  inline const Ticker* GetBestBid(SymbolPairId symbol) const {
+    const SymbolBook& book = m_books[symbol];
+    return book.best_bid < EXCHANGE_COUNT ? &book.tickers[book.best_bid] : nullptr;
+  }
+
+  /**
+   * @return ticker of the exchange with the lowest ask, nullptr if there are no tickers
+   */
+  inline const Ticker* GetBestAsk(SymbolPairId symbol) const {
+    const SymbolBook& book = m_books[symbol];
+    return book.best_ask < EXCHANGE_COUNT ? &book.tickers[book.best_ask] : nullptr;
+  }
+
+  inline ExchangeId GetBestBidExchange(SymbolPairId symbol) const {
+    return static_cast<ExchangeId>(m_books[symbol].best_bid);
+  }
+
+  inline ExchangeId GetBestAskExchange(SymbolPairId symbol) const {
+    return static_cast<ExchangeId>(m_books[symbol].best_ask);
+  }
+
+  inline const Ticker* GetTicker(SymbolPairId symbol, ExchangeId exchange) const {
+    if (!IsValid(symbol, exchange) || !m_books[symbol].present[exchange]) {
+      return nullptr;
+    }
+    return &m_books[symbol].tickers[exchange];
+  }
+
+  inline size_t GetExchangeCount(SymbolPairId symbol) const {
+    return m_books[symbol].count;
+  }
+
+private:
+  struct SymbolBook {
+    std::array<Ticker, EXCHANGE_COUNT> tickers;
+    std::array<bool, EXCHANGE_COUNT> present;
+    // EXCHANGE_COUNT if none
+    size_t best_bid;
+    size_t best_ask;
+    size_t count;
+  };
+
+  inline static bool IsValid(SymbolPairId symbol, ExchangeId exchange) {
+    return static_cast<size_t>(symbol) < SYMBOL_PAIR_COUNT && static_cast<size_t>(exchange) < EXCHANGE_COUNT;
+  }
+
+  static void RescanBestBid(SymbolBook& book);
+  static void RescanBestAsk(SymbolBook& book);
+
+private:
+  std::array<SymbolBook, SYMBOL_PAIR_COUNT> m_books;
+};
@@ -0,0 +1,43 @@
+#include "model/consolidated_book.h"
+
+#include "model/ticker_test_utils.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using namespace testing;
+
+TEST(ConsolidatedBookTest, BestPriceTest) {
+  ConsolidatedBook book;
+  EXPECT_EQ(nullptr, book.GetBestBid(SymbolPairId::BTC_USDT));
+  EXPECT_EQ(nullptr, book.GetBestAsk(SymbolPairId::BTC_USDT));
+
+  book.Update(ExchangeId::BINANCE, CreateTicker("binance", SymbolPairId::BTC_USDT, 100.0, 101.0, 1));
+  book.Update(ExchangeId::KRAKEN, CreateTicker("kraken", SymbolPairId::BTC_USDT, 100.5, 101.5, 1));
+  book.Update(ExchangeId::COINBASE, CreateTicker("coinbase", SymbolPairId::BTC_USDT, 99.0, 100.8, 1));
+  EXPECT_EQ(3u, book.GetExchangeCount(SymbolPairId::BTC_USDT));
+  EXPECT_EQ(ExchangeId::KRAKEN, book.GetBestBidExchange(SymbolPairId::BTC_USDT));
+  EXPECT_DOUBLE_EQ(100.5, book.GetBestBid(SymbolPairId::BTC_USDT)->bid);
+  EXPECT_EQ(ExchangeId::COINBASE, book.GetBestAskExchange(SymbolPairId::BTC_USDT));
+  EXPECT_DOUBLE_EQ(100.8, book.GetBestAsk(SymbolPairId::BTC_USDT)->ask);
+  EXPECT_EQ(nullptr, book.GetBestBid(SymbolPairId::ETH_USDT));
+
+  // Best bid venue gets worse
+  book.Update(ExchangeId::KRAKEN, CreateTicker("kraken", SymbolPairId::BTC_USDT, 99.5, 101.5, 1));
+  EXPECT_EQ(ExchangeId::BINANCE, book.GetBestBidExchange(SymbolPairId::BTC_USDT));
+
+  // Best ask venue disconnects
+  book.Remove(ExchangeId::COINBASE);
+  EXPECT_EQ(2u, book.GetExchangeCount(SymbolPairId::BTC_USDT));
+  EXPECT_EQ(ExchangeId::BINANCE, book.GetBestAskExchange(SymbolPairId::BTC_USDT));
+  EXPECT_EQ(nullptr, book.GetTicker(SymbolPairId::BTC_USDT, ExchangeId::COINBASE));
+
+  book.RefreshArrival(SymbolPairId::BTC_USDT, ExchangeId::KRAKEN, 5);
+  EXPECT_EQ(5u, book.GetTicker(SymbolPairId::BTC_USDT, ExchangeId::KRAKEN)->arrived_ts);
+}
+
+TEST(ConsolidatedBookTest, UnknownExchangeTest) {
+  ConsolidatedBook book;
+  EXPECT_FALSE(book.Update(GetExchangeId("test"), CreateTicker("test", SymbolPairId::BTC_USDT, 100.0, 101.0, 1)));
+  EXPECT_EQ(nullptr, book.GetBestBid(SymbolPairId::BTC_USDT));
+}
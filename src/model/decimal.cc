@@ -0,0 +1,23 @@
+#include "decimal.h"
+
+std::string Decimal::ToString() const {
+  // 20 digits, dot and leading zero at most
+  char buf[24];
+  char* end = buf + sizeof(buf);
+  char* p = end;
+  uint64_t m = m_mantissa;
+  size_t written = 0;
+  do {
+    if (m_scale > 0 && written == m_scale) {
+      *--p = '.';
+    }
+    *--p = static_cast<char>('0' + m % 10);
+    m /= 10;
+    ++written;
+  } while (m > 0 || written <= m_scale);
+  return std::string(p, end);
+}
+
+std::ostream& operator<<(std::ostream& os, const Decimal& d) {
+  return os << d.ToString();
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+/**
+ * Fixed-point decimal number, as sent by exchanges in string form.
+ * "0.01230000" is stored as mantissa 1230000 with scale 8,
+ * so no information is lost and no floating point arithmetic is involved.
+ */
+class Decimal {
+public:
+  static constexpr size_t MAX_DIGITS = 19;
+
+  Decimal() : m_mantissa(0), m_scale(0) {}
+  Decimal(uint64_t mantissa, uint8_t scale) : m_mantissa(mantissa), m_scale(scale) {}
+
+  /**
+   * Parse non-negative decimal string, eg. "123.4500".
+   *
+   * @throws std::invalid_argument on malformed input or more than MAX_DIGITS digits
+   */
+  static Decimal Parse(std::string_view str) {
+    uint64_t mantissa = 0;
+    size_t digits = 0;
+    size_t scale = 0;
+    bool has_dot = false;
+    bool has_digit = false;
+    for (char c : str) {
+      if (c == '.' && !has_dot) {
+        has_dot = true;
+        continue;
+      }
+      unsigned d = static_cast<unsigned>(c - '0');
+      if (d > 9) {
+        throw std::invalid_argument("Decimal::Parse: not a number");
+      }
+      if (mantissa > 0 || d > 0) {
+        ++digits;
+      }
+      has_digit = true;
+      mantissa = mantissa * 10 + d;
+      scale += has_dot;
+    }
+    if (!has_digit || digits > MAX_DIGITS || scale > MAX_DIGITS) {
+      throw std::invalid_argument("Decimal::Parse: not a number");
+    }
+    return Decimal(mantissa, static_cast<uint8_t>(scale));
+  }
+
+  /**
+   * @throws std::invalid_argument if 10^n does not fit into uint64_t (n > MAX_DIGITS)
+   */
+  static uint64_t Pow10(size_t n) {
+    if (n > MAX_DIGITS) {
+      throw std::invalid_argument("Decimal::Pow10: exponent out of range");
+    }
+    static constexpr uint64_t s_pow10[MAX_DIGITS + 1] = {
+      1ull, 10ull, 100ull, 1000ull, 10000ull,
+      100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull,
+      10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull,
+      1000000000000000ull, 10000000000000000ull, 100000000000000000ull, 1000000000000000000ull,
+      10000000000000000000ull
+    };
+    return s_pow10[n];
+  }
+
+  /**
+   * Get value as an integer number of 10^-precision units (ticks).
+   * Digits beyond requested precision are truncated.
+   *
+   * @throws std::invalid_argument if the number of ticks does not fit into uint64_t
+   */
+  uint64_t ToFixedPoint(size_t precision) const {
+    if (precision < m_scale) {
+      size_t exponent = m_scale - precision;
+      // Any mantissa is below 10^20
+      return exponent > MAX_DIGITS ? 0 : m_mantissa / Pow10(exponent);
+    }
+    size_t exponent = precision - m_scale;
+    if (m_mantissa == 0) {
+      return 0;
+    }
+    uint64_t ticks;
+    if (exponent > MAX_DIGITS || __builtin_mul_overflow(m_mantissa, Pow10(exponent), &ticks)) {
+      throw std::invalid_argument("Decimal::ToFixedPoint: out of range");
+    }
+    return ticks;
+  }
+
+  double ToDouble() const {
+    return static_cast<double>(m_mantissa) / Pow10(m_scale);
+  }
+
+  /**
+   * Number of significant fractional digits, ie. without trailing zeros.
+   */
+  size_t GetPrecision() const {
+    if (m_mantissa == 0) {
+      return 0;
+    }
+    size_t precision = m_scale;
+    uint64_t m = m_mantissa;
+    while (precision > 0 && m % 10 == 0) {
+      m /= 10;
+      --precision;
+    }
+    return precision;
+  }
+
+  inline bool IsZero() const { return m_mantissa == 0; }
+  inline uint64_t GetMantissa() const { return m_mantissa; }
+  inline size_t GetScale() const { return m_scale; }
+
+  /**
+   * Format back to the exact string representation it was parsed from
+   * (leading zeros of the integer part excluded).
+   */
+  std::string ToString() const;
+
+  friend std::ostream& operator<<(std::ostream& os, const Decimal& d);
+
+private:
+  uint64_t m_mantissa;
+  uint8_t m_scale;
+};
+
+std::ostream& operator<<(std::ostream& os, const Decimal& d);
@@ -0,0 +1,62 @@
+#include "model/decimal.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using namespace testing;
+
+TEST(DecimalTest, ParseTest) {
+  Decimal d = Decimal::Parse("0.01230000");
+  EXPECT_EQ(1230000u, d.GetMantissa());
+  EXPECT_EQ(8u, d.GetScale());
+  EXPECT_EQ(4u, d.GetPrecision());
+  EXPECT_EQ(123u, d.ToFixedPoint(4));
+  EXPECT_EQ(1u, d.ToFixedPoint(2));
+  EXPECT_EQ(1230000000u, d.ToFixedPoint(11));
+  EXPECT_DOUBLE_EQ(0.0123, d.ToDouble());
+  EXPECT_EQ("0.01230000", d.ToString());
+
+  Decimal price = Decimal::Parse("57321.13");
+  EXPECT_EQ(5732113u, price.ToFixedPoint(2));
+  EXPECT_EQ(573211300u, price.ToFixedPoint(4));
+  EXPECT_EQ("57321.13", price.ToString());
+
+  Decimal integer = Decimal::Parse("128");
+  EXPECT_EQ(0u, integer.GetPrecision());
+  EXPECT_EQ(12800u, integer.ToFixedPoint(2));
+  EXPECT_EQ("128", integer.ToString());
+
+  EXPECT_TRUE(Decimal::Parse("0.00000000").IsZero());
+  EXPECT_EQ("0.00000000", Decimal::Parse("0.00000000").ToString());
+  EXPECT_EQ(1616663113240127u, Decimal::Parse("1616663113.240127").GetMantissa());
+}
+
+TEST(DecimalTest, NoRoundingErrorTest) {
+  // 0.29 * 100 == 28.999999999999996 in floating point
+  EXPECT_EQ(29u, Decimal::Parse("0.29").ToFixedPoint(2));
+  EXPECT_EQ(115u, Decimal::Parse("1.15").ToFixedPoint(2));
+}
+
+TEST(DecimalTest, FixedPointRangeTest) {
+  Decimal price = Decimal::Parse("57321.13");
+  EXPECT_EQ(5732113000000000000u, price.ToFixedPoint(14));
+  EXPECT_THROW(price.ToFixedPoint(15), std::invalid_argument);
+  EXPECT_THROW(price.ToFixedPoint(22), std::invalid_argument);
+  EXPECT_EQ(0u, Decimal::Parse("0.00").ToFixedPoint(40));
+
+  // Truncated below requested precision, also beyond 19 digits
+  Decimal tiny = Decimal(9999999999999999999u, 19);
+  EXPECT_EQ(9u, tiny.ToFixedPoint(1));
+  EXPECT_EQ(0u, tiny.ToFixedPoint(0));
+  EXPECT_EQ(0u, Decimal(123, 30).ToFixedPoint(5));
+  EXPECT_THROW(Decimal::Pow10(20), std::invalid_argument);
+}
+
+TEST(DecimalTest, InvalidInputTest) {
+  EXPECT_THROW(Decimal::Parse(""), std::invalid_argument);
+  EXPECT_THROW(Decimal::Parse("."), std::invalid_argument);
+  EXPECT_THROW(Decimal::Parse("1.2.3"), std::invalid_argument);
+  EXPECT_THROW(Decimal::Parse("-1.5"), std::invalid_argument);
+  EXPECT_THROW(Decimal::Parse("asdf"), std::invalid_argument);
+  EXPECT_THROW(Decimal::Parse("123456789012345678901"), std::invalid_argument);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "account_balance.h"
+#include "order.h"
+#include "order_book.h"
+#include "ticker.h"
+
+#include "utils/checkpoint.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Checkpoint writers and readers of model types, see cryptobot::Checkpoint.
+ */
+
+inline void SaveOrder(cryptobot::CheckpointWriter& writer, const Order& order) {
+  writer.WriteString(order.GetId());
+  writer.WriteString(order.GetClientId());
+  writer.Write(order.GetSymbolId());
+  writer.Write(order.GetSide());
+  writer.Write(order.GetType());
+  writer.Write(order.GetQuantity());
+  writer.Write(order.GetPrice());
+  writer.Write(order.GetStatus());
+  writer.Write(order.GetCreationTime());
+  writer.Write(order.GetExecutedQuantity());
+  writer.Write(order.GetTotalCost());
+}
+
+inline Order LoadOrder(cryptobot::CheckpointReader& reader) {
+  std::string id = reader.ReadString();
+  std::string client_id = reader.ReadString();
+  const SymbolPairId symbol = reader.Read<SymbolPairId>();
+  const Side side = reader.Read<Side>();
+  const OrderType type = reader.Read<OrderType>();
+  const double quantity = reader.Read<double>();
+  const double price = reader.Read<double>();
+  const OrderStatus status = reader.Read<OrderStatus>();
+  const uint64_t creation_time_us = reader.Read<uint64_t>();
+  Order order(std::move(id), std::move(client_id), symbol, side, type, quantity, price, status, creation_time_us);
+  order.SetExecutedQuantity(reader.Read<double>());
+  order.SetTotalCost(reader.Read<double>());
+  return order;
+}
+
+inline void SaveTicker(cryptobot::CheckpointWriter& writer, const Ticker& ticker) {
+  writer.Write(ticker.ask);
+  writer.WriteOptional(ticker.ask_vol);
+  writer.Write(ticker.bid);
+  writer.WriteOptional(ticker.bid_vol);
+  writer.WriteOptional(ticker.source_ts);
+  writer.Write(ticker.arrived_ts);
+  writer.Write(ticker.id);
+  writer.WriteString(ticker.exchange);
+  writer.Write(SymbolPairId(ticker.symbol));
+}
+
+inline Ticker LoadTicker(cryptobot::CheckpointReader& reader) {
+  Ticker ticker;
+  ticker.ask = reader.Read<double>();
+  ticker.ask_vol = reader.ReadOptional<double>();
+  ticker.bid = reader.Read<double>();
+  ticker.bid_vol = reader.ReadOptional<double>();
+  ticker.source_ts = reader.ReadOptional<uint64_t>();
+  ticker.arrived_ts = reader.Read<uint64_t>();
+  ticker.id = reader.Read<uint64_t>();
+  ticker.exchange = reader.ReadString();
+  ticker.symbol = SymbolPair(reader.Read<SymbolPairId>());
+  return ticker;
+}
+
+// Sorted by asset, so equal balances give equal checkpoints
+inline void SaveBalanceMap(cryptobot::CheckpointWriter& writer, const std::unordered_map<SymbolId, double>& balances) {
+  std::vector<std::pair<SymbolId, double>> sorted(balances.begin(), balances.end());
+  std::sort(sorted.begin(), sorted.end());
+  writer.Write<uint64_t>(sorted.size());
+  for (const auto& p : sorted) {
+    writer.Write(p.first);
+    writer.Write(p.second);
+  }
+}
+
+inline std::unordered_map<SymbolId, double> LoadBalanceMap(cryptobot::CheckpointReader& reader) {
+  std::unordered_map<SymbolId, double> balances;
+  const uint64_t count = reader.Read<uint64_t>();
+  for (uint64_t i = 0; i < count; ++i) {
+    const SymbolId asset = reader.Read<SymbolId>();
+    balances.insert_or_assign(asset, reader.Read<double>());
+  }
+  return balances;
+}
+
+inline void SaveAccountBalance(cryptobot::CheckpointWriter& writer, const AccountBalance& balance) {
+  SaveBalanceMap(writer, balance.m_asset_balance_map);
+  SaveBalanceMap(writer, balance.m_locked_balance_map);
+  writer.WriteString(balance.m_exchange);
+}
+
+inline AccountBalance LoadAccountBalance(cryptobot::CheckpointReader& reader) {
+  auto balances = LoadBalanceMap(reader);
+  auto locked_balances = LoadBalanceMap(reader);
+  return AccountBalance(balances, locked_balances, reader.ReadString());
+}
+
+/**
+ * Price levels and settings of the book, not its last update.
+ */
+inline void SaveOrderBook(cryptobot::CheckpointWriter& writer, const OrderBook& ob) {
+  writer.WriteString(ob.GetExchangeName());
+  writer.Write(ob.GetSymbolPairId());
+  writer.Write<uint64_t>(ob.GetDepth());
+  const PrecisionSettings& precision = ob.GetPrecisionSettings();
+  writer.Write<uint64_t>(precision.m_price_precision);
+  writer.Write<uint64_t>(precision.m_volume_precision);
+  writer.Write<uint64_t>(precision.m_timestamp_precision);
+  for (const PriceLevels* levels : {&ob.GetBids(), &ob.GetAsks()}) {
+    writer.Write<uint64_t>(levels->size());
+    for (const PriceLevel& level : *levels) {
+      writer.Write(level.GetPrice());
+      writer.Write(level.GetVolume());
+      writer.Write(level.GetTimestamp());
+    }
+  }
+}
+
+inline OrderBook LoadOrderBook(cryptobot::CheckpointReader& reader) {
+  std::string exchange = reader.ReadString();
+  const SymbolPairId symbol = reader.Read<SymbolPairId>();
+  const size_t depth = reader.Read<uint64_t>();
+  const size_t price_precision = reader.Read<uint64_t>();
+  const size_t volume_precision = reader.Read<uint64_t>();
+  const size_t timestamp_precision = reader.Read<uint64_t>();
+  OrderBook ob(exchange, symbol, depth, PrecisionSettings(price_precision, volume_precision, timestamp_precision));
+  for (int side = 0; side < 2; ++side) {
+    const uint64_t count = reader.Read<uint64_t>();
+    for (uint64_t i = 0; i < count; ++i) {
+      const price_t price = reader.Read<price_t>();
+      const quantity_t volume = reader.Read<quantity_t>();
+      PriceLevel level(price, volume, reader.Read<uint64_t>());
+      if (side == 0) {
+        ob.UpsertBid(level);
+      } else {
+        ob.UpsertAsk(level);
+      }
+    }
+  }
+  return ob;
+}
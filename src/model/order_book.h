@@ -1,17 +1,20 @@
 #pragma once
 
+#include "order.h"
 #include "order_book_update.h"
 #include "settings.h"
 #include "symbol.h"
-#include "utils/math.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <functional>
+#include <optional>
 #include <utility>
-#include <list>
+#include <vector>
 
 #include "json/json.hpp"
 
@@ -34,7 +37,13 @@ public:
   PriceLevel(PriceLevel&& o) noexcept : m_price(std::move(o.m_price)),
       m_volume(std::exchange(o.m_volume, 0)),
       m_timestamp(std::exchange(o.m_timestamp, 0)) { }
-  PriceLevel& operator=(PriceLevel&& o) {
+  PriceLevel& operator=(const PriceLevel& o) noexcept {
+    m_price = o.m_price;
+    m_volume = o.m_volume;
+    m_timestamp = o.m_timestamp;
+    return *this;
+  }
+  PriceLevel& operator=(PriceLevel&& o) noexcept {
     m_price = std::move(o.m_price);
     m_volume = std::exchange(o.m_volume, 0);
     m_timestamp = std::exchange(o.m_timestamp, 0);
@@ -86,6 +95,21 @@ private:
   uint64_t m_timestamp;
 };
 
+// Contiguous price ladder, sorted with the best price at the back
+using PriceLevels = std::vector<PriceLevel>;
+
+// Result of walking the book with an aggressive order
+struct MarketFill {
+  quantity_t quantity = 0;
+  // Sum of price * quantity of filled levels
+  double notional = 0;
+  size_t levels = 0;
+
+  double GetAveragePrice() const {
+    return quantity > 0 ? notional / quantity : 0;
+  }
+};
+
 class OrderBook {
 public:
 
@@ -94,7 +118,10 @@ public:
   }
 
 	OrderBook(const std::string& name, SymbolPairId symbol, size_t depth, PrecisionSettings precision_settings)
-      : m_exchange_name(name), m_symbol(symbol), m_depth(depth), m_precision_settings(precision_settings) {
+      : m_exchange_name(name), m_symbol(symbol), m_depth(depth), m_precision_settings(precision_settings),
+        m_latest_update_ts(0), m_top_changed(false) {
+    m_bids.reserve(depth);
+    m_asks.reserve(depth);
   }
 
 	/**
@@ -103,24 +130,8 @@ public:
 	 * @param price_level price level
 	 */
 	void UpsertBid(PriceLevel& price_level) {
-    auto it = m_bids.begin();
-		bool found = false;
-		for (; it != m_bids.end(); ++it) {
-			PriceLevel& cprice = *it;
-			if (cprice == price_level) {
-        cprice = std::move(price_level);
-				found = true;
-				break;
-			} else if (price_level < cprice) {
-				break;
-			}
-		}
-		if (!found) {
-			m_bids.insert(it, price_level);
-		}
-    if (m_bids.size() > m_depth) {
-      m_bids.pop_front();
-    }
+    m_latest_update_ts = std::max(m_latest_update_ts, price_level.GetTimestamp());
+    m_top_changed |= Upsert(m_bids, price_level, m_depth, std::less<price_t>());
   }
 
   /**
@@ -129,41 +140,38 @@ public:
 	 * @param price_level price level
 	 */
 	void UpsertAsk(PriceLevel& price_level) {
-		auto it = m_asks.begin();
-		bool found = false;
-		for (; it != m_asks.end(); ++it) {
-			PriceLevel& cprice = *it;
-			if (cprice == price_level) {
-        cprice = std::move(price_level);
-				found = true;
-				break;
-			} else if (price_level > cprice) {
-				break;
-			}
-		}
-		if (!found) {
-			m_asks.insert(it, price_level);
-		}
-    if (m_asks.size() > m_depth) {
-      m_asks.pop_front();
-    }
+    m_latest_update_ts = std::max(m_latest_update_ts, price_level.GetTimestamp());
+    m_top_changed |= Upsert(m_asks, price_level, m_depth, std::greater<price_t>());
   }
 
   void DeleteBid(price_t price) {
-		Delete(m_bids, price);
+    m_top_changed |= Delete(m_bids, price, std::less<price_t>());
   }
 
   void DeleteAsk(price_t price) {
-    Delete(m_asks, price);
+    m_top_changed |= Delete(m_asks, price, std::greater<price_t>());
   }
 
   void clear() {
     m_asks.clear();
     m_bids.clear();
+    m_latest_update_ts = 0;
+    m_top_changed = true;
   }
 
-	const std::list<PriceLevel>& GetBids() const { return m_bids; }
-	const std::list<PriceLevel>& GetAsks() const { return m_asks; }
+  /**
+   * Start tracking top of book changes for a new batch of level updates.
+   * Called by Update(), needs to be called by handlers upserting levels directly.
+   */
+  void ResetTopChanged() { m_top_changed = false; }
+
+  /**
+   * @return true if best bid or best ask (price or volume) changed since last ResetTopChanged()
+   */
+  bool IsTopChanged() const { return m_top_changed; }
+
+  const PriceLevels& GetBids() const { return m_bids; }
+  const PriceLevels& GetAsks() const { return m_asks; }
 
   const PriceLevel& GetBestBid() const {
     if (m_bids.empty()) {
@@ -179,38 +187,79 @@ public:
     return m_asks.back();
   }
 
+  /**
+   * Walk the opposite side of the book from the top, as an aggressive order would,
+   * until the quantity is filled, the side is exhausted or the limit price is reached.
+   * The book is not modified.
+   *
+   * @param side BUY takes asks, SELL takes bids
+   * @param limit_price worst acceptable price, std::nullopt for market orders
+   */
+  MarketFill GetMarketFill(Side side, quantity_t qty, std::optional<price_t> limit_price = std::nullopt) const {
+    const PriceLevels& levels = side == Side::BUY ? m_asks : m_bids;
+    MarketFill fill;
+    quantity_t remaining = qty;
+    for (auto it = levels.rbegin(); it != levels.rend() && remaining > 0; ++it) {
+      if (limit_price.has_value()
+          && (side == Side::BUY ? it->GetPrice() > limit_price.value() : it->GetPrice() < limit_price.value())) {
+        break;
+      }
+      quantity_t taken = std::min(remaining, it->GetVolume());
+      remaining -= taken;
+      fill.quantity += taken;
+      fill.notional += taken * ToDouble(it->GetPrice());
+      ++fill.levels;
+    }
+    return fill;
+  }
+
+  /**
+   * @return volume of the level at price on the given side (BUY for bids), 0 if there is no such level
+   */
+  quantity_t GetLevelVolume(Side side, price_t price) const {
+    if (side == Side::BUY) {
+      auto it = Find(m_bids, price, std::less<price_t>());
+      return it != m_bids.end() && *it == price ? it->GetVolume() : 0;
+    }
+    auto it = Find(m_asks, price, std::greater<price_t>());
+    return it != m_asks.end() && *it == price ? it->GetVolume() : 0;
+  }
+
+  double ToDouble(price_t price) const {
+    return static_cast<double>(static_cast<uint64_t>(price)) / Decimal::Pow10(m_precision_settings.m_price_precision);
+  }
+
+  price_t ToPrice(double price) const {
+    return price_t(std::llround(price * Decimal::Pow10(m_precision_settings.m_price_precision)));
+  }
+
+  /**
+   * @return latest timestamp of all price levels upserted since the book was cleared
+   */
   uint64_t GetLatestUpdateTimestamp() const {
-    // TODO: use m_last_update ?
-    uint64_t ret = 0;
-    std::for_each(m_bids.cbegin(), m_bids.cend(), [&](const PriceLevel& pl) {
-      ret = std::max<uint64_t>(ret, pl.GetTimestamp());
-    });
-    std::for_each(m_asks.cbegin(), m_asks.cend(), [&](const PriceLevel& pl) {
-      ret = std::max<uint64_t>(ret, pl.GetTimestamp());
-    });
-    return ret;
+    return m_latest_update_ts;
   }
 
   void Update(const OrderBookUpdate& ob_update) {
     m_last_update = ob_update;
+    ResetTopChanged();
+    const size_t price_precision = m_precision_settings.m_price_precision;
     for (const auto& raw_lvl : m_last_update.bids) {
-      price_t price_lvl = price_t(uint64_t(std::stod(raw_lvl.price) * cryptobot::quick_pow10(m_precision_settings.m_price_precision)));
-      double qty = std::stod(raw_lvl.volume);
-      if (qty == 0) {
+      price_t price_lvl = price_t(raw_lvl.price.ToFixedPoint(price_precision));
+      if (raw_lvl.volume.IsZero()) {
         DeleteBid(price_lvl);
         continue;
       }
-      PriceLevel level(price_lvl, qty, raw_lvl.timestamp.has_value() ? raw_lvl.timestamp.value() : 0);
+      PriceLevel level(price_lvl, raw_lvl.volume.ToDouble(), raw_lvl.timestamp.has_value() ? raw_lvl.timestamp.value() : 0);
       UpsertBid(level);
     }
     for (const auto& raw_lvl : m_last_update.asks) {
-      price_t price_lvl = price_t(uint64_t(std::stod(raw_lvl.price) * cryptobot::quick_pow10(m_precision_settings.m_price_precision)));
-      double qty = std::stod(raw_lvl.volume);
-      if (qty == 0) {
+      price_t price_lvl = price_t(raw_lvl.price.ToFixedPoint(price_precision));
+      if (raw_lvl.volume.IsZero()) {
         DeleteAsk(price_lvl);
         continue;
       }
-      PriceLevel level(price_lvl, qty, raw_lvl.timestamp.has_value() ? raw_lvl.timestamp.value() : 0);
+      PriceLevel level(price_lvl, raw_lvl.volume.ToDouble(), raw_lvl.timestamp.has_value() ? raw_lvl.timestamp.value() : 0);
       UpsertAsk(level);
     }
   }
@@ -224,27 +273,62 @@ public:
   friend std::ostream& operator<<(std::ostream& os, const OrderBook& ob);
 
 private:
-  inline static void Delete(std::list<PriceLevel>& vec, price_t price) {
-		auto it = vec.end();
-		while (it-- != vec.begin()) {
-			PriceLevel& cprice = *it;
-			if (cprice == price) {
-        vec.erase(it);
-				break;
-			}
-		}
+  // Levels are kept sorted from the worst to the best price, so that most updates
+  // (which happen close to the top of the book) only move a few elements at the back.
+  // `worse(a, b)` is true when price `a` is further from the top of the book than `b`.
+  template <typename Levels, typename Compare>
+  inline static auto Find(Levels& levels, price_t price, Compare worse) -> decltype(levels.begin()) {
+    return std::lower_bound(levels.begin(), levels.end(), price, [&](const PriceLevel& lvl, price_t p) {
+      return worse(lvl.GetPrice(), p);
+    });
+  }
+
+  // Returns true if the best level was touched
+  template <typename Compare>
+  inline static bool Upsert(PriceLevels& levels, PriceLevel& price_level, size_t depth, Compare worse) {
+    auto it = Find(levels, price_level.GetPrice(), worse);
+    if (it != levels.end() && *it == price_level) {
+      *it = std::move(price_level);
+      return it + 1 == levels.end();
+    }
+    const bool is_top = it == levels.end();
+    if (levels.size() < depth) {
+      levels.insert(it, std::move(price_level));
+      return is_top;
+    }
+    // Book is full, the worst level gets dropped
+    if (it == levels.begin()) {
+      return false;
+    }
+    std::move(levels.begin() + 1, it, levels.begin());
+    *(it - 1) = std::move(price_level);
+    return is_top;
+  }
+
+  // Returns true if the best level was deleted
+  template <typename Compare>
+  inline static bool Delete(PriceLevels& levels, price_t price, Compare worse) {
+    auto it = Find(levels, price, worse);
+    if (it != levels.end() && *it == price) {
+      const bool is_top = it + 1 == levels.end();
+      levels.erase(it);
+      return is_top;
+    }
+    return false;
   }
 
 private:
   // Highest bid last
-	std::list<PriceLevel> m_bids;
+  PriceLevels m_bids;
   // Lowest ask last
-	std::list<PriceLevel> m_asks;
+  PriceLevels m_asks;
   const std::string m_exchange_name;
   const SymbolPairId m_symbol;
   const size_t m_depth;
   const PrecisionSettings m_precision_settings;
   OrderBookUpdate m_last_update;
+  uint64_t m_latest_update_ts;
+  bool m_top_changed;
 };
 
 std::ostream& operator<<(std::ostream& os, const PriceLevel& pl);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "order_book.h"
+#include "symbol.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Fixed size copy of the top of the order book, trivially copyable,
+ * so that it can be published from feed threads through cryptobot::seqlock.
+ */
+struct OrderBookSnapshot {
+  static constexpr size_t DEPTH = 10;
+
+  struct Level {
+    price_t price;
+    quantity_t volume;
+  };
+
+  OrderBookSnapshot() : symbol(SymbolPairId::UNKNOWN), timestamp_us(0), bid_count(0), ask_count(0), bids(), asks() {}
+
+  /**
+   * Copy top DEPTH levels of the order book.
+   *
+   * @param timestamp_us arrival timestamp of the update the book was built from
+   */
+  void Assign(const OrderBook& ob, uint64_t timestamp_us_) {
+    symbol = ob.GetSymbolPairId();
+    timestamp_us = timestamp_us_;
+    bid_count = CopyTop(ob.GetBids(), bids);
+    ask_count = CopyTop(ob.GetAsks(), asks);
+  }
+
+  SymbolPairId symbol;
+  uint64_t timestamp_us;
+  size_t bid_count;
+  size_t ask_count;
+  // Best level first
+  std::array<Level, DEPTH> bids;
+  std::array<Level, DEPTH> asks;
+
+private:
+  // Order book keeps the best level at the back
+  static size_t CopyTop(const PriceLevels& levels, std::array<Level, DEPTH>& out) {
+    const size_t count = std::min(levels.size(), DEPTH);
+    auto it = levels.rbegin();
+    for (size_t i = 0; i < count; ++i, ++it) {
+      out[i].price = it->GetPrice();
+      out[i].volume = it->GetVolume();
+    }
+    return count;
+  }
+};
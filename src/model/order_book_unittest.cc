@@ -1,4 +1,5 @@
 #include "model/order_book.h"
+#include "model/order_book_snapshot.h"
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -41,4 +42,122 @@ TEST(OrderBookTest, AskOrderTest) {
   ASSERT_THAT(ob.GetAsks(), ElementsAre(Eq(pl4)));
   ob.DeleteAsk(price_t(473821));
   ASSERT_TRUE(ob.GetAsks().empty());
-}
\ No newline at end of file
+}
+
+TEST(OrderBookTest, DepthLimitTest) {
+  OrderBook ob{"test", SymbolPairId::BTC_USDT, 3, PrecisionSettings{8, 8, 8}};
+  PriceLevel bid1(price_t(100), 1.0, 1);
+  ob.UpsertBid(bid1);
+  PriceLevel bid2(price_t(103), 1.0, 1);
+  ob.UpsertBid(bid2);
+  PriceLevel bid3(price_t(101), 1.0, 1);
+  ob.UpsertBid(bid3);
+  // Worse than every level in a full book, dropped
+  PriceLevel bid4(price_t(99), 1.0, 1);
+  ob.UpsertBid(bid4);
+  ASSERT_THAT(ob.GetBids(), ElementsAre(Eq(bid1), Eq(bid3), Eq(bid2)));
+  // New best bid pushes out the lowest one
+  PriceLevel bid5(price_t(104), 2.0, 2);
+  ob.UpsertBid(bid5);
+  ASSERT_THAT(ob.GetBids(), ElementsAre(Eq(bid3), Eq(bid2), Eq(bid5)));
+  ASSERT_EQ(price_t(104), ob.GetBestBid().GetPrice());
+  ASSERT_DOUBLE_EQ(2.0, ob.GetBestBid().GetVolume());
+
+  PriceLevel ask1(price_t(110), 1.0, 1);
+  ob.UpsertAsk(ask1);
+  PriceLevel ask2(price_t(107), 1.0, 1);
+  ob.UpsertAsk(ask2);
+  PriceLevel ask3(price_t(112), 1.0, 1);
+  ob.UpsertAsk(ask3);
+  PriceLevel ask4(price_t(108), 1.0, 1);
+  ob.UpsertAsk(ask4);
+  ASSERT_THAT(ob.GetAsks(), ElementsAre(Eq(ask1), Eq(ask4), Eq(ask2)));
+  ASSERT_EQ(price_t(107), ob.GetBestAsk().GetPrice());
+}
+
+TEST(OrderBookTest, TopChangedTest) {
+  OrderBook ob{"test", SymbolPairId::BTC_USDT, 3, PrecisionSettings{8, 8, 8}};
+  PriceLevel bid1(price_t(100), 1.0, 5);
+  ob.UpsertBid(bid1);
+  PriceLevel bid2(price_t(101), 1.0, 3);
+  ob.UpsertBid(bid2);
+  EXPECT_TRUE(ob.IsTopChanged());
+  EXPECT_EQ(5u, ob.GetLatestUpdateTimestamp());
+
+  ob.ResetTopChanged();
+  PriceLevel bid3(price_t(99), 1.0, 7);
+  ob.UpsertBid(bid3);
+  EXPECT_FALSE(ob.IsTopChanged());
+  EXPECT_EQ(7u, ob.GetLatestUpdateTimestamp());
+  ob.DeleteBid(price_t(100));
+  EXPECT_FALSE(ob.IsTopChanged());
+
+  // Volume change at the top
+  PriceLevel bid4(price_t(101), 2.0, 8);
+  ob.UpsertBid(bid4);
+  EXPECT_TRUE(ob.IsTopChanged());
+
+  ob.ResetTopChanged();
+  ob.DeleteBid(price_t(101));
+  EXPECT_TRUE(ob.IsTopChanged());
+  EXPECT_EQ(price_t(99), ob.GetBestBid().GetPrice());
+
+  ob.ResetTopChanged();
+  PriceLevel ask1(price_t(105), 1.0, 9);
+  ob.UpsertAsk(ask1);
+  EXPECT_TRUE(ob.IsTopChanged());
+
+  ob.clear();
+  EXPECT_EQ(0u, ob.GetLatestUpdateTimestamp());
+}
+
+TEST(OrderBookTest, SnapshotTest) {
+  OrderBook ob{"test", SymbolPairId::BTC_USDT, 20, PrecisionSettings{8, 8, 8}};
+  for (uint64_t i = 0; i < 15; ++i) {
+    PriceLevel bid(price_t(100 - i), 1.0 + i, 1);
+    ob.UpsertBid(bid);
+  }
+  PriceLevel ask1(price_t(102), 2.0, 1);
+  ob.UpsertAsk(ask1);
+  PriceLevel ask2(price_t(101), 3.0, 1);
+  ob.UpsertAsk(ask2);
+
+  OrderBookSnapshot snapshot;
+  snapshot.Assign(ob, 42);
+  EXPECT_EQ(SymbolPairId::BTC_USDT, snapshot.symbol);
+  EXPECT_EQ(42u, snapshot.timestamp_us);
+  ASSERT_EQ(OrderBookSnapshot::DEPTH, snapshot.bid_count);
+  EXPECT_EQ(price_t(100), snapshot.bids[0].price);
+  EXPECT_DOUBLE_EQ(1.0, snapshot.bids[0].volume);
+  EXPECT_EQ(price_t(91), snapshot.bids[9].price);
+  ASSERT_EQ(2u, snapshot.ask_count);
+  EXPECT_EQ(price_t(101), snapshot.asks[0].price);
+  EXPECT_EQ(price_t(102), snapshot.asks[1].price);
+}
+
+TEST(OrderBookTest, MarketFillTest) {
+  OrderBook ob{"test", SymbolPairId::BTC_USDT, 10, PrecisionSettings{2, 8, 8}};
+  PriceLevel bid1(price_t(10000), 1.0, 1);
+  ob.UpsertBid(bid1);
+  PriceLevel bid2(price_t(9990), 2.0, 1);
+  ob.UpsertBid(bid2);
+  PriceLevel bid3(price_t(9900), 5.0, 1);
+  ob.UpsertBid(bid3);
+
+  MarketFill fill = ob.GetMarketFill(Side::SELL, 2.0);
+  EXPECT_DOUBLE_EQ(2.0, fill.quantity);
+  EXPECT_DOUBLE_EQ(100.0 + 99.9, fill.notional);
+  EXPECT_EQ(2u, fill.levels);
+  EXPECT_DOUBLE_EQ(99.95, fill.GetAveragePrice());
+
+  fill = ob.GetMarketFill(Side::SELL, 10.0, ob.ToPrice(99.9));
+  EXPECT_DOUBLE_EQ(3.0, fill.quantity);
+  EXPECT_EQ(2u, fill.levels);
+
+  fill = ob.GetMarketFill(Side::SELL, 10.0);
+  EXPECT_DOUBLE_EQ(8.0, fill.quantity);
+
+  fill = ob.GetMarketFill(Side::BUY, 1.0);
+  EXPECT_DOUBLE_EQ(0.0, fill.quantity);
+  EXPECT_DOUBLE_EQ(0.0, fill.GetAveragePrice());
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "decimal.h"
 #include "symbol.h"
 
 #include <optional>
@@ -9,8 +10,8 @@
 
 struct OrderBookUpdate {
   struct Level {
-    std::string price;
-    std::string volume;
+    Decimal price;
+    Decimal volume;
     std::optional<uint64_t> timestamp;
   };
 
@@ -14,6 +14,45 @@ std::ostream &operator<<(std::ostream &os, const Ticker &res) {
   return os;
 }
 
+ExchangeId GetExchangeId(const std::string& name) {
+  static const std::unordered_map<std::string, ExchangeId> s_exchange_ids = {
+    {"binance", ExchangeId::BINANCE},
+    {"coinbase", ExchangeId::COINBASE},
+    {"kraken", ExchangeId::KRAKEN},
+    {"bitbay", ExchangeId::BITBAY},
+    {"bitstamp", ExchangeId::BITSTAMP},
+    {"bybit", ExchangeId::BYBIT},
+    {"etorox", ExchangeId::ETOROX},
+    {"ftx", ExchangeId::FTX},
+    {"huobiglobal", ExchangeId::HUOBI_GLOBAL},
+    {"okex", ExchangeId::OKEX},
+    {"poloniex", ExchangeId::POLONIEX},
+  };
+  auto it = s_exchange_ids.find(name);
+  if (it == s_exchange_ids.end()) {
+    return ExchangeId::UNKNOWN_EXCHANGE;
+  }
+  return it->second;
+}
+
+std::ostream& operator<< (std::ostream& os, ExchangeId exchange_id) {
+  switch (exchange_id) {
+    case ExchangeId::BINANCE: return os << "binance";
+    case ExchangeId::COINBASE: return os << "coinbase";
+    case ExchangeId::KRAKEN: return os << "kraken";
+    case ExchangeId::BITBAY: return os << "bitbay";
+    case ExchangeId::BITSTAMP: return os << "bitstamp";
+    case ExchangeId::BYBIT: return os << "bybit";
+    case ExchangeId::ETOROX: return os << "etorox";
+    case ExchangeId::FTX: return os << "ftx";
+    case ExchangeId::HUOBI_GLOBAL: return os << "huobiglobal";
+    case ExchangeId::OKEX: return os << "okex";
+    case ExchangeId::POLONIEX: return os << "poloniex";
+    case ExchangeId::UNKNOWN_EXCHANGE: return os << "UNKNOWN_EXCHANGE";
+    default: return os << "ExchangeId{" << std::to_string(int(exchange_id)) << "}";
+  }
+}
+
 uint64_t RawTicker::last_ticker_id = 0;
 
 std::ostream& operator<<(std::ostream& os, const RawTicker& rt) {
@@ -8,14 +8,31 @@
 #include <iostream>
 #include <optional>
 #include <string>
+#include <unordered_map>
 
-// TODO: use this
 enum ExchangeId : int {
-  BINANCE,
+  BINANCE = 0,
   COINBASE,
-  KRAKEN
+  KRAKEN,
+  BITBAY,
+  BITSTAMP,
+  BYBIT,
+  ETOROX,
+  FTX,
+  HUOBI_GLOBAL,
+  OKEX,
+  POLONIEX,
+  UNKNOWN_EXCHANGE
 };
 
+/**
+ * Map exchange (connection) name, as used in Ticker::exchange, to ExchangeId.
+ * Returns UNKNOWN_EXCHANGE for unsupported names.
+ */
+ExchangeId GetExchangeId(const std::string& name);
+
+std::ostream& operator<< (std::ostream& os, ExchangeId exchange_id);
+
 struct Ticker {
   double ask;
   std::optional<double> ask_vol;
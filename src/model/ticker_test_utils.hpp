@@ -0,0 +1,25 @@
+#pragma once
+
+#include "model/ticker.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/**
+ * Ticker for unit tests, both volumes are 1000.
+ */
+inline Ticker CreateTicker(const std::string& exchange, SymbolPairId symbol, double bid, double ask, uint64_t arrived_ts,
+                           uint64_t id = 0, std::optional<uint64_t> source_ts = std::nullopt) {
+  Ticker ticker;
+  ticker.ask = ask;
+  ticker.ask_vol = 1000;
+  ticker.bid = bid;
+  ticker.bid_vol = 1000;
+  ticker.source_ts = source_ts;
+  ticker.arrived_ts = arrived_ts;
+  ticker.id = id;
+  ticker.exchange = exchange;
+  ticker.symbol = symbol;
+  return ticker;
+}
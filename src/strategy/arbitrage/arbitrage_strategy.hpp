@@ -4,6 +4,7 @@
 
 #include "exchange/exchange_client.h"
 #include "exchange/exchange_listener.h"
+#include "model/consolidated_book.h"
 #include "model/options.h"
 #include "strategy/mean_reversion_signal.hpp"
 #include "utils/math.h"
@@ -65,9 +66,14 @@ public:
       m_mrs[current_symbol_id].Consume(ticker);
     }
 #endif
+    ExchangeId exchange_id = GetExchangeId(ticker.exchange);
     m_tickers_lock.lock();
-    m_tickers[current_symbol_id][ticker.exchange] = ticker;
-    auto match_opt = m_matcher.FindMatch(m_tickers[current_symbol_id]);
+    if (!m_book.Update(exchange_id, ticker)) {
+      m_tickers_lock.unlock();
+      BOOST_LOG_TRIVIAL(warning) << "Unsupported ticker " << ticker;
+      return;
+    }
+    auto match_opt = m_matcher.FindMatch(m_book, current_symbol_id);
     m_tickers_lock.unlock();
     if (match_opt.has_value()) {
       auto match = match_opt.value();
@@ -144,16 +150,14 @@ public:
             case PriceOutlook::BEARISH: {
                 // Use limit order tilted by fee
                 double fee = m_opts.exchange_params.at(best_bid_exchange).fee;
-                auto f1 = std::async(std::launch::async, &ExchangeClient::LimitOrder, m_account_managers[best_bid_exchange],
+                auto f1_res = m_account_managers[best_bid_exchange]->LimitOrder(
                     current_symbol_id, Side::SELL, order_qty, (1.0 - fee) * best_bid_ticker.bid);
-                auto f1_res = f1.get();
                 if (!f1_res) {
                   BOOST_LOG_TRIVIAL(warning) << "Error sending order for " << best_bid_exchange << ": " << f1_res.GetErrorMsg();
                   std::exit(1);
                 }
-                auto f2 = std::async(std::launch::async, &ExchangeClient::LimitOrder, m_account_managers[best_ask_exchange],
+                auto f2_res = m_account_managers[best_ask_exchange]->LimitOrder(
                     current_symbol_id, Side::BUY, order_qty, prediction.target_price);
-                auto f2_res = f2.get();
                 if (!f2_res) {
                   BOOST_LOG_TRIVIAL(warning) << "Error sending order for " << best_ask_exchange << ": " << f2_res.GetErrorMsg();
                   std::exit(1);
@@ -169,16 +173,14 @@ public:
             case PriceOutlook::BULLISH: {
                 // Use limit order tilted by fee
                 double fee = m_opts.exchange_params.at(best_ask_exchange).fee;
-                auto f1 = std::async(std::launch::async, &ExchangeClient::LimitOrder, m_account_managers[best_ask_exchange],
+                auto f1_res = m_account_managers[best_ask_exchange]->LimitOrder(
                     current_symbol_id, Side::BUY, order_qty, (1.0 + fee) * best_ask_ticker.ask);
-                auto f1_res = f1.get();
                 if (!f1_res) {
                   BOOST_LOG_TRIVIAL(warning) << "Error sending order for " << best_bid_exchange << ": " << f1_res.GetErrorMsg();
                   std::exit(1);
                 }
-                auto f2 = std::async(std::launch::async, &ExchangeClient::LimitOrder, m_account_managers[best_bid_exchange],
+                auto f2_res = m_account_managers[best_bid_exchange]->LimitOrder(
                     current_symbol_id, Side::SELL, order_qty, prediction.target_price);
-                auto f2_res = f2.get();
                 if (!f2_res) {
                   BOOST_LOG_TRIVIAL(warning) << "Error sending order for " << best_ask_exchange << ": " << f2_res.GetErrorMsg();
                   std::exit(1);
@@ -199,6 +201,17 @@ public:
   }
 
   virtual void OnOrderBookUpdate(const OrderBook& order_book) {
+    if (!order_book.IsTopChanged()) {
+      // Only deeper levels moved, matches could not have changed.
+      // Just keep the ticker fresh, so that it does not get rejected as too old.
+      // Arrival timestamp is taken the same way as in TickerFromOrderBook.
+      uint64_t now_us = duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+      ExchangeId exchange_id = GetExchangeId(order_book.GetExchangeName());
+      m_tickers_lock.lock();
+      m_book.RefreshArrival(order_book.GetSymbolPairId(), exchange_id, now_us);
+      m_tickers_lock.unlock();
+      return;
+    }
     Ticker ticker = ExchangeListener::TickerFromOrderBook(order_book);
     assert(ticker.ask_vol.has_value());
     assert(ticker.bid_vol.has_value());
@@ -209,10 +222,9 @@ public:
   }
 
   virtual void OnConnectionClose(const std::string& name) override {
+    ExchangeId exchange_id = GetExchangeId(name);
     m_tickers_lock.lock();
-    for (auto p : m_tickers) {
-      p.second.erase(name);
-    }
+    m_book.Remove(exchange_id);
     m_tickers_lock.unlock();
   }
 
@@ -222,10 +234,15 @@ private:
     const auto& best_bid_exchange = best_bid_ticker.exchange;
     const auto& best_ask_exchange = best_ask_ticker.exchange;
     SymbolPairId current_symbol_id = SymbolPairId(best_bid_ticker.symbol); 
-    auto f1 = std::async(std::launch::async, &ExchangeClient::LimitOrder, m_account_managers[best_bid_exchange],
-        current_symbol_id, Side::SELL, vol, sell_price);
-    auto f2 = std::async(std::launch::async, &ExchangeClient::LimitOrder, m_account_managers[best_ask_exchange],
-        current_symbol_id, Side::BUY, vol, buy_price);
+    AccountManager* bid_manager = m_account_managers[best_bid_exchange];
+    AccountManager* ask_manager = m_account_managers[best_ask_exchange];
+    // Both legs are in flight at once, over the warm connections of the exchange clients
+    auto f1 = bid_manager->LimitOrderAsync(current_symbol_id, Side::SELL, vol, sell_price);
+    if (bid_manager == ask_manager) {
+      // An account places one order at a time
+      f1.wait();
+    }
+    auto f2 = ask_manager->LimitOrderAsync(current_symbol_id, Side::BUY, vol, buy_price);
     auto f1_res = f1.get();
     if (!f1_res) {
       BOOST_LOG_TRIVIAL(warning) << "Error sending order for " << best_bid_exchange << ": " << f1_res.GetErrorMsg();
@@ -261,8 +278,8 @@ private:
 private:
   ArbitrageStrategyOptions m_opts;
   ArbitrageStrategyMatcher m_matcher;
-  // symbol -> (exchange -> ticker)
-  std::map<SymbolPairId, std::map<std::string, Ticker>> m_tickers;
+  // Latest ticker of every exchange for every symbol, with best bid/ask across exchanges
+  ConsolidatedBook m_book;
   std::map<SymbolPairId, MeanReversionSignal> m_mrs;
   std::mutex m_orders_mutex;
   cryptobot::spinlock m_tickers_lock;
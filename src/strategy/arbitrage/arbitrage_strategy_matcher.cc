@@ -11,7 +11,12 @@ std::ostream &operator<<(std::ostream &os, const ArbitrageStrategyMatch &match)
 
 ArbitrageStrategyMatcher::ArbitrageStrategyMatcher(const std::unordered_map<std::string, ExchangeParams>& exchange_params, double profit_margin)
     : m_exchange_params(exchange_params), m_profit_margin(profit_margin) {
-
+  for (const auto& p : m_exchange_params) {
+    ExchangeId exchange_id = GetExchangeId(p.first);
+    if (exchange_id != ExchangeId::UNKNOWN_EXCHANGE) {
+      m_exchange_params_by_id[exchange_id] = p.second;
+    }
+  }
 }
 
 ArbitrageStrategyMatcher::~ArbitrageStrategyMatcher() {
@@ -64,6 +69,24 @@ std::optional<ArbitrageStrategyMatch> ArbitrageStrategyMatcher::FindMatch(const
   return std::nullopt;
 }
 
+std::optional<ArbitrageStrategyMatch> ArbitrageStrategyMatcher::FindMatch(const ConsolidatedBook& book, SymbolPairId symbol) {
+  const Ticker* best_bid_ticker = book.GetBestBid(symbol);
+  const Ticker* best_ask_ticker = book.GetBestAsk(symbol);
+  if (best_bid_ticker == nullptr || best_ask_ticker == nullptr) {
+    return std::nullopt;
+  }
+  const auto& bid_side_params = m_exchange_params_by_id[book.GetBestBidExchange(symbol)];
+  const auto& ask_side_params = m_exchange_params_by_id[book.GetBestAskExchange(symbol)];
+  if (!bid_side_params.has_value() || !ask_side_params.has_value()) {
+    return std::nullopt;
+  }
+  double profit = CalculateProfit(*bid_side_params, *ask_side_params, best_bid_ticker->bid, best_ask_ticker->ask);
+  if (profit >= 0) {
+    return std::optional<ArbitrageStrategyMatch>{ArbitrageStrategyMatch(*best_bid_ticker, *best_ask_ticker, profit)};
+  }
+  return std::nullopt;
+}
+
 double ArbitrageStrategyMatcher::CalculateProfit(const Ticker& best_bid_ticker, const Ticker& best_ask_ticker) const {
   // TODO: perhaps add some validations and sanity checks eg. this is not the same exchange on both bid and ask side
   if (0 == m_exchange_params.count(best_bid_ticker.exchange)
@@ -72,5 +95,10 @@ double ArbitrageStrategyMatcher::CalculateProfit(const Ticker& best_bid_ticker,
   }
   const auto& bid_side_params = m_exchange_params.at(best_bid_ticker.exchange);
   const auto& ask_side_params = m_exchange_params.at(best_ask_ticker.exchange);
-  return (1 - bid_side_params.fee - m_profit_margin)*(best_bid_ticker.bid - bid_side_params.slippage) - (1 + ask_side_params.fee + m_profit_margin)*(best_ask_ticker.ask + ask_side_params.slippage);
+  return CalculateProfit(bid_side_params, ask_side_params, best_bid_ticker.bid, best_ask_ticker.ask);
+}
+
+double ArbitrageStrategyMatcher::CalculateProfit(const ExchangeParams& bid_side_params, const ExchangeParams& ask_side_params,
+    double best_bid, double best_ask) const {
+  return (1 - bid_side_params.fee - m_profit_margin)*(best_bid - bid_side_params.slippage) - (1 + ask_side_params.fee + m_profit_margin)*(best_ask + ask_side_params.slippage);
 }
\ No newline at end of file
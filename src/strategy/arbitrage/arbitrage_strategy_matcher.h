@@ -1,8 +1,10 @@
+#include "model/consolidated_book.h"
 #include "model/options.h"
 #include "model/ticker.h"
 
 #include <boost/log/trivial.hpp>
 
+#include <array>
 #include <cassert>
 #include <optional>
 #include <map>
@@ -29,10 +31,19 @@ public:
 
   virtual std::optional<ArbitrageStrategyMatch> FindMatch(const std::map<std::string, Ticker>& tickers);
 
+  /**
+   * Match best bid and best ask across exchanges in the consolidated book. O(1).
+   */
+  virtual std::optional<ArbitrageStrategyMatch> FindMatch(const ConsolidatedBook& book, SymbolPairId symbol);
+
 private:
   double CalculateProfit(const Ticker& best_bid_ticker, const Ticker& best_ask_ticker) const;
+  double CalculateProfit(const ExchangeParams& bid_side_params, const ExchangeParams& ask_side_params,
+      double best_bid, double best_ask) const;
 
 private:
   std::unordered_map<std::string, ExchangeParams> m_exchange_params;
+  // Same parameters indexed by ExchangeId, empty for exchanges without parameters
+  std::array<std::optional<ExchangeParams>, ConsolidatedBook::EXCHANGE_COUNT> m_exchange_params_by_id;
   double m_profit_margin;
 };
\ No newline at end of file
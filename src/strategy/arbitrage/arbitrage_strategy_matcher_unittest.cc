@@ -52,4 +52,33 @@ TEST_F(ArbitrageStrategyMatcherFixture, OnTickerTest)
   // TODO: fix calculation precision ?
   // EXPECT_DOUBLE_EQ(0.0451, exchange_match.profit);
   EXPECT_NEAR(0.0451, exchange_match.profit, 0.000000000001);
-}
\ No newline at end of file
+}
+
+TEST(ArbitrageStrategyMatcherTest, ConsolidatedBookTest)
+{
+  std::unordered_map<std::string, ExchangeParams> exchange_params = {
+    {"binance", ExchangeParams("binance", 0.01, 0.01, 1)},
+    {"kraken", ExchangeParams("kraken", 0.01, 0.02, 1)}
+  };
+  ArbitrageStrategyMatcher matcher(exchange_params, 0);
+  ConsolidatedBook book;
+  Ticker ticker1;
+  ticker1.ask = 1.1;
+  ticker1.bid = 1.0;
+  ticker1.exchange = "binance";
+  ticker1.symbol = SymbolPairId::ADA_USDT;
+  Ticker ticker2;
+  ticker2.ask = 1.3;
+  ticker2.bid = 1.2;
+  ticker2.exchange = "kraken";
+  ticker2.symbol = SymbolPairId::ADA_USDT;
+  book.Update(ExchangeId::BINANCE, ticker1);
+  EXPECT_FALSE(matcher.FindMatch(book, SymbolPairId::ADA_USDT).has_value());
+  book.Update(ExchangeId::KRAKEN, ticker2);
+  auto exchange_match_opt = matcher.FindMatch(book, SymbolPairId::ADA_USDT);
+  ASSERT_TRUE(exchange_match_opt.has_value());
+  auto exchange_match = exchange_match_opt.value();
+  EXPECT_EQ("kraken", exchange_match.best_bid.exchange);
+  EXPECT_EQ("binance", exchange_match.best_ask.exchange);
+  EXPECT_NEAR(0.0451, exchange_match.profit, 0.000000000001);
+}
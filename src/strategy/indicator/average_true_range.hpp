@@ -1,11 +1,14 @@
+#pragma once
+
 #include "model/candle.h"
+#include "utils/checkpoint.hpp"
 
 #include <algorithm>
 #include <vector>
 
-class AverageTrueRange {
+class AverageTrueRange : public cryptobot::Checkpointable {
 public:
-  AverageTrueRange(size_t period) : m_period(period) {
+  AverageTrueRange(size_t period) : m_period(period), m_tr_sum(0) {
 
   }
 
@@ -24,6 +27,18 @@ public:
   double Get() const {
     return m_atr.at(m_atr.size() - 1);
   }
+
+  virtual void SaveState(cryptobot::CheckpointWriter& writer) const override {
+    writer.WriteVector(m_true_range);
+    writer.WriteVector(m_atr);
+    writer.Write(m_tr_sum);
+  }
+
+  virtual void LoadState(cryptobot::CheckpointReader& reader) override {
+    m_true_range = reader.ReadVector<double>();
+    m_atr = reader.ReadVector<double>();
+    m_tr_sum = reader.Read<double>();
+  }
 private:
   const size_t m_period;
   std::vector<double> m_true_range;
@@ -1,10 +1,14 @@
+#pragma once
+
+#include "utils/checkpoint.hpp"
+
 #include <cassert>
 #include <optional>
 #include <vector>
 
-class SimpleMovingAverage {
+class SimpleMovingAverage : public cryptobot::Checkpointable {
 public:
-  SimpleMovingAverage(size_t period) : m_period(period), m_count(0) {
+  SimpleMovingAverage(size_t period) : m_period(period), m_sum(0), m_count(0) {
   }
 
   void Update(const std::vector<double>& series) {
@@ -54,6 +58,18 @@ public:
     const size_t sz = m_smas.size();
     return m_smas[sz - 1] - m_smas[sz - 2];
   }
+
+  virtual void SaveState(cryptobot::CheckpointWriter& writer) const override {
+    writer.WriteVector(m_smas);
+    writer.Write(m_sum);
+    writer.Write<uint64_t>(m_count);
+  }
+
+  virtual void LoadState(cryptobot::CheckpointReader& reader) override {
+    m_smas = reader.ReadVector<double>();
+    m_sum = reader.Read<double>();
+    m_count = reader.Read<uint64_t>();
+  }
 private:
   const size_t m_period;
   std::vector<double> m_smas;
@@ -1,5 +1,7 @@
 #include "strategy/market_making/market_making_risk_manager.h"
 
+#include "model/model_checkpoint.hpp"
+
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
 
@@ -46,6 +48,28 @@ void MarketMakingRiskManager::OnOrderUpdate(const Order& order) {
   }
 }
 
+void MarketMakingRiskManager::SaveState(cryptobot::CheckpointWriter& writer) const {
+  std::scoped_lock<std::mutex> order_lock{m_order_mutex};
+  writer.Write<uint64_t>(m_orders.size());
+  for (const auto& order : m_orders) {
+    SaveOrder(writer, order);
+  }
+  SaveAccountBalance(writer, m_account_balance);
+  writer.Write(m_trading_balance);
+  writer.Write(m_last_order_timestamp_us);
+}
+
+void MarketMakingRiskManager::LoadState(cryptobot::CheckpointReader& reader) {
+  std::scoped_lock<std::mutex> order_lock{m_order_mutex};
+  m_orders.clear();
+  for (uint64_t i = reader.Read<uint64_t>(); i > 0; --i) {
+    m_orders.push_back(LoadOrder(reader));
+  }
+  m_account_balance = LoadAccountBalance(reader);
+  m_trading_balance = reader.Read<double>();
+  m_last_order_timestamp_us = reader.Read<uint64_t>();
+}
+
 namespace {
 // TODO: temporarily here
 
@@ -1,6 +1,7 @@
 #include "exchange/exchange_client.h"
 #include "exchange/user_data_listener.hpp"
 #include "model/prediction.h"
+#include "utils/checkpoint.hpp"
 
 #include <mutex>
 
@@ -15,7 +16,7 @@ struct MarketMakingRiskMangerOptions {
   double exp_rate_limit_coeff;
 };
 
-class MarketMakingRiskManager : public UserDataListener {
+class MarketMakingRiskManager : public UserDataListener, public cryptobot::Checkpointable {
 public:
   MarketMakingRiskManager(const MarketMakingRiskMangerOptions& opts, ExchangeClient* exchange_client);
 
@@ -31,6 +32,11 @@ public:
 
   void OnPricePrediction(const MarketMakingPrediction&);
 
+  // Checkpointable, open orders and balances
+  virtual void SaveState(cryptobot::CheckpointWriter& writer) const override;
+
+  virtual void LoadState(cryptobot::CheckpointReader& reader) override;
+
 private:
   std::vector<Order> CalculateOrders(const MarketMakingPrediction&);
 
@@ -42,6 +48,6 @@ private:
   // Amount of asset traded by the program.
   // Positive value means long position, negative value means short position.
   double m_trading_balance;
-  std::mutex m_order_mutex;
+  mutable std::mutex m_order_mutex;
   uint64_t m_last_order_timestamp_us;
 };
\ No newline at end of file
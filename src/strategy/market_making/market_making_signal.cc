@@ -1,5 +1,7 @@
 #include "market_making_signal.h"
 
+#include "model/model_checkpoint.hpp"
+
 #include <boost/log/trivial.hpp>
 
 #include <chrono>
@@ -98,4 +100,21 @@ void MarketMakingSignal::OnBookTicker(const Ticker& ticker) {
     m_minute = mins_count;
   }
   m_book_ticker = ticker;
-}
\ No newline at end of file
+}
+void MarketMakingSignal::SaveState(cryptobot::CheckpointWriter& writer) const {
+  writer.Write(m_minute);
+  SaveTicker(writer, m_book_ticker);
+  writer.WriteVector(m_mid_closes);
+  m_sma_short.SaveState(writer);
+  m_sma_mid.SaveState(writer);
+  m_sma_long.SaveState(writer);
+}
+
+void MarketMakingSignal::LoadState(cryptobot::CheckpointReader& reader) {
+  m_minute = reader.Read<int32_t>();
+  m_book_ticker = LoadTicker(reader);
+  m_mid_closes = reader.ReadVector<double>();
+  m_sma_short.LoadState(reader);
+  m_sma_mid.LoadState(reader);
+  m_sma_long.LoadState(reader);
+}
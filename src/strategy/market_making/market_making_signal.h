@@ -1,23 +1,26 @@
 #include "exchange/exchange_listener.h"
+#include "model/order_book_snapshot.h"
 #include "model/prediction.h"
 #include "strategy/indicator/order_book_imbalance.h"
 #include "strategy/indicator/relative_strength_index.h"
 #include "strategy/indicator/simple_moving_average.hpp"
 #include "strategy/trading_signal.hpp"
+#include "utils/checkpoint.hpp"
 
 #include <vector>
 
 struct MarketMakingPredictionData {
-  MarketMakingPredictionData(uint64_t timestamp_us_, const OrderBook& ob_) : timestamp_us(timestamp_us_), ob(ob_) {}
+  MarketMakingPredictionData(uint64_t timestamp_us_, const OrderBookSnapshot& ob_) : timestamp_us(timestamp_us_), ob(ob_) {}
   uint64_t timestamp_us;
-  const OrderBook& ob;
+  const OrderBookSnapshot& ob;
   // uint64_t interval_ms;
   // std::vector<double> book_imbalances;
   // std::vector<double> trade_volumes;
   // std::vector<double> trade_prices;
 };
 
-class MarketMakingSignal : public TradingSignal<MarketMakingPredictionData, MarketMakingPrediction>, public ExchangeListener {
+class MarketMakingSignal : public TradingSignal<MarketMakingPredictionData, MarketMakingPrediction>, public ExchangeListener,
+    public cryptobot::Checkpointable {
 public:
   MarketMakingSignal();
   virtual ~MarketMakingSignal();
@@ -28,6 +31,10 @@ public:
   virtual void OnConnectionClose(const std::string& name) override;
   virtual void OnBookTicker(const Ticker& ticker) override;
 
+  // Checkpointable, minute closes and moving averages
+  virtual void SaveState(cryptobot::CheckpointWriter& writer) const override;
+  virtual void LoadState(cryptobot::CheckpointReader& reader) override;
+
 private:
   RelativeStrengthIndex m_rsi;
   OrderBookImbalance m_ob_imbalance;
@@ -1,11 +1,27 @@
 #include "market_making_strategy.h"
 
-MarketMakingStrategy::MarketMakingStrategy(MarketMakingRiskManager& risk_manager) : m_risk_manager(risk_manager) {
+#include "model/model_checkpoint.hpp"
+
+MarketMakingStrategy::MarketMakingStrategy(MarketMakingRiskManager& risk_manager) : m_risk_manager(risk_manager), m_running(false) {
 
 }
 
 MarketMakingStrategy::~MarketMakingStrategy() {
+  Stop();
+}
+
+void MarketMakingStrategy::Start() {
+  if (m_running.exchange(true)) {
+    return;
+  }
+  m_thread = std::thread(&MarketMakingStrategy::Run, this);
+}
 
+void MarketMakingStrategy::Stop() {
+  m_running = false;
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
 }
 
 void MarketMakingStrategy::OnConnectionOpen(const std::string&) {
@@ -30,13 +46,48 @@ void MarketMakingStrategy::OnTradeTicker(const TradeTicker& ticker) {
 }
 
 void MarketMakingStrategy::OnOrderBookUpdate(const OrderBook& order_book) {
+  m_feed_snapshot.Assign(order_book, order_book.GetLastUpdate().arrived_ts);
+  if (m_running.load(std::memory_order_relaxed)) {
+    m_book_snapshot.store(m_feed_snapshot);
+    return;
+  }
   std::scoped_lock<std::mutex> lock{m_mutex};
   BOOST_LOG_TRIVIAL(debug) << "MarketMakingStrategy::OnOrderBookUpdate, order_book=" << order_book;
   m_signal.OnOrderBookUpdate(order_book);
+  Predict(m_feed_snapshot);
+}
+
+void MarketMakingStrategy::SaveState(cryptobot::CheckpointWriter& writer) const {
+  std::scoped_lock<std::mutex> lock{m_mutex};
+  SaveTicker(writer, m_book_ticker);
+  m_signal.SaveState(writer);
+}
+
+void MarketMakingStrategy::LoadState(cryptobot::CheckpointReader& reader) {
+  std::scoped_lock<std::mutex> lock{m_mutex};
+  m_book_ticker = LoadTicker(reader);
+  m_signal.LoadState(reader);
+}
+
+void MarketMakingStrategy::Run() {
+  uint64_t seen_version = 0;
+  OrderBookSnapshot snapshot;
+  while (m_running.load(std::memory_order_relaxed)) {
+    const uint64_t version = m_book_snapshot.version();
+    if (version == seen_version) {
+      std::this_thread::yield();
+      continue;
+    }
+    seen_version = version;
+    snapshot = m_book_snapshot.load();
+    std::scoped_lock<std::mutex> lock{m_mutex};
+    Predict(snapshot);
+  }
+}
 
-  MarketMakingPredictionData data(order_book.GetLastUpdate().arrived_ts, order_book);
-  // data.timestamp_us = order_book.GetLastUpdate().arrived_ts;
-  // data.ob = order_book;
+// Requires m_mutex
+void MarketMakingStrategy::Predict(const OrderBookSnapshot& snapshot) {
+  MarketMakingPredictionData data(snapshot.timestamp_us, snapshot);
   BOOST_LOG_TRIVIAL(trace) << "Order book update timestamp: " << data.timestamp_us;
   MarketMakingPrediction prediction = m_signal.Predict(data);
   m_risk_manager.OnPricePrediction(prediction);
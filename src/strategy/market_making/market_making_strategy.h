@@ -1,10 +1,15 @@
 #include "exchange/exchange_listener.h"
 #include "market_making_signal.h"
 #include "market_making_risk_manager.h"
+#include "model/order_book_snapshot.h"
+#include "utils/checkpoint.hpp"
+#include "utils/seqlock.hpp"
 
+#include <atomic>
 #include <mutex>
+#include <thread>
 
-class MarketMakingStrategy : public ExchangeListener {
+class MarketMakingStrategy : public ExchangeListener, public cryptobot::Checkpointable {
 public:
 
   MarketMakingStrategy(MarketMakingRiskManager& risk_manager);
@@ -21,10 +26,34 @@ public:
 
   virtual void OnOrderBookUpdate(const OrderBook& order_book) override;
 
+  /**
+   * Run predictions on a dedicated strategy thread. Order book updates are then only
+   * published as snapshots, so the feed thread never waits for the strategy.
+   * Intermediate snapshots are skipped when the strategy can't keep up.
+   * Without Start() predictions run synchronously in OnOrderBookUpdate (eg. for backtests).
+   */
+  void Start();
+
+  void Stop();
+
+  // Checkpointable, state of the signal
+  virtual void SaveState(cryptobot::CheckpointWriter& writer) const override;
+
+  virtual void LoadState(cryptobot::CheckpointReader& reader) override;
+
+private:
+  void Run();
+  void Predict(const OrderBookSnapshot& snapshot);
+
 private:
   MarketMakingRiskManager& m_risk_manager;
   MarketMakingSignal m_signal;
   Ticker m_book_ticker;
   std::vector<double> m_mid_closes;
-  std::mutex m_mutex;
+  mutable std::mutex m_mutex;
+  // Written only by the feed thread
+  OrderBookSnapshot m_feed_snapshot;
+  cryptobot::seqlock<OrderBookSnapshot> m_book_snapshot;
+  std::atomic<bool> m_running;
+  std::thread m_thread;
 };
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace cryptobot {
+
+/**
+ * Monotonic bump allocator for short lived, trivially destructible data (eg. one replay batch).
+ *
+ * Memory is handed out from large blocks and never freed individually. reset() makes
+ * all blocks available again without returning them to the system, so a reused arena
+ * stops allocating once it has grown to the size of the largest batch.
+ */
+class arena {
+public:
+  static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+  explicit arena(size_t block_size = DEFAULT_BLOCK_SIZE) : m_block_size(block_size) {}
+
+  arena(const arena&) = delete;
+  arena& operator=(const arena&) = delete;
+  arena(arena&&) = default;
+  arena& operator=(arena&&) = default;
+
+  void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+    while (m_current < m_blocks.size()) {
+      Block& block = m_blocks[m_current];
+      const size_t offset = (block.used + alignment - 1) & ~(alignment - 1);
+      if (offset + size <= block.size) {
+        block.used = offset + size;
+        return block.data.get() + offset;
+      }
+      ++m_current;
+    }
+    // Oversized requests get a block of their own
+    const size_t block_size = std::max(m_block_size, size + alignment);
+    m_blocks.push_back(Block{std::make_unique<std::byte[]>(block_size), block_size, 0});
+    m_current = m_blocks.size() - 1;
+    return allocate(size, alignment);
+  }
+
+  /**
+   * Uninitialized storage for `count` objects of type T.
+   */
+  template <typename T>
+  T* allocate(size_t count) {
+    static_assert(std::is_trivially_destructible_v<T>, "arena does not run destructors");
+    return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+  }
+
+  /**
+   * Invalidates everything allocated so far, keeps the blocks for reuse.
+   */
+  void reset() noexcept {
+    for (Block& block : m_blocks) {
+      block.used = 0;
+    }
+    m_current = 0;
+  }
+
+  /**
+   * @return bytes reserved from the system
+   */
+  size_t capacity() const noexcept {
+    size_t total = 0;
+    for (const Block& block : m_blocks) {
+      total += block.size;
+    }
+    return total;
+  }
+
+private:
+  struct Block {
+    std::unique_ptr<std::byte[]> data;
+    size_t size;
+    size_t used;
+  };
+
+  size_t m_block_size;
+  std::vector<Block> m_blocks;
+  size_t m_current = 0;
+};
+
+}
@@ -0,0 +1,36 @@
+#include "arena.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <cstdint>
+
+using namespace testing;
+using namespace cryptobot;
+
+TEST(ArenaTest, AllocateTest) {
+  arena a(256);
+  EXPECT_EQ(0u, a.capacity());
+  char* c = a.allocate<char>(3);
+  uint64_t* u = a.allocate<uint64_t>(4);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(u) % alignof(uint64_t));
+  EXPECT_GE(reinterpret_cast<char*>(u), c + 3);
+  EXPECT_EQ(256u, a.capacity());
+  // Does not fit in the first block
+  a.allocate<char>(220);
+  EXPECT_EQ(512u, a.capacity());
+  // Oversized request
+  a.allocate<char>(1000);
+  EXPECT_GE(a.capacity(), 1512u);
+}
+
+TEST(ArenaTest, ResetReusesBlocksTest) {
+  arena a(256);
+  void* first = a.allocate(100, 8);
+  a.allocate(200, 8);
+  const size_t capacity = a.capacity();
+  a.reset();
+  EXPECT_EQ(first, a.allocate(100, 8));
+  a.allocate(200, 8);
+  EXPECT_EQ(capacity, a.capacity());
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+
+namespace cryptobot {
+
+/**
+ * Delays of consecutive retries, growing exponentially up to a maximum. Each delay is randomized
+ * by up to +-jitter of it, so that clients disconnected together do not all retry at once.
+ */
+class ExponentialBackoff {
+public:
+  typedef std::chrono::milliseconds Delay;
+
+  /**
+   * @param jitter fraction of a delay it is randomized by, in [0, 1)
+   * @throws std::invalid_argument for an initial delay over the maximum, a multiplier below 1 or a jitter out of range
+   */
+  ExponentialBackoff(Delay initial_delay, Delay max_delay, double multiplier = 2, double jitter = 0.2, uint64_t seed = std::random_device()())
+      : m_initial_delay(initial_delay), m_max_delay(max_delay), m_multiplier(multiplier), m_jitter(jitter), m_rng(seed),
+        m_next_delay(static_cast<double>(initial_delay.count())), m_attempts(0) {
+    if (initial_delay.count() < 0 || initial_delay > max_delay) {
+      throw std::invalid_argument("ExponentialBackoff: initial delay must be in [0, max delay]");
+    }
+    if (multiplier < 1) {
+      throw std::invalid_argument("ExponentialBackoff: multiplier must be at least 1");
+    }
+    if (jitter < 0 || jitter >= 1) {
+      throw std::invalid_argument("ExponentialBackoff: jitter must be in [0, 1)");
+    }
+  }
+
+  /**
+   * @return delay of the next retry
+   */
+  Delay Next() {
+    const double delay = m_next_delay;
+    m_next_delay = std::min(m_next_delay * m_multiplier, static_cast<double>(m_max_delay.count()));
+    ++m_attempts;
+    if (m_jitter == 0) {
+      return Delay(static_cast<Delay::rep>(delay));
+    }
+    std::uniform_real_distribution<double> jitter(1 - m_jitter, 1 + m_jitter);
+    return Delay(static_cast<Delay::rep>(delay * jitter(m_rng)));
+  }
+
+  // Starts over from the initial delay, once a retry succeeded
+  void Reset() {
+    m_next_delay = static_cast<double>(m_initial_delay.count());
+    m_attempts = 0;
+  }
+
+  // Retries since the last reset
+  uint32_t GetAttempts() const {
+    return m_attempts;
+  }
+
+private:
+  const Delay m_initial_delay;
+  const Delay m_max_delay;
+  const double m_multiplier;
+  const double m_jitter;
+  std::mt19937_64 m_rng;
+  double m_next_delay;
+  uint32_t m_attempts;
+};
+
+}
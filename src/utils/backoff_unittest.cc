@@ -0,0 +1,42 @@
+#include "backoff.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using namespace testing;
+using namespace cryptobot;
+using namespace std::chrono_literals;
+
+TEST(ExponentialBackoffTest, TestNoJitter) {
+  ExponentialBackoff backoff(100ms, 1000ms, 2, 0);
+  EXPECT_EQ(100ms, backoff.Next());
+  EXPECT_EQ(200ms, backoff.Next());
+  EXPECT_EQ(400ms, backoff.Next());
+  EXPECT_EQ(800ms, backoff.Next());
+  EXPECT_EQ(1000ms, backoff.Next());
+  EXPECT_EQ(1000ms, backoff.Next());
+  EXPECT_EQ(6u, backoff.GetAttempts());
+  backoff.Reset();
+  EXPECT_EQ(0u, backoff.GetAttempts());
+  EXPECT_EQ(100ms, backoff.Next());
+}
+
+TEST(ExponentialBackoffTest, TestJitter) {
+  ExponentialBackoff backoff(1000ms, 8000ms, 2, 0.25, 42);
+  ExponentialBackoff same_seed(1000ms, 8000ms, 2, 0.25, 42);
+  bool randomized = false;
+  for (int64_t base : {1000, 2000, 4000, 8000, 8000}) {
+    const auto delay = backoff.Next();
+    EXPECT_GE(delay.count(), base * 3 / 4);
+    EXPECT_LE(delay.count(), base * 5 / 4);
+    randomized |= delay.count() != base;
+    EXPECT_EQ(delay, same_seed.Next());
+  }
+  EXPECT_TRUE(randomized);
+}
+
+TEST(ExponentialBackoffTest, TestInvalid) {
+  EXPECT_THROW(ExponentialBackoff(2000ms, 1000ms), std::invalid_argument);
+  EXPECT_THROW(ExponentialBackoff(100ms, 1000ms, 0.5), std::invalid_argument);
+  EXPECT_THROW(ExponentialBackoff(100ms, 1000ms, 2, 1), std::invalid_argument);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace cryptobot {
+
+/**
+ * Bounded queue handing values from producer threads to a consumer, which block while
+ * the queue is full or empty (unlike BoundedQueue, meant for work where waiting is fine).
+ *
+ * Closing ends the stream: producers stop pushing, and the consumer pops the values left
+ * and then gets the end of the stream, or the error the queue was closed with.
+ */
+template <typename T>
+class BlockingQueue {
+public:
+  explicit BlockingQueue(size_t capacity) : m_capacity(capacity) {
+    if (capacity == 0) {
+      throw std::invalid_argument("BlockingQueue: capacity must be positive");
+    }
+  }
+
+  BlockingQueue(const BlockingQueue&) = delete;
+  BlockingQueue& operator=(const BlockingQueue&) = delete;
+
+  /**
+   * Blocks while the queue is full.
+   *
+   * @return false if the queue was closed, the value is dropped
+   */
+  bool Push(T value) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_not_full.wait(lock, [this]() { return m_closed || m_values.size() < m_capacity; });
+    if (m_closed) {
+      return false;
+    }
+    m_values.push_back(std::move(value));
+    m_not_empty.notify_one();
+    return true;
+  }
+
+  /**
+   * Blocks while the queue is empty and open.
+   *
+   * @return next value, std::nullopt once the queue is closed and drained
+   * @throws the error the queue was closed with, once drained
+   */
+  std::optional<T> Pop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_not_empty.wait(lock, [this]() { return m_closed || !m_values.empty(); });
+    if (m_values.empty()) {
+      if (m_error) {
+        std::rethrow_exception(m_error);
+      }
+      return std::nullopt;
+    }
+    std::optional<T> value(std::move(m_values.front()));
+    m_values.pop_front();
+    m_not_full.notify_one();
+    return value;
+  }
+
+  /**
+   * Ends the stream, wakes up blocked producers and the consumer. Only the first close counts.
+   *
+   * @param error rethrown by Pop() once the values left are popped
+   */
+  void Close(std::exception_ptr error = nullptr) {
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    if (m_closed) {
+      return;
+    }
+    m_closed = true;
+    m_error = error;
+    m_not_full.notify_all();
+    m_not_empty.notify_all();
+  }
+
+  size_t size() const {
+    std::scoped_lock<std::mutex> lock(m_mutex);
+    return m_values.size();
+  }
+
+private:
+  const size_t m_capacity;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_not_full;
+  std::condition_variable m_not_empty;
+  std::deque<T> m_values;
+  bool m_closed = false;
+  std::exception_ptr m_error;
+};
+
+}
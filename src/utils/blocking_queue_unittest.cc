@@ -0,0 +1,69 @@
+#include "blocking_queue.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+using namespace cryptobot;
+
+TEST(BlockingQueueTest, PushPopTest) {
+  BlockingQueue<std::unique_ptr<int>> queue(2);
+  EXPECT_TRUE(queue.Push(std::make_unique<int>(1)));
+  EXPECT_TRUE(queue.Push(std::make_unique<int>(2)));
+  EXPECT_EQ(2u, queue.size());
+  queue.Close();
+  // Closed queue rejects values but hands out the ones left
+  EXPECT_FALSE(queue.Push(std::make_unique<int>(3)));
+  std::optional<std::unique_ptr<int>> value = queue.Pop();
+  ASSERT_TRUE(value.has_value());
+  EXPECT_EQ(1, **value);
+  value = queue.Pop();
+  ASSERT_TRUE(value.has_value());
+  EXPECT_EQ(2, **value);
+  EXPECT_FALSE(queue.Pop().has_value());
+  EXPECT_THROW(BlockingQueue<int>(0), std::invalid_argument);
+}
+
+TEST(BlockingQueueTest, ProducerBlocksWhileFullTest) {
+  BlockingQueue<int> queue(1);
+  std::thread producer([&queue]() {
+    for (int i = 0; i < 100; ++i) {
+      ASSERT_TRUE(queue.Push(i));
+    }
+    queue.Close();
+  });
+  std::vector<int> values;
+  while (std::optional<int> value = queue.Pop()) {
+    EXPECT_LE(queue.size(), 1u);
+    values.push_back(value.value());
+  }
+  producer.join();
+  ASSERT_EQ(100u, values.size());
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(i, values[i]);
+  }
+}
+
+TEST(BlockingQueueTest, CloseWithErrorTest) {
+  BlockingQueue<int> queue(4);
+  queue.Push(1);
+  queue.Close(std::make_exception_ptr(std::runtime_error("fetch failed")));
+  EXPECT_EQ(1, queue.Pop().value());
+  EXPECT_THROW(queue.Pop(), std::runtime_error);
+}
+
+TEST(BlockingQueueTest, CloseWakesProducerTest) {
+  BlockingQueue<int> queue(1);
+  queue.Push(1);
+  std::thread producer([&queue]() {
+    // Blocks until the consumer gives up
+    EXPECT_FALSE(queue.Push(2));
+  });
+  queue.Close();
+  producer.join();
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace cryptobot {
+
+/**
+ * Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's array based queue).
+ *
+ * Every slot carries a sequence number telling whether it is ready to be written
+ * or read in the current lap, so producers and consumers only contend on their own index.
+ * TryPush fails instead of blocking when the queue is full.
+ */
+template <typename T>
+class BoundedQueue {
+  static_assert(std::is_default_constructible_v<T>, "BoundedQueue value must be default constructible");
+
+public:
+  /**
+   * @param capacity rounded up to a power of two
+   */
+  explicit BoundedQueue(size_t capacity) {
+    if (capacity == 0) {
+      throw std::invalid_argument("BoundedQueue: capacity must be positive");
+    }
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    m_mask = size - 1;
+    m_cells = std::make_unique<Cell[]>(size);
+    for (size_t i = 0; i < size; ++i) {
+      m_cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  /**
+   * @return false if the queue is full, `value` is not moved from then
+   */
+  bool TryPush(T&& value) {
+    size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = m_cells[pos & m_mask];
+      const size_t seq = cell.seq.load(std::memory_order_acquire);
+      const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          cell.value = std::move(value);
+          cell.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = m_enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool TryPush(const T& value) {
+    T copy(value);
+    return TryPush(std::move(copy));
+  }
+
+  /**
+   * @return false if the queue is empty
+   */
+  bool TryPop(T& out) {
+    size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = m_cells[pos & m_mask];
+      const size_t seq = cell.seq.load(std::memory_order_acquire);
+      const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          out = std::move(cell.value);
+          cell.seq.store(pos + m_mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = m_dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * Approximate number of queued values, exact only when there are no concurrent operations.
+   */
+  size_t size() const noexcept {
+    const size_t enqueue_pos = m_enqueue_pos.load(std::memory_order_relaxed);
+    const size_t dequeue_pos = m_dequeue_pos.load(std::memory_order_relaxed);
+    return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+  }
+
+  size_t capacity() const noexcept {
+    return m_mask + 1;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  size_t m_mask;
+  std::unique_ptr<Cell[]> m_cells;
+  // Producers and consumers on separate cache lines
+  alignas(64) std::atomic<size_t> m_enqueue_pos{0};
+  alignas(64) std::atomic<size_t> m_dequeue_pos{0};
+};
+
+}
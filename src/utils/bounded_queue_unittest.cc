@@ -0,0 +1,63 @@
+#include "bounded_queue.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+using namespace cryptobot;
+
+TEST(BoundedQueueTest, PushPopTest) {
+  BoundedQueue<std::string> queue(3);
+  EXPECT_EQ(4u, queue.capacity());
+  std::string value;
+  EXPECT_FALSE(queue.TryPop(value));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue.TryPush(std::to_string(i)));
+  }
+  std::string rejected("4");
+  EXPECT_FALSE(queue.TryPush(std::move(rejected)));
+  EXPECT_EQ("4", rejected);
+  EXPECT_EQ(4u, queue.size());
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(queue.TryPop(value));
+    EXPECT_EQ(std::to_string(i), value);
+  }
+  EXPECT_FALSE(queue.TryPop(value));
+  EXPECT_EQ(0u, queue.size());
+}
+
+TEST(BoundedQueueTest, ConcurrentProducersTest) {
+  constexpr uint64_t PER_PRODUCER = 100000;
+  BoundedQueue<uint64_t> queue(1024);
+  auto producer = [&](uint64_t id) {
+    for (uint64_t n = 0; n < PER_PRODUCER; ++n) {
+      while (!queue.TryPush(id << 32 | n)) {
+        std::this_thread::yield();
+      }
+    }
+  };
+  std::thread producer1(producer, 1);
+  std::thread producer2(producer, 2);
+  // Values of every producer come out in the order they were pushed
+  std::vector<uint64_t> next(3, 0);
+  uint64_t popped = 0;
+  uint64_t value;
+  while (popped < 2 * PER_PRODUCER) {
+    if (!queue.TryPop(value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    uint64_t id = value >> 32;
+    ASSERT_EQ(next[id], value & 0xFFFFFFFF);
+    ++next[id];
+    ++popped;
+  }
+  producer1.join();
+  producer2.join();
+  EXPECT_EQ(PER_PRODUCER, next[1]);
+  EXPECT_EQ(PER_PRODUCER, next[2]);
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace cryptobot {
+
+/**
+ * Appends values to a binary buffer, in host byte order. Checkpoints are only meant to be
+ * read back by the same build on the same machine.
+ */
+class CheckpointWriter {
+public:
+  template <typename T>
+  void Write(const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "CheckpointWriter: use a dedicated writer for this type");
+    m_data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  void WriteString(const std::string& value) {
+    Write<uint64_t>(value.size());
+    m_data.append(value);
+  }
+
+  template <typename T>
+  void WriteOptional(const std::optional<T>& value) {
+    Write<uint8_t>(value.has_value());
+    if (value) {
+      Write(value.value());
+    }
+  }
+
+  template <typename T>
+  void WriteVector(const std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable<T>::value, "CheckpointWriter: use a dedicated writer for this type");
+    Write<uint64_t>(values.size());
+    m_data.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+  }
+
+  /**
+   * Standard random engines, eg. std::mt19937_64, through their stream representation.
+   */
+  template <typename Engine>
+  void WriteEngine(const Engine& engine) {
+    std::ostringstream oss;
+    oss << engine;
+    WriteString(oss.str());
+  }
+
+  const std::string& GetData() const {
+    return m_data;
+  }
+
+private:
+  std::string m_data;
+};
+
+/**
+ * Reads values written by CheckpointWriter.
+ *
+ * @throws std::runtime_error when reading past the end of the data
+ */
+class CheckpointReader {
+public:
+  explicit CheckpointReader(const std::string& data) : m_data(data), m_offset(0) {}
+
+  template <typename T>
+  T Read() {
+    static_assert(std::is_trivially_copyable<T>::value, "CheckpointReader: use a dedicated reader for this type");
+    T value;
+    std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  std::string ReadString() {
+    const uint64_t size = Read<uint64_t>();
+    return std::string(Take(size), size);
+  }
+
+  template <typename T>
+  std::optional<T> ReadOptional() {
+    if (Read<uint8_t>()) {
+      return Read<T>();
+    }
+    return std::nullopt;
+  }
+
+  template <typename T>
+  std::vector<T> ReadVector() {
+    const uint64_t size = Read<uint64_t>();
+    if (size > (m_data.size() - m_offset) / sizeof(T)) {
+      throw std::runtime_error("CheckpointReader: truncated data");
+    }
+    std::vector<T> values(size);
+    std::memcpy(values.data(), Take(size * sizeof(T)), size * sizeof(T));
+    return values;
+  }
+
+  template <typename Engine>
+  void ReadEngine(Engine& engine) {
+    std::istringstream iss(ReadString());
+    iss >> engine;
+    if (!iss) {
+      throw std::runtime_error("CheckpointReader: bad random engine state");
+    }
+  }
+
+  bool AtEnd() const {
+    return m_offset == m_data.size();
+  }
+
+private:
+  const char* Take(size_t size) {
+    if (size > m_data.size() - m_offset) {
+      throw std::runtime_error("CheckpointReader: truncated data");
+    }
+    const char* p = m_data.data() + m_offset;
+    m_offset += size;
+    return p;
+  }
+
+  const std::string& m_data;
+  size_t m_offset;
+};
+
+/**
+ * Component of a backtest whose state can be saved to a checkpoint and restored from it.
+ */
+class Checkpointable {
+public:
+  virtual ~Checkpointable() = default;
+
+  virtual void SaveState(CheckpointWriter& writer) const = 0;
+
+  /**
+   * @throws std::runtime_error if the state can't be restored
+   */
+  virtual void LoadState(CheckpointReader& reader) = 0;
+};
+
+/**
+ * Named states of the components of a run, taken at one point of simulated time.
+ *
+ * File layout: magic, u32 version, u64 timestamp, u32 section count,
+ * then per section: u64 name length, name, u64 size, state.
+ */
+class Checkpoint {
+public:
+  explicit Checkpoint(uint64_t timestamp = 0) : m_timestamp(timestamp) {}
+
+  uint64_t GetTimestamp() const {
+    return m_timestamp;
+  }
+
+  void Add(const std::string& name, const Checkpointable& component) {
+    CheckpointWriter writer;
+    component.SaveState(writer);
+    m_sections.insert_or_assign(name, writer.GetData());
+  }
+
+  bool Contains(const std::string& name) const {
+    return m_sections.count(name) > 0;
+  }
+
+  /**
+   * @throws std::runtime_error if there is no such section or the component does not read all of it
+   */
+  void Restore(const std::string& name, Checkpointable& component) const {
+    auto it = m_sections.find(name);
+    if (it == m_sections.end()) {
+      throw std::runtime_error("Checkpoint: no state for " + name);
+    }
+    CheckpointReader reader(it->second);
+    component.LoadState(reader);
+    if (!reader.AtEnd()) {
+      throw std::runtime_error("Checkpoint: unread state for " + name);
+    }
+  }
+
+  /**
+   * Written to a temporary file first, so a crash while saving leaves no partial checkpoint.
+   *
+   * @throws std::runtime_error if the file can't be written
+   */
+  void Save(const std::string& path) const {
+    CheckpointWriter writer;
+    writer.Write(MAGIC);
+    writer.Write(VERSION);
+    writer.Write(m_timestamp);
+    writer.Write<uint32_t>(m_sections.size());
+    for (const auto& p : m_sections) {
+      writer.WriteString(p.first);
+      writer.WriteString(p.second);
+    }
+    const std::string tmp_path = path + ".tmp";
+    {
+      std::ofstream file(tmp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+      file.write(writer.GetData().data(), writer.GetData().size());
+      if (!file) {
+        throw std::runtime_error("Checkpoint: can't write " + tmp_path);
+      }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+      throw std::runtime_error("Checkpoint: can't rename " + tmp_path + " to " + path);
+    }
+  }
+
+  /**
+   * @throws std::runtime_error if the file can't be read or is not a checkpoint
+   */
+  static Checkpoint Load(const std::string& path) {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Checkpoint: can't open " + path);
+    }
+    std::ostringstream oss;
+    oss << file.rdbuf();
+    const std::string data = oss.str();
+    CheckpointReader reader(data);
+    if (data.size() < sizeof(MAGIC) || reader.Read<uint64_t>() != MAGIC) {
+      throw std::runtime_error("Checkpoint: not a checkpoint file: " + path);
+    }
+    const uint32_t version = reader.Read<uint32_t>();
+    if (version != VERSION) {
+      throw std::runtime_error("Checkpoint: unsupported version " + std::to_string(version));
+    }
+    Checkpoint checkpoint(reader.Read<uint64_t>());
+    const uint32_t count = reader.Read<uint32_t>();
+    for (uint32_t i = 0; i < count; ++i) {
+      std::string name = reader.ReadString();
+      checkpoint.m_sections.insert_or_assign(std::move(name), reader.ReadString());
+    }
+    return checkpoint;
+  }
+
+private:
+  static constexpr uint64_t MAGIC = 0x3150544b43544f42; // "BOTCKPT1"
+  static constexpr uint32_t VERSION = 1;
+
+  uint64_t m_timestamp;
+  std::map<std::string, std::string> m_sections;
+};
+
+}
@@ -0,0 +1,135 @@
+#include "checkpoint.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <unistd.h>
+
+using namespace testing;
+using namespace cryptobot;
+
+namespace {
+
+class Counter : public Checkpointable {
+public:
+  Counter(const std::string& name, uint64_t count) : m_name(name), m_count(count) {}
+
+  virtual void SaveState(CheckpointWriter& writer) const override {
+    writer.WriteString(m_name);
+    writer.Write(m_count);
+  }
+
+  virtual void LoadState(CheckpointReader& reader) override {
+    m_name = reader.ReadString();
+    m_count = reader.Read<uint64_t>();
+  }
+
+  std::string m_name;
+  uint64_t m_count;
+};
+
+// Reads less than it saved
+class PartialCounter : public Counter {
+public:
+  PartialCounter() : Counter("", 0) {}
+
+  virtual void LoadState(CheckpointReader& reader) override {
+    m_name = reader.ReadString();
+  }
+};
+
+class CheckpointTest : public Test {
+protected:
+  void SetUp() override {
+    m_path = (std::filesystem::temp_directory_path() / ("checkpoint_unittest_" + std::to_string(::getpid()))).string();
+    std::remove(m_path.c_str());
+  }
+
+  void TearDown() override {
+    std::remove(m_path.c_str());
+  }
+
+  std::string m_path;
+};
+
+}
+
+TEST(CheckpointReaderTest, TestRoundTrip) {
+  std::mt19937_64 engine(42);
+  engine();
+  CheckpointWriter writer;
+  writer.Write<uint32_t>(7);
+  writer.Write(1.5);
+  writer.WriteString("binance");
+  writer.WriteString("");
+  writer.WriteOptional(std::optional<uint64_t>(12));
+  writer.WriteOptional(std::optional<double>());
+  writer.WriteVector(std::vector<int64_t>{-1, 2, 3});
+  writer.WriteEngine(engine);
+
+  CheckpointReader reader(writer.GetData());
+  EXPECT_EQ(7u, reader.Read<uint32_t>());
+  EXPECT_DOUBLE_EQ(1.5, reader.Read<double>());
+  EXPECT_EQ("binance", reader.ReadString());
+  EXPECT_EQ("", reader.ReadString());
+  EXPECT_EQ(std::optional<uint64_t>(12), reader.ReadOptional<uint64_t>());
+  EXPECT_FALSE(reader.ReadOptional<double>().has_value());
+  EXPECT_THAT(reader.ReadVector<int64_t>(), ElementsAre(-1, 2, 3));
+  std::mt19937_64 restored;
+  reader.ReadEngine(restored);
+  EXPECT_TRUE(reader.AtEnd());
+  EXPECT_EQ(engine(), restored());
+}
+
+TEST(CheckpointReaderTest, TestTruncatedData) {
+  CheckpointWriter writer;
+  writer.WriteString("binance");
+  writer.WriteVector(std::vector<double>{1.0, 2.0});
+  const std::string data = writer.GetData();
+
+  const std::string truncated = data.substr(0, 4);
+  CheckpointReader reader(truncated);
+  EXPECT_THROW(reader.Read<uint64_t>(), std::runtime_error);
+
+  // Vector size larger than the data left
+  const std::string truncated_vector = data.substr(0, data.size() - 1);
+  CheckpointReader vector_reader(truncated_vector);
+  EXPECT_EQ("binance", vector_reader.ReadString());
+  EXPECT_THROW(vector_reader.ReadVector<double>(), std::runtime_error);
+}
+
+TEST_F(CheckpointTest, TestSaveLoad) {
+  Counter tickers("tickers", 10);
+  Counter trades("trades", 20);
+  Checkpoint checkpoint(123456);
+  checkpoint.Add("tickers", tickers);
+  checkpoint.Add("trades", trades);
+  checkpoint.Save(m_path);
+  EXPECT_FALSE(std::filesystem::exists(m_path + ".tmp"));
+
+  Checkpoint loaded = Checkpoint::Load(m_path);
+  EXPECT_EQ(123456u, loaded.GetTimestamp());
+  EXPECT_TRUE(loaded.Contains("tickers"));
+  EXPECT_FALSE(loaded.Contains("orders"));
+  Counter restored("", 0);
+  loaded.Restore("trades", restored);
+  EXPECT_EQ("trades", restored.m_name);
+  EXPECT_EQ(20u, restored.m_count);
+
+  EXPECT_THROW(loaded.Restore("orders", restored), std::runtime_error);
+  PartialCounter partial;
+  EXPECT_THROW(loaded.Restore("tickers", partial), std::runtime_error);
+}
+
+TEST_F(CheckpointTest, TestLoadInvalidFile) {
+  EXPECT_THROW(Checkpoint::Load(m_path), std::runtime_error);
+  {
+    std::ofstream file(m_path, std::ios::out | std::ios::binary);
+    file << "not a checkpoint";
+  }
+  EXPECT_THROW(Checkpoint::Load(m_path), std::runtime_error);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cryptobot {
+
+/**
+ * CRC-32 (IEEE 802.3, same as zlib and boost::crc_32_type).
+ * Can be computed incrementally: crc32(b, lb, crc32(a, la)) == crc32(ab, la + lb).
+ *
+ * Uses carry-less multiplication (PCLMULQDQ) on x86-64 CPUs that support it,
+ * portable slicing-by-8 table implementation otherwise.
+ */
+uint32_t crc32(const void* data, size_t len, uint32_t crc = 0);
+
+uint32_t crc32_portable(const void* data, size_t len, uint32_t crc = 0);
+
+bool crc32_has_hw_support();
+
+}
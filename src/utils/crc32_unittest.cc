@@ -0,0 +1,44 @@
+#include "crc32.h"
+
+#include <boost/crc.hpp>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace testing;
+using namespace cryptobot;
+
+TEST(Crc32Test, KnownValueTest) {
+  const std::string input = "123456789";
+  EXPECT_EQ(0xCBF43926u, crc32(input.data(), input.size()));
+  EXPECT_EQ(0xCBF43926u, crc32_portable(input.data(), input.size()));
+  EXPECT_EQ(0u, crc32(input.data(), 0));
+}
+
+TEST(Crc32Test, MatchesBoostTest) {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dist('0', '9');
+  std::vector<char> data(2048);
+  for (auto& c : data) {
+    c = static_cast<char>(dist(gen));
+  }
+  for (size_t len = 0; len < data.size(); len += 7) {
+    boost::crc_32_type expected;
+    expected.process_bytes(data.data(), len);
+    EXPECT_EQ(expected.checksum(), crc32(data.data(), len)) << "len=" << len;
+    EXPECT_EQ(expected.checksum(), crc32_portable(data.data(), len)) << "len=" << len;
+  }
+}
+
+TEST(Crc32Test, IncrementalTest) {
+  const std::string input = "5541300000000000000000000000000000000000000000000000000000000000000000000001234567891234";
+  uint32_t crc = 0;
+  for (size_t i = 0; i < input.size(); i += 5) {
+    crc = crc32(input.data() + i, std::min<size_t>(5, input.size() - i), crc);
+  }
+  EXPECT_EQ(crc32(input.data(), input.size()), crc);
+}
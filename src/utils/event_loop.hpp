@@ -0,0 +1,263 @@
+#pragma once
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/log/trivial.hpp>
+
+#include "json/json.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace cryptobot {
+
+/**
+ * Pins the calling thread to a core.
+ *
+ * @throws std::runtime_error if the core is not available to the process
+ */
+inline void PinCurrentThread(int cpu) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  const int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  if (err != 0) {
+    throw std::runtime_error("Can't pin thread to cpu " + std::to_string(cpu) + ": " + std::strerror(err));
+  }
+}
+
+/**
+ * Switches the calling thread to SCHED_FIFO with the priority, which needs CAP_SYS_NICE
+ * (or an RLIMIT_RTPRIO of at least the priority).
+ *
+ * @throws std::runtime_error if the scheduling policy can't be changed
+ */
+inline void SetCurrentThreadRealtimePriority(int priority) {
+  sched_param param{};
+  param.sched_priority = priority;
+  const int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+  if (err != 0) {
+    throw std::runtime_error("Can't set realtime priority " + std::to_string(priority) + ": " + std::strerror(err));
+  }
+}
+
+struct EventLoopOptions {
+  // Name in logs
+  std::string name;
+  // Core the loop thread is pinned to, not pinned if not set
+  std::optional<int> cpu;
+  // Spin on the loop instead of waiting for events in the kernel, saves the wakeup latency
+  // but keeps a core busy, so it should go with a dedicated cpu
+  bool busy_poll = false;
+  // SCHED_FIFO priority of the loop thread (1-99), normal scheduling if not set
+  std::optional<int> realtime_priority;
+
+  /**
+   * @param config eg. {"cpu": 2, "busy_poll": true, "realtime_priority": 50}, all optional
+   * @throws std::invalid_argument for values out of range
+   */
+  static EventLoopOptions FromJson(const std::string& name, const nlohmann::json& config) {
+    EventLoopOptions options;
+    options.name = name;
+    if (config.contains("cpu")) {
+      options.cpu = config["cpu"].get<int>();
+    }
+    options.busy_poll = config.value("busy_poll", false);
+    if (config.contains("realtime_priority")) {
+      options.realtime_priority = config["realtime_priority"].get<int>();
+    }
+    options.Validate();
+    return options;
+  }
+
+  /**
+   * @throws std::invalid_argument for values out of range
+   */
+  void Validate() const {
+    if (cpu.has_value() && (cpu.value() < 0 || cpu.value() >= CPU_SETSIZE)) {
+      throw std::invalid_argument("EventLoopOptions: invalid cpu " + std::to_string(cpu.value()) + " of loop " + name);
+    }
+    if (realtime_priority.has_value()
+        && (realtime_priority.value() < sched_get_priority_min(SCHED_FIFO) || realtime_priority.value() > sched_get_priority_max(SCHED_FIFO))) {
+      throw std::invalid_argument("EventLoopOptions: invalid realtime priority " + std::to_string(realtime_priority.value()) + " of loop " + name);
+    }
+  }
+};
+
+/**
+ * Thread running an asio io_context, shared by the websocket connections assigned to it
+ * (see WebsocketClient::set_event_loop()) instead of a thread per connection. Handlers of
+ * all connections of a loop run one at a time on the loop thread.
+ */
+class EventLoop {
+public:
+  /**
+   * @throws std::invalid_argument for invalid options
+   */
+  explicit EventLoop(const EventLoopOptions& options)
+      : m_options(options), m_work(boost::asio::make_work_guard(m_io_context)), m_stopped(false) {
+    m_options.Validate();
+  }
+
+  EventLoop(const EventLoop&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+
+  ~EventLoop() {
+    Stop();
+  }
+
+  /**
+   * Starts the loop thread and applies thread options. Handlers posted before are run once started.
+   *
+   * @throws std::runtime_error if the loop was started before, or thread options can't be applied
+   */
+  void Start() {
+    if (m_thread.joinable() || m_stopped) {
+      throw std::runtime_error("EventLoop: " + m_options.name + " started twice");
+    }
+    std::promise<void> started;
+    std::future<void> started_future = started.get_future();
+    m_thread = std::thread(&EventLoop::Run, this, std::move(started));
+    try {
+      started_future.get();
+    } catch (...) {
+      m_thread.join();
+      throw;
+    }
+    BOOST_LOG_TRIVIAL(info) << "Event loop " << m_options.name << " started"
+        << (m_options.cpu.has_value() ? " on cpu " + std::to_string(m_options.cpu.value()) : "")
+        << (m_options.busy_poll ? ", busy polling" : "");
+  }
+
+  /**
+   * Stops the loop thread, handlers not run yet are dropped.
+   */
+  void Stop() {
+    m_stopped = true;
+    m_work.reset();
+    m_io_context.stop();
+    if (m_thread.joinable()) {
+      m_thread.join();
+    }
+  }
+
+  void Post(std::function<void()> handler) {
+    boost::asio::post(m_io_context, std::move(handler));
+  }
+
+  boost::asio::io_context& GetIoContext() {
+    return m_io_context;
+  }
+
+  const EventLoopOptions& GetOptions() const {
+    return m_options;
+  }
+
+private:
+  void Run(std::promise<void> started) {
+    try {
+      if (m_options.cpu.has_value()) {
+        PinCurrentThread(m_options.cpu.value());
+      }
+      if (m_options.realtime_priority.has_value()) {
+        SetCurrentThreadRealtimePriority(m_options.realtime_priority.value());
+      }
+    } catch (...) {
+      started.set_exception(std::current_exception());
+      return;
+    }
+    pthread_setname_np(pthread_self(), m_options.name.substr(0, 15).c_str());
+    started.set_value();
+    while (!m_stopped) {
+      try {
+        if (m_options.busy_poll) {
+          m_io_context.poll();
+        } else {
+          m_io_context.run();
+        }
+      } catch (const std::exception& e) {
+        BOOST_LOG_TRIVIAL(error) << "Event loop " << m_options.name << " handler exception: " << e.what();
+      }
+      if (m_io_context.stopped() && !m_stopped) {
+        BOOST_LOG_TRIVIAL(warning) << "Event loop " << m_options.name << " stopped by a handler, restarting";
+        m_io_context.restart();
+      }
+    }
+  }
+
+  const EventLoopOptions m_options;
+  boost::asio::io_context m_io_context;
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type> m_work;
+  std::atomic<bool> m_stopped;
+  std::thread m_thread;
+};
+
+/**
+ * Event loops of a process with the streams assigned to them, configured as
+ * {"feeds": {"cpu": 2, "busy_poll": true, "realtime_priority": 50, "streams": ["binance_book_ticker", "kraken"]}, ...}
+ * Streams not assigned to a loop keep a thread of their own.
+ */
+class EventLoopGroup {
+public:
+  EventLoopGroup() {}
+
+  /**
+   * @throws std::invalid_argument for invalid loop options or a stream assigned to several loops
+   */
+  explicit EventLoopGroup(const nlohmann::json& config) {
+    for (const auto& loop_config : config.items()) {
+      m_loops.push_back(std::make_unique<EventLoop>(EventLoopOptions::FromJson(loop_config.key(), loop_config.value())));
+      for (const auto& stream : loop_config.value().value("streams", nlohmann::json::array())) {
+        if (!m_stream_loops.emplace(stream.get<std::string>(), m_loops.back().get()).second) {
+          throw std::invalid_argument("EventLoopGroup: stream " + stream.get<std::string>() + " assigned to several loops");
+        }
+      }
+    }
+  }
+
+  /**
+   * @return loop of the stream, nullptr if it was not assigned to one
+   */
+  EventLoop* GetStreamLoop(const std::string& stream) const {
+    auto it = m_stream_loops.find(stream);
+    return it != m_stream_loops.end() ? it->second : nullptr;
+  }
+
+  /**
+   * @throws std::runtime_error if thread options of a loop can't be applied
+   */
+  void Start() {
+    for (auto& loop : m_loops) {
+      loop->Start();
+    }
+  }
+
+  void Stop() {
+    for (auto& loop : m_loops) {
+      loop->Stop();
+    }
+  }
+
+  size_t size() const {
+    return m_loops.size();
+  }
+
+private:
+  std::vector<std::unique_ptr<EventLoop>> m_loops;
+  std::unordered_map<std::string, EventLoop*> m_stream_loops;
+};
+
+}
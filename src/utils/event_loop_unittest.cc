@@ -0,0 +1,104 @@
+#include "event_loop.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <future>
+#include <vector>
+
+using namespace testing;
+using namespace cryptobot;
+
+namespace {
+
+// First core the process may run on
+int GetAllowedCpu() {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  sched_getaffinity(0, sizeof(cpu_set), &cpu_set);
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &cpu_set)) {
+      return cpu;
+    }
+  }
+  return 0;
+}
+
+template <typename T>
+T RunOnLoop(EventLoop& loop, std::function<T()> f) {
+  std::promise<T> promise;
+  std::future<T> future = promise.get_future();
+  loop.Post([&]() {
+    promise.set_value(f());
+  });
+  return future.get();
+}
+
+}
+
+TEST(EventLoopTest, TestPost) {
+  EventLoop loop(EventLoopOptions{"test", std::nullopt, false, std::nullopt});
+  std::vector<int> handled;
+  // Posted before the start
+  loop.Post([&]() { handled.push_back(1); });
+  loop.Start();
+  loop.Post([&]() { handled.push_back(2); });
+  const std::thread::id loop_thread = RunOnLoop<std::thread::id>(loop, []() { return std::this_thread::get_id(); });
+  EXPECT_NE(std::this_thread::get_id(), loop_thread);
+  EXPECT_THAT(handled, ElementsAre(1, 2));
+  EXPECT_THROW(loop.Start(), std::runtime_error);
+  loop.Stop();
+  loop.Stop();
+}
+
+TEST(EventLoopTest, TestBusyPollPinned) {
+  const int cpu = GetAllowedCpu();
+  EventLoop loop(EventLoopOptions{"busy", cpu, true, std::nullopt});
+  loop.Start();
+  EXPECT_EQ(cpu, RunOnLoop<int>(loop, []() { return sched_getcpu(); }));
+  int count = 0;
+  for (int i = 0; i < 1000; ++i) {
+    loop.Post([&count]() { ++count; });
+  }
+  EXPECT_EQ(1000, RunOnLoop<int>(loop, [&count]() { return count; }));
+}
+
+TEST(EventLoopTest, TestHandlerException) {
+  EventLoop loop(EventLoopOptions{"test", std::nullopt, false, std::nullopt});
+  loop.Start();
+  loop.Post([]() { throw std::runtime_error("handler failed"); });
+  EXPECT_TRUE(RunOnLoop<bool>(loop, []() { return true; }));
+  // Stopped by a handler, eg. a websocket endpoint
+  loop.Post([&loop]() { loop.GetIoContext().stop(); });
+  EXPECT_TRUE(RunOnLoop<bool>(loop, []() { return true; }));
+}
+
+TEST(EventLoopTest, TestInvalidOptions) {
+  EXPECT_THROW(EventLoop(EventLoopOptions{"test", -1, false, std::nullopt}), std::invalid_argument);
+  EXPECT_THROW(EventLoop(EventLoopOptions{"test", std::nullopt, false, 100}), std::invalid_argument);
+  // Not a core of this machine
+  EventLoop loop(EventLoopOptions{"test", CPU_SETSIZE - 1, false, std::nullopt});
+  EXPECT_THROW(loop.Start(), std::runtime_error);
+}
+
+TEST(EventLoopGroupTest, TestStreams) {
+  const nlohmann::json config = nlohmann::json::parse(R"({
+    "feeds": {"busy_poll": true, "streams": ["binance_book_ticker", "kraken"]},
+    "orders": {"streams": ["binance_user_data"]}
+  })");
+  EventLoopGroup group(config);
+  EXPECT_EQ(2u, group.size());
+  ASSERT_NE(nullptr, group.GetStreamLoop("kraken"));
+  EXPECT_EQ(group.GetStreamLoop("binance_book_ticker"), group.GetStreamLoop("kraken"));
+  EXPECT_TRUE(group.GetStreamLoop("kraken")->GetOptions().busy_poll);
+  ASSERT_NE(nullptr, group.GetStreamLoop("binance_user_data"));
+  EXPECT_EQ("orders", group.GetStreamLoop("binance_user_data")->GetOptions().name);
+  EXPECT_FALSE(group.GetStreamLoop("binance_user_data")->GetOptions().busy_poll);
+  EXPECT_EQ(nullptr, group.GetStreamLoop("binance_trade_ticker"));
+  group.Start();
+  EXPECT_TRUE(RunOnLoop<bool>(*group.GetStreamLoop("kraken"), []() { return true; }));
+  group.Stop();
+
+  EXPECT_THROW(EventLoopGroup(nlohmann::json::parse(R"({"a": {"streams": ["kraken"]}, "b": {"streams": ["kraken"]}})")), std::invalid_argument);
+  EXPECT_THROW(EventLoopGroup(nlohmann::json::parse(R"({"a": {"cpu": -2}})")), std::invalid_argument);
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <system_error>
+
+namespace cryptobot {
+
+/**
+ * Forward-only JSON scanner over a raw message, for decoding known message schemas
+ * without building a DOM. Values are read in document order, values not needed
+ * are skipped without being parsed. Strings are returned as views into the message,
+ * so the message must outlive them.
+ *
+ * The scanner is not a validator: it accepts some malformed documents (eg. missing
+ * commas), but reads well-formed ones correctly. Any read of an unexpected token fails
+ * the scanner, all further reads then fail as well. Strings with escape sequences are
+ * not supported by ReadString(), callers fall back to a full parser for those.
+ */
+class JsonScanner {
+public:
+  explicit JsonScanner(std::string_view json) : m_pos(json.data()), m_end(json.data() + json.size()), m_failed(false) {}
+
+  bool Failed() const { return m_failed; }
+
+  /**
+   * @return first non-whitespace character, 0 at the end of the message
+   */
+  char Peek() {
+    SkipWhitespace();
+    return m_pos < m_end ? *m_pos : 0;
+  }
+
+  bool EnterObject() { return Consume('{'); }
+
+  bool EnterArray() { return Consume('['); }
+
+  /**
+   * Moves to the next member of the current object and reads its key.
+   *
+   * @return false at the end of the object (which is consumed) or on failure, see Failed()
+   */
+  bool NextMember(std::string_view& key) {
+    if (!NextItem('}')) {
+      return false;
+    }
+    return ReadString(key) && Consume(':');
+  }
+
+  /**
+   * Moves to the next element of the current array.
+   *
+   * @return false at the end of the array (which is consumed) or on failure, see Failed()
+   */
+  bool NextElement() {
+    return NextItem(']');
+  }
+
+  bool ReadString(std::string_view& value) {
+    if (!Consume('"')) {
+      return false;
+    }
+    const char* begin = m_pos;
+    const char* quote = static_cast<const char*>(std::memchr(begin, '"', m_end - begin));
+    if (quote == nullptr || std::memchr(begin, '\\', quote - begin) != nullptr) {
+      return Fail();
+    }
+    value = std::string_view(begin, quote - begin);
+    m_pos = quote + 1;
+    return true;
+  }
+
+  bool ReadUint(uint64_t& value) {
+    SkipWhitespace();
+    return FromChars(m_pos, m_end, value, m_pos);
+  }
+
+  bool ReadDouble(double& value) {
+    SkipWhitespace();
+    return FromChars(m_pos, m_end, value, m_pos);
+  }
+
+  bool ReadBool(bool& value) {
+    if (ConsumeLiteral("true")) {
+      value = true;
+      return true;
+    }
+    if (ConsumeLiteral("false")) {
+      value = false;
+      return true;
+    }
+    return Fail();
+  }
+
+  // Number sent as a string, eg. "0.12340000"
+  bool ReadQuotedDouble(double& value) {
+    std::string_view str;
+    if (!ReadString(str)) {
+      return false;
+    }
+    const char* end;
+    return FromChars(str.data(), str.data() + str.size(), value, end) && (end == str.data() + str.size() || Fail());
+  }
+
+  /**
+   * Skips the next value, including nested objects and arrays.
+   *
+   * @param raw if given, set to the text of the skipped value
+   */
+  bool SkipValue(std::string_view* raw = nullptr) {
+    SkipWhitespace();
+    const char* begin = m_pos;
+    size_t depth = 0;
+    do {
+      if (m_pos >= m_end) {
+        return Fail();
+      }
+      const char c = *m_pos;
+      if (c == '"') {
+        if (!SkipString()) {
+          return false;
+        }
+      } else if (c == '{' || c == '[') {
+        ++depth;
+        ++m_pos;
+      } else if (c == '}' || c == ']') {
+        if (depth == 0) {
+          return Fail();
+        }
+        --depth;
+        ++m_pos;
+      } else if (depth == 0) {
+        SkipScalar();
+        if (m_pos == begin) {
+          return Fail();
+        }
+      } else {
+        ++m_pos;
+      }
+    } while (depth > 0);
+    if (raw != nullptr) {
+      *raw = std::string_view(begin, m_pos - begin);
+    }
+    return true;
+  }
+
+private:
+  template <typename T>
+  bool FromChars(const char* begin, const char* end, T& value, const char*& next) {
+    if (m_failed) {
+      return false;
+    }
+    auto res = std::from_chars(begin, end, value);
+    if (res.ec != std::errc()) {
+      return Fail();
+    }
+    next = res.ptr;
+    return true;
+  }
+
+  bool NextItem(char close) {
+    if (m_failed) {
+      return false;
+    }
+    char c = Peek();
+    if (c == ',') {
+      ++m_pos;
+      c = Peek();
+    }
+    if (c == close) {
+      ++m_pos;
+      return false;
+    }
+    return c != 0 || Fail();
+  }
+
+  bool Consume(char expected) {
+    if (m_failed || Peek() != expected) {
+      return Fail();
+    }
+    ++m_pos;
+    return true;
+  }
+
+  bool ConsumeLiteral(std::string_view literal) {
+    if (m_failed) {
+      return false;
+    }
+    SkipWhitespace();
+    if (static_cast<size_t>(m_end - m_pos) < literal.size() || std::string_view(m_pos, literal.size()) != literal) {
+      return false;
+    }
+    m_pos += literal.size();
+    return true;
+  }
+
+  bool SkipString() {
+    for (const char* p = m_pos + 1; p < m_end; ++p) {
+      if (*p == '\\') {
+        ++p;
+      } else if (*p == '"') {
+        m_pos = p + 1;
+        return true;
+      }
+    }
+    return Fail();
+  }
+
+  // Numbers, true, false and null
+  void SkipScalar() {
+    while (m_pos < m_end && std::strchr(",:]} \t\r\n", *m_pos) == nullptr) {
+      ++m_pos;
+    }
+  }
+
+  void SkipWhitespace() {
+    while (m_pos < m_end && (*m_pos == ' ' || *m_pos == '\n' || *m_pos == '\r' || *m_pos == '\t')) {
+      ++m_pos;
+    }
+  }
+
+  bool Fail() {
+    m_failed = true;
+    return false;
+  }
+
+  const char* m_pos;
+  const char* m_end;
+  bool m_failed;
+};
+
+}
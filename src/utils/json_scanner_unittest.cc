@@ -0,0 +1,102 @@
+#include "json_scanner.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+using namespace testing;
+using namespace cryptobot;
+
+TEST(JsonScannerTest, TestObject) {
+  JsonScanner scanner(R"( {"s" : "ADAUSDT", "u":400900217, "b":"1.25000000", "m": true, "x": false, "n": 1.5e2 } )");
+  ASSERT_TRUE(scanner.EnterObject());
+  std::string_view key;
+  std::string_view str;
+  uint64_t u = 0;
+  double d = 0;
+  bool b = false;
+  ASSERT_TRUE(scanner.NextMember(key));
+  EXPECT_EQ("s", key);
+  ASSERT_TRUE(scanner.ReadString(str));
+  EXPECT_EQ("ADAUSDT", str);
+  ASSERT_TRUE(scanner.NextMember(key));
+  ASSERT_TRUE(scanner.ReadUint(u));
+  EXPECT_EQ(400900217u, u);
+  ASSERT_TRUE(scanner.NextMember(key));
+  ASSERT_TRUE(scanner.ReadQuotedDouble(d));
+  EXPECT_DOUBLE_EQ(1.25, d);
+  ASSERT_TRUE(scanner.NextMember(key));
+  ASSERT_TRUE(scanner.ReadBool(b));
+  EXPECT_TRUE(b);
+  ASSERT_TRUE(scanner.NextMember(key));
+  ASSERT_TRUE(scanner.ReadBool(b));
+  EXPECT_FALSE(b);
+  ASSERT_TRUE(scanner.NextMember(key));
+  EXPECT_EQ("n", key);
+  ASSERT_TRUE(scanner.ReadDouble(d));
+  EXPECT_DOUBLE_EQ(150, d);
+  EXPECT_FALSE(scanner.NextMember(key));
+  EXPECT_FALSE(scanner.Failed());
+  EXPECT_EQ(0, scanner.Peek());
+}
+
+TEST(JsonScannerTest, TestSkipValue) {
+  const std::string msg = R"([0,{"a":["1.0",1,"2.0"],"s":"]}\"{["},[],"book-10",null,-1.5])";
+  JsonScanner scanner(msg);
+  ASSERT_TRUE(scanner.EnterArray());
+  std::vector<std::string_view> elements;
+  while (scanner.NextElement()) {
+    std::string_view raw;
+    ASSERT_TRUE(scanner.SkipValue(&raw));
+    elements.push_back(raw);
+  }
+  EXPECT_FALSE(scanner.Failed());
+  EXPECT_THAT(elements, ElementsAre("0", R"({"a":["1.0",1,"2.0"],"s":"]}\"{["})", "[]", R"("book-10")", "null", "-1.5"));
+}
+
+TEST(JsonScannerTest, TestEmptyContainers) {
+  JsonScanner scanner(R"({"a":[],"b":{}})");
+  std::string_view key;
+  ASSERT_TRUE(scanner.EnterObject());
+  ASSERT_TRUE(scanner.NextMember(key));
+  ASSERT_TRUE(scanner.EnterArray());
+  EXPECT_FALSE(scanner.NextElement());
+  ASSERT_TRUE(scanner.NextMember(key));
+  ASSERT_TRUE(scanner.EnterObject());
+  EXPECT_FALSE(scanner.NextMember(key));
+  EXPECT_FALSE(scanner.NextMember(key));
+  EXPECT_FALSE(scanner.Failed());
+}
+
+TEST(JsonScannerTest, TestFailures) {
+  std::string_view str;
+  double d = 0;
+  uint64_t u = 0;
+  bool b = false;
+  // Escaped strings are left to a full parser
+  EXPECT_FALSE(JsonScanner(R"("a\"b")").ReadString(str));
+  EXPECT_FALSE(JsonScanner(R"("unterminated)").ReadString(str));
+  EXPECT_FALSE(JsonScanner(R"("1.5x")").ReadQuotedDouble(d));
+  EXPECT_FALSE(JsonScanner("-1").ReadUint(u));
+  EXPECT_FALSE(JsonScanner("null").ReadBool(b));
+  EXPECT_FALSE(JsonScanner("[1,2").SkipValue());
+  EXPECT_FALSE(JsonScanner("]").SkipValue());
+
+  // Reads fail once the scanner failed
+  JsonScanner scanner(R"({"a":x,"b":"1"})");
+  std::string_view key;
+  ASSERT_TRUE(scanner.EnterObject());
+  ASSERT_TRUE(scanner.NextMember(key));
+  EXPECT_FALSE(scanner.ReadString(str));
+  EXPECT_TRUE(scanner.Failed());
+  EXPECT_FALSE(scanner.NextMember(key));
+
+  JsonScanner truncated(R"({"a":"1")");
+  ASSERT_TRUE(truncated.EnterObject());
+  ASSERT_TRUE(truncated.NextMember(key));
+  ASSERT_TRUE(truncated.ReadString(str));
+  EXPECT_FALSE(truncated.NextMember(key));
+  EXPECT_TRUE(truncated.Failed());
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+
+namespace cryptobot {
+
+/**
+ * Histogram of latencies, eg. in microseconds, with log2 buckets split into 8 linear sub-buckets,
+ * so percentiles are within 12.5% of the exact value. Values below 16 are counted exactly.
+ * Recording is a few instructions and never allocates, not thread safe.
+ */
+class LatencyHistogram {
+public:
+  LatencyHistogram() : m_buckets(), m_count(0), m_sum(0), m_min(std::numeric_limits<uint64_t>::max()), m_max(0) {}
+
+  void Record(uint64_t value) {
+    ++m_buckets[BucketIndex(value)];
+    ++m_count;
+    m_sum += value;
+    m_min = std::min(m_min, value);
+    m_max = std::max(m_max, value);
+  }
+
+  void Merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+      m_buckets[i] += other.m_buckets[i];
+    }
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_min = std::min(m_min, other.m_min);
+    m_max = std::max(m_max, other.m_max);
+  }
+
+  uint64_t GetCount() const {
+    return m_count;
+  }
+
+  uint64_t GetMin() const {
+    return m_count > 0 ? m_min : 0;
+  }
+
+  uint64_t GetMax() const {
+    return m_max;
+  }
+
+  double GetMean() const {
+    return m_count > 0 ? m_sum / m_count : 0.0;
+  }
+
+  /**
+   * @param percentile in [0, 100]
+   * @return upper bound of the bucket of the percentile, capped by the maximum, 0 when empty
+   */
+  uint64_t GetPercentile(double percentile) const {
+    if (m_count == 0) {
+      return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * m_count)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+      seen += m_buckets[i];
+      if (seen >= rank) {
+        return std::min(BucketUpperBound(i), m_max);
+      }
+    }
+    return m_max;
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, const LatencyHistogram& histogram) {
+    os << "count=" << histogram.GetCount()
+       << " mean=" << histogram.GetMean()
+       << " p50=" << histogram.GetPercentile(50)
+       << " p90=" << histogram.GetPercentile(90)
+       << " p99=" << histogram.GetPercentile(99)
+       << " p99.9=" << histogram.GetPercentile(99.9)
+       << " max=" << histogram.GetMax();
+    return os;
+  }
+
+private:
+  static constexpr unsigned SUB_BUCKET_BITS = 3;
+  static constexpr uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  // Exact buckets for values below 2 * SUB_BUCKETS, then SUB_BUCKETS per power of two up to 2^63
+  static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+
+  static size_t BucketIndex(uint64_t value) {
+    if (value < 2 * SUB_BUCKETS) {
+      return value;
+    }
+    const unsigned msb = 63 - __builtin_clzll(value);
+    const unsigned shift = msb - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+  }
+
+  static uint64_t BucketUpperBound(size_t index) {
+    if (index < 2 * SUB_BUCKETS) {
+      return index;
+    }
+    const unsigned shift = index / SUB_BUCKETS - 1;
+    const uint64_t lower = (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+  }
+
+  std::array<uint64_t, BUCKET_COUNT> m_buckets;
+  uint64_t m_count;
+  double m_sum;
+  uint64_t m_min;
+  uint64_t m_max;
+};
+
+}
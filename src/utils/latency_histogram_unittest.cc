@@ -0,0 +1,73 @@
+#include "latency_histogram.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+using namespace testing;
+using namespace cryptobot;
+
+TEST(LatencyHistogramTest, TestEmpty) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(0u, histogram.GetCount());
+  EXPECT_EQ(0u, histogram.GetMin());
+  EXPECT_EQ(0u, histogram.GetMax());
+  EXPECT_DOUBLE_EQ(0.0, histogram.GetMean());
+  EXPECT_EQ(0u, histogram.GetPercentile(99));
+}
+
+TEST(LatencyHistogramTest, TestSmallValuesExact) {
+  LatencyHistogram histogram;
+  for (uint64_t v : {3, 1, 7, 5, 9}) {
+    histogram.Record(v);
+  }
+  EXPECT_EQ(5u, histogram.GetCount());
+  EXPECT_EQ(1u, histogram.GetMin());
+  EXPECT_EQ(9u, histogram.GetMax());
+  EXPECT_DOUBLE_EQ(5.0, histogram.GetMean());
+  EXPECT_EQ(1u, histogram.GetPercentile(0));
+  EXPECT_EQ(5u, histogram.GetPercentile(50));
+  EXPECT_EQ(9u, histogram.GetPercentile(100));
+}
+
+TEST(LatencyHistogramTest, TestPercentileResolution) {
+  LatencyHistogram histogram;
+  for (uint64_t v = 1; v <= 100000; ++v) {
+    histogram.Record(v);
+  }
+  for (double p : {50.0, 90.0, 99.0, 99.9}) {
+    const double exact = p / 100 * 100000;
+    const uint64_t value = histogram.GetPercentile(p);
+    EXPECT_GE(value, exact) << p;
+    EXPECT_LE(value, exact * 1.125) << p;
+  }
+  EXPECT_EQ(100000u, histogram.GetPercentile(100));
+}
+
+TEST(LatencyHistogramTest, TestLargeValues) {
+  LatencyHistogram histogram;
+  histogram.Record(std::numeric_limits<uint64_t>::max());
+  histogram.Record(uint64_t(1) << 40);
+  EXPECT_GE(histogram.GetPercentile(50), uint64_t(1) << 40);
+  EXPECT_LE(histogram.GetPercentile(50), (uint64_t(1) << 40) + (uint64_t(1) << 37));
+  EXPECT_EQ(std::numeric_limits<uint64_t>::max(), histogram.GetPercentile(100));
+}
+
+TEST(LatencyHistogramTest, TestMerge) {
+  LatencyHistogram a;
+  LatencyHistogram b;
+  a.Record(10);
+  b.Record(1000);
+  b.Record(2);
+  a.Merge(b);
+  EXPECT_EQ(3u, a.GetCount());
+  EXPECT_EQ(2u, a.GetMin());
+  EXPECT_EQ(1000u, a.GetMax());
+  EXPECT_EQ(10u, a.GetPercentile(50));
+
+  std::ostringstream oss;
+  oss << a;
+  EXPECT_THAT(oss.str(), HasSubstr("count=3"));
+  EXPECT_THAT(oss.str(), HasSubstr("max=1000"));
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace cryptobot {
+
+/**
+ * Sequence lock guarding a trivially copyable value.
+ *
+ * Single writer, any number of readers. The writer never blocks or waits for readers,
+ * readers retry when they raced with a write, so they always get a consistent copy.
+ * Intended for publishing small snapshots (eg. top of the order book) from feed threads.
+ */
+template <typename T>
+class seqlock {
+  static_assert(std::is_trivially_copyable_v<T>, "seqlock value must be trivially copyable");
+
+public:
+  seqlock() : m_seq(0), m_value() {}
+
+  seqlock(const seqlock&) = delete;
+  seqlock& operator=(const seqlock&) = delete;
+
+  /**
+   * Publish new value. Must not be called concurrently from multiple threads.
+   */
+  void store(const T& value) noexcept {
+    const uint64_t seq = m_seq.load(std::memory_order_relaxed);
+    // Odd sequence number marks write in progress
+    m_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&m_value, &value, sizeof(T));
+    m_seq.store(seq + 2, std::memory_order_release);
+  }
+
+  /**
+   * Single read attempt.
+   *
+   * @return false if the read raced with a write, `out` is then left in unspecified state
+   */
+  bool try_load(T& out) const noexcept {
+    const uint64_t seq_before = m_seq.load(std::memory_order_acquire);
+    if (seq_before & 1) {
+      return false;
+    }
+    std::memcpy(&out, &m_value, sizeof(T));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return m_seq.load(std::memory_order_relaxed) == seq_before;
+  }
+
+  T load() const noexcept {
+    T value;
+    while (!try_load(value)) {
+      __builtin_ia32_pause();
+    }
+    return value;
+  }
+
+  /**
+   * @return number of completed stores, readers can poll it to detect new values cheaply
+   */
+  uint64_t version() const noexcept {
+    return m_seq.load(std::memory_order_acquire) >> 1;
+  }
+
+private:
+  // Sequence number and value on separate cache lines, so that polling version()
+  // does not contend with the writer copying the value
+  alignas(64) std::atomic<uint64_t> m_seq;
+  alignas(64) T m_value;
+};
+
+}
@@ -0,0 +1,56 @@
+#include "seqlock.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <array>
+#include <atomic>
+#include <thread>
+
+using namespace testing;
+using namespace cryptobot;
+
+TEST(SeqlockTest, StoreLoadTest) {
+  seqlock<std::array<uint64_t, 4>> lock;
+  EXPECT_EQ(0u, lock.version());
+  EXPECT_THAT(lock.load(), ElementsAre(0, 0, 0, 0));
+  lock.store({1, 2, 3, 4});
+  EXPECT_EQ(1u, lock.version());
+  EXPECT_THAT(lock.load(), ElementsAre(1, 2, 3, 4));
+  lock.store({5, 6, 7, 8});
+  EXPECT_EQ(2u, lock.version());
+  std::array<uint64_t, 4> value;
+  ASSERT_TRUE(lock.try_load(value));
+  EXPECT_THAT(value, ElementsAre(5, 6, 7, 8));
+}
+
+TEST(SeqlockTest, ConcurrentReadersTest) {
+  using Value = std::array<uint64_t, 16>;
+  seqlock<Value> lock;
+  std::atomic<bool> done{false};
+  std::atomic<size_t> torn_reads{0};
+  auto reader = [&]() {
+    while (!done.load()) {
+      Value value = lock.load();
+      for (size_t i = 1; i < value.size(); ++i) {
+        if (value[i] != value[0]) {
+          ++torn_reads;
+          break;
+        }
+      }
+    }
+  };
+  std::thread reader1(reader);
+  std::thread reader2(reader);
+  for (uint64_t n = 1; n <= 200000; ++n) {
+    Value value;
+    value.fill(n);
+    lock.store(value);
+  }
+  done = true;
+  reader1.join();
+  reader2.join();
+  EXPECT_EQ(0u, torn_reads.load());
+  EXPECT_EQ(200000u, lock.version());
+  EXPECT_EQ(200000u, lock.load()[15]);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace cryptobot {
+
+/**
+ * Rate limiter allowing bursts of up to capacity operations, refilled at a steady rate,
+ * eg. for the message limits of exchange connections. Not thread safe.
+ */
+class TokenBucket {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * Starts full.
+   *
+   * @throws std::invalid_argument for a capacity below 1 or a non positive rate
+   */
+  TokenBucket(double capacity, double tokens_per_second, Clock::time_point now = Clock::now())
+      : m_capacity(capacity), m_tokens_per_second(tokens_per_second), m_tokens(capacity), m_last_refill(now) {
+    if (capacity < 1) {
+      throw std::invalid_argument("TokenBucket: capacity must be at least 1");
+    }
+    if (tokens_per_second <= 0) {
+      throw std::invalid_argument("TokenBucket: rate must be positive");
+    }
+  }
+
+  /**
+   * @return true if a token was taken, false if the bucket is empty
+   */
+  bool TryAcquire(Clock::time_point now = Clock::now()) {
+    Refill(now);
+    if (m_tokens < 1) {
+      return false;
+    }
+    m_tokens -= 1;
+    return true;
+  }
+
+  /**
+   * @return time until a token is available, zero if one is available now
+   */
+  std::chrono::microseconds GetWait(Clock::time_point now = Clock::now()) {
+    Refill(now);
+    if (m_tokens >= 1) {
+      return std::chrono::microseconds(0);
+    }
+    // Rounded up not to wake up just before the token is there
+    return std::chrono::microseconds(static_cast<int64_t>((1 - m_tokens) / m_tokens_per_second * 1e6) + 1);
+  }
+
+private:
+  void Refill(Clock::time_point now) {
+    if (now <= m_last_refill) {
+      return;
+    }
+    const double elapsed_s = std::chrono::duration<double>(now - m_last_refill).count();
+    m_tokens = std::min(m_capacity, m_tokens + elapsed_s * m_tokens_per_second);
+    m_last_refill = now;
+  }
+
+  const double m_capacity;
+  const double m_tokens_per_second;
+  double m_tokens;
+  Clock::time_point m_last_refill;
+};
+
+}
@@ -0,0 +1,33 @@
+#include "token_bucket.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using namespace testing;
+using namespace cryptobot;
+using namespace std::chrono_literals;
+
+TEST(TokenBucketTest, TestBurstAndRefill) {
+  const TokenBucket::Clock::time_point start;
+  TokenBucket bucket(5, 5, start);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_TRUE(bucket.TryAcquire(start));
+  }
+  EXPECT_FALSE(bucket.TryAcquire(start));
+  EXPECT_EQ(200001us, bucket.GetWait(start));
+  EXPECT_FALSE(bucket.TryAcquire(start + 199ms));
+  EXPECT_TRUE(bucket.TryAcquire(start + 201ms));
+  EXPECT_FALSE(bucket.TryAcquire(start + 201ms));
+  // Refilled up to the capacity only
+  const auto later = start + 10s;
+  EXPECT_EQ(0us, bucket.GetWait(later));
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_TRUE(bucket.TryAcquire(later));
+  }
+  EXPECT_FALSE(bucket.TryAcquire(later));
+}
+
+TEST(TokenBucketTest, TestInvalid) {
+  EXPECT_THROW(TokenBucket(0.5, 1), std::invalid_argument);
+  EXPECT_THROW(TokenBucket(1, 0), std::invalid_argument);
+}
@@ -1,7 +1,9 @@
+#include "binance_message_decoders.hpp"
 #include "tickers_watcher.hpp"
 
 #include "exchange/exchange_listener.h"
 #include "serialization_utils.hpp"
+#include "subscription_messages.hpp"
 #include "websocket/websocket_client.hpp"
 #include "utils/spinlock.hpp"
 
@@ -11,6 +13,7 @@
 #include <optional>
 #include <string>
 #include <thread>
+#include <vector>
 
 using namespace std::chrono;
 
@@ -22,27 +25,45 @@ public:
 
   BinanceBookTickerStream(ExchangeListener* exchange_listener)
       : WebsocketClient("wss://stream.binance.com:9443/ws/bookTicker", NAME), m_exchange_listener(exchange_listener), m_tickers_watcher(30000, NAME, this) {
+        // Binance allows 5 messages a second, pongs included
+        set_send_rate(3, 3);
         m_tickers_watcher.Start();
   }
 
   void SubscribeTicker(const std::string& symbol) {
-      const std::string message = "{\"method\": \"SUBSCRIBE\",\"params\": [\"" + symbol + "@bookTicker\"],\"id\": " + std::to_string(++s_sub_id) +"}";
-      m_subscription_msg.push_back(message);
-      BOOST_LOG_TRIVIAL(info) << message;
-      WebsocketClient::send(message);
+      SubscribeTickers({symbol});
+  }
+
+  // Subscribes with as few messages as possible, once connected if not yet
+  void SubscribeTickers(const std::vector<std::string>& symbols) {
+      std::vector<std::string> streams;
+      for (const auto& symbol : symbols) {
+        streams.push_back(symbol + "@bookTicker");
+      }
+      Post([this, streams]() {
+        m_streams.insert(m_streams.end(), streams.begin(), streams.end());
+        if (get_state() == State::OPEN) {
+          Subscribe(streams);
+        }
+      });
   }
 
   void ListSubscriptions() {
       const std::string message = "{\"method\": \"LIST_SUBSCRIPTIONS\",\"id\": " + std::to_string(++s_sub_id) +"}";
-      WebsocketClient::send(message);
+      send_paced(message);
   }
 
 private:
-  virtual void OnOpen(websocketpp::connection_hdl) override {
-    for (const auto& msg : m_subscription_msg) {
-      std::this_thread::sleep_for(500ms);
-      WebsocketClient::send(msg);
+  void Subscribe(const std::vector<std::string>& streams) {
+    for (std::string& message : subscription_messages::BinanceSubscribe(streams, s_sub_id)) {
+      BOOST_LOG_TRIVIAL(info) << message;
+      send_paced(std::move(message));
     }
+  }
+
+  virtual void OnOpen(websocketpp::connection_hdl) override {
+    // Resubscribes after reconnecting too
+    Subscribe(m_streams);
     m_exchange_listener->OnConnectionOpen(NAME);
   }
 
@@ -51,19 +72,12 @@ private:
   }
 
   virtual void OnMessage(websocketpp::connection_hdl, client::message_ptr msg) override {
-      auto msg_json = json::parse(msg->get_payload());
-      BOOST_LOG_TRIVIAL(trace) << "Binance websocket message: " << msg_json;
-      // TODO: Perhaps do not do schema validation for every message in production
-      if (!msg_json.is_object()
-          || !utils::check_message(msg_json, {"u", "s", "b", "B", "a", "A"})) {
-        std::cout << "Binance: Not an expected ticker object: " << msg_json << std::endl;
+      BOOST_LOG_TRIVIAL(trace) << "Binance websocket message: " << msg->get_payload();
+      Ticker ticker;
+      if (!DecodeMessage<binance_decoders::BookTickerDecoder>(msg->get_payload(), ticker)) {
+        BOOST_LOG_TRIVIAL(warning) << "Binance: Not an expected ticker object: " << msg->get_payload();
         return;
       }
-      Ticker ticker;
-      ticker.bid = std::stod(msg_json["b"].get<std::string>());
-      ticker.bid_vol = std::optional<double>(std::stod(msg_json["B"].get<std::string>()));
-      ticker.ask = std::stod(msg_json["a"].get<std::string>());
-      ticker.ask_vol = std::optional<double>(std::stod(msg_json["A"].get<std::string>()));
       // Transaction time (received in ms)
       ticker.source_ts = std::nullopt;//std::optional<int64_t>(msg_json["T"].get<int64_t>() * 1000);
       // TODO: perhaps generate timestamp in base class and pass it to this method
@@ -72,9 +86,6 @@ private:
       microseconds us = duration_cast<microseconds>(tp);
       ticker.arrived_ts = us.count();
       ticker.exchange = NAME;
-      ticker.symbol = SymbolPair::FromBinanceString(msg_json["s"].get<std::string>());
-      // TODO: should be unique across exchange
-      ticker.id = 1;
       // TODO: reconnect/resubscribe all websocket clients when they are inactive for too long
       m_tickers_watcher.Set(SymbolPair(ticker.symbol), ticker.arrived_ts, ticker.arrived_ts);
       m_exchange_listener->OnBookTicker(ticker);
@@ -82,7 +93,8 @@ private:
 
 private:
   ExchangeListener* m_exchange_listener;
-  std::vector<std::string> m_subscription_msg;
+  // Subscribed streams, only used on the client thread
+  std::vector<std::string> m_streams;
   static int s_sub_id;
   TickersWatcher m_tickers_watcher;
 };
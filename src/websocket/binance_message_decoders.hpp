@@ -0,0 +1,224 @@
+#pragma once
+
+#include "message_decoder.hpp"
+
+#include "model/decimal.h"
+#include "model/order_book_update.h"
+#include "model/symbol.h"
+#include "model/ticker.h"
+#include "model/trade_ticker.h"
+#include "utils/json_scanner.hpp"
+
+#include "json/json.hpp"
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Decoders of Binance market data streams, see DecodeMessage(). They fill the fields
+ * sent by the exchange, the streams set the exchange name and the arrival time.
+ */
+namespace binance_decoders {
+
+// Member keys of Binance messages are single letters, @return 0 for others
+inline char ShortKey(std::string_view key) {
+  return key.size() == 1 ? key[0] : 0;
+}
+
+// [["price", "quantity"], ...]
+inline bool ReadLevels(cryptobot::JsonScanner& scanner, std::vector<OrderBookUpdate::Level>& levels) {
+  if (!scanner.EnterArray()) {
+    return false;
+  }
+  while (scanner.NextElement()) {
+    std::string_view price;
+    std::string_view volume;
+    if (!scanner.EnterArray() || !scanner.NextElement() || !scanner.ReadString(price)
+        || !scanner.NextElement() || !scanner.ReadString(volume)) {
+      return false;
+    }
+    while (scanner.NextElement()) {
+      scanner.SkipValue();
+    }
+    levels.push_back(OrderBookUpdate::Level{Decimal::Parse(price), Decimal::Parse(volume), std::nullopt});
+  }
+  return !scanner.Failed();
+}
+
+inline void ReadLevels(const json& levels_json, std::vector<OrderBookUpdate::Level>& levels) {
+  for (const json& lvl : levels_json) {
+    levels.push_back(OrderBookUpdate::Level{Decimal::Parse(lvl[0].get_ref<const std::string&>()),
+        Decimal::Parse(lvl[1].get_ref<const std::string&>()), std::nullopt});
+  }
+}
+
+inline bool ContainsAll(const json& msg_json, std::initializer_list<const char*> fields) {
+  if (!msg_json.is_object()) {
+    return false;
+  }
+  for (const char* field : fields) {
+    if (!msg_json.contains(field)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Individual symbol book ticker, eg.
+ * {"u":400900217,"s":"BNBUSDT","b":"25.35190000","B":"31.21000000","a":"25.36520000","A":"40.66000000"}
+ * The order book update id (u) goes to the ticker id, which tells copies of a ticker apart (see FeedArbiter).
+ */
+struct BookTickerDecoder {
+  static bool DecodeFast(std::string_view payload, Ticker& ticker) {
+    cryptobot::JsonScanner scanner(payload);
+    if (!scanner.EnterObject()) {
+      return false;
+    }
+    std::string_view key;
+    std::string_view symbol;
+    double bid_vol = 0;
+    double ask_vol = 0;
+    unsigned seen = 0;
+    while (scanner.NextMember(key)) {
+      switch (ShortKey(key)) {
+        case 'u': seen |= 1; scanner.ReadUint(ticker.id); break;
+        case 's': seen |= 2; scanner.ReadString(symbol); break;
+        case 'b': seen |= 4; scanner.ReadQuotedDouble(ticker.bid); break;
+        case 'B': seen |= 8; scanner.ReadQuotedDouble(bid_vol); break;
+        case 'a': seen |= 16; scanner.ReadQuotedDouble(ticker.ask); break;
+        case 'A': seen |= 32; scanner.ReadQuotedDouble(ask_vol); break;
+        default: scanner.SkipValue();
+      }
+    }
+    if (scanner.Failed() || seen != 63) {
+      return false;
+    }
+    ticker.bid_vol = bid_vol;
+    ticker.ask_vol = ask_vol;
+    ticker.symbol = SymbolPair::FromBinanceString(std::string(symbol));
+    return true;
+  }
+
+  static bool DecodeJson(const json& msg_json, Ticker& ticker) {
+    if (!ContainsAll(msg_json, {"u", "s", "b", "B", "a", "A"})) {
+      return false;
+    }
+    ticker.id = msg_json["u"].get<uint64_t>();
+    ticker.bid = std::stod(msg_json["b"].get_ref<const std::string&>());
+    ticker.bid_vol = std::stod(msg_json["B"].get_ref<const std::string&>());
+    ticker.ask = std::stod(msg_json["a"].get_ref<const std::string&>());
+    ticker.ask_vol = std::stod(msg_json["A"].get_ref<const std::string&>());
+    ticker.symbol = SymbolPair::FromBinanceString(msg_json["s"].get<std::string>());
+    return true;
+  }
+};
+
+/**
+ * Trade, eg. {"e":"trade","E":123456789,"s":"BNBBTC","t":12345,"p":"0.001","q":"100","b":88,"a":50,
+ * "T":123456785,"m":true,"M":true}
+ */
+struct TradeDecoder {
+  static bool DecodeFast(std::string_view payload, TradeTicker& ticker) {
+    cryptobot::JsonScanner scanner(payload);
+    if (!scanner.EnterObject()) {
+      return false;
+    }
+    std::string_view key;
+    std::string_view symbol;
+    uint64_t trade_id = 0;
+    unsigned seen = 0;
+    while (scanner.NextMember(key)) {
+      switch (ShortKey(key)) {
+        case 'e': seen |= 1; scanner.SkipValue(); break;
+        case 'E': seen |= 2; scanner.ReadUint(ticker.event_time); break;
+        case 's': seen |= 4; scanner.ReadString(symbol); break;
+        case 't': seen |= 8; scanner.ReadUint(trade_id); break;
+        case 'p': seen |= 16; scanner.ReadQuotedDouble(ticker.price); break;
+        case 'q': seen |= 32; scanner.ReadQuotedDouble(ticker.qty); break;
+        case 'T': seen |= 64; scanner.ReadUint(ticker.trade_time); break;
+        case 'm': seen |= 128; scanner.ReadBool(ticker.is_market_maker); break;
+        default: scanner.SkipValue();
+      }
+    }
+    if (scanner.Failed() || seen != 255) {
+      return false;
+    }
+    ticker.trade_id = std::to_string(trade_id);
+    ticker.symbol = SymbolPair::FromBinanceString(std::string(symbol));
+    return true;
+  }
+
+  static bool DecodeJson(const json& msg_json, TradeTicker& ticker) {
+    if (!ContainsAll(msg_json, {"e", "E", "s", "t", "p", "q", "T", "m"})) {
+      return false;
+    }
+    ticker.event_time = msg_json["E"].get<uint64_t>();
+    ticker.trade_time = msg_json["T"].get<uint64_t>();
+    ticker.symbol = SymbolPair::FromBinanceString(msg_json["s"].get<std::string>());
+    ticker.trade_id = std::to_string(msg_json["t"].get<uint64_t>());
+    ticker.price = std::stod(msg_json["p"].get_ref<const std::string&>());
+    ticker.qty = std::stod(msg_json["q"].get_ref<const std::string&>());
+    ticker.is_market_maker = msg_json["m"].get<bool>();
+    return true;
+  }
+};
+
+// Diff depth event with the update id range needed to sync it with a snapshot
+struct DepthUpdate {
+  uint64_t first_update_id = 0;
+  OrderBookUpdate update;
+};
+
+/**
+ * Diff depth event, eg. {"e":"depthUpdate","E":123456789,"s":"BNBBTC","U":157,"u":160,
+ * "b":[["0.0024","10"]],"a":[["0.0026","100"]]}
+ */
+struct DepthDecoder {
+  static bool DecodeFast(std::string_view payload, DepthUpdate& depth_update) {
+    cryptobot::JsonScanner scanner(payload);
+    if (!scanner.EnterObject()) {
+      return false;
+    }
+    OrderBookUpdate& update = depth_update.update;
+    std::string_view key;
+    std::string_view symbol;
+    unsigned seen = 0;
+    while (scanner.NextMember(key)) {
+      switch (ShortKey(key)) {
+        case 'e': seen |= 1; scanner.SkipValue(); break;
+        case 'E': seen |= 2; scanner.SkipValue(); break;
+        case 's': seen |= 4; scanner.ReadString(symbol); break;
+        case 'U': seen |= 8; scanner.ReadUint(depth_update.first_update_id); break;
+        case 'u': seen |= 16; scanner.ReadUint(update.last_update_id); break;
+        case 'b': seen |= ReadLevels(scanner, update.bids) ? 32 : 0; break;
+        case 'a': seen |= ReadLevels(scanner, update.asks) ? 64 : 0; break;
+        default: scanner.SkipValue();
+      }
+    }
+    if (scanner.Failed() || seen != 127) {
+      return false;
+    }
+    update.is_snapshot = false;
+    update.symbol = SymbolPair::FromBinanceString(std::string(symbol));
+    return true;
+  }
+
+  static bool DecodeJson(const json& msg_json, DepthUpdate& depth_update) {
+    if (!ContainsAll(msg_json, {"E", "U", "a", "b", "e", "s", "u"})) {
+      return false;
+    }
+    OrderBookUpdate& update = depth_update.update;
+    depth_update.first_update_id = msg_json["U"].get<uint64_t>();
+    update.last_update_id = msg_json["u"].get<uint64_t>();
+    update.is_snapshot = false;
+    update.symbol = SymbolPair::FromBinanceString(msg_json["s"].get<std::string>());
+    ReadLevels(msg_json["b"], update.bids);
+    ReadLevels(msg_json["a"], update.asks);
+    return true;
+  }
+};
+
+}
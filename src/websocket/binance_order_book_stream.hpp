@@ -1,3 +1,4 @@
+#include "binance_message_decoders.hpp"
 #include "tickers_watcher.hpp"
 
 #include "exchange/exchange_listener.h"
@@ -18,6 +19,11 @@ using namespace std::chrono;
 
 using json = nlohmann::json;
 
+/**
+ * Diff depth stream of a symbol, the order book starts from a REST api snapshot. In replay mode
+ * (see WebsocketClient::start_replay()) the snapshots are injected as messages in the format of the
+ * REST api instead (see replay_messages::BinanceDepthEncoder), the binance client may then be null.
+ */
 class BinanceOrderBookStream : public WebsocketClient {
 public:
   inline static const std::string EXCHANGE_NAME = "binance";
@@ -33,8 +39,12 @@ public:
 private:
   virtual void OnOpen(websocketpp::connection_hdl) override {
     BOOST_LOG_TRIVIAL(trace) << "BinanceOrderBookStream::OnOpen begin";
-    m_book_snapshot_future = std::async(std::launch::async, &BinanceOrderBookStream::GetOrderBookSnapshotInitial, this);
-    BOOST_LOG_TRIVIAL(trace) << "Getting snapshot";
+    if (m_replay) {
+      WaitForReplaySnapshot();
+    } else {
+      m_book_snapshot_future = std::async(std::launch::async, &BinanceOrderBookStream::GetOrderBookSnapshotInitial, this);
+      BOOST_LOG_TRIVIAL(trace) << "Getting snapshot";
+    }
     m_exchange_listener->OnConnectionOpen(EXCHANGE_NAME);
     BOOST_LOG_TRIVIAL(trace) << "BinanceOrderBookStream::OnOpen end";
   }
@@ -44,13 +54,25 @@ private:
   }
 
   virtual void OnMessage(websocketpp::connection_hdl, client::message_ptr msg) override {
-      auto msg_json = json::parse(msg->get_payload());
-      BOOST_LOG_TRIVIAL(trace) << "Binance order book websocket message: " << msg_json;
-      if (!msg_json.is_object()
-          || !utils::check_message(msg_json, {"E", "U", "a", "b", "e", "s", "u"})) {
-        BOOST_LOG_TRIVIAL(warning) << "Binance: Not an expected ticker object: " << msg_json << std::endl;
+      BOOST_LOG_TRIVIAL(trace) << "Binance order book websocket message: " << msg->get_payload();
+      binance_decoders::DepthUpdate depth_update;
+      if (!DecodeMessage<binance_decoders::DepthDecoder>(msg->get_payload(), depth_update)) {
+        if (m_replay) {
+          json snapshot_json = json::parse(msg->get_payload(), nullptr, false);
+          if (snapshot_json.is_object() && snapshot_json.contains("lastUpdateId")) {
+            OnReplaySnapshot(std::move(snapshot_json));
+            return;
+          }
+        }
+        BOOST_LOG_TRIVIAL(warning) << "Binance: Not an expected ticker object: " << msg->get_payload();
         return;
       }
+      OrderBookUpdate& update = depth_update.update;
+      update.exchange = EXCHANGE_NAME;
+      auto now = system_clock::now();
+      system_clock::duration tp = now.time_since_epoch();
+      microseconds us = duration_cast<microseconds>(tp);
+      update.arrived_ts = us.count();
       if (m_book_snapshot_future.valid()) {
         if (m_book_snapshot_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
           json snapshot_json = m_book_snapshot_future.get();
@@ -63,22 +85,22 @@ private:
           if (!m_depth_updates.empty()) {
             // Validation
             size_t i = 0;
-            uint64_t final_update_id = m_depth_updates[i]["u"].get<uint64_t>();
-            uint64_t first_update_id = m_depth_updates[i]["U"].get<uint64_t>();
+            uint64_t final_update_id = m_depth_updates[i].update.last_update_id;
+            uint64_t first_update_id = m_depth_updates[i].first_update_id;
             while (!(first_update_id <= last_update_id + 1 && final_update_id >= last_update_id + 1) && ++i < m_depth_updates.size()) {
-              final_update_id = m_depth_updates[i]["u"].get<uint64_t>();
-              first_update_id = m_depth_updates[i]["U"].get<uint64_t>();
+              final_update_id = m_depth_updates[i].update.last_update_id;
+              first_update_id = m_depth_updates[i].first_update_id;
             }
             if (i >= m_depth_updates.size()) {
               BOOST_LOG_TRIVIAL(info) << "No buffered events to process";
             }
             for (; i < m_depth_updates.size(); ++i) {
-              const json& depth_update = m_depth_updates[i];
-              uint64_t final_update_id = depth_update["u"].get<uint64_t>();
+              const OrderBookUpdate& buffered_update = m_depth_updates[i].update;
+              uint64_t final_update_id = buffered_update.last_update_id;
               if (final_update_id <= last_update_id) {
                 continue;
               }
-              m_order_book.Update(DeserializeOrderBookUpdate(depth_update));
+              m_order_book.Update(buffered_update);
               m_exchange_listener->OnOrderBookUpdate(m_order_book);
               m_previous_update_id = final_update_id;
             }
@@ -88,21 +110,24 @@ private:
           }
         } else {
           BOOST_LOG_TRIVIAL(info) << "Buffering order book update event";
-          m_depth_updates.push_back(msg_json);
+          m_depth_updates.push_back(std::move(depth_update));
           return;
         }
       }
-      uint64_t first_update_id = msg_json["U"].get<uint64_t>();
-      if (m_previous_update_id + 1 < first_update_id) {
-        BOOST_LOG_TRIVIAL(warning) << "Missing order book update, requesting snapshot";
+      if (m_previous_update_id + 1 < depth_update.first_update_id) {
         m_order_book.clear();
+        if (m_replay) {
+          BOOST_LOG_TRIVIAL(warning) << "Missing order book update, waiting for the next recorded snapshot";
+          WaitForReplaySnapshot();
+          return;
+        }
+        BOOST_LOG_TRIVIAL(warning) << "Missing order book update, requesting snapshot";
         m_book_snapshot_future = std::async(std::launch::async, &BinanceOrderBookStream::GetOrderBookSnapshot, this);
         return;
       }
-      m_previous_update_id = msg_json["u"].get<uint64_t>();
-      OrderBookUpdate update = DeserializeOrderBookUpdate(msg_json);
+      m_previous_update_id = update.last_update_id;
       m_tickers_watcher.Set(SymbolPair(update.symbol), update.arrived_ts, update.arrived_ts);
-      m_order_book.Update(DeserializeOrderBookUpdate(msg_json));
+      m_order_book.Update(update);
       m_exchange_listener->OnOrderBookUpdate(m_order_book);
   }
 
@@ -117,42 +142,31 @@ private:
     ob_update.arrived_ts = us.count();
     for (const json& bid : snapshot_json["bids"]) {
       OrderBookUpdate::Level lvl;
-      lvl.price = bid[0].get<std::string>();
-      lvl.volume = bid[1].get<std::string>();
+      lvl.price = Decimal::Parse(bid[0].get_ref<const std::string&>());
+      lvl.volume = Decimal::Parse(bid[1].get_ref<const std::string&>());
       ob_update.bids.push_back(std::move(lvl));
     }
     for (const json& ask : snapshot_json["asks"]) {
       OrderBookUpdate::Level lvl;
-      lvl.price = ask[0].get<std::string>();
-      lvl.volume = ask[1].get<std::string>();
+      lvl.price = Decimal::Parse(ask[0].get_ref<const std::string&>());
+      lvl.volume = Decimal::Parse(ask[1].get_ref<const std::string&>());
       ob_update.asks.push_back(std::move(lvl));
     }
     return ob_update;
   }
 
-  OrderBookUpdate DeserializeOrderBookUpdate(const json& update_json) { 
-    OrderBookUpdate ob_update;
-    ob_update.symbol = SymbolPair::FromBinanceString(update_json["s"].get<std::string>());
-    ob_update.exchange = EXCHANGE_NAME;
-    ob_update.last_update_id = update_json["u"].get<uint64_t>();
-    ob_update.is_snapshot = false;
-    auto now = system_clock::now();
-    system_clock::duration tp = now.time_since_epoch();
-    microseconds us = duration_cast<microseconds>(tp);
-    ob_update.arrived_ts = us.count();
-    for (const json& bid : update_json["b"]) {
-      OrderBookUpdate::Level lvl;
-      lvl.price = bid[0].get<std::string>();
-      lvl.volume = bid[1].get<std::string>();
-      ob_update.bids.push_back(std::move(lvl));
-    }
-    for (const json& ask : update_json["a"]) {
-      OrderBookUpdate::Level lvl;
-      lvl.price = ask[0].get<std::string>();
-      lvl.volume = ask[1].get<std::string>();
-      ob_update.asks.push_back(std::move(lvl));
+  // Diffs are buffered until a snapshot is injected
+  void WaitForReplaySnapshot() {
+    m_replay_snapshot = std::promise<json>();
+    m_book_snapshot_future = m_replay_snapshot.get_future();
+  }
+
+  // Applied with the next diff, as a snapshot received from the REST api
+  void OnReplaySnapshot(json snapshot_json) {
+    if (!m_book_snapshot_future.valid() || m_book_snapshot_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+      WaitForReplaySnapshot();
     }
-    return ob_update;
+    m_replay_snapshot.set_value(std::move(snapshot_json));
   }
 
   json GetOrderBookSnapshotInitial() {
@@ -177,5 +191,7 @@ private:
   OrderBook m_order_book;
   uint64_t m_previous_update_id;
   std::future<json> m_book_snapshot_future;
-  std::vector<json> m_depth_updates;
+  // Snapshot of replay mode, taken from the injected messages
+  std::promise<json> m_replay_snapshot;
+  std::vector<binance_decoders::DepthUpdate> m_depth_updates;
 };
\ No newline at end of file
@@ -1,8 +1,10 @@
+#include "binance_message_decoders.hpp"
 #include "tickers_watcher.hpp"
 
 #include "exchange/exchange_listener.h"
 #include "model/trade_ticker.h"
 #include "serialization_utils.hpp"
+#include "subscription_messages.hpp"
 #include "websocket/websocket_client.hpp"
 #include "utils/spinlock.hpp"
 
@@ -12,6 +14,7 @@
 #include <optional>
 #include <string>
 #include <thread>
+#include <vector>
 
 using namespace std::chrono;
 
@@ -23,27 +26,45 @@ public:
 
   BinanceTradeTickerStream(ExchangeListener* exchange_listener)
       : WebsocketClient("wss://stream.binance.com:9443/ws/trade", NAME), m_exchange_listener(exchange_listener), m_tickers_watcher(30000, NAME, this) {
+        // Binance allows 5 messages a second, pongs included
+        set_send_rate(3, 3);
         m_tickers_watcher.Start();
   }
 
   void SubscribeTicker(const std::string& symbol) {
-      const std::string message = "{\"method\": \"SUBSCRIBE\",\"params\": [\"" + symbol + "@trade\"],\"id\": " + std::to_string(++s_sub_id) +"}";
-      m_subscription_msg.push_back(message);
-      BOOST_LOG_TRIVIAL(info) << message;
-      WebsocketClient::send(message);
+      SubscribeTickers({symbol});
+  }
+
+  // Subscribes with as few messages as possible, once connected if not yet
+  void SubscribeTickers(const std::vector<std::string>& symbols) {
+      std::vector<std::string> streams;
+      for (const auto& symbol : symbols) {
+        streams.push_back(symbol + "@trade");
+      }
+      Post([this, streams]() {
+        m_streams.insert(m_streams.end(), streams.begin(), streams.end());
+        if (get_state() == State::OPEN) {
+          Subscribe(streams);
+        }
+      });
   }
 
   void ListSubscriptions() {
       const std::string message = "{\"method\": \"LIST_SUBSCRIPTIONS\",\"id\": " + std::to_string(++s_sub_id) +"}";
-      WebsocketClient::send(message);
+      send_paced(message);
   }
 
 private:
-  virtual void OnOpen(websocketpp::connection_hdl) override {
-    for (const auto& msg : m_subscription_msg) {
-      std::this_thread::sleep_for(500ms);
-      WebsocketClient::send(msg);
+  void Subscribe(const std::vector<std::string>& streams) {
+    for (std::string& message : subscription_messages::BinanceSubscribe(streams, s_sub_id)) {
+      BOOST_LOG_TRIVIAL(info) << message;
+      send_paced(std::move(message));
     }
+  }
+
+  virtual void OnOpen(websocketpp::connection_hdl) override {
+    // Resubscribes after reconnecting too
+    Subscribe(m_streams);
     m_exchange_listener->OnConnectionOpen(NAME);
   }
 
@@ -52,27 +73,17 @@ private:
   }
 
   virtual void OnMessage(websocketpp::connection_hdl, client::message_ptr msg) override {
-      auto msg_json = json::parse(msg->get_payload());
-      BOOST_LOG_TRIVIAL(trace) << "Binance trade ticker: " << msg_json;
-      // TODO: Perhaps do not do schema validation for every message in production
-      if (!msg_json.is_object()
-          || !utils::check_message(msg_json, {"e", "E", "s", "t", "p", "q", "T", "m"})) {
-        BOOST_LOG_TRIVIAL(warning) << "Binance: Not an expected trade ticker object: " << msg_json << std::endl;
+      BOOST_LOG_TRIVIAL(trace) << "Binance trade ticker: " << msg->get_payload();
+      TradeTicker ticker;
+      if (!DecodeMessage<binance_decoders::TradeDecoder>(msg->get_payload(), ticker)) {
+        BOOST_LOG_TRIVIAL(warning) << "Binance: Not an expected trade ticker object: " << msg->get_payload();
         return;
       }
-      TradeTicker ticker;
       auto now = system_clock::now();
       system_clock::duration tp = now.time_since_epoch();
       microseconds us = duration_cast<microseconds>(tp);
       ticker.arrived_ts = us.count();
-      ticker.event_time = msg_json["E"].get<uint64_t>();
-      ticker.trade_time = msg_json["T"].get<uint64_t>();
-      ticker.symbol = SymbolPair::FromBinanceString(msg_json["s"].get<std::string>());
       ticker.exchange = NAME;
-      ticker.trade_id = std::to_string(msg_json["t"].get<uint64_t>());
-      ticker.price = std::stod(msg_json["p"].get<std::string>());
-      ticker.qty = std::stod(msg_json["q"].get<std::string>());
-      ticker.is_market_maker = msg_json["m"].get<bool>();
 
       m_tickers_watcher.Set(SymbolPair(ticker.symbol), ticker.arrived_ts, ticker.arrived_ts);
       m_exchange_listener->OnTradeTicker(ticker);
@@ -80,7 +91,8 @@ private:
 
 private:
   ExchangeListener* m_exchange_listener;
-  std::vector<std::string> m_subscription_msg;
+  // Subscribed streams, only used on the client thread
+  std::vector<std::string> m_streams;
   static int s_sub_id;
   TickersWatcher m_tickers_watcher;
 };
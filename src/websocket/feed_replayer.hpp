@@ -0,0 +1,208 @@
+#pragma once
+
+#include "replay_target.hpp"
+
+#include "exchange/exchange_listener.h"
+#include "model/order_book.h"
+#include "model/ticker.h"
+#include "utils/latency_histogram.hpp"
+
+#include <boost/log/trivial.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct FeedReplayOptions {
+  // Replay speed relative to the recorded arrival times, eg. 10 for 10x, 0 for as fast as possible
+  double speed = 1.0;
+};
+
+/**
+ * Replays recorded events into live market data streams: registered with a CaptureFileReader, it
+ * encodes every event of a registered stream as an exchange message (see replay_messages.hpp) and
+ * injects it at its recorded arrival time, scaled by the replay speed. Messages are then parsed and
+ * passed to listeners on the stream threads, as they are when received from exchanges.
+ *
+ * Latency of a message is measured from the time it is due to the end of its handling, so it includes
+ * queueing behind earlier messages and the listeners called on the stream thread.
+ */
+class FeedReplayer : public ExchangeListener {
+public:
+  typedef std::function<std::string(const Ticker&)> TickerEncoder;
+  typedef std::function<std::string(const TradeTicker&)> TradeEncoder;
+  typedef std::function<std::string(const OrderBookUpdate&)> OrderBookEncoder;
+
+  /**
+   * @throws std::invalid_argument if the speed is negative
+   */
+  explicit FeedReplayer(const FeedReplayOptions& options = FeedReplayOptions())
+      : m_options(options), m_started(false), m_start_ts(0), m_injected(0), m_max_lag_us(0) {
+    if (m_options.speed < 0) {
+      throw std::invalid_argument("FeedReplayer: speed must not be negative");
+    }
+  }
+
+  /**
+   * Book tickers of the exchange go to the stream. A stream can take several kinds of events.
+   *
+   * @param name stream name in the latency report
+   */
+  void AddBookTickerStream(const std::string& exchange, const std::string& name, ReplayTarget& target, TickerEncoder encoder) {
+    m_ticker_routes.insert_or_assign(exchange, Route<TickerEncoder>{&GetStream(name, target), std::move(encoder)});
+  }
+
+  void AddTradeTickerStream(const std::string& exchange, const std::string& name, ReplayTarget& target, TradeEncoder encoder) {
+    m_trade_routes.insert_or_assign(exchange, Route<TradeEncoder>{&GetStream(name, target), std::move(encoder)});
+  }
+
+  void AddOrderBookStream(const std::string& exchange, const std::string& name, ReplayTarget& target, OrderBookEncoder encoder) {
+    m_order_book_routes.insert_or_assign(exchange, Route<OrderBookEncoder>{&GetStream(name, target), std::move(encoder)});
+  }
+
+  virtual void OnConnectionOpen(const std::string&) override {}
+
+  virtual void OnConnectionClose(const std::string&) override {}
+
+  virtual void OnBookTicker(const Ticker& ticker) override {
+    Send(m_ticker_routes, ticker.exchange, ticker.arrived_ts, ticker);
+  }
+
+  virtual void OnTradeTicker(const TradeTicker& ticker) override {
+    Send(m_trade_routes, ticker.exchange, ticker.arrived_ts, ticker);
+  }
+
+  virtual void OnOrderBookUpdate(const OrderBook& order_book) override {
+    const OrderBookUpdate& update = order_book.GetLastUpdate();
+    Send(m_order_book_routes, update.exchange, update.arrived_ts, update);
+  }
+
+  /**
+   * Waits until all streams handled the injected messages, latencies can be read afterwards.
+   */
+  void Finish() {
+    std::vector<std::future<void>> futures;
+    for (auto& stream : m_streams) {
+      auto promise = std::make_shared<std::promise<void>>();
+      futures.push_back(promise->get_future());
+      stream->target->Post([promise]() {
+        promise->set_value();
+      });
+    }
+    for (auto& future : futures) {
+      future.wait();
+    }
+  }
+
+  /**
+   * Latencies in microseconds of the messages of a stream, see Finish()
+   *
+   * @throws std::out_of_range for an unknown stream
+   */
+  const cryptobot::LatencyHistogram& GetLatencies(const std::string& name) const {
+    for (const auto& stream : m_streams) {
+      if (stream->name == name) {
+        return stream->latencies;
+      }
+    }
+    throw std::out_of_range("FeedReplayer: unknown stream " + name);
+  }
+
+  uint64_t GetInjectedCount() const {
+    return m_injected;
+  }
+
+  // How far injection fell behind the replay schedule, the replay is then slower than requested
+  uint64_t GetMaxLagUs() const {
+    return m_max_lag_us;
+  }
+
+  void LogReport() const {
+    BOOST_LOG_TRIVIAL(info) << "Replayed " << m_injected << " messages, max injection lag " << m_max_lag_us << " us";
+    for (const auto& stream : m_streams) {
+      BOOST_LOG_TRIVIAL(info) << stream->name << " latency us: " << stream->latencies;
+    }
+  }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Stream {
+    std::string name;
+    ReplayTarget* target;
+    // Written on the stream thread only
+    cryptobot::LatencyHistogram latencies;
+  };
+
+  template <typename Encoder>
+  struct Route {
+    Stream* stream;
+    Encoder encoder;
+  };
+
+  Stream& GetStream(const std::string& name, ReplayTarget& target) {
+    for (auto& stream : m_streams) {
+      if (stream->name == name) {
+        if (stream->target != &target) {
+          throw std::invalid_argument("FeedReplayer: stream " + name + " already added for another target");
+        }
+        return *stream;
+      }
+    }
+    m_streams.push_back(std::make_unique<Stream>(Stream{name, &target, cryptobot::LatencyHistogram()}));
+    return *m_streams.back();
+  }
+
+  template <typename Routes, typename Event>
+  void Send(Routes& routes, const std::string& exchange, uint64_t arrived_ts, const Event& event) {
+    auto it = routes.find(exchange);
+    if (it == routes.end()) {
+      return;
+    }
+    const Clock::time_point due = Pace(arrived_ts);
+    Stream* stream = it->second.stream;
+    ++m_injected;
+    stream->target->InjectMessage(it->second.encoder(event), [stream, due]() {
+      stream->latencies.Record(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - due).count());
+    });
+  }
+
+  // Sleeps until the event is due, @return the due time
+  Clock::time_point Pace(uint64_t arrived_ts) {
+    const Clock::time_point now = Clock::now();
+    if (!m_started) {
+      m_started = true;
+      m_start_ts = arrived_ts;
+      m_start_time = now;
+    }
+    if (m_options.speed == 0) {
+      return now;
+    }
+    const double elapsed_us = arrived_ts > m_start_ts ? (arrived_ts - m_start_ts) / m_options.speed : 0.0;
+    const Clock::time_point due = m_start_time + std::chrono::microseconds(static_cast<uint64_t>(elapsed_us));
+    if (due > now) {
+      std::this_thread::sleep_until(due);
+    } else {
+      m_max_lag_us = std::max<uint64_t>(m_max_lag_us, std::chrono::duration_cast<std::chrono::microseconds>(now - due).count());
+    }
+    return due;
+  }
+
+  FeedReplayOptions m_options;
+  std::vector<std::unique_ptr<Stream>> m_streams;
+  std::unordered_map<std::string, Route<TickerEncoder>> m_ticker_routes;
+  std::unordered_map<std::string, Route<TradeEncoder>> m_trade_routes;
+  std::unordered_map<std::string, Route<OrderBookEncoder>> m_order_book_routes;
+  bool m_started;
+  uint64_t m_start_ts;
+  Clock::time_point m_start_time;
+  uint64_t m_injected;
+  uint64_t m_max_lag_us;
+};
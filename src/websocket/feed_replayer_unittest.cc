@@ -0,0 +1,283 @@
+#include "binance_message_decoders.hpp"
+#include "feed_replayer.hpp"
+#include "kraken_order_book_handler.hpp"
+#include "replay_messages.hpp"
+
+#include "model/ticker_test_utils.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+using namespace testing;
+
+namespace {
+
+// Handles messages on its own thread, like a websocket client in replay mode
+class RecordingTarget : public ReplayTarget {
+public:
+  RecordingTarget() : m_running(true), m_thread(&RecordingTarget::Run, this) {}
+
+  ~RecordingTarget() {
+    Post([this]() {
+      m_running = false;
+    });
+    m_thread.join();
+  }
+
+  virtual void InjectMessage(std::string payload, std::function<void()> on_handled) override {
+    Post([this, payload = std::move(payload), on_handled = std::move(on_handled)]() {
+      m_payloads.push_back(payload);
+      if (on_handled) {
+        on_handled();
+      }
+    });
+  }
+
+  virtual void Post(std::function<void()> handler) override {
+    std::scoped_lock<std::mutex> lock{m_mutex};
+    m_handlers.push_back(std::move(handler));
+    m_cv.notify_one();
+  }
+
+  // Read after FeedReplayer::Finish()
+  std::vector<std::string> m_payloads;
+
+private:
+  void Run() {
+    while (m_running) {
+      std::function<void()> handler;
+      {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_cv.wait(lock, [this]() { return !m_handlers.empty(); });
+        handler = std::move(m_handlers.front());
+        m_handlers.pop_front();
+      }
+      handler();
+    }
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<std::function<void()>> m_handlers;
+  bool m_running;
+  std::thread m_thread;
+};
+
+OrderBookUpdate::Level CreateLevel(const std::string& price, const std::string& volume, std::optional<uint64_t> ts) {
+  return OrderBookUpdate::Level{Decimal::Parse(price), Decimal::Parse(volume), ts};
+}
+
+}
+
+TEST(FeedReplayerTest, TestRouting) {
+  RecordingTarget binance;
+  RecordingTarget kraken;
+  FeedReplayOptions options;
+  options.speed = 0;
+  FeedReplayer replayer(options);
+  replayer.AddBookTickerStream("binance", "binance", binance, replay_messages::BinanceBookTicker);
+  replayer.AddBookTickerStream("kraken", "kraken", kraken, replay_messages::KrakenTicker);
+
+  replayer.OnBookTicker(CreateTicker("binance", SymbolPairId::ADA_USDT, 1.2344, 1.2345, 1000, 7));
+  replayer.OnBookTicker(CreateTicker("kraken", SymbolPairId::ADA_USDT, 1.2344, 1.2345, 2000, 7));
+  replayer.OnBookTicker(CreateTicker("bitstamp", SymbolPairId::ADA_USDT, 1.2344, 1.2345, 3000, 7));
+  replayer.OnBookTicker(CreateTicker("binance", SymbolPairId::ADA_USDT, 1.2344, 1.2345, 4000, 7));
+  replayer.Finish();
+
+  EXPECT_EQ(3u, replayer.GetInjectedCount());
+  ASSERT_EQ(2u, binance.m_payloads.size());
+  ASSERT_EQ(1u, kraken.m_payloads.size());
+  EXPECT_EQ(2u, replayer.GetLatencies("binance").GetCount());
+  EXPECT_EQ(1u, replayer.GetLatencies("kraken").GetCount());
+  EXPECT_THROW(replayer.GetLatencies("bitstamp"), std::out_of_range);
+
+  auto msg = nlohmann::json::parse(binance.m_payloads[0]);
+  EXPECT_EQ("ADAUSDT", msg["s"].get<std::string>());
+  EXPECT_DOUBLE_EQ(1.2344, std::stod(msg["b"].get<std::string>()));
+  EXPECT_DOUBLE_EQ(1000, std::stod(msg["B"].get<std::string>()));
+  EXPECT_DOUBLE_EQ(1.2345, std::stod(msg["a"].get<std::string>()));
+
+  auto kraken_msg = nlohmann::json::parse(kraken.m_payloads[0]);
+  EXPECT_EQ("ticker", kraken_msg[2].get<std::string>());
+  EXPECT_EQ("ADA/USDT", kraken_msg[3].get<std::string>());
+  EXPECT_DOUBLE_EQ(1000, std::stod(kraken_msg[1]["a"][2].get<std::string>()));
+}
+
+TEST(FeedReplayerTest, TestStreamForAnotherTarget) {
+  RecordingTarget a;
+  RecordingTarget b;
+  FeedReplayer replayer;
+  replayer.AddBookTickerStream("binance", "binance", a, replay_messages::BinanceBookTicker);
+  EXPECT_THROW(replayer.AddTradeTickerStream("binance", "binance", b, replay_messages::BinanceTrade), std::invalid_argument);
+  EXPECT_THROW(FeedReplayer(FeedReplayOptions{-1.0}), std::invalid_argument);
+}
+
+TEST(FeedReplayerTest, TestPacing) {
+  RecordingTarget target;
+  FeedReplayOptions options;
+  options.speed = 10;
+  FeedReplayer replayer(options);
+  replayer.AddBookTickerStream("binance", "binance", target, replay_messages::BinanceBookTicker);
+
+  // 200 ms of recorded time take 20 ms at 10x
+  const auto start = std::chrono::steady_clock::now();
+  replayer.OnBookTicker(CreateTicker("binance", SymbolPairId::ADA_USDT, 1.2344, 1.2345, 1000000, 7));
+  replayer.OnBookTicker(CreateTicker("binance", SymbolPairId::ADA_USDT, 1.2344, 1.2345, 1100000, 7));
+  replayer.OnBookTicker(CreateTicker("binance", SymbolPairId::ADA_USDT, 1.2344, 1.2345, 1200000, 7));
+  replayer.Finish();
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_GE(elapsed, std::chrono::milliseconds(20));
+  EXPECT_EQ(3u, target.m_payloads.size());
+}
+
+TEST(FeedReplayerTest, TestMaxSpeed) {
+  RecordingTarget target;
+  FeedReplayOptions options;
+  options.speed = 0;
+  FeedReplayer replayer(options);
+  replayer.AddBookTickerStream("binance", "binance", target, replay_messages::BinanceBookTicker);
+
+  // An hour of recorded time
+  const auto start = std::chrono::steady_clock::now();
+  for (uint64_t ts = 0; ts <= 3600000000; ts += 600000000) {
+    replayer.OnBookTicker(CreateTicker("binance", SymbolPairId::ADA_USDT, 1.2344, 1.2345, ts, 7));
+  }
+  replayer.Finish();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+  EXPECT_EQ(7u, target.m_payloads.size());
+}
+
+// Order book events reach the Binance depth stream as the snapshot it would request and continuous diffs
+TEST(FeedReplayerTest, TestBinanceOrderBook) {
+  RecordingTarget target;
+  FeedReplayOptions options;
+  options.speed = 0;
+  FeedReplayer replayer(options);
+  replayer.AddOrderBookStream("binance", "binance order book", target, replay_messages::BinanceDepthEncoder());
+
+  OrderBook ob{"binance", SymbolPairId::ADA_USDT, 100, PrecisionSettings{4, 1, 3}};
+  OrderBookUpdate snapshot;
+  snapshot.exchange = "binance";
+  snapshot.symbol = SymbolPairId::ADA_USDT;
+  snapshot.is_snapshot = true;
+  snapshot.last_update_id = 100;
+  snapshot.arrived_ts = 1614556800000000;
+  snapshot.bids = {CreateLevel("1.2340", "150.0", std::nullopt)};
+  snapshot.asks = {CreateLevel("1.2350", "75.5", std::nullopt)};
+  ob.Update(snapshot);
+  replayer.OnOrderBookUpdate(ob);
+
+  OrderBookUpdate diff = snapshot;
+  diff.is_snapshot = false;
+  diff.last_update_id = 105;
+  diff.arrived_ts = 1614556800100000;
+  diff.bids = {CreateLevel("1.2340", "0.0", std::nullopt), CreateLevel("1.2339", "10.0", std::nullopt)};
+  diff.asks = {};
+  ob.Update(diff);
+  replayer.OnOrderBookUpdate(ob);
+  diff.last_update_id = 109;
+  diff.bids = {};
+  diff.asks = {CreateLevel("1.2351", "5.0", std::nullopt)};
+  ob.Update(diff);
+  replayer.OnOrderBookUpdate(ob);
+  // Recording restarted from a new snapshot
+  snapshot.last_update_id = 200;
+  ob.Update(snapshot);
+  replayer.OnOrderBookUpdate(ob);
+  diff.last_update_id = 203;
+  ob.Update(diff);
+  replayer.OnOrderBookUpdate(ob);
+  replayer.Finish();
+
+  ASSERT_EQ(5u, target.m_payloads.size());
+  auto snapshot_msg = nlohmann::json::parse(target.m_payloads[0]);
+  EXPECT_EQ(100u, snapshot_msg["lastUpdateId"].get<uint64_t>());
+  EXPECT_EQ("1.2340", snapshot_msg["bids"][0][0].get<std::string>());
+  EXPECT_EQ("150.0", snapshot_msg["bids"][0][1].get<std::string>());
+  EXPECT_EQ("1.2350", snapshot_msg["asks"][0][0].get<std::string>());
+  binance_decoders::DepthUpdate depth_update;
+  EXPECT_FALSE(DecodeMessage<binance_decoders::DepthDecoder>(target.m_payloads[0], depth_update));
+
+  binance_decoders::DepthUpdate first;
+  ASSERT_TRUE(DecodeMessage<binance_decoders::DepthDecoder>(target.m_payloads[1], first));
+  EXPECT_EQ(101u, first.first_update_id);
+  EXPECT_EQ(105u, first.update.last_update_id);
+  EXPECT_EQ(SymbolPairId::ADA_USDT, first.update.symbol);
+  ASSERT_EQ(2u, first.update.bids.size());
+  EXPECT_EQ(Decimal::Parse("0.0").GetMantissa(), first.update.bids[0].volume.GetMantissa());
+  EXPECT_EQ(Decimal::Parse("1.2339").GetMantissa(), first.update.bids[1].price.GetMantissa());
+  EXPECT_TRUE(first.update.asks.empty());
+
+  binance_decoders::DepthUpdate second;
+  ASSERT_TRUE(DecodeMessage<binance_decoders::DepthDecoder>(target.m_payloads[2], second));
+  EXPECT_EQ(106u, second.first_update_id);
+  EXPECT_EQ(109u, second.update.last_update_id);
+  ASSERT_EQ(1u, second.update.asks.size());
+
+  EXPECT_EQ(200u, nlohmann::json::parse(target.m_payloads[3])["lastUpdateId"].get<uint64_t>());
+  binance_decoders::DepthUpdate after_snapshot;
+  ASSERT_TRUE(DecodeMessage<binance_decoders::DepthDecoder>(target.m_payloads[4], after_snapshot));
+  EXPECT_EQ(201u, after_snapshot.first_update_id);
+  EXPECT_EQ(203u, after_snapshot.update.last_update_id);
+}
+
+TEST(ReplayMessagesTest, TestKrakenPairs) {
+  for (const auto& p : KRAKEN_SYMBOL_TO_STRING_MAP) {
+    EXPECT_EQ(p.first, SymbolPairId(SymbolPair::FromKrakenString(replay_messages::KrakenPair(p.first)))) << p.second;
+  }
+  EXPECT_EQ("XBT/USDT", replay_messages::KrakenPair(SymbolPairId::BTC_USDT));
+}
+
+TEST(ReplayMessagesTest, TestBinanceTrade) {
+  TradeTicker trade;
+  trade.exchange = "binance";
+  trade.symbol = SymbolPairId::ETH_USDT;
+  trade.event_time = 100;
+  trade.trade_time = 99;
+  trade.trade_id = "12345";
+  trade.price = 2000.5;
+  trade.qty = 0.25;
+  trade.is_market_maker = true;
+  auto msg = nlohmann::json::parse(replay_messages::BinanceTrade(trade));
+  EXPECT_EQ("ETHUSDT", msg["s"].get<std::string>());
+  EXPECT_EQ(12345u, msg["t"].get<uint64_t>());
+  EXPECT_EQ(100u, msg["E"].get<uint64_t>());
+  EXPECT_EQ(99u, msg["T"].get<uint64_t>());
+  EXPECT_DOUBLE_EQ(2000.5, std::stod(msg["p"].get<std::string>()));
+  EXPECT_DOUBLE_EQ(0.25, std::stod(msg["q"].get<std::string>()));
+  EXPECT_TRUE(msg["m"].get<bool>());
+}
+
+// Book messages are applied by the Kraken handler as recorded
+TEST(ReplayMessagesTest, TestKrakenBook) {
+  OrderBookUpdate snapshot;
+  snapshot.exchange = "kraken";
+  snapshot.symbol = SymbolPairId::BTC_USDT;
+  snapshot.is_snapshot = true;
+  snapshot.arrived_ts = 1614556800000000;
+  snapshot.asks = {CreateLevel("55413.00000", "0.50000000", 1614556799123456)};
+  snapshot.bids = {CreateLevel("55412.00000", "1.25000000", std::nullopt),
+      CreateLevel("55411.00000", "2.00000000", 1614556799000001)};
+
+  OrderBookUpdate update = snapshot;
+  update.is_snapshot = false;
+  update.asks = {CreateLevel("55413.00000", "0.00000000", 1614556800500000)};
+  update.bids = {};
+
+  KrakenOrderBookHandler handler(false);
+  OrderBook ob{"kraken", SymbolPairId::BTC_USDT, 10, PrecisionSettings{5, 8, 6}};
+  EXPECT_TRUE(handler.OnOrderBookMessage(json::parse(replay_messages::KrakenBook(snapshot)), ob));
+  ASSERT_EQ(1u, ob.GetAsks().size());
+  ASSERT_EQ(2u, ob.GetBids().size());
+  EXPECT_EQ(price_t(5541300000), ob.GetAsks().begin()->GetPrice());
+  EXPECT_DOUBLE_EQ(0.5, ob.GetAsks().begin()->GetVolume());
+  EXPECT_EQ(1614556799123456u, ob.GetAsks().begin()->GetTimestamp());
+
+  EXPECT_TRUE(handler.OnOrderBookMessage(json::parse(replay_messages::KrakenBook(update)), ob));
+  EXPECT_TRUE(ob.GetAsks().empty());
+  EXPECT_EQ(2u, ob.GetBids().size());
+}
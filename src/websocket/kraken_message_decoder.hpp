@@ -0,0 +1,253 @@
+#pragma once
+
+#include "message_decoder.hpp"
+
+#include "model/decimal.h"
+#include "model/order_book_update.h"
+#include "model/symbol.h"
+#include "model/ticker.h"
+#include "utils/json_scanner.hpp"
+
+#include "json/json.hpp"
+
+#include <charconv>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Public message of the Kraken websocket API, decoded by KrakenMessageDecoder
+struct KrakenMessage {
+  enum class Channel {
+    TICKER,
+    BOOK,
+    // Any other channel, or an event (heartbeat, subscription status...)
+    OTHER
+  };
+
+  Channel channel = Channel::OTHER;
+  // Pair as sent, eg. "XBT/USDT"
+  std::string pair;
+  Ticker ticker{};
+  // Level timestamps are in microseconds
+  OrderBookUpdate book{};
+  // Checksum of the top of the book after the update, not sent with snapshots
+  std::optional<uint32_t> checksum;
+};
+
+/**
+ * Decoder of ticker and book channel messages, eg.
+ * [0,{"a":["5525.40000",1,"1.000"],"b":["5525.10000",1,"1.000"],"c":[...],...},"ticker","XBT/USD"]
+ * [0,{"as":[["5541.30000","2.50700000","1534614248.123678"],...],"bs":[...]},"book-10","XBT/USD"]
+ * [0,{"a":[["5541.30000","2.50700000","1534614248.456738"]]},{"b":[...],"c":"974942666"},"book-10","XBT/USD"]
+ * See DecodeMessage(). Fills the fields sent by the exchange, the stream sets the exchange name,
+ * the symbol and the arrival time.
+ */
+struct KrakenMessageDecoder {
+  static bool DecodeFast(std::string_view payload, KrakenMessage& message) {
+    cryptobot::JsonScanner scanner(payload);
+    if (scanner.Peek() != '[') {
+      message.channel = KrakenMessage::Channel::OTHER;
+      return scanner.Peek() == '{';
+    }
+    // [channel id, data, (data,) channel name, pair], channel name comes after the data
+    std::string_view elements[5];
+    size_t size = 0;
+    scanner.EnterArray();
+    while (scanner.NextElement()) {
+      if (size == 5 || !scanner.SkipValue(&elements[size++])) {
+        return false;
+      }
+    }
+    std::string_view channel_name;
+    std::string_view pair;
+    if (scanner.Failed() || size < 4
+        || !cryptobot::JsonScanner(elements[size - 2]).ReadString(channel_name)
+        || !cryptobot::JsonScanner(elements[size - 1]).ReadString(pair)) {
+      return false;
+    }
+    message.pair = pair;
+    if (channel_name == "ticker") {
+      message.channel = KrakenMessage::Channel::TICKER;
+      return size == 4 && DecodeTicker(elements[1], message.ticker);
+    }
+    if (channel_name.find("book") != std::string_view::npos) {
+      message.channel = KrakenMessage::Channel::BOOK;
+      bool has_levels = false;
+      for (size_t i = 1; i + 2 < size; ++i) {
+        if (!DecodeBook(elements[i], message, has_levels)) {
+          return false;
+        }
+      }
+      return has_levels;
+    }
+    message.channel = KrakenMessage::Channel::OTHER;
+    return true;
+  }
+
+  static bool DecodeJson(const json& msg_json, KrakenMessage& message) {
+    if (!msg_json.is_array()) {
+      message.channel = KrakenMessage::Channel::OTHER;
+      return true;
+    }
+    if (msg_json.size() < 4) {
+      return false;
+    }
+    const std::string& channel_name = msg_json[msg_json.size() - 2].get_ref<const std::string&>();
+    message.pair = msg_json[msg_json.size() - 1].get<std::string>();
+    if (channel_name == "ticker") {
+      message.channel = KrakenMessage::Channel::TICKER;
+      const json& data = msg_json[1];
+      message.ticker.bid = std::stod(data["b"][0].get_ref<const std::string&>());
+      message.ticker.bid_vol = std::stod(data["b"][2].get_ref<const std::string&>());
+      message.ticker.ask = std::stod(data["a"][0].get_ref<const std::string&>());
+      message.ticker.ask_vol = std::stod(data["a"][2].get_ref<const std::string&>());
+      return true;
+    }
+    if (channel_name.find("book") != std::string::npos) {
+      message.channel = KrakenMessage::Channel::BOOK;
+      return DecodeBookJson(msg_json, message.book, message.checksum);
+    }
+    message.channel = KrakenMessage::Channel::OTHER;
+    return true;
+  }
+
+  /**
+   * Levels and checksum of a book message, also used by KrakenOrderBookHandler
+   *
+   * @return false if the message has no levels
+   */
+  static bool DecodeBookJson(const json& msg_json, OrderBookUpdate& book, std::optional<uint32_t>& checksum) {
+    const json& book_obj = msg_json[1];
+    if (book_obj.contains("as")) {
+      book.is_snapshot = true;
+      ReadLevels(book_obj["as"], book.asks);
+      if (book_obj.contains("bs")) {
+        ReadLevels(book_obj["bs"], book.bids);
+      }
+      return true;
+    }
+    if (!book_obj.contains("a") && !book_obj.contains("b")) {
+      return false;
+    }
+    book.is_snapshot = false;
+    // Asks and bids come in separate objects when both sides changed
+    for (size_t i = 1; i + 2 < msg_json.size(); ++i) {
+      const json& update_obj = msg_json[i];
+      if (update_obj.contains("a")) {
+        ReadLevels(update_obj["a"], book.asks);
+      }
+      if (update_obj.contains("b")) {
+        ReadLevels(update_obj["b"], book.bids);
+      }
+      if (update_obj.contains("c")) {
+        checksum = std::stoul(update_obj["c"].get_ref<const std::string&>());
+      }
+    }
+    return true;
+  }
+
+private:
+  static bool DecodeTicker(std::string_view data, Ticker& ticker) {
+    cryptobot::JsonScanner scanner(data);
+    if (!scanner.EnterObject()) {
+      return false;
+    }
+    std::string_view key;
+    unsigned seen = 0;
+    while (scanner.NextMember(key)) {
+      if (key == "a") {
+        seen |= ReadTickerSide(scanner, ticker.ask, ticker.ask_vol) ? 1 : 0;
+      } else if (key == "b") {
+        seen |= ReadTickerSide(scanner, ticker.bid, ticker.bid_vol) ? 2 : 0;
+      } else {
+        scanner.SkipValue();
+      }
+    }
+    return !scanner.Failed() && seen == 3;
+  }
+
+  // [price, whole lot volume, lot volume]
+  static bool ReadTickerSide(cryptobot::JsonScanner& scanner, double& price, std::optional<double>& volume) {
+    double lot_volume = 0;
+    if (!scanner.EnterArray() || !scanner.NextElement() || !scanner.ReadQuotedDouble(price)
+        || !scanner.NextElement() || !scanner.SkipValue()
+        || !scanner.NextElement() || !scanner.ReadQuotedDouble(lot_volume)) {
+      return false;
+    }
+    while (scanner.NextElement()) {
+      scanner.SkipValue();
+    }
+    volume = lot_volume;
+    return !scanner.Failed();
+  }
+
+  static bool DecodeBook(std::string_view data, KrakenMessage& message, bool& has_levels) {
+    cryptobot::JsonScanner scanner(data);
+    if (!scanner.EnterObject()) {
+      return false;
+    }
+    OrderBookUpdate& book = message.book;
+    std::string_view key;
+    while (scanner.NextMember(key)) {
+      if (key == "as" || key == "bs") {
+        book.is_snapshot = true;
+        has_levels = true;
+        if (!ReadLevels(scanner, key == "as" ? book.asks : book.bids)) {
+          return false;
+        }
+      } else if (key == "a" || key == "b") {
+        book.is_snapshot = false;
+        has_levels = true;
+        if (!ReadLevels(scanner, key == "a" ? book.asks : book.bids)) {
+          return false;
+        }
+      } else if (key == "c") {
+        std::string_view checksum;
+        uint32_t value = 0;
+        if (!scanner.ReadString(checksum)
+            || std::from_chars(checksum.data(), checksum.data() + checksum.size(), value).ec != std::errc()) {
+          return false;
+        }
+        message.checksum = value;
+      } else {
+        scanner.SkipValue();
+      }
+    }
+    return !scanner.Failed();
+  }
+
+  // [["price", "volume", "timestamp"(, "r")], ...]
+  static bool ReadLevels(cryptobot::JsonScanner& scanner, std::vector<OrderBookUpdate::Level>& levels) {
+    if (!scanner.EnterArray()) {
+      return false;
+    }
+    while (scanner.NextElement()) {
+      std::string_view price;
+      std::string_view volume;
+      std::string_view timestamp;
+      if (!scanner.EnterArray() || !scanner.NextElement() || !scanner.ReadString(price)
+          || !scanner.NextElement() || !scanner.ReadString(volume)
+          || !scanner.NextElement() || !scanner.ReadString(timestamp)) {
+        return false;
+      }
+      while (scanner.NextElement()) {
+        scanner.SkipValue();
+      }
+      levels.push_back(OrderBookUpdate::Level{Decimal::Parse(price), Decimal::Parse(volume), ToMicroseconds(Decimal::Parse(timestamp))});
+    }
+    return !scanner.Failed();
+  }
+
+  static void ReadLevels(const json& levels_json, std::vector<OrderBookUpdate::Level>& levels) {
+    for (const json& lvl : levels_json) {
+      levels.push_back(OrderBookUpdate::Level{Decimal::Parse(lvl[0].get_ref<const std::string&>()),
+          Decimal::Parse(lvl[1].get_ref<const std::string&>()), ToMicroseconds(Decimal::Parse(lvl[2].get_ref<const std::string&>()))});
+    }
+  }
+
+  // Timestamps are sent in seconds with microsecond precision, eg. "1534614248.456738"
+  static uint64_t ToMicroseconds(const Decimal& ts) {
+    return ts.ToFixedPoint(6);
+  }
+};
@@ -1,13 +1,17 @@
+#include "kraken_message_decoder.hpp"
+
 #include "model/order_book.h"
 #include "model/symbol.h"
-#include "utils/math.h"
+#include "utils/crc32.h"
 #include "utils/string.h"
 
-#include <boost/crc.hpp>
 #include <boost/log/trivial.hpp>
 #include "json/json.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
 #include <string>
 
 class KrakenOrderBookHandler {
@@ -17,118 +21,82 @@ public:
   }
 
   bool OnOrderBookMessage(const json& msg_json, OrderBook& ob) {
-    bool is_valid = false;
-    auto book_obj = msg_json[1];
-    if (book_obj.contains("as")) {
-      is_valid = true;
-      OnOrderBookSnapshot(ob, book_obj);
-    } else if (book_obj.contains("a") || book_obj.contains("b")) {
-      is_valid = OnOrderBookUpdate(ob, book_obj);
-      if (msg_json.size() == 5) {
-        is_valid = OnOrderBookUpdate(ob, msg_json[2]);
-      }
-    } else {
+    OrderBookUpdate update{};
+    std::optional<uint32_t> checksum;
+    if (!KrakenMessageDecoder::DecodeBookJson(msg_json, update, checksum)) {
       BOOST_LOG_TRIVIAL(error) << "Unexpected book message!";
+      return false;
     }
-    return is_valid;
+    update.exchange = ob.GetExchangeName();
+    update.symbol = ob.GetSymbolPairId();
+    return OnOrderBookMessage(update, checksum, ob);
   }
 
-private:
-
-  void OnOrderBookSnapshot(OrderBook& ob, const json& snapshot_obj) {
-    BOOST_LOG_TRIVIAL(debug) << "Received order book snapshot";
-    // Clear order book first
-    ob.clear();
-    const auto& precision_settings = ob.GetPrecisionSettings();
-    for (const json& lvl : snapshot_obj["as"]) {
-      // Upsert price level
-      PriceLevel pl = ParsePriceLevel(lvl, precision_settings);
-      ob.UpsertAsk(pl);
-    }
-    for (const json& lvl : snapshot_obj["bs"]) {
-      // Upsert price level
-      PriceLevel pl = ParsePriceLevel(lvl, precision_settings);
-      ob.UpsertBid(pl);
-    }
-  }
-
-  bool OnOrderBookUpdate(OrderBook& ob, const json& update_obj) {
-    const auto& precision_settings = ob.GetPrecisionSettings();
-    if (update_obj.contains("a")) {
-      for (const json& lvl : update_obj["a"]) {
-        // Upsert price level
-        PriceLevel pl = ParsePriceLevel(lvl, precision_settings);
-        if (pl.GetVolume() == 0.0) {
-          ob.DeleteAsk(pl.GetPrice());
-        } else {
-          ob.UpsertAsk(pl);
+  /**
+   * Applies a decoded book message, see KrakenMessageDecoder.
+   *
+   * @return false if the checksum of the updated book does not match
+   */
+  bool OnOrderBookMessage(const OrderBookUpdate& update, const std::optional<uint32_t>& checksum, OrderBook& ob) {
+    const size_t price_precision = ob.GetPrecisionSettings().m_price_precision;
+    for (const auto* side : {&update.asks, &update.bids}) {
+      for (const auto& level : *side) {
+        if (level.price.GetScale() != price_precision) {
+          throw std::runtime_error("Unexpected price precision");
         }
       }
     }
-    if (update_obj.contains("b")) {
-      for (const json& lvl : update_obj["b"]) {
-        // Upsert price level
-        PriceLevel pl = ParsePriceLevel(lvl, precision_settings);
-        if (pl.GetVolume() == 0.0) {
-          ob.DeleteBid(pl.GetPrice());
-        } else {
-          ob.UpsertBid(pl);
-        }
-      }
+    if (update.is_snapshot) {
+      BOOST_LOG_TRIVIAL(debug) << "Received order book snapshot";
+      ob.clear();
     }
+    ob.Update(update);
     BOOST_LOG_TRIVIAL(trace) << "Order book: " << ob;
-    if (m_with_checksum_validation && update_obj.contains("c")) {
-      std::string crc32_in = CalculateChecksumInput(ob);
-      BOOST_LOG_TRIVIAL(trace) << "Checksum: " << crc32_in;
-      boost::crc_32_type crc;
-      crc.process_bytes(crc32_in.c_str(), crc32_in.size());
-      if (crc.checksum() != std::stoul(update_obj["c"].get<std::string>())) {
+    if (m_with_checksum_validation && checksum.has_value()) {
+      uint32_t calculated = CalculateChecksum(ob);
+      BOOST_LOG_TRIVIAL(trace) << "Checksum: " << calculated;
+      if (calculated != checksum.value()) {
         BOOST_LOG_TRIVIAL(debug) << "Wrong checksum!";
         return false;
       }
     }
-    //std::cout << m_order_book << std::endl;
-    //std::cout << "Best ask: " << m_order_book.GetBestAsk() << ", best bid: " << m_order_book.GetBestBid() << std::endl;
     return true;
   }
 
-  PriceLevel ParsePriceLevel(const json& lvl, const PrecisionSettings& precision_settings) {
-    // Parse price
-    auto p = lvl[0].get<std::string>();
-    size_t dot_pos = p.find('.');
-    if (p.size() - 1 - dot_pos != precision_settings.m_price_precision) {
-      throw std::runtime_error("Unexpected price precision");
-    }
-    double price = std::stod(p);
-    price_t price_lvl = price_t(uint64_t(price * cryptobot::quick_pow10(precision_settings.m_price_precision)));
-
-    // Parse timestamp
-    auto ts = lvl[2].get<std::string>();
-    dot_pos = ts.find('.');
-    if (ts.size() - 1 - dot_pos != precision_settings.m_timestamp_precision) {
-      throw std::runtime_error("Unexpected timestamp precision");
-    }
-    ts.erase(dot_pos, 1);
-
-    return PriceLevel(price_lvl, std::stod(lvl[1].get<std::string>()), std::stoull(ts));
+  /**
+   * CRC32 of top CHECKSUM_DEPTH asks and bids (best first), with price and volume
+   * of every level written as integers with no leading zeros.
+   * Digits are formatted into a stack buffer, no heap allocations.
+   */
+  static uint32_t CalculateChecksum(const OrderBook& ob) {
+    const uint64_t volume_mul = Decimal::Pow10(ob.GetPrecisionSettings().m_volume_precision);
+    // 2 sides, 2 numbers per level, 20 digits per number at most
+    char buf[2 * 2 * 20 * CHECKSUM_DEPTH];
+    char* p = buf;
+    auto append_levels = [&](const PriceLevels& levels) {
+      size_t n = 0;
+      for (auto it = levels.rbegin(); it != levels.rend() && n < CHECKSUM_DEPTH; ++it, ++n) {
+        p = AppendDigits(p, uint64_t(it->GetPrice()));
+        p = AppendDigits(p, static_cast<uint64_t>(std::llround(it->GetVolume() * volume_mul)));
+      }
+    };
+    append_levels(ob.GetAsks());
+    append_levels(ob.GetBids());
+    return cryptobot::crc32(buf, p - buf);
   }
 
-  std::string CalculateChecksumInput(const OrderBook& ob) {
-    const auto& precision_settings = ob.GetPrecisionSettings();
-    std::vector<std::string> partial_input;
-    const auto& asks = ob.GetAsks(); 
-    std::transform(asks.rbegin(), asks.rend(), std::back_inserter(partial_input),
-        [&](const PriceLevel& pl) -> std::string {
-          return std::to_string(uint64_t(pl.GetPrice())) + std::to_string(uint64_t(pl.GetVolume()*cryptobot::quick_pow10(precision_settings.m_volume_precision)));
-        });
-    const auto& bids = ob.GetBids(); 
-    std::transform(bids.rbegin(), bids.rend(), std::back_inserter(partial_input),
-        [&](const PriceLevel& pl) -> std::string {
-          return std::to_string(uint64_t(pl.GetPrice())) + std::to_string(uint64_t(pl.GetVolume()*cryptobot::quick_pow10(precision_settings.m_volume_precision)));
-        });
-    std::string res;
-    for (const auto &piece : partial_input) res += piece;
-    return res;
+  // Kraken checksum covers top 10 levels, regardless of subscribed depth
+  static constexpr size_t CHECKSUM_DEPTH = 10;
+
+private:
+  static char* AppendDigits(char* p, uint64_t v) {
+    char tmp[20];
+    char* t = tmp + sizeof(tmp);
+    do {
+      *--t = static_cast<char>('0' + v % 10);
+      v /= 10;
+    } while (v > 0);
+    return std::copy(t, tmp + sizeof(tmp), p);
   }
 
 private:
@@ -0,0 +1,52 @@
+#include "kraken_order_book_handler.hpp"
+
+#include <boost/crc.hpp>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using namespace testing;
+
+namespace {
+
+// Reference implementation, as described in Kraken websocket API docs
+uint32_t ReferenceChecksum(const OrderBook& ob) {
+  std::string input;
+  const auto& asks = ob.GetAsks();
+  size_t n = 0;
+  for (auto it = asks.rbegin(); it != asks.rend() && n < 10; ++it, ++n) {
+    input += std::to_string(uint64_t(it->GetPrice())) + std::to_string(std::llround(it->GetVolume() * 1e8));
+  }
+  const auto& bids = ob.GetBids();
+  n = 0;
+  for (auto it = bids.rbegin(); it != bids.rend() && n < 10; ++it, ++n) {
+    input += std::to_string(uint64_t(it->GetPrice())) + std::to_string(std::llround(it->GetVolume() * 1e8));
+  }
+  boost::crc_32_type crc;
+  crc.process_bytes(input.data(), input.size());
+  return crc.checksum();
+}
+
+OrderBook CreateOrderBook(size_t depth) {
+  OrderBook ob{"kraken", SymbolPairId::BTC_USDT, depth, PrecisionSettings{5, 8, 6}};
+  for (size_t i = 0; i < depth; ++i) {
+    PriceLevel ask(price_t(5541300000 + 1000 * i), 0.00010000 + 0.1 * i, 1);
+    ob.UpsertAsk(ask);
+    PriceLevel bid(price_t(5541200000 - 1000 * i), 1.2345 * (i + 1), 1);
+    ob.UpsertBid(bid);
+  }
+  return ob;
+}
+
+}
+
+TEST(KrakenOrderBookHandlerTest, ChecksumTest) {
+  OrderBook ob = CreateOrderBook(10);
+  EXPECT_EQ(ReferenceChecksum(ob), KrakenOrderBookHandler::CalculateChecksum(ob));
+}
+
+TEST(KrakenOrderBookHandlerTest, ChecksumTopLevelsOnlyTest) {
+  OrderBook ob10 = CreateOrderBook(10);
+  OrderBook ob100 = CreateOrderBook(100);
+  EXPECT_EQ(KrakenOrderBookHandler::CalculateChecksum(ob10), KrakenOrderBookHandler::CalculateChecksum(ob100));
+}
@@ -1,8 +1,10 @@
+#include "kraken_message_decoder.hpp"
 #include "kraken_order_book_handler.hpp"
 #include "tickers_watcher.hpp"
 
 #include "exchange/exchange_listener.h"
 #include "serialization_utils.hpp"
+#include "subscription_messages.hpp"
 #include "websocket/websocket_client.hpp"
 
 #include <boost/crc.hpp>
@@ -13,6 +15,8 @@
 #include <iterator>
 #include <stdexcept>
 #include <string>
+#include <tuple>
+#include <vector>
 
 using namespace std::chrono;
 
@@ -34,49 +38,76 @@ public:
 
   KrakenWebsocketClient(ExchangeListener* exchange_listener, bool validate = true)
       : WebsocketClient("wss://ws.kraken.com", NAME), m_exchange_listener(exchange_listener), m_tickers_watcher(30000, NAME, this), m_order_book_handler(validate) {
+    // Pace of the former sleeps between subscriptions, which are batched now
+    set_send_rate(2, 2.5);
     m_tickers_watcher.Start();
   }
 
   void SubscribeTicker(const std::string& symbol) {
-    const std::string message = "{\"event\": \"subscribe\",\"pair\": [\"" + symbol + "\"],\"subscription\": {\"name\": \"ticker\"}}";
-    m_subscription_msg.push_back(message);
-    WebsocketClient::send(message);
+    Subscribe({{symbol, {{"name", "ticker"}}}}, {});
   }
 
   void SubscribeOrderBook(const std::string& symbol, KrakenOrderBookDepth requested_depth) {
-    std::string message = OrderBookSubscribeMsg(symbol, requested_depth);
-    m_subscription_msg.push_back(message);
-    SymbolPair sp = SymbolPair::FromKrakenString(symbol);
-    SymbolPairId spid = SymbolPairId(sp);
-    m_order_books.emplace(spid, OrderBook(NAME, spid, static_cast<size_t>(requested_depth), SENT_PRECISIONS.at(spid)));
-    WebsocketClient::send(message);
+    SubscribeOrderBooks({symbol}, requested_depth, static_cast<size_t>(requested_depth));
   }
 
   void SubscribeBookTicker(const std::string& symbol) {
-    std::string message = OrderBookSubscribeMsg(symbol, KrakenOrderBookDepth::DEPTH_10);
-    m_subscription_msg.push_back(message);
-    SymbolPair sp = SymbolPair::FromKrakenString(symbol);
-    SymbolPairId spid = SymbolPairId(sp);
-    m_order_books.emplace(spid, OrderBook(NAME, spid, 1, SENT_PRECISIONS.at(spid)));
-    WebsocketClient::send(message);
+    SubscribeBookTickers({symbol});
+  }
+
+  // Best prices of the pairs, with a single message
+  void SubscribeBookTickers(const std::vector<std::string>& symbols) {
+    SubscribeOrderBooks(symbols, KrakenOrderBookDepth::DEPTH_10, 1);
   }
 
   void UnsubscribeOrderBook(const std::string& symbol) {
-    const std::string message = "{\"event\": \"unsubscribe\",\"pair\": [\"" + symbol + "\"],\"subscription\": {\"name\": \"book\",\"depth\": 10}}";
-    WebsocketClient::send(message);
+    send_paced(subscription_messages::KrakenSubscribe({{symbol, BookSubscription(KrakenOrderBookDepth::DEPTH_10)}}, false).front());
   }
 
 private:
+  // Pair, precisions and depth of an order book
+  typedef std::tuple<SymbolPairId, PrecisionSettings, size_t> OrderBookSettings;
 
-  std::string OrderBookSubscribeMsg(const std::string& symbol, KrakenOrderBookDepth depth, bool subscribe = true) {
-    return std::string("{\"event\": \"") + (subscribe ? "subscribe" : "unsubscribe") + "\",\"pair\": [\"" + symbol + "\"],\"subscription\": {\"name\": \"book\",\"depth\": " + std::to_string(static_cast<size_t>(depth))  + "}}";
+  static json BookSubscription(KrakenOrderBookDepth depth) {
+    return {{"name", "book"}, {"depth", static_cast<size_t>(depth)}};
   }
 
-  virtual void OnOpen(websocketpp::connection_hdl conn) override {
-    for (const auto& msg : m_subscription_msg) {
-      WebsocketClient::send(msg);
-      std::this_thread::sleep_for(400ms);
+  /**
+   * @throws std::out_of_range for a pair without sent precisions
+   */
+  void SubscribeOrderBooks(const std::vector<std::string>& symbols, KrakenOrderBookDepth depth, size_t book_depth) {
+    std::vector<subscription_messages::KrakenSubscription> subscriptions;
+    std::vector<OrderBookSettings> order_books;
+    for (const auto& symbol : symbols) {
+      SymbolPairId spid = SymbolPairId(SymbolPair::FromKrakenString(symbol));
+      order_books.emplace_back(spid, SENT_PRECISIONS.at(spid), book_depth);
+      subscriptions.emplace_back(symbol, BookSubscription(depth));
+    }
+    Subscribe(subscriptions, order_books);
+  }
+
+  // Books are created on the client thread, which updates them
+  void Subscribe(const std::vector<subscription_messages::KrakenSubscription>& subscriptions, const std::vector<OrderBookSettings>& order_books) {
+    Post([this, subscriptions, order_books]() {
+      for (const auto& [spid, precision_settings, book_depth] : order_books) {
+        m_order_books.emplace(spid, OrderBook(NAME, spid, book_depth, precision_settings));
+      }
+      m_subscriptions.insert(m_subscriptions.end(), subscriptions.begin(), subscriptions.end());
+      if (get_state() == State::OPEN) {
+        SendSubscriptions(subscriptions);
+      }
+    });
+  }
+
+  void SendSubscriptions(const std::vector<subscription_messages::KrakenSubscription>& subscriptions) {
+    for (std::string& message : subscription_messages::KrakenSubscribe(subscriptions)) {
+      send_paced(std::move(message));
     }
+  }
+
+  virtual void OnOpen(websocketpp::connection_hdl conn) override {
+    // Resubscribes after reconnecting too
+    SendSubscriptions(m_subscriptions);
     m_exchange_listener->OnConnectionOpen(NAME);
   }
 
@@ -85,45 +116,42 @@ private:
   }
 
   virtual void OnMessage(websocketpp::connection_hdl, client::message_ptr msg) override {
-    auto msg_json = json::parse(msg->get_payload());
-    BOOST_LOG_TRIVIAL(trace) << "Kraken websocket message: " << msg_json;
-    if (!msg_json.is_array()) {
-      // It is most probably a publication or response
-      // TODO:
+    BOOST_LOG_TRIVIAL(trace) << "Kraken websocket message: " << msg->get_payload();
+    KrakenMessage message;
+    if (!DecodeMessage<KrakenMessageDecoder>(msg->get_payload(), message)) {
+      BOOST_LOG_TRIVIAL(warning) << "Kraken: Not an expected message: " << msg->get_payload();
       return;
     }
-    auto channel_name = msg_json[msg_json.size() - 2];
-    const auto& symbol = msg_json[msg_json.size() - 1].get<std::string>();
-    if (channel_name == "ticker") {
-      m_exchange_listener->OnBookTicker(ParseTicker(msg_json[1], symbol));
-    } else if (channel_name.get<std::string>().find("book") != std::string::npos) {
-      SymbolPair symbol_pair = SymbolPair::FromKrakenString(symbol);
+    if (message.channel == KrakenMessage::Channel::TICKER) {
+      m_exchange_listener->OnBookTicker(CompleteTicker(message.ticker, message.pair));
+    } else if (message.channel == KrakenMessage::Channel::BOOK) {
+      SymbolPair symbol_pair = SymbolPair::FromKrakenString(message.pair);
       SymbolPairId pair_id = SymbolPairId(symbol_pair);
       if (m_order_books.count(pair_id) < 1) {
         throw std::runtime_error("Order book update for an unexpected symbol pair");
       }
       OrderBook& ob = m_order_books.at(pair_id);
-      bool is_valid = m_order_book_handler.OnOrderBookMessage(msg_json, ob);
+      auto now = system_clock::now();
+      system_clock::duration tp = now.time_since_epoch();
+      microseconds us = duration_cast<microseconds>(tp);
+      message.book.exchange = NAME;
+      message.book.symbol = pair_id;
+      message.book.arrived_ts = us.count();
+      bool is_valid = m_order_book_handler.OnOrderBookMessage(message.book, message.checksum, ob);
       if (is_valid) {
-        auto now = system_clock::now();
-        system_clock::duration tp = now.time_since_epoch();
-        microseconds us = duration_cast<microseconds>(tp);
         m_tickers_watcher.Set(ob.GetSymbolPairId(), us.count(), ob.GetLatestUpdateTimestamp());
         m_exchange_listener->OnOrderBookUpdate(ob);
       } else {
         // TODO: implement state machine, with subscription class objects in a vector as a state,
         // with which subscriptions can be re-created upon receiving unsubscribed publication
-        WebsocketClient::send(OrderBookSubscribeMsg(symbol, static_cast<KrakenOrderBookDepth>(ob.GetDepth())));
+        SendSubscriptions({{message.pair, BookSubscription(static_cast<KrakenOrderBookDepth>(ob.GetDepth()))}});
       }
     }
+    // Otherwise it is most probably a publication or response
+    // TODO:
   }
 
-  Ticker ParseTicker(json data, const std::string& symbol) {
-      Ticker ticker;
-      ticker.bid = std::stod(data["b"][0].get<std::string>());
-      ticker.bid_vol = std::optional<double>(std::stod(data["b"][2].get<std::string>()));
-      ticker.ask = std::stod(data["a"][0].get<std::string>());
-      ticker.ask_vol = std::optional<double>(std::stod(data["a"][2].get<std::string>()));
+  const Ticker& CompleteTicker(Ticker& ticker, const std::string& symbol) {
       ticker.source_ts = std::nullopt; // not provided
       // TODO: perhaps generate timestamp in base class and pass it to this method
       auto now = system_clock::now();
@@ -140,7 +168,8 @@ private:
 
 private:
   ExchangeListener* m_exchange_listener;
-  std::vector<std::string> m_subscription_msg;
+  // Subscriptions and books, only used on the client thread
+  std::vector<subscription_messages::KrakenSubscription> m_subscriptions;
   std::unordered_map<SymbolPairId, OrderBook> m_order_books;
   TickersWatcher m_tickers_watcher;
   KrakenOrderBookHandler m_order_book_handler;
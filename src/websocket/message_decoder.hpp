@@ -0,0 +1,34 @@
+#pragma once
+
+#include "json/json.hpp"
+
+#include <string_view>
+
+using json = nlohmann::json;
+
+/**
+ * Decodes a websocket message of a stream with its decoder, which provides
+ *
+ *   static bool DecodeFast(std::string_view payload, T& out);
+ *   static bool DecodeJson(const json& msg_json, T& out);
+ *
+ * The fast path scans the raw payload for the fields of the expected messages
+ * (see cryptobot::JsonScanner) and fails on anything else: other messages (eg. subscription
+ * responses), escaped strings or unexpected layouts. Those are parsed into a DOM and
+ * decoded from it, as all messages were before.
+ *
+ * @return false if the message is not one the decoder expects or is not JSON
+ */
+template <typename Decoder, typename T>
+bool DecodeMessage(std::string_view payload, T& out) {
+  if (Decoder::DecodeFast(payload, out)) {
+    return true;
+  }
+  // Drop whatever the fast path decoded before failing
+  out = T();
+  const json msg_json = json::parse(payload.begin(), payload.end(), nullptr, false);
+  if (msg_json.is_discarded()) {
+    return false;
+  }
+  return Decoder::DecodeJson(msg_json, out);
+}
@@ -0,0 +1,209 @@
+#include "binance_message_decoders.hpp"
+#include "kraken_message_decoder.hpp"
+#include "kraken_order_book_handler.hpp"
+#include "replay_messages.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using namespace testing;
+
+namespace {
+
+void ExpectLevelsEqual(const std::vector<OrderBookUpdate::Level>& expected, const std::vector<OrderBookUpdate::Level>& actual) {
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i].price.GetMantissa(), actual[i].price.GetMantissa()) << i;
+    EXPECT_EQ(expected[i].price.GetScale(), actual[i].price.GetScale()) << i;
+    EXPECT_EQ(expected[i].volume.GetMantissa(), actual[i].volume.GetMantissa()) << i;
+    EXPECT_EQ(expected[i].volume.GetScale(), actual[i].volume.GetScale()) << i;
+    EXPECT_EQ(expected[i].timestamp, actual[i].timestamp) << i;
+  }
+}
+
+OrderBookUpdate::Level CreateLevel(const std::string& price, const std::string& volume, std::optional<uint64_t> ts) {
+  return OrderBookUpdate::Level{Decimal::Parse(price), Decimal::Parse(volume), ts};
+}
+
+}
+
+TEST(BinanceDecodersTest, TestBookTicker) {
+  const std::string payload = R"({"u":400900217,"s":"ADAUSDT","b":"1.25350000","B":"31.21000000","a":"1.25360000","A":"40.66000000"})";
+  Ticker fast;
+  ASSERT_TRUE(binance_decoders::BookTickerDecoder::DecodeFast(payload, fast));
+  Ticker dom;
+  ASSERT_TRUE(binance_decoders::BookTickerDecoder::DecodeJson(json::parse(payload), dom));
+  for (const Ticker* ticker : {&fast, &dom}) {
+    EXPECT_EQ(SymbolPairId::ADA_USDT, SymbolPairId(ticker->symbol));
+    EXPECT_EQ(400900217u, ticker->id);
+    EXPECT_DOUBLE_EQ(1.2535, ticker->bid);
+    EXPECT_DOUBLE_EQ(31.21, ticker->bid_vol.value());
+    EXPECT_DOUBLE_EQ(1.2536, ticker->ask);
+    EXPECT_DOUBLE_EQ(40.66, ticker->ask_vol.value());
+  }
+  // Same rounding as std::stod
+  EXPECT_EQ(dom.bid, fast.bid);
+  EXPECT_EQ(dom.ask_vol, fast.ask_vol);
+}
+
+TEST(BinanceDecodersTest, TestOtherMessages) {
+  Ticker ticker;
+  // Subscription response
+  EXPECT_FALSE(DecodeMessage<binance_decoders::BookTickerDecoder>(R"({"result":null,"id":1})", ticker));
+  EXPECT_FALSE(DecodeMessage<binance_decoders::BookTickerDecoder>("not json", ticker));
+  EXPECT_FALSE(DecodeMessage<binance_decoders::BookTickerDecoder>(R"([1,2])", ticker));
+  // Skipped fields may have escapes
+  ASSERT_TRUE(binance_decoders::BookTickerDecoder::DecodeFast(R"({"u":1,"x":"\"{","s":"ADAUSDT","b":"1.1","B":"2","a":"1.2","A":"3"})", ticker));
+  // Escaped strings that are read fail the fast path only
+  const std::string escaped = R"({"u":1,"s":"ADA\u0055SDT","b":"1.1","B":"2","a":"1.2","A":"3"})";
+  EXPECT_FALSE(binance_decoders::BookTickerDecoder::DecodeFast(escaped, ticker));
+  ASSERT_TRUE(DecodeMessage<binance_decoders::BookTickerDecoder>(escaped, ticker));
+  EXPECT_EQ(SymbolPairId::ADA_USDT, SymbolPairId(ticker.symbol));
+  EXPECT_DOUBLE_EQ(1.2, ticker.ask);
+}
+
+TEST(BinanceDecodersTest, TestTrade) {
+  TradeTicker trade;
+  trade.symbol = SymbolPairId::ETH_USDT;
+  trade.event_time = 1614556800123;
+  trade.trade_time = 1614556800120;
+  trade.trade_id = "987654321";
+  trade.price = 1423.57;
+  trade.qty = 0.0123;
+  trade.is_market_maker = true;
+  const std::string payload = replay_messages::BinanceTrade(trade);
+
+  TradeTicker fast;
+  ASSERT_TRUE(binance_decoders::TradeDecoder::DecodeFast(payload, fast));
+  TradeTicker dom;
+  ASSERT_TRUE(binance_decoders::TradeDecoder::DecodeJson(json::parse(payload), dom));
+  for (const TradeTicker* decoded : {&fast, &dom}) {
+    EXPECT_EQ(SymbolPairId::ETH_USDT, SymbolPairId(decoded->symbol));
+    EXPECT_EQ(trade.event_time, decoded->event_time);
+    EXPECT_EQ(trade.trade_time, decoded->trade_time);
+    EXPECT_EQ("987654321", decoded->trade_id);
+    EXPECT_DOUBLE_EQ(trade.price, decoded->price);
+    EXPECT_DOUBLE_EQ(trade.qty, decoded->qty);
+    EXPECT_TRUE(decoded->is_market_maker);
+  }
+}
+
+TEST(BinanceDecodersTest, TestDepthUpdate) {
+  const std::string payload = R"({"e":"depthUpdate","E":1614556800123,"s":"BTCUSDT","U":157,"u":160,)"
+      R"("b":[["55412.01000000","0.25000000"],["55411.00000000","0.00000000"]],"a":[["55413.00000000","1.50000000"]]})";
+  binance_decoders::DepthUpdate fast;
+  ASSERT_TRUE(binance_decoders::DepthDecoder::DecodeFast(payload, fast));
+  binance_decoders::DepthUpdate dom;
+  ASSERT_TRUE(binance_decoders::DepthDecoder::DecodeJson(json::parse(payload), dom));
+  for (const binance_decoders::DepthUpdate* decoded : {&fast, &dom}) {
+    EXPECT_EQ(157u, decoded->first_update_id);
+    EXPECT_EQ(160u, decoded->update.last_update_id);
+    EXPECT_FALSE(decoded->update.is_snapshot);
+    EXPECT_EQ(SymbolPairId::BTC_USDT, decoded->update.symbol);
+  }
+  ExpectLevelsEqual({CreateLevel("55412.01000000", "0.25000000", std::nullopt), CreateLevel("55411.00000000", "0.00000000", std::nullopt)}, fast.update.bids);
+  ExpectLevelsEqual(dom.update.bids, fast.update.bids);
+  ExpectLevelsEqual(dom.update.asks, fast.update.asks);
+
+  // Malformed level
+  EXPECT_FALSE(binance_decoders::DepthDecoder::DecodeFast(R"({"e":"depthUpdate","E":1,"s":"BTCUSDT","U":1,"u":2,"b":[[]],"a":[]})", fast));
+}
+
+TEST(KrakenMessageDecoderTest, TestTicker) {
+  const std::string payload = R"([340,{"a":["55413.00000",0,"0.50000000"],"b":["55412.00000",1,"1.25000000"],)"
+      R"("c":["55412.10000","0.00100000"],"v":["1.0","2.0"],"p":["1.0","2.0"],"t":[1,2],"l":["1","2"],"h":["1","2"],"o":["1","2"]},"ticker","XBT/USDT"])";
+  KrakenMessage fast;
+  ASSERT_TRUE(KrakenMessageDecoder::DecodeFast(payload, fast));
+  KrakenMessage dom;
+  ASSERT_TRUE(KrakenMessageDecoder::DecodeJson(json::parse(payload), dom));
+  for (const KrakenMessage* message : {&fast, &dom}) {
+    EXPECT_EQ(KrakenMessage::Channel::TICKER, message->channel);
+    EXPECT_EQ("XBT/USDT", message->pair);
+    EXPECT_DOUBLE_EQ(55413, message->ticker.ask);
+    EXPECT_DOUBLE_EQ(0.5, message->ticker.ask_vol.value());
+    EXPECT_DOUBLE_EQ(55412, message->ticker.bid);
+    EXPECT_DOUBLE_EQ(1.25, message->ticker.bid_vol.value());
+  }
+}
+
+TEST(KrakenMessageDecoderTest, TestOtherMessages) {
+  KrakenMessage message;
+  ASSERT_TRUE(DecodeMessage<KrakenMessageDecoder>(R"({"event":"heartbeat"})", message));
+  EXPECT_EQ(KrakenMessage::Channel::OTHER, message.channel);
+  ASSERT_TRUE(DecodeMessage<KrakenMessageDecoder>(R"([42,[["5541.2","1.0","1534614057.3","s",""]],"trade","XBT/USD"])", message));
+  EXPECT_EQ(KrakenMessage::Channel::OTHER, message.channel);
+  EXPECT_FALSE(DecodeMessage<KrakenMessageDecoder>("[1,2]", message));
+  EXPECT_FALSE(DecodeMessage<KrakenMessageDecoder>("", message));
+}
+
+TEST(KrakenMessageDecoderTest, TestBook) {
+  const std::string snapshot = R"([0,{"as":[["55413.00000","0.50000000","1614556799.123456"]],)"
+      R"("bs":[["55412.00000","1.25000000","1614556799.000001"],["55411.00000","2.00000000","1614556799.1"]]},"book-10","XBT/USDT"])";
+  const std::string update = R"([0,{"a":[["55413.00000","0.00000000","1614556800.500000"]]},)"
+      R"({"b":[["55412.00000","1.00000000","1614556800.600000","r"]],"c":"12345"},"book-10","XBT/USDT"])";
+  for (const std::string& payload : {snapshot, update}) {
+    KrakenMessage fast;
+    ASSERT_TRUE(KrakenMessageDecoder::DecodeFast(payload, fast)) << payload;
+    KrakenMessage dom;
+    ASSERT_TRUE(KrakenMessageDecoder::DecodeJson(json::parse(payload), dom)) << payload;
+    EXPECT_EQ(KrakenMessage::Channel::BOOK, fast.channel);
+    EXPECT_EQ("XBT/USDT", fast.pair);
+    EXPECT_EQ(dom.book.is_snapshot, fast.book.is_snapshot);
+    EXPECT_EQ(dom.checksum, fast.checksum);
+    ExpectLevelsEqual(dom.book.asks, fast.book.asks);
+    ExpectLevelsEqual(dom.book.bids, fast.book.bids);
+  }
+
+  KrakenMessage message;
+  ASSERT_TRUE(KrakenMessageDecoder::DecodeFast(snapshot, message));
+  EXPECT_TRUE(message.book.is_snapshot);
+  EXPECT_FALSE(message.checksum.has_value());
+  ExpectLevelsEqual({CreateLevel("55412.00000", "1.25000000", 1614556799000001), CreateLevel("55411.00000", "2.00000000", 1614556799100000)}, message.book.bids);
+
+  message = KrakenMessage();
+  ASSERT_TRUE(KrakenMessageDecoder::DecodeFast(update, message));
+  EXPECT_FALSE(message.book.is_snapshot);
+  EXPECT_EQ(12345u, message.checksum);
+  ExpectLevelsEqual({CreateLevel("55413.00000", "0.00000000", 1614556800500000)}, message.book.asks);
+  ExpectLevelsEqual({CreateLevel("55412.00000", "1.00000000", 1614556800600000)}, message.book.bids);
+}
+
+// Decoded messages keep the book in sync with the exchange checksums
+TEST(KrakenMessageDecoderTest, TestBookChecksum) {
+  OrderBookUpdate snapshot{};
+  snapshot.exchange = "kraken";
+  snapshot.symbol = SymbolPairId::BTC_USDT;
+  snapshot.is_snapshot = true;
+  snapshot.arrived_ts = 1614556800000000;
+  snapshot.asks = {CreateLevel("55413.00000", "0.50000000", 1614556799123456), CreateLevel("55414.00000", "1.00000000", 1614556799123456)};
+  snapshot.bids = {CreateLevel("55412.00000", "1.25000000", 1614556799000001)};
+
+  KrakenOrderBookHandler handler(true);
+  OrderBook ob{"kraken", SymbolPairId::BTC_USDT, 10, PrecisionSettings{5, 8, 6}};
+  KrakenMessage message;
+  ASSERT_TRUE(DecodeMessage<KrakenMessageDecoder>(replay_messages::KrakenBook(snapshot), message));
+  EXPECT_TRUE(handler.OnOrderBookMessage(message.book, message.checksum, ob));
+  EXPECT_EQ(2u, ob.GetAsks().size());
+  EXPECT_EQ(1614556799123456u, ob.GetLatestUpdateTimestamp());
+
+  OrderBook expected{"kraken", SymbolPairId::BTC_USDT, 10, PrecisionSettings{5, 8, 6}};
+  expected.Update(snapshot);
+  expected.DeleteAsk(price_t(5541300000));
+  const uint32_t checksum = KrakenOrderBookHandler::CalculateChecksum(expected);
+
+  const std::string update = R"([0,{"a":[["55413.00000","0.00000000","1614556800.500000"]],"c":")" + std::to_string(checksum) + R"("},"book-10","XBT/USDT"])";
+  message = KrakenMessage();
+  ASSERT_TRUE(DecodeMessage<KrakenMessageDecoder>(update, message));
+  EXPECT_TRUE(handler.OnOrderBookMessage(message.book, message.checksum, ob));
+  EXPECT_EQ(1u, ob.GetAsks().size());
+
+  const std::string wrong = R"([0,{"b":[["55412.00000","2.00000000","1614556800.600000"]],"c":")" + std::to_string(checksum) + R"("},"book-10","XBT/USDT"])";
+  message = KrakenMessage();
+  ASSERT_TRUE(DecodeMessage<KrakenMessageDecoder>(wrong, message));
+  EXPECT_FALSE(handler.OnOrderBookMessage(message.book, message.checksum, ob));
+
+  // Prices must come with the precision of the pair
+  message = KrakenMessage();
+  ASSERT_TRUE(DecodeMessage<KrakenMessageDecoder>(R"([0,{"a":[["55413.0","1.0","1614556800.500000"]]},"book-10","XBT/USDT"])", message));
+  EXPECT_THROW(handler.OnOrderBookMessage(message.book, message.checksum, ob), std::runtime_error);
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "model/order_book_update.h"
+#include "model/symbol.h"
+#include "model/ticker.h"
+#include "utils/string.h"
+
+#include "json/json.hpp"
+
+#include <cstdlib>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Exchange websocket messages of recorded events, in the format the exchange streams parse,
+ * for FeedReplayer. Fields the streams do not read are left out.
+ */
+namespace replay_messages {
+
+// Enough digits for the precisions of the traded pairs
+constexpr int PRICE_DIGITS = 10;
+
+// Symbol of Binance messages, eg. "ADAUSDT"
+inline std::string BinanceSymbol(SymbolPairId symbol) {
+  auto it = BINANCE_SYMBOL_TO_STRING_MAP.find(symbol);
+  return it != BINANCE_SYMBOL_TO_STRING_MAP.end() ? it->second : "";
+}
+
+// Pair of Kraken websocket messages, eg. "XBT/USDT"
+inline std::string KrakenPair(SymbolPairId symbol) {
+  auto asset_name = [](SymbolId asset) {
+    switch (asset) {
+      case SymbolId::BTC: return std::string("XBT");
+      case SymbolId::DOGE: return std::string("XDG");
+      default: {
+        std::ostringstream oss;
+        oss << asset;
+        return oss.str();
+      }
+    }
+  };
+  const SymbolPair pair(symbol);
+  return asset_name(pair.GetBaseAsset()) + "/" + asset_name(pair.GetQuoteAsset());
+}
+
+// See BinanceBookTickerStream::OnMessage()
+inline std::string BinanceBookTicker(const Ticker& ticker) {
+  nlohmann::json msg = {
+    {"u", ticker.id},
+    {"s", BinanceSymbol(ticker.symbol)},
+    {"b", cryptobot::to_string(ticker.bid, PRICE_DIGITS)},
+    {"B", cryptobot::to_string(ticker.bid_vol.value_or(0.0), PRICE_DIGITS)},
+    {"a", cryptobot::to_string(ticker.ask, PRICE_DIGITS)},
+    {"A", cryptobot::to_string(ticker.ask_vol.value_or(0.0), PRICE_DIGITS)}
+  };
+  return msg.dump();
+}
+
+// See BinanceTradeTickerStream::OnMessage(), trade ids that are not numeric are sent as 0
+inline std::string BinanceTrade(const TradeTicker& trade) {
+  nlohmann::json msg = {
+    {"e", "trade"},
+    {"E", trade.event_time},
+    {"s", BinanceSymbol(trade.symbol)},
+    {"t", std::strtoull(trade.trade_id.c_str(), nullptr, 10)},
+    {"p", cryptobot::to_string(trade.price, PRICE_DIGITS)},
+    {"q", cryptobot::to_string(trade.qty, PRICE_DIGITS)},
+    {"T", trade.trade_time},
+    {"m", trade.is_market_maker}
+  };
+  return msg.dump();
+}
+
+/**
+ * Order book events of the Binance depth stream, see BinanceOrderBookStream. Snapshots are sent in the
+ * format of the REST api snapshot, which the stream takes instead of requesting one in replay mode,
+ * diffs as "depthUpdate" messages. Only the last update id of a diff is recorded, the first one is
+ * continued from the previous event, so the stream sees a gap only where recording restarted from
+ * a new snapshot. Keeps that id, so an encoder is to be used for a single stream.
+ */
+class BinanceDepthEncoder {
+public:
+  std::string operator()(const OrderBookUpdate& update) {
+    auto levels = [](const std::vector<OrderBookUpdate::Level>& side) {
+      nlohmann::json res = nlohmann::json::array();
+      for (const auto& level : side) {
+        res.push_back({level.price.ToString(), level.volume.ToString()});
+      }
+      return res;
+    };
+    const uint64_t first_update_id = m_last_update_id.has_value() ? m_last_update_id.value() + 1 : update.last_update_id;
+    m_last_update_id = update.last_update_id;
+    if (update.is_snapshot) {
+      nlohmann::json msg = {
+        {"lastUpdateId", update.last_update_id},
+        {"bids", levels(update.bids)},
+        {"asks", levels(update.asks)}
+      };
+      return msg.dump();
+    }
+    nlohmann::json msg = {
+      {"e", "depthUpdate"},
+      {"E", update.arrived_ts / 1000},
+      {"s", BinanceSymbol(update.symbol)},
+      {"U", first_update_id},
+      {"u", update.last_update_id},
+      {"b", levels(update.bids)},
+      {"a", levels(update.asks)}
+    };
+    return msg.dump();
+  }
+
+private:
+  std::optional<uint64_t> m_last_update_id;
+};
+
+// See KrakenMessageDecoder, volumes are the lot volumes
+inline std::string KrakenTicker(const Ticker& ticker) {
+  nlohmann::json data = {
+    {"a", {cryptobot::to_string(ticker.ask, PRICE_DIGITS), "0", cryptobot::to_string(ticker.ask_vol.value_or(0.0), PRICE_DIGITS)}},
+    {"b", {cryptobot::to_string(ticker.bid, PRICE_DIGITS), "0", cryptobot::to_string(ticker.bid_vol.value_or(0.0), PRICE_DIGITS)}}
+  };
+  return nlohmann::json::array({0, data, "ticker", KrakenPair(ticker.symbol)}).dump();
+}
+
+/**
+ * Snapshot or update of the "book-10" channel, see KrakenOrderBookHandler. Prices and volumes keep
+ * their recorded scale, levels without a timestamp get the arrival time of the update.
+ */
+inline std::string KrakenBook(const OrderBookUpdate& update) {
+  auto levels = [&](const std::vector<OrderBookUpdate::Level>& side) {
+    nlohmann::json res = nlohmann::json::array();
+    for (const auto& level : side) {
+      const Decimal ts(level.timestamp.value_or(update.arrived_ts), 6);
+      res.push_back({level.price.ToString(), level.volume.ToString(), ts.ToString()});
+    }
+    return res;
+  };
+  nlohmann::json data = nlohmann::json::object();
+  if (update.is_snapshot) {
+    data["as"] = levels(update.asks);
+    data["bs"] = levels(update.bids);
+  } else {
+    if (!update.asks.empty()) {
+      data["a"] = levels(update.asks);
+    }
+    if (!update.bids.empty()) {
+      data["b"] = levels(update.bids);
+    }
+  }
+  return nlohmann::json::array({0, data, "book-10", KrakenPair(update.symbol)}).dump();
+}
+
+}
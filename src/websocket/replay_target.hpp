@@ -0,0 +1,25 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+/**
+ * Receiver of recorded exchange messages, handled on its own thread like messages of a live
+ * connection, see FeedReplayer and WebsocketClient::start_replay().
+ */
+class ReplayTarget {
+public:
+  virtual ~ReplayTarget() {}
+
+  /**
+   * Handles the message on the target thread, after the messages injected before.
+   *
+   * @param on_handled called on the target thread once the message was handled, may be empty
+   */
+  virtual void InjectMessage(std::string payload, std::function<void()> on_handled) = 0;
+
+  /**
+   * Runs the handler on the target thread, after the messages injected before.
+   */
+  virtual void Post(std::function<void()> handler) = 0;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "json/json.hpp"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Subscription messages of exchange streams, with as many subscriptions per message as
+ * the exchange accepts, so that resubscribing after a reconnect takes a few messages.
+ */
+namespace subscription_messages {
+
+// Well below the 1024 streams of a Binance connection, keeps messages small
+constexpr size_t BINANCE_MAX_STREAMS_PER_MESSAGE = 200;
+
+/**
+ * Binance SUBSCRIBE messages of the streams, eg. "adausdt@bookTicker".
+ *
+ * @param next_id id of the first message, incremented for each message
+ */
+inline std::vector<std::string> BinanceSubscribe(const std::vector<std::string>& streams, int& next_id,
+                                                 size_t max_streams_per_message = BINANCE_MAX_STREAMS_PER_MESSAGE) {
+  std::vector<std::string> messages;
+  for (size_t begin = 0; begin < streams.size(); begin += max_streams_per_message) {
+    const size_t end = std::min(streams.size(), begin + max_streams_per_message);
+    nlohmann::json msg = {
+      {"method", "SUBSCRIBE"},
+      {"params", std::vector<std::string>(streams.begin() + begin, streams.begin() + end)},
+      {"id", next_id++}
+    };
+    messages.push_back(msg.dump());
+  }
+  return messages;
+}
+
+// Pair of a Kraken subscription with its subscription object, eg. {"name": "book", "depth": 10}
+typedef std::pair<std::string, nlohmann::json> KrakenSubscription;
+
+/**
+ * Kraken subscribe (or unsubscribe) messages of the subscriptions, one per distinct subscription
+ * object with all of its pairs, in the order the subscription objects first appear.
+ */
+inline std::vector<std::string> KrakenSubscribe(const std::vector<KrakenSubscription>& subscriptions, bool subscribe = true) {
+  std::vector<nlohmann::json> messages;
+  for (const auto& [pair, subscription] : subscriptions) {
+    auto it = std::find_if(messages.begin(), messages.end(), [&subscription = subscription](const nlohmann::json& msg) {
+      return msg["subscription"] == subscription;
+    });
+    if (it == messages.end()) {
+      messages.push_back({
+        {"event", subscribe ? "subscribe" : "unsubscribe"},
+        {"pair", nlohmann::json::array()},
+        {"subscription", subscription}
+      });
+      it = messages.end() - 1;
+    }
+    (*it)["pair"].push_back(pair);
+  }
+  std::vector<std::string> res;
+  for (const auto& msg : messages) {
+    res.push_back(msg.dump());
+  }
+  return res;
+}
+
+}
@@ -0,0 +1,39 @@
+#include "subscription_messages.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+using namespace testing;
+using json = nlohmann::json;
+
+TEST(SubscriptionMessagesTest, TestBinanceSubscribe) {
+  int id = 7;
+  const std::vector<std::string> messages = subscription_messages::BinanceSubscribe(
+      {"adausdt@bookTicker", "btcusdt@bookTicker", "ethusdt@bookTicker"}, id, 2);
+  ASSERT_EQ(2u, messages.size());
+  EXPECT_EQ(R"({"id":7,"method":"SUBSCRIBE","params":["adausdt@bookTicker","btcusdt@bookTicker"]})", messages[0]);
+  EXPECT_EQ(R"({"id":8,"method":"SUBSCRIBE","params":["ethusdt@bookTicker"]})", messages[1]);
+  EXPECT_EQ(9, id);
+
+  EXPECT_THAT(subscription_messages::BinanceSubscribe({}, id), IsEmpty());
+  EXPECT_EQ(9, id);
+}
+
+TEST(SubscriptionMessagesTest, TestKrakenSubscribe) {
+  const json book_10 = {{"name", "book"}, {"depth", 10}};
+  const json ticker = {{"name", "ticker"}};
+  const std::vector<std::string> messages = subscription_messages::KrakenSubscribe({
+    {"XBT/USDT", book_10},
+    {"ADA/USDT", ticker},
+    {"ETH/XBT", book_10},
+    {"ADA/USDT", {{"name", "book"}, {"depth", 100}}}
+  });
+  ASSERT_EQ(3u, messages.size());
+  EXPECT_EQ(json::parse(R"({"event":"subscribe","pair":["XBT/USDT","ETH/XBT"],"subscription":{"name":"book","depth":10}})"), json::parse(messages[0]));
+  EXPECT_EQ(json::parse(R"({"event":"subscribe","pair":["ADA/USDT"],"subscription":{"name":"ticker"}})"), json::parse(messages[1]));
+  EXPECT_EQ(json::parse(R"({"event":"subscribe","pair":["ADA/USDT"],"subscription":{"name":"book","depth":100}})"), json::parse(messages[2]));
+
+  const std::vector<std::string> unsubscribe = subscription_messages::KrakenSubscribe({{"XBT/USDT", book_10}}, false);
+  ASSERT_EQ(1u, unsubscribe.size());
+  EXPECT_EQ("unsubscribe", json::parse(unsubscribe[0])["event"]);
+}
@@ -1,5 +1,9 @@
 #pragma once
 #include "model/ticker.h"
+#include "replay_target.hpp"
+#include "utils/backoff.hpp"
+#include "utils/event_loop.hpp"
+#include "utils/token_bucket.hpp"
 
 #include <boost/log/trivial.hpp>
 
@@ -9,10 +13,13 @@
 
 #include <atomic>
 #include <chrono>
+#include <deque>
+#include <functional>
 #include <future>
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <thread>
 
 using namespace std::chrono_literals;
 
@@ -27,29 +34,109 @@ typedef websocketpp::config::asio_tls_client::message_type::ptr message_ptr;
 typedef websocketpp::lib::shared_ptr<boost::asio::ssl::context> context_ptr;
 typedef client::connection_ptr connection_ptr;
 
-class WebsocketClient {
+class WebsocketClient : public ReplayTarget {
 public:
+    enum class State {
+        IDLE,
+        CONNECTING,
+        OPEN,
+        // Closed, reconnecting once the backoff delay is over
+        WAITING_RECONNECT
+    };
+
+    virtual ~WebsocketClient() {
+        // Pending injected messages are dropped, derived handlers are already gone
+        if (m_replay_thread.joinable()) {
+            m_endpoint->stop();
+            m_replay_thread.join();
+        }
+    }
+
     void start(std::promise<void>&& promise) {
         m_start_promise = std::move(promise);
         start(m_uri);
     }
 
-    // Do not call from m_thread!
+    /**
+     * Runs the connection on a shared event loop instead of a thread of its own, to be called
+     * before start() or start_replay() and before subscribing. The loop must outlive the client.
+     */
+    void set_event_loop(cryptobot::EventLoop& event_loop) {
+        m_event_loop = &event_loop;
+        // Asio of an endpoint can only be initialized once
+        m_endpoint.reset(new client());
+        init_endpoint();
+    }
+
+    /**
+     * Runs the client thread without connecting, see FeedReplayer. Messages are then only
+     * injected with InjectMessage(), sends are dropped and the connection is never closed.
+     */
+    void start_replay(std::promise<void>&& promise) {
+        m_replay = true;
+        m_start_promise = std::move(promise);
+        if (m_event_loop == nullptr) {
+            m_replay_thread = std::thread(&client::run, m_endpoint.get());
+        }
+        Post([this]() {
+            on_open(websocketpp::connection_hdl());
+        });
+    }
+
+    // Stops the client thread of replay mode once injected messages are handled
+    void stop_replay() {
+        if (m_replay_thread.joinable()) {
+            m_endpoint->stop_perpetual();
+            m_replay_thread.join();
+        }
+    }
+
+    virtual void InjectMessage(std::string payload, std::function<void()> on_handled) override {
+        Post([this, payload = std::move(payload), on_handled = std::move(on_handled)]() mutable {
+            typedef websocketpp::config::asio_tls_client::message_type message_type;
+            message_ptr msg = websocketpp::lib::make_shared<message_type>(message_type::con_msg_man_ptr(), websocketpp::frame::opcode::text);
+            msg->get_raw_payload() = std::move(payload);
+            on_message(websocketpp::connection_hdl(), msg);
+            if (on_handled) {
+                on_handled();
+            }
+        });
+    }
+
+    virtual void Post(std::function<void()> handler) override {
+        m_endpoint->get_io_service().post(std::move(handler));
+    }
+
+    // Closed on the client thread, the connection then reconnects
     void close() {
-        try {
-            m_endpoint->pause_reading(m_con);
-            m_endpoint->close(m_con, websocketpp::close::status::normal, "");
-        } catch (const websocketpp::exception &e) {
-            BOOST_LOG_TRIVIAL(error) << "Exception when closing websocketpp endpoint: " << e.what();
+        if (m_replay) {
+            BOOST_LOG_TRIVIAL(warning) << m_name + ": Not closing replayed connection";
+            return;
         }
+        Post([this]() {
+            if (m_state != State::OPEN) {
+                return;
+            }
+            try {
+                m_endpoint->pause_reading(m_con);
+                m_endpoint->close(m_con, websocketpp::close::status::normal, "");
+            } catch (const websocketpp::exception &e) {
+                BOOST_LOG_TRIVIAL(error) << "Exception when closing websocketpp endpoint: " << e.what();
+            }
+        });
     }
 
     void set_do_reconnect(bool do_reconnect) {
         m_do_reconnect = do_reconnect;
     }
+
+    State get_state() const {
+        return m_state;
+    }
 protected:
     WebsocketClient(const std::string& uri, const std::string& name) :  m_uri(uri), m_name(name), m_endpoint(new client()),
-            m_do_reconnect(true), m_reconnect_delay(3000ms) {
+            m_do_reconnect(true), m_reconnect_backoff(250ms, 30000ms), m_replay(false), m_event_loop(nullptr),
+            m_state(State::IDLE), m_opened(false), m_pacing_timer_set(false) {
         init_endpoint();
     }
 
@@ -57,8 +144,13 @@ protected:
         m_endpoint->set_access_channels(websocketpp::log::alevel::all);
         m_endpoint->set_error_channels(websocketpp::log::elevel::all);
 
-        m_endpoint->init_asio();
-        m_endpoint->start_perpetual();
+        if (m_event_loop != nullptr) {
+            // Kept running by the loop
+            m_endpoint->init_asio(&m_event_loop->GetIoContext());
+        } else {
+            m_endpoint->init_asio();
+            m_endpoint->start_perpetual();
+        }
 
         //m_endpoint.set_socket_init_handler(bind(&WebsocketClient::on_socket_init,this,::_1));
         m_endpoint->set_tls_init_handler(bind(&WebsocketClient::on_tls_init,this,::_1));
@@ -70,6 +162,13 @@ protected:
     }
 
     void start(const std::string& uri) {
+        m_state = State::CONNECTING;
+        if (m_event_loop != nullptr) {
+            Post([this, uri]() {
+                connect(uri);
+            });
+            return;
+        }
         connect(uri);
         m_thread = std::make_shared<std::thread>(&client::run, m_endpoint.get());
         m_thread->detach();
@@ -81,13 +180,38 @@ protected:
 
         if (ec) {
             m_endpoint->get_alog().write(websocketpp::log::alevel::app, ec.message());
+            reconnect(websocketpp::connection_hdl());
             return;
         }
 
         m_endpoint->connect(m_con);
     }
 
+    /**
+     * Limits the rate of send_paced(), to bursts of up to burst messages refilled at messages_per_second.
+     * To be called before the connection is started.
+     */
+    void set_send_rate(double burst, double messages_per_second) {
+        m_send_bucket.emplace(burst, messages_per_second);
+    }
+
+    /**
+     * Sends the message on the client thread once the connection is open and the send rate allows,
+     * without blocking the caller. Messages pending when the connection closes are dropped, so
+     * subscriptions are to be sent again by OnOpen().
+     */
+    void send_paced(std::string message) {
+        Post([this, message = std::move(message)]() mutable {
+            m_paced_messages.push_back(std::move(message));
+            send_pending();
+        });
+    }
+
     virtual void send(const std::string& message) {
+        if (m_replay) {
+            BOOST_LOG_TRIVIAL(debug) << m_name + ": Dropping message in replay mode: " << message;
+            return;
+        }
         BOOST_LOG_TRIVIAL(debug) << m_name + ": Sending" << std::endl;
         websocketpp::lib::error_code ec;
         m_endpoint->send(m_con->get_handle(), message, websocketpp::frame::opcode::text, ec);
@@ -96,6 +220,27 @@ protected:
         }
     }
 
+    // Called on the client thread only
+    void send_pending() {
+        while (m_state == State::OPEN && !m_paced_messages.empty()) {
+            if (m_send_bucket.has_value() && !m_send_bucket->TryAcquire()) {
+                if (!m_pacing_timer_set) {
+                    m_pacing_timer_set = true;
+                    const auto wait = std::chrono::ceil<std::chrono::milliseconds>(m_send_bucket->GetWait());
+                    m_endpoint->set_timer(wait.count(), [this](const websocketpp::lib::error_code& ec) {
+                        m_pacing_timer_set = false;
+                        if (!ec) {
+                            send_pending();
+                        }
+                    });
+                }
+                return;
+            }
+            send(m_paced_messages.front());
+            m_paced_messages.pop_front();
+        }
+    }
+
     virtual context_ptr on_tls_init(websocketpp::connection_hdl) {
         context_ptr ctx = websocketpp::lib::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::tlsv12);
 
@@ -128,8 +273,15 @@ protected:
 
     virtual void on_open(websocketpp::connection_hdl conn) {
         BOOST_LOG_TRIVIAL(debug) << m_name + ": Connection opened" << std::endl;
-        m_start_promise.set_value();
+        m_state = State::OPEN;
+        m_reconnect_backoff.Reset();
+        // Only the first connection is waited for
+        if (!m_opened) {
+            m_opened = true;
+            m_start_promise.set_value();
+        }
         OnOpen(conn);
+        send_pending();
     }
 
     virtual void on_close(websocketpp::connection_hdl conn) {
@@ -138,20 +290,26 @@ protected:
         reconnect(conn);
     }
 
+    /**
+     * Schedules the next connection attempt after the backoff delay. The client thread (or the shared
+     * loop) keeps running meanwhile, it is neither stopped nor put to sleep.
+     */
     void reconnect(websocketpp::connection_hdl) {
-        // Reconnect
-        if (m_do_reconnect) {
-            m_endpoint->stop();
-            m_endpoint->reset();
-            // m_endpoint.reset(new client());
-            // init_endpoint();
-            // TODO: do we need to delay here ?
-            std::this_thread::sleep_for(m_reconnect_delay);
-            start(std::move(std::promise<void>()));
-        } else {
-            // Exit
+        m_paced_messages.clear();
+        if (!m_do_reconnect) {
+            // Left to whatever restarts the process
+            BOOST_LOG_TRIVIAL(error) << m_name << ": Connection lost and reconnecting is disabled, exiting";
             std::exit(1);
         }
+        m_state = State::WAITING_RECONNECT;
+        const auto delay = m_reconnect_backoff.Next();
+        BOOST_LOG_TRIVIAL(warning) << m_name << ": Reconnecting in " << delay.count() << " ms, attempt " << m_reconnect_backoff.GetAttempts();
+        m_endpoint->set_timer(delay.count(), [this](const websocketpp::lib::error_code& ec) {
+            if (!ec) {
+                m_state = State::CONNECTING;
+                connect(m_uri);
+            }
+        });
     }
 
     virtual void on_message(websocketpp::connection_hdl conn, client::message_ptr msg) {
@@ -184,6 +342,18 @@ protected:
     client::connection_ptr m_con;
     std::shared_ptr<std::thread> m_thread;
     bool m_do_reconnect;
-    std::chrono::duration<int64_t, std::milli> m_reconnect_delay;
+    cryptobot::ExponentialBackoff m_reconnect_backoff;
     std::promise<void> m_start_promise;
+    // Set before the replay thread starts, only read afterwards
+    bool m_replay;
+    std::thread m_replay_thread;
+    // Shared loop running the endpoint, the endpoint has a thread of its own if not set
+    cryptobot::EventLoop* m_event_loop;
+    std::atomic<State> m_state;
+    // Whether the start promise was set
+    bool m_opened;
+    // Paced messages and their rate, only used on the client thread
+    std::deque<std::string> m_paced_messages;
+    std::optional<cryptobot::TokenBucket> m_send_bucket;
+    bool m_pacing_timer_set;
 };
\ No newline at end of file